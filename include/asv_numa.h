@@ -0,0 +1,57 @@
+/*
+ * Aerospike NUMA Placement
+ *
+ * Copyright (c) 2008-2017 Aerospike, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <shared.h>
+#include <utils.h>
+
+#include <sched.h>
+
+#define NUMA_SYSFS_PATH "/sys/devices/system/node"  ///< Where the kernel lists the NUMA nodes.
+#define MAX_NUMA_NODES 64               ///< Spread the workers across up to this many NUMA
+                                        ///  nodes.
+
+///
+/// A NUMA node and its CPUs.
+///
+typedef struct {
+	uint32_t id;                        ///< The kernel's ID of the node.
+	cpu_set_t cpus;                     ///< The node's CPUs.
+	uint32_t n_cpus;                    ///< The number of CPUs in cpus.
+} numa_node;
+
+///
+/// The NUMA nodes that the workers are spread across.
+///
+typedef struct {
+	numa_node nodes[MAX_NUMA_NODES];    ///< The nodes that have CPUs, by ascending ID.
+	uint32_t n_nodes;                   ///< The number of elements in nodes.
+} numa_topology;
+
+bool numa_init(numa_topology *topo);
+bool numa_thread_attr(const numa_topology *topo, uint32_t index, pthread_attr_t *attr);
+int32_t numa_current_node(const numa_topology *topo);
+void numa_bind(const numa_topology *topo, int32_t node, void *mem, size_t size);
@@ -24,15 +24,68 @@
 
 #pragma once
 
+#include <index.h>
+#include <metrics.h>
+#include <msgpack_in.h>
+#include <asv_numa.h>
 #include <shared.h>
+#include <uring.h>
+#include <utils.h>
 
 #define DEFAULT_FILE_LIMIT 250                      ///< By default, start a new backup file when
                                                     ///  the current backup file crosses this size
                                                     ///  in MiB.
+#define ROTATE_PREOPEN_PERCENT 50                   ///< Pre-open a node's next backup file when its
+                                                    ///  current backup file reaches this percentage
+                                                    ///  of the file size limit.
+#define SAMPLE_Z 1.96                               ///< The normal quantile for the 95% confidence
+                                                    ///  intervals reported in sampling mode.
+
+#define STATE_CLOCK_MARGIN 60                       ///< The number of seconds that the incremental
+                                                    ///  validation watermark is moved back to
+                                                    ///  tolerate clock skew.
+
+#define CDT_FIX_MAX_TRIES 3                         ///< Maximal number of tries for a fix that
+                                                    ///  keeps losing against concurrent writes.
+
+#define MAP_FIX_KEEP_FIRST 0x01                     ///< --map-fix: of several pairs with equal keys,
+                                                    ///  keep the first one.
+#define MAP_FIX_KEEP_LAST 0x02                      ///< --map-fix: of several pairs with equal keys,
+                                                    ///  keep the last one.
+#define MAP_FIX_DROP_NONSTORAGE 0x04                ///< --map-fix: drop the pairs that contain
+                                                    ///  non-storage elements.
+
+#define DEFAULT_QUEUE_MEMORY 256                    ///< By default, cap the memory held by records
+                                                    ///  queued for the validation pool at this many
+                                                    ///  MiB.
+#define MAX_VALIDATION_THREADS 256                  ///< Allow up to this many validation pool
+                                                    ///  threads.
+
+#define VERDICT_SHARDS 64                           ///< The number of independently locked shards
+                                                    ///  of the verdict cache.
+#define MAX_VERDICT_ENTRIES 100000000               ///< Allow the verdict cache to hold up to this
+                                                    ///  many verdicts.
+
+#define DEFAULT_RECHECK_BATCH 5000                  ///< By default, --recheck reads this many
+                                                    ///  records per batch.
+#define MAX_RECHECK_BATCH 100000                    ///< Allow --recheck batches of up to this many
+                                                    ///  records.
+
 #define DEFAULT_PARALLEL 10                         ///< By default, backup up to this many nodes in
                                                     ///  parallel.
 #define MAX_PARALLEL 100                            ///< Allow up to this many nodes to be backed up
                                                     ///  in parallel.
+#define ADAPT_INTERVAL 5                            ///< With --adaptive-parallel, reconsider the
+                                                    ///  number of concurrent scans every this many
+                                                    ///  seconds.
+#define ADAPT_GAIN 5                                ///< Only keep an additional scan, if it raised
+                                                    ///  the record rate by this many percent.
+#define ADAPT_LATENCY_FACTOR 2                      ///< Back off when the latency exceeds the
+                                                    ///  lowest observed latency by this factor.
+#define ADAPT_MIN_LATENCY 50                        ///< Ignore latencies below this many
+                                                    ///  microseconds as noise.
+#define ADAPT_HOLD 6                                ///< After finding the plateau, wait this many
+                                                    ///  intervals before probing again.
 
 ///
 /// The interface exposed by the backup file format encoder.
@@ -45,12 +98,21 @@ typedef struct {
 	/// @param fd       The file descriptor of the backup file.
 	/// @param compact  If true, don't use base-64 encoding on BLOB bin values.
 	/// @param rec      The record to be written.
+	/// @param buf      The caller-owned scratch buffer that the record is formatted into before
+	///                 it is written with a single write call. Reused across records.
 	///
 	/// @result         `true`, if successful.
 	///
-	bool (*put_record)(uint64_t *bytes, FILE *fd, bool compact, const as_record *rec);
+	bool (*put_record)(uint64_t *bytes, FILE *fd, bool compact, const as_record *rec,
+			output_buffer *buf);
 } backup_encoder;
 
+///
+/// A shard of the verdict cache, which maps the hashes of CDT bin values to their validation
+/// verdicts. Defined in backup.c.
+///
+typedef struct verdict_shard_s verdict_shard;
+
 typedef struct cdt_stats_s {
 	cf_atomic32 count;
 	cf_atomic32 fixed;
@@ -59,13 +121,137 @@ typedef struct cdt_stats_s {
 	cf_atomic32 nf_failed;
 	cf_atomic32 nf_order;
 	cf_atomic32 nf_padding;
+	cf_atomic32 nf_dupkey; // map only, with a --map-fix policy
+	cf_atomic32 nf_nonstorage; // map only, with a --map-fix policy
 
 	cf_atomic32 cannot_fix;
 	cf_atomic32 cf_dupkey; // map only
 	cf_atomic32 cf_nonstorage;
 	cf_atomic32 cf_corrupt;
+
+	cf_atomic32 fix_retries; // fixes retried after a concurrent write
+	cf_atomic64 fix_bytes; // bytes written by successful fixes
 } cdt_stats;
 
+///
+/// The normalized key of the previous element of an ordered CDT. Carried from one comparison to
+/// the next by cdt_cmp_next(), so that each element is only parsed once.
+///
+typedef struct {
+	msgpack_key key;                    ///< The normalized element.
+	uint32_t end;                       ///< The offset just past the element.
+	bool valid;                         ///< `false`, if the element isn't a scalar.
+} cdt_prev_key;
+
+///
+/// A normalized CDT element along with its offset, sorted when rebuilding ordered lists and
+/// checking maps for duplicate keys.
+///
+typedef struct {
+	msgpack_key key;                    ///< The normalized element.
+	uint32_t off;                       ///< The offset of the element.
+} cdt_key_ele;
+
+#define N_LATENCY_BUCKETS 12                        ///< The number of fix latency histogram
+                                                    ///  buckets, not counting +Inf.
+
+///
+/// The phases that --profile attributes the validation threads' wall time to.
+///
+typedef enum {
+	PHASE_NETWORK,      ///< Waiting for the next record from the node scan.
+	PHASE_CHECK,        ///< Checking the record's CDTs and computing repairs.
+	PHASE_FIX,          ///< Writing repairs to the cluster, including re-reads and retries.
+	PHASE_STORE,        ///< Writing invalid records to the output file.
+	PHASE_THROTTLE,     ///< Waiting for --bandwidth.
+	PHASE_ROTATE,       ///< Closing the full output file and opening the next one.
+	PHASE_QUEUE,        ///< Waiting for room in the validation pool's queue.
+	N_PHASES
+} profile_phase;
+
+#define PROFILE_INTERVAL 10                         ///< Log the --profile breakdown every this many
+                                                    ///  seconds.
+
+///
+/// The per-node counters exposed by the metrics endpoint.
+///
+typedef struct {
+	char node_name[AS_NODE_NAME_SIZE];  ///< The node ID of the cluster node.
+	cf_atomic64 rec_count_checked;      ///< The number of records checked from this node.
+	cf_atomic64 byte_count;             ///< The number of bytes written for this node.
+	uint64_t rec_count_prev;            ///< The counter thread's previous rec_count_checked.
+	volatile uint64_t rec_rate;         ///< The records checked per second, updated by the
+	                                    ///  counter thread.
+	cf_atomic64 phase_us[N_PHASES];     ///< With --profile, the total time spent per phase, summed
+	                                    ///  over all threads that worked for this node.
+	uint64_t phase_prev[N_PHASES];      ///< The counter thread's previous phase_us.
+} node_metrics;
+
+#define MAX_TARGETS 64                              ///< Allow up to this many namespace and set
+                                                    ///  combinations in a single run.
+#define STATE_LINE_SIZE (MAX_TARGETS * AS_SET_MAX_SIZE)  ///< The maximal size of the namespace
+                                                        ///  and set lines of the state file.
+
+///
+/// A namespace and set to be validated, along with its scan and its share of the stats.
+///
+typedef struct {
+	char ns[AS_NAMESPACE_MAX_SIZE];     ///< The namespace.
+	char set[AS_SET_MAX_SIZE];          ///< The set. Empty for all sets.
+	as_scan scan;                       ///< A copy of the shared scan for this namespace and set.
+	                                    ///  Shares the bin selection and the predicate
+	                                    ///  expressions with the original, so it's never
+	                                    ///  destroyed.
+	uint64_t rec_count_estimate;        ///< The estimated number of records to be validated.
+	uint64_t *node_counts;              ///< The estimated number of records per node, as returned
+	                                    ///  by get_object_count().
+	cf_atomic64 rec_count_checked;      ///< The number of records checked so far.
+	cf_atomic64 rec_count_total;        ///< The number of invalid records found so far.
+	cdt_stats cdt_list;                 ///< The list counters.
+	cdt_stats cdt_map;                  ///< The map counters.
+} scan_target;
+
+///
+/// The counter thread's state of the --adaptive-parallel controller.
+///
+typedef struct {
+	uint64_t recs_prev;                 ///< rec_count_checked at the last step.
+	uint64_t net_us_prev;               ///< The summed network phase time at the last step.
+	uint64_t fix_us_prev;               ///< fix_latency_us at the last step.
+	uint64_t fix_count_prev;            ///< The number of fix operates at the last step.
+	uint64_t rate_prev;                 ///< The record rate of the last step.
+	uint64_t base_latency;              ///< The lowest per-record scan latency seen so far.
+	uint64_t base_fix_latency;          ///< The lowest fix latency seen so far.
+	int32_t last_step;                  ///< The last change to the scan limit: -1, 0, or +1.
+	uint32_t hold;                      ///< The number of steps to wait before probing again.
+} adapt_state;
+
+///
+/// The simulated repairs of a fix dry run for one set.
+///
+typedef struct {
+	char set[AS_SET_MAX_SIZE];          ///< The set name. Empty for records without a set.
+	uint64_t records;                   ///< The records that would be written.
+	uint64_t bins;                      ///< The CDT bins that would be rewritten.
+	uint64_t failed;                    ///< The CDT bins whose repair could not be computed.
+	uint64_t bytes_reclaimed;           ///< The bytes the repairs would remove.
+	uint64_t dup_elements;              ///< The duplicate list elements and map pairs the
+	                                    ///  repairs would drop.
+	uint64_t nonstorage_elements;       ///< The map pairs with non-storage elements the repairs
+	                                    ///  would drop.
+	uint64_t write_bytes;               ///< The bytes the repairs would write.
+} dry_run_stats;
+
+///
+/// The repairs collected for a record by cdt_collect_fixes().
+///
+typedef struct {
+	uint32_t list_fixes;                ///< The number of list bins to be rewritten.
+	uint32_t map_fixes;                 ///< The number of map bins to be rewritten.
+	uint64_t list_bytes;                ///< The size of the rewritten list bin values.
+	uint64_t map_bytes;                 ///< The size of the rewritten map bin values.
+} fix_counts;
+
 ///
 /// The global backup configuration and stats shared by all backup threads and the counter thread.
 ///
@@ -77,15 +263,19 @@ typedef struct {
 	char *password;
 	bool remove_files;
 	char *bin_list;
+	const char **fix_bins;              ///< With -B, the `NULL`-terminated bins to be re-read
+	                                    ///  before retrying a fix. `NULL` for all bins.
 	char *node_list;
 	int64_t mod_after;
 	int64_t mod_before;
+	char *state_file;                   ///< The state file for incremental validation. `NULL`,
+	                                    ///  if not validating incrementally.
 
 	as_config_tls tls;
 
 	aerospike *as;                      ///< The Aerospike client to be used for the node scans.
 	as_policy_scan *policy;             ///< The scan policy to be used for the node scans.
-	as_scan *scan;                      ///< The scan configuration to be used for the node scans.
+	as_scan *scan;                      ///< The shared scan configuration. Copied into each target.
 	char *directory;                    ///< The backup directory. `NULL`, when backing up to a
 	                                    ///  single file.
 	char *output_file;                  ///< The backup file. `NULL`, when backing up to a
@@ -97,6 +287,12 @@ typedef struct {
 	uint64_t bandwidth;                 ///< The B/s cap for throttling.
 	uint64_t file_limit;                ///< Start a new backup file when the current backup file
 	                                    ///  crosses this size.
+	uint32_t index_interval;            ///< Write an offset index for each backup file, with a
+	                                    ///  checkpoint every this many records. 0 disables the
+	                                    ///  offset indexes.
+	bool uring;                         ///< Writes the backup files through io_uring.
+	bool numa;                          ///< Pins the worker threads to NUMA nodes.
+	numa_topology *numa_topo;           ///< With --numa, the NUMA nodes. `NULL` otherwise.
 	backup_encoder *encoder;            ///< The file format encoder to be used for writing data to
 	                                    ///  a backup file.
 	uint64_t rec_count_estimate;        ///< The number of objects to be backed up. This can change
@@ -111,11 +307,100 @@ typedef struct {
 	char *auth_mode;					///< Authentication mode
 
 	bool cdt_fix;
+	bool cdt_fix_dry_run;               ///< Computes the list repairs without applying them.
+	uint32_t map_fix;                   ///< The MAP_FIX_* policies that make maps with duplicate
+	                                    ///  keys or non-storage elements fixable. 0 leaves them
+	                                    ///  unfixable.
+	as_vector dry_run_sets;             ///< The per-set dry_run_stats of a fix dry run.
+	uint32_t sample;                    ///< The percentage of records to be validated. Less than
+	                                    ///  100 selects sampling mode, which reports estimated
+	                                    ///  rates instead of exact counts.
+	uint32_t validation_threads;        ///< The size of the validation pool. 0 validates records
+	                                    ///  inline on the client threads that receive the scans.
+	uint64_t queue_memory;              ///< The cap for the memory held by records queued for the
+	                                    ///  validation pool. Scan callbacks block while it is
+	                                    ///  exceeded.
+	cf_queue *record_queue;             ///< The queued_record elements waiting for the validation
+	                                    ///  pool.
+	cf_atomic64 queue_bytes;            ///< The memory currently held by queued records.
+	uint32_t verdict_entries;           ///< The capacity of the verdict cache. 0 disables it.
+	verdict_shard *verdict_cache;       ///< The VERDICT_SHARDS shards of the verdict cache.
+	cf_atomic64 verdict_hits;           ///< The number of CDT checks answered by the cache.
+	cf_atomic64 verdict_misses;         ///< The number of CDT checks that had to validate.
+
+	char *metrics;                      ///< The listen address of the metrics endpoint. `NULL`, if
+	                                    ///  disabled.
+	node_metrics *node_metrics;         ///< The per-node counters, one for each scanned node.
+	uint32_t n_node_metrics;            ///< The number of elements in node_metrics.
+	cf_queue *job_queue;                ///< The nodes that haven't been picked up by a backup
+	                                    ///  thread yet.
+	cf_queue *rotate_queue;             ///< When backing up to a directory, the rotate_job
+	                                    ///  elements waiting for the rotation thread.
+	cf_atomic64 fix_latency[N_LATENCY_BUCKETS + 1]; ///< The fix operate latency histogram.
+	cf_atomic64 fix_latency_us;         ///< The total fix operate latency.
+	cf_atomic64 throttle_us;            ///< The total time spent waiting for bandwidth.
+	bool profile;                       ///< Attributes the validation threads' time to phases
+	                                    ///  and periodically logs the breakdown per node.
+	bool phase_timing;                  ///< Takes the phase timings. Needed by --profile and
+	                                    ///  --adaptive-parallel.
+	bool adaptive;                      ///< Adapts the number of concurrent node scans to the
+	                                    ///  observed throughput and latency.
+	uint32_t scan_limit;                ///< With --adaptive-parallel, the current maximal number of
+	                                    ///  concurrent node scans. Protected by the global lock.
+	uint32_t active_scans;              ///< The number of running node scans. Protected by the
+	                                    ///  global lock.
+	uint32_t max_scans;                 ///< The number of backup threads, i.e., the upper bound
+	                                    ///  for scan_limit.
+	cf_clock first_scan_ms;             ///< When the first node scan started. Protected by the
+	                                    ///  global lock.
+	cf_clock last_scan_ms;              ///< When the last node scan ended. Protected by the global
+	                                    ///  lock.
+	uint64_t scan_busy_ms;              ///< The total duration of all node scans. Protected by the
+	                                    ///  global lock.
+	uint64_t longest_scan_ms;           ///< The duration of the longest node scan. Protected by the
+	                                    ///  global lock.
+
+	char *recheck;                      ///< The digest list to be rechecked instead of scanning.
+	                                    ///  `NULL`, if scanning.
+	uint32_t recheck_batch;             ///< The number of records per --recheck batch read.
 
-	cdt_stats cdt_list;
-	cdt_stats cdt_map;
+	char *ns_list;                      ///< The namespaces to be validated, `ns[/set][,...]`.
+	char *set_list;                     ///< The sets to be validated, `set[,...]`, for namespaces
+	                                    ///  without an explicit set.
+	scan_target *targets;               ///< The namespaces and sets to be validated.
+	uint32_t n_targets;                 ///< The number of elements in targets.
 } backup_config;
 
+///
+/// A record to be rechecked.
+///
+typedef struct {
+	uint8_t digest[AS_DIGEST_VALUE_SIZE];   ///< The record's digest.
+	uint32_t ns;                        ///< The index of the record's namespace in
+	                                    ///  recheck_state.namespaces.
+} recheck_key;
+
+///
+/// The digest list of a --recheck run and its stats, shared by the recheck threads.
+///
+typedef struct {
+	backup_config *conf;                ///< The global backup configuration and stats.
+	as_vector namespaces;               ///< The namespaces of the records, as
+	                                    ///  `char[AS_NAMESPACE_MAX_SIZE]` elements.
+	as_vector keys;                     ///< The recheck_key elements, sorted and without
+	                                    ///  duplicates.
+	const char **bins;                  ///< The bins to be read, from -B. `NULL` for all bins.
+	uint32_t n_bins;                    ///< The number of elements in bins.
+	cf_atomic64 next;                   ///< The index of the first key of the next batch to be
+	                                    ///  claimed by a recheck thread.
+	cf_atomic64 found;                  ///< The number of records read.
+	cf_atomic64 missing;                ///< The number of records that don't exist anymore.
+	cf_atomic64 failed;                 ///< The number of records that couldn't be read.
+	cf_atomic64 broken;                 ///< The number of records that still have a broken CDT.
+	cdt_stats cdt_list;                 ///< The list counters.
+	cdt_stats cdt_map;                  ///< The map counters.
+} recheck_state;
+
 ///
 /// The per-node information pushed to the job queue and picked up by the backup threads.
 ///
@@ -127,8 +412,22 @@ typedef struct {
 	uint64_t bytes;                     ///< When backing up to a single file, the number of bytes
 	                                    ///  that were written when open_file() created that file
 	                                    ///  (version header, meta data).
+	node_metrics *metrics;              ///< The cluster node's metrics.
+	scan_target *target;                ///< The namespace and set to be scanned.
+	uint64_t rec_count_estimate;        ///< The estimated number of records. Orders the jobs
+	                                    ///  largest-first.
 } backup_thread_args;
 
+///
+/// The states of a node's pre-opened next backup file.
+///
+typedef enum {
+	NEXT_NONE,          ///< Not requested. Only the node's own thread leaves this state.
+	NEXT_PENDING,       ///< Requested, but the rotation thread hasn't opened it yet.
+	NEXT_READY,         ///< Opened and waiting to be used.
+	NEXT_FAILED         ///< The rotation thread couldn't open it.
+} next_file_state;
+
 ///
 /// The per-node context for information about the currently processed cluster node. Each backup
 /// thread creates one of these for each node that it scans.
@@ -143,6 +442,7 @@ typedef struct {
 	                                    ///  currently processed cluster node.
 	void *fd_buf;                       ///< When backing up to a directory, the I/O buffer
 	                                    ///  associated with the current backup file descriptor.
+	output_buffer *out_buf;             ///< The validation thread's record formatting buffer.
 	uint32_t file_count;                ///< When backing up to a directory, counts the number of
 	                                    ///  backup files created for the currently processed
 	                                    ///  cluster node.
@@ -156,4 +456,50 @@ typedef struct {
 	                                    ///  processed cluster node.
 	uint64_t byte_count_node;           ///< Counts the number of bytes written to all backup files
 	                                    ///  for the currently processed cluster node.
+	pthread_mutex_t out_lock;           ///< With a validation pool, serializes the pool threads'
+	                                    ///  output to this node's backup file and counters.
+	cf_atomic32 pending;                ///< With a validation pool, the number of records of this
+	                                    ///  node that are still queued or being validated.
+	node_metrics *metrics;              ///< The node's metrics. Copied from
+	                                    ///  backup_thread_args.metrics.
+	scan_target *target;                ///< The namespace and set being scanned. Copied from
+	                                    ///  backup_thread_args.target.
+	cf_clock phase_mark;                ///< With --profile, when the scan callback last returned.
+	cf_atomic32 next_state;             ///< The next_file_state of the pre-opened next backup
+	                                    ///  file. Changed under the global lock.
+	FILE *next_fd;                      ///< The file descriptor of the pre-opened next backup
+	                                    ///  file, if NEXT_READY.
+	void *next_fd_buf;                  ///< The I/O buffer of the pre-opened next backup file.
+	uint64_t next_bytes;                ///< The header size of the pre-opened next backup file.
+	int32_t numa_node;                  ///< With --numa, the index of the validation thread's
+	                                    ///  NUMA node in backup_config.numa_topo. -1 otherwise.
+	file_index *index;                  ///< The offset index of the current backup file. `NULL`
+	                                    ///  without offset indexes.
 } per_node_context;
+
+///
+/// A job for the rotation thread: either close a full backup file or pre-open a node's next one.
+///
+typedef struct {
+	per_node_context *pnc;              ///< The node whose next backup file is to be opened.
+	                                    ///  `NULL` for closing a backup file.
+	uint32_t index;                     ///< The file number of the backup file to be opened.
+	FILE *fd;                           ///< The backup file to be closed. `NULL`, together with
+	                                    ///  a `NULL` pnc, tells the rotation thread to exit.
+	void *fd_buf;                       ///< The I/O buffer of the backup file to be closed.
+	uint64_t size;                      ///< The size of the backup file to be closed.
+	file_index *idx;                    ///< The offset index of the backup file to be closed,
+	                                    ///  written once the file is closed. `NULL`, if none.
+	char *idx_path;                     ///< The path of the backup file to be closed. Only set
+	                                    ///  with an offset index.
+} rotate_job;
+
+///
+/// A record handed from a scan callback to the validation pool.
+///
+typedef struct {
+	as_record *rec;                     ///< The heap copy of the record made by the scan callback.
+	                                    ///  `NULL` tells a pool thread to exit.
+	per_node_context *pnc;              ///< The context of the node that the record came from.
+	uint64_t mem_size;                  ///< The record's estimated memory footprint.
+} queued_record;
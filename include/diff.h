@@ -0,0 +1,90 @@
+/*
+ * Aerospike Validation Run Diff
+ *
+ * Copyright (c) 2008-2017 Aerospike, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <index.h>
+#include <shared.h>
+#include <utils.h>
+
+#include <sys/resource.h>
+
+#define DIFF_BLOCK 64                   ///< The number of records that a stream reads from its
+                                        ///  offset index at a time.
+#define DIFF_MAX_OPEN 1024              ///< Each run keeps at most this many offset indexes open
+                                        ///  between reads.
+#define DIFF_RESERVED_FDS 32            ///< File descriptors left for anything but the offset
+                                        ///  indexes that are kept open.
+
+///
+/// How a record changed between two validation runs.
+///
+typedef enum {
+	DIFF_NEW,           ///< Only found by the second run: newly broken.
+	DIFF_STILL,         ///< Found by both runs: still broken.
+	DIFF_REPAIRED,      ///< Only found by the first run: repaired (or deleted).
+	DIFF_N_KINDS
+} diff_kind;
+
+///
+/// The records of a single output file in digest order, read from the file's offset index.
+///
+typedef struct {
+	char *path;                         ///< The output file.
+	char ns[AS_NAMESPACE_MAX_SIZE];     ///< The namespace of the output file's records.
+	index_reader reader;                ///< Reads the output file's offset index. Only keeps the
+	                                    ///  file open between reads, if keep_open.
+	bool keep_open;                     ///< The stream is one of the run's streams that may keep
+	                                    ///  their offset index open. The others reopen it for
+	                                    ///  each block.
+	index_entry block[DIFF_BLOCK];      ///< The records read ahead from the offset index.
+	uint32_t block_size;                ///< The number of records in block.
+	uint32_t block_pos;                 ///< The position of the next record in block.
+	index_entry cur;                    ///< The stream's current record.
+} diff_stream;
+
+///
+/// The records of a validation run in namespace and digest order, merged from the streams of
+/// its output files. Memory only grows with the number of output files, not with the number of
+/// records. The number of open files is bounded by the `max_open` argument of run_open().
+///
+typedef struct {
+	const char *name;                   ///< The run's output directory or output file.
+	diff_stream *streams;               ///< One stream per output file.
+	uint32_t n_streams;                 ///< The number of elements in streams.
+	diff_stream **heap;                 ///< The streams with records left, as a min-heap.
+	uint32_t heap_size;                 ///< The number of elements in heap.
+	const char *prev_ns;                ///< The namespace of the last returned record.
+	uint8_t prev_digest[AS_DIGEST_VALUE_SIZE];  ///< The digest of the last returned record.
+	uint64_t n_records;                 ///< The number of distinct records returned so far.
+} diff_run;
+
+///
+/// A record returned by a diff_run.
+///
+typedef struct {
+	const diff_stream *stream;          ///< The stream of the output file that has the record.
+	index_entry entry;                  ///< The record's digest and offset.
+} diff_record;
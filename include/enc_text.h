@@ -25,5 +25,7 @@
 #pragma once
 
 #include <shared.h>
+#include <utils.h>
 
-bool text_put_record(uint64_t *bytes, FILE *fd, bool compact, const as_record *rec);
+bool text_put_record(uint64_t *bytes, FILE *fd, bool compact, const as_record *rec,
+		output_buffer *buf);
@@ -0,0 +1,103 @@
+/*
+ * Aerospike Validation Corpus Generator
+ *
+ * Copyright (c) 2008-2017 Aerospike, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <shared.h>
+#include <spec.h>
+#include <utils.h>
+
+#define DEFAULT_SPEC_FILE "spec.txt"    ///< The default specification file.
+#define DEFAULT_GEN_NAMESPACE "test"    ///< The default namespace of the generated records.
+#define DEFAULT_GEN_THREADS 4           ///< The default number of generator threads.
+#define DEFAULT_GEN_FILE_LIMIT 250      ///< By default, start a new file when the current file
+                                        ///  crosses this size (in MiB).
+#define GEN_CHUNK 65536                 ///< The number of records a generator thread claims at a
+                                        ///  time.
+#define MAX_GEN_PADDING 8               ///< The maximal number of garbage bytes appended to a
+                                        ///  padded CDT.
+
+///
+/// The kinds of broken CDTs that can be generated.
+///
+typedef enum {
+	BREAK_NONE,         ///< A valid CDT.
+	BREAK_ORDER,        ///< An ordered list or key-ordered map with elements out of order.
+	BREAK_PADDING,      ///< Garbage bytes after the CDT.
+	BREAK_DUPKEY,       ///< A map with a duplicate key.
+	BREAK_NONSTORAGE,   ///< A CDT that contains a non-storage ext value (wildcard).
+	BREAK_N_KINDS
+} break_kind;
+
+///
+/// The generator configuration and stats shared by all generator threads.
+///
+typedef struct {
+	const spec_record *spec;            ///< The record specification.
+	char (*bin_names)[AS_BIN_NAME_MAX_SIZE];    ///< The bin names of the generated records.
+	char *directory;                    ///< The output directory.
+	char ns[AS_NAMESPACE_MAX_SIZE];     ///< The namespace of the generated records.
+	char set[AS_SET_MAX_SIZE];          ///< The set of the generated records.
+	uint64_t count;                     ///< The number of records to be generated.
+	uint64_t first_key;                 ///< The integer key of the first record.
+	uint64_t seed;                      ///< Seeds the pseudo-random values. The same seed
+	                                    ///  yields the same records.
+	uint32_t threads;                   ///< The number of generator threads.
+	uint64_t file_limit;                ///< Start a new file when the current file crosses this
+	                                    ///  size.
+	uint32_t broken;                    ///< The percentage of records with a broken CDT bin.
+	uint32_t kinds;                     ///< The break_kind bit mask of the enabled kinds.
+	bool raw;                           ///< Write length-prefixed msgpack CDT values instead of
+	                                    ///  a validation file.
+	bool compact;                       ///< Disables base-64 encoding for BLOB bin values.
+	uint32_t bench;                     ///< With a non-zero value, format each record this many
+	                                    ///  times to `/dev/null` and measure the encoder.
+
+	cf_atomic64 next;                   ///< The index of the next record to be claimed.
+	cf_atomic64 rec_count;              ///< The number of records generated so far.
+	cf_atomic64 byte_count;             ///< The number of bytes written so far.
+	cf_atomic64 broken_count[BREAK_N_KINDS];    ///< The number of records broken per kind.
+	cf_atomic32 done;                   ///< The number of generator threads that finished.
+	cf_atomic32 failed;                 ///< The number of generator threads that failed.
+} gen_config;
+
+///
+/// The state of a generator thread.
+///
+typedef struct {
+	gen_config *conf;                   ///< The generator configuration and stats.
+	uint32_t index;                     ///< The thread's index, used in its file names.
+	uint64_t rnd;                       ///< The pseudo-random state of the current record.
+	FILE *fd;                           ///< The current output file.
+	void *fd_buf;                       ///< The I/O buffer of the current output file.
+	uint32_t file_count;                ///< The number of files started so far.
+	uint64_t byte_count_file;           ///< The size of the current output file.
+	uint64_t byte_count_done;           ///< The total size of the closed output files.
+	output_buffer vals;                 ///< The generated bin values of the current record.
+	output_buffer out;                  ///< The formatted current record.
+	uint32_t *bin_offs;                 ///< The offsets of the bin values in `vals`.
+	as_record rec;                      ///< The current record. Reused for all records.
+	uint64_t bench_recs;                ///< The number of records formatted in benchmark mode.
+	uint64_t bench_ns;                  ///< The thread CPU time spent formatting them.
+} gen_context;
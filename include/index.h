@@ -0,0 +1,84 @@
+/*
+ * Aerospike Backup File Offset Index
+ *
+ * Copyright (c) 2008-2017 Aerospike, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <shared.h>
+#include <utils.h>
+
+#define BACKUP_FILE_SUFFIX ".asb"      ///< The suffix of the backup files in a backup directory.
+#define INDEX_SUFFIX ".idx"             ///< Appended to the path of a backup file to get the path
+                                        ///  of its offset index.
+#define INDEX_MAGIC "ASBIDX01"          ///< Identifies an offset index file. 8 bytes, no NUL.
+#define INDEX_HEADER_SIZE 28            ///< Magic, checkpoint interval (4 bytes), number of
+                                        ///  digests (8 bytes), number of checkpoints (8 bytes).
+#define INDEX_ENTRY_SIZE (AS_DIGEST_VALUE_SIZE + 8) ///< Digest, record offset (8 bytes).
+#define MAX_INDEX_INTERVAL 1000000000   ///< The maximal checkpoint interval.
+
+///
+/// Locates a record in a backup file.
+///
+typedef struct {
+	uint8_t digest[AS_DIGEST_VALUE_SIZE];   ///< The record's digest.
+	uint64_t offset;                    ///< The offset of the record in the backup file.
+} index_entry;
+
+///
+/// The offset index of a backup file, collected while the file is written.
+///
+/// On disk, all integers are big-endian. The header is followed by the digests, sorted, so that
+/// they can be binary-searched, and then by the checkpoints, in file order, i.e., the offsets of
+/// records 0, interval, 2 * interval, etc., which allow for splitting a file into equal parts.
+///
+typedef struct {
+	uint32_t interval;                  ///< Add a checkpoint every this many records.
+	uint64_t offset;                    ///< The current size of the backup file, i.e., the offset
+	                                    ///  of the next record.
+	as_vector entries;                  ///< The index_entry elements, in file order.
+	as_vector checkpoints;              ///< The uint64_t offsets of every interval-th record.
+} file_index;
+
+///
+/// Reads the digests of an offset index file in digest order.
+///
+typedef struct {
+	FILE *fd;                           ///< The offset index file.
+	uint32_t interval;                  ///< The checkpoint interval.
+	uint64_t n_entries;                 ///< The number of digests in the file.
+	uint64_t n_checkpoints;             ///< The number of checkpoints in the file.
+	uint64_t next;                      ///< The number of digests read so far.
+} index_reader;
+
+void index_init(file_index *index, uint32_t interval);
+void index_reset(file_index *index, uint64_t offset);
+void index_add(file_index *index, const as_digest *digest, uint64_t bytes);
+bool index_write(file_index *index, const char *file_path);
+void index_free(file_index *index);
+bool index_open(index_reader *ir, const char *file_path);
+bool index_reopen(index_reader *ir, const char *file_path);
+bool index_next(index_reader *ir, index_entry *entry);
+void index_close(index_reader *ir);
+bool index_namespace(const char *path, char *ns, size_t size);
+bool index_backup_files(const char *name, as_vector *paths);
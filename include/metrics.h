@@ -0,0 +1,60 @@
+/*
+ * Aerospike Metrics Endpoint
+ *
+ * Copyright (c) 2008-2017 Aerospike, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <shared.h>
+#include <utils.h>
+
+#define METRICS_UNIX_PREFIX "unix:"     ///< Selects a Unix domain socket as the listen address.
+#define METRICS_DEFAULT_HOST "127.0.0.1"    ///< The default host to listen on.
+#define METRICS_MAX_REQUEST 4096        ///< The maximal size of a request that we read.
+
+///
+/// Formats the current metrics in the Prometheus text format.
+///
+/// @param buf    The output buffer. Formatting appends to the buffer's current contents.
+/// @param udata  The user data passed to metrics_start().
+///
+/// @result       `true`, if successful.
+///
+typedef bool (*metrics_render)(output_buffer *buf, void *udata);
+
+///
+/// A metrics endpoint that answers every HTTP request with the current metrics.
+///
+typedef struct {
+	int32_t fd;                         ///< The listening socket.
+	char *unix_path;                    ///< The path of the Unix domain socket, if any.
+	pthread_t thread;                   ///< The thread that serves the requests.
+	volatile bool stop;                 ///< Makes the serving thread exit.
+	metrics_render render;              ///< Formats the metrics.
+	void *udata;                        ///< The user data passed to `render`.
+} metrics_server;
+
+bool metrics_start(metrics_server *srv, const char *listen_addr, metrics_render render,
+		void *udata);
+void metrics_stop(metrics_server *srv);
+bool metrics_printf(output_buffer *buf, const char *format, ...)
+		__attribute__ ((format (printf, 2, 3)));
@@ -28,6 +28,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 
 //==========================================================
@@ -78,6 +79,17 @@ typedef enum {
 	MSGPACK_N_TYPES
 } msgpack_type;
 
+// Scalar element normalized for comparison. Keys compare like the elements
+// under msgpack_cmp(): type rank first, then the order-preserving prefix,
+// then - for strings, bytes and geojson - the rest of the contents and the
+// length.
+typedef struct msgpack_key_s {
+	uint64_t prefix;		// ints as is, ordered double bits, or first 8 bytes
+	const uint8_t *data;	// string/bytes/geojson contents, NULL otherwise
+	uint32_t len;			// size of contents
+	msgpack_type type;		// type rank
+} msgpack_key;
+
 
 //==========================================================
 // Public API.
@@ -139,3 +151,33 @@ msgpack_buf_get_list_ele_count(const uint8_t *buf, uint32_t buf_sz,
 	return msgpack_get_list_ele_count(&mp, count_r);
 }
 bool msgpack_get_map_ele_count(msgpack_in *mp, uint32_t *count_r);
+
+bool msgpack_get_key(msgpack_in *mp, msgpack_key *key);
+static inline msgpack_cmp_type
+msgpack_key_cmp(const msgpack_key *key0, const msgpack_key *key1)
+{
+	if (key0->type != key1->type) {
+		return key0->type < key1->type ? MSGPACK_CMP_LESS : MSGPACK_CMP_GREATER;
+	}
+
+	if (key0->prefix != key1->prefix) {
+		return key0->prefix < key1->prefix ?
+				MSGPACK_CMP_LESS : MSGPACK_CMP_GREATER;
+	}
+
+	// Equal prefixes - only contents beyond the first 8 bytes can differ.
+	if (key0->len > 8 && key1->len > 8) {
+		uint32_t len = key0->len < key1->len ? key0->len : key1->len;
+		int cmp = memcmp(key0->data + 8, key1->data + 8, len - 8);
+
+		if (cmp != 0) {
+			return cmp < 0 ? MSGPACK_CMP_LESS : MSGPACK_CMP_GREATER;
+		}
+	}
+
+	if (key0->len != key1->len) {
+		return key0->len < key1->len ? MSGPACK_CMP_LESS : MSGPACK_CMP_GREATER;
+	}
+
+	return MSGPACK_CMP_EQUAL;
+}
@@ -26,6 +26,7 @@
 
 #include <stdbool.h>
 #include <shared.h>
+#include <utils.h>
 
 #define DEFAULT_THREADS 20              ///< The default number of restore threads.
 
@@ -33,6 +34,11 @@
 #define INITIAL_BACKOFF 10              ///< Initial backoff delay (in ms) between tries when
                                         ///  overloaded; doubled after each try.
 
+#define MAX_ASYNC 100000                ///< The maximal number of in-flight asynchronous writes per
+                                        ///  cluster node.
+#define ASYNC_EVENT_LOOPS 1             ///< The number of client event loops used for asynchronous
+                                        ///  writes. A single loop keeps one core busy.
+
 #define STAT_INTERVAL 10                ///< The interval for logging per-thread timing stats.
 
 ///
@@ -60,11 +66,17 @@ typedef struct {
 	///                  [DECODER_RECORD](@ref decoder_status::DECODER_RECORD).
 	/// @param expired   Indicates that an expired record was read. Only valid, if the result is
 	///                  [DECODER_RECORD](@ref decoder_status::DECODER_RECORD).
+	/// @param arena     Optional. With a value arena, `rec` is reused across calls: the caller
+	///                  initializes it once and destroys it when done, the decoder allocates the
+	///                  record's values from the arena and releases them before decoding the
+	///                  next record into `rec`. Without, `rec` is a new record for each call that
+	///                  the caller destroys after each call.
 	///
 	/// @result          See @ref decoder_status.
 	///
 	decoder_status (*parse)(FILE *fd, as_vector *ns_vec, as_vector *bin_vec,
-			uint32_t *line_no, cf_atomic64 *total, as_record *rec, bool *expired);
+			uint32_t *line_no, cf_atomic64 *total, as_record *rec, bool *expired,
+			value_arena *arena);
 } backup_decoder;
 
 ///
@@ -131,6 +143,15 @@ typedef struct {
 	char *auth_mode;                ///< Authentication mode.
 
 	bool cdt_print;
+
+	uint32_t max_async;             ///< The number of in-flight asynchronous writes per cluster
+	                                ///  node. 0 selects synchronous writes.
+	uint32_t async_limit;           ///< The total number of in-flight asynchronous writes, i.e.,
+	                                ///  max_async times the number of cluster nodes.
+	cf_atomic32 async_pending;      ///< The number of asynchronous writes that have been issued,
+	                                ///  but not yet completed. Includes queued retries.
+	cf_queue *async_retries;        ///< Asynchronous writes that failed with a transient error and
+	                                ///  wait to be re-issued by a restore thread.
 } restore_config;
 
 
@@ -149,6 +170,18 @@ typedef struct {
 	as_vector *set_vec;     ///< The sets to be restored, as a vector of set name strings.
 } restore_thread_args;
 
+///
+/// An in-flight asynchronous write. Owns the record until the write completes.
+///
+typedef struct {
+	restore_config *conf;       ///< The global restore configuration and stats.
+	as_policy_write policy;     ///< The write policy of the restore thread that issued the write.
+	int32_t tries;              ///< The number of failed tries so far.
+	as_status last;             ///< The result of the last failed try.
+	useconds_t backoff;         ///< The current backoff delay for overloaded devices.
+	as_record rec;              ///< The record to be written.
+} async_write;
+
 ///
 /// The per-thread context for information about the currently processed backup file. Each restore
 /// thread creates one of these for each backup file that it reads.
@@ -157,6 +157,22 @@ typedef enum {
 
 #define CDT_FIX_OPT 3000
 #define CDT_PRINT 3001
+#define MAX_ASYNC_OPT 3002
+#define SAMPLE_OPT 3003
+#define STATE_FILE_OPT 3004
+#define VALIDATION_THREADS_OPT 3005
+#define QUEUE_MEMORY_OPT 3006
+#define FIX_DRY_RUN_OPT 3007
+#define METRICS_OPT 3008
+#define PROFILE_OPT 3009
+#define ADAPTIVE_OPT 3010
+#define IO_URING_OPT 3011
+#define VERDICT_CACHE_OPT 3012
+#define MAP_FIX_OPT 3013
+#define NUMA_OPT 3014
+#define OFFSET_INDEX_OPT 3015
+#define RECHECK_OPT 3016
+#define RECHECK_BATCH_OPT 3017
 
 typedef struct {
 	void *conf;                                 ///< The global configuration and stats.
@@ -0,0 +1,76 @@
+/*
+ * Aerospike Record Specification Parser
+ *
+ * Copyright (c) 2008-2017 Aerospike, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <shared.h>
+#include <utils.h>
+
+#define MAX_SPEC_NAME 100       ///< The maximal length of a record specification's name.
+
+///
+/// The value types of the specification language.
+///
+typedef enum {
+	SPEC_NIL,       ///< `(nil)`
+	SPEC_INTEGER,   ///< `(integer)`
+	SPEC_DOUBLE,    ///< `(double)`
+	SPEC_STRING,    ///< `(string <length>)`
+	SPEC_BYTES,     ///< `(bytes <length>)`
+	SPEC_LIST,      ///< `(list <count> <element>)`
+	SPEC_MAP        ///< `(map <count> <key> <value>)`
+} spec_type;
+
+///
+/// A value specification. Lists have an element specification, maps have a key and a value
+/// specification.
+///
+typedef struct spec_value_s {
+	spec_type type;                 ///< The value type.
+	uint32_t size;                  ///< The length of a string or BLOB, the element count of a
+	                                ///  list or map.
+	struct spec_value_s *sub1;      ///< The element of a list, the key of a map.
+	struct spec_value_s *sub2;      ///< The value of a map.
+} spec_value;
+
+///
+/// A group of bins of the same value specification.
+///
+typedef struct {
+	uint32_t count;                 ///< The number of bins in the group.
+	spec_value *value;              ///< The value specification of the bins.
+} spec_bins;
+
+///
+/// A record specification, i.e., `(record "<name>" <count> <value> ...)`.
+///
+typedef struct {
+	char name[MAX_SPEC_NAME + 1];   ///< The name of the record specification.
+	as_vector bins;                 ///< The spec_bins of the record.
+	uint32_t n_bins;                ///< The total number of bins of the record.
+} spec_record;
+
+bool spec_parse_file(const char *path, as_vector *records);
+void spec_free(as_vector *records);
+const spec_record *spec_find(const as_vector *records, const char *name);
@@ -29,9 +29,20 @@
 #define IO_BUF_SIZE (1024 * 1024 * 16)      ///< We do I/O in blocks of this size.
 #define STACK_BUF_SIZE (1024 * 16)          ///< The size limit for stack-allocated buffers.
 #define ETA_BUF_SIZE (4 + 3 + 3 + 3 + 1)    ///< The buffer size for pretty-printing an ETA.
+#define ARENA_BLOCK_SIZE (1024 * 1024)      ///< The default size of a value arena's blocks.
 
 #define MAX_THREADS 4096                    ///< The maximal supported number of threads.
 
+#define LOG_LINE_SIZE 10000                 ///< The maximal size of a log line.
+#define LOG_RING_SIZE (1024 * 256)          ///< The size of a thread's log ring.
+#define LOG_DRAIN_MS 10                     ///< When idle, the log thread checks the log rings
+                                            ///  every this many milliseconds.
+#define LOG_WAIT_US 1000                    ///< A thread with a full log ring waits for the log
+                                            ///  thread in steps of this many microseconds.
+#define LOG_REPEAT_BURST 10                 ///< Log an error message up to this many times per
+                                            ///  repeat window, then only count its repeats.
+#define LOG_REPEAT_WINDOW 10                ///< The length of a repeat window in seconds.
+
 ///
 /// Allocates a buffer. Buffers smaller than @ref STACK_BUF_SIZE are allocated on the stack.
 ///
@@ -107,6 +118,34 @@ typedef struct {
 	size_t len; ///< The length.
 } esc_res;
 
+///
+/// A growable output buffer. Records are formatted into one of these and then handed to stdio in
+/// a single write.
+///
+typedef struct {
+	char *data;         ///< The buffer.
+	size_t size;        ///< The number of bytes currently in the buffer.
+	size_t capacity;    ///< The allocated size of the buffer.
+} output_buffer;
+
+///
+/// A memory block of a value arena.
+///
+typedef struct {
+	void *data;         ///< The block.
+	size_t size;        ///< The size of the block.
+} arena_block;
+
+///
+/// A bump allocator for values that all go away at the same time, e.g., the bin values of a
+/// record. Resetting the arena keeps its blocks for the next round of allocations.
+///
+typedef struct {
+	as_vector blocks;   ///< The arena_block elements.
+	uint32_t block;     ///< The index of the block that we currently allocate from.
+	size_t used;        ///< The number of bytes allocated from the current block.
+} value_arena;
+
 ///
 /// Context for the streaming base-64 decoder.
 ///
@@ -127,6 +166,8 @@ extern void hex_dump_ver(const void *data, uint32_t len);
 extern void hex_dump_inf(const void *data, uint32_t len);
 extern void hex_dump_err(const void *data, uint32_t len);
 extern void enable_client_log(void);
+extern bool log_start(void);
+extern void log_stop(void);
 extern void *safe_malloc(size_t size);
 extern char *safe_strdup(const char *string);
 extern void safe_lock(void);
@@ -141,7 +182,14 @@ extern esc_res unescape_space(const char *source, char *dest);
 extern char *trim_string(char *str);
 extern void split_string(char *str, char split, bool trim, as_vector *vec);
 extern void format_eta(int32_t seconds, char *buffer, size_t size);
+extern void murmur_hash_128(const void *data, size_t size, uint64_t hash[2]);
 extern char *print_char(int32_t ch);
+extern bool output_buffer_grow(output_buffer *buf, size_t size);
+extern void output_buffer_free(output_buffer *buf);
+extern void value_arena_init(value_arena *arena);
+extern void *value_arena_alloc(value_arena *arena, size_t size);
+extern void value_arena_reset(value_arena *arena);
+extern void value_arena_free(value_arena *arena);
 extern void get_node_names(as_cluster *clust, node_spec *node_specs, uint32_t n_node_specs,
 		char (**node_names)[][AS_NODE_NAME_SIZE], uint32_t *n_node_names);
 extern bool get_info(aerospike *as, const char *value, const char *node_name, void *context,
@@ -397,6 +445,24 @@ fprintf_bytes(uint64_t *bytes, FILE *fd, const char *format, ...)
 	return res;
 }
 
+///
+/// Makes sure that the given output buffer has room for the given number of additional bytes.
+///
+/// @param buf   The output buffer.
+/// @param size  The number of bytes to be appended.
+///
+/// @result      `true`, if successful.
+///
+static inline bool
+output_buffer_reserve(output_buffer *buf, size_t size)
+{
+	if (LIKELY(buf->size + size <= buf->capacity)) {
+		return true;
+	}
+
+	return output_buffer_grow(buf, size);
+}
+
 ///
 /// A wrapper around `fwrite()` that counts the bytes that were written.
 ///
@@ -0,0 +1,327 @@
+/*
+ * Aerospike NUMA Placement
+ *
+ * Copyright (c) 2008-2017 Aerospike, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <asv_numa.h>
+
+#if defined __linux__
+
+#include <linux/mempolicy.h>
+
+///
+/// Parses a CPU list as found in sysfs, e.g., `0-15,32-47`.
+///
+/// @param list  The CPU list.
+/// @param cpus  Returns the listed CPUs.
+///
+/// @result      The number of listed CPUs, `0` on error.
+///
+static uint32_t
+numa_parse_cpulist(const char *list, cpu_set_t *cpus)
+{
+	CPU_ZERO(cpus);
+	uint32_t n_cpus = 0;
+	const char *pos = list;
+
+	while (*pos >= '0' && *pos <= '9') {
+		char *end;
+		unsigned long from = strtoul(pos, &end, 10);
+		unsigned long to = from;
+
+		if (*end == '-') {
+			to = strtoul(end + 1, &end, 10);
+		}
+
+		if (to < from || to >= CPU_SETSIZE) {
+			return 0;
+		}
+
+		for (unsigned long cpu = from; cpu <= to; ++cpu) {
+			CPU_SET(cpu, cpus);
+			++n_cpus;
+		}
+
+		pos = *end == ',' ? end + 1 : end;
+	}
+
+	return n_cpus;
+}
+
+///
+/// Orders NUMA nodes by ascending ID. Passed to `qsort()`.
+///
+/// @param left   The first numa_node to compare.
+/// @param right  The second numa_node to compare.
+///
+/// @result       Negative, zero, or positive, as expected by `qsort()`.
+///
+static int32_t
+compare_node_id(const void *left, const void *right)
+{
+	const numa_node *l = left;
+	const numa_node *r = right;
+	return l->id < r->id ? -1 : l->id > r->id ? 1 : 0;
+}
+
+///
+/// Reads the NUMA nodes and their CPUs from sysfs. Memory-only nodes are skipped.
+///
+/// @param topo  The topology to be populated.
+///
+/// @result      `true`, if successful.
+///
+bool
+numa_init(numa_topology *topo)
+{
+	memset(topo, 0, sizeof (numa_topology));
+	DIR *dir = opendir(NUMA_SYSFS_PATH);
+
+	if (dir == NULL) {
+		err_code("Error while opening %s", NUMA_SYSFS_PATH);
+		return false;
+	}
+
+	struct dirent *ent;
+
+	while ((ent = readdir(dir)) != NULL) {
+		uint32_t id;
+		char tail;
+
+		if (sscanf(ent->d_name, "node%u%c", &id, &tail) != 1) {
+			continue;
+		}
+
+		// the node mask that we pass to mbind() is a single unsigned long
+		if (id >= 8 * sizeof (unsigned long) || topo->n_nodes == MAX_NUMA_NODES) {
+			inf("Ignoring NUMA node %u", id);
+			continue;
+		}
+
+		char path[PATH_MAX];
+		snprintf(path, sizeof path, "%s/%s/cpulist", NUMA_SYSFS_PATH, ent->d_name);
+		FILE *fd = fopen(path, "r");
+
+		if (fd == NULL) {
+			err_code("Error while opening %s", path);
+			closedir(dir);
+			return false;
+		}
+
+		char list[4096];
+		bool ok = fgets(list, sizeof list, fd) != NULL;
+		fclose(fd);
+
+		if (!ok) {
+			err("Error while reading %s", path);
+			closedir(dir);
+			return false;
+		}
+
+		numa_node *node = &topo->nodes[topo->n_nodes];
+		node->id = id;
+		node->n_cpus = numa_parse_cpulist(list, &node->cpus);
+
+		if (node->n_cpus > 0) {
+			++topo->n_nodes;
+		}
+	}
+
+	closedir(dir);
+
+	if (topo->n_nodes == 0) {
+		err("Found no NUMA nodes with CPUs in %s", NUMA_SYSFS_PATH);
+		return false;
+	}
+
+	qsort(topo->nodes, topo->n_nodes, sizeof (numa_node), compare_node_id);
+
+	for (uint32_t i = 0; i < topo->n_nodes; ++i) {
+		inf("NUMA node %u: %u CPU(s)", topo->nodes[i].id, topo->nodes[i].n_cpus);
+	}
+
+	return true;
+}
+
+///
+/// Initializes the attributes for a worker thread that pin it to the CPUs of a NUMA node.
+/// Consecutive workers go to consecutive nodes.
+///
+/// @param topo   The NUMA topology.
+/// @param index  The worker's index.
+/// @param attr   The thread attributes to be initialized. To be destroyed by the caller.
+///
+/// @result       `true`, if successful.
+///
+bool
+numa_thread_attr(const numa_topology *topo, uint32_t index, pthread_attr_t *attr)
+{
+	if (pthread_attr_init(attr) != 0) {
+		err_code("Error while initializing thread attributes");
+		return false;
+	}
+
+	const numa_node *node = &topo->nodes[index % topo->n_nodes];
+	int32_t res = pthread_attr_setaffinity_np(attr, sizeof (cpu_set_t), &node->cpus);
+
+	if (res != 0) {
+		errno = res;
+		err_code("Error while pinning worker to NUMA node %u", node->id);
+		pthread_attr_destroy(attr);
+		return false;
+	}
+
+	return true;
+}
+
+///
+/// Finds the NUMA node of the CPU that the calling thread runs on.
+///
+/// @param topo  The NUMA topology. May be `NULL`.
+///
+/// @result      The index of the node in the topology, `-1`, if unknown or without a
+///              topology.
+///
+int32_t
+numa_current_node(const numa_topology *topo)
+{
+	if (topo == NULL) {
+		return -1;
+	}
+
+	int32_t cpu = sched_getcpu();
+
+	if (cpu < 0) {
+		return -1;
+	}
+
+	for (uint32_t i = 0; i < topo->n_nodes; ++i) {
+		if (CPU_ISSET((size_t)cpu, &topo->nodes[i].cpus)) {
+			return (int32_t)i;
+		}
+	}
+
+	return -1;
+}
+
+///
+/// Asks the kernel to back a buffer with memory from the given NUMA node, wherever the buffer
+/// gets touched first. Pages that are already backed get migrated. Only covers the buffer's
+/// whole pages, so it's meant for large buffers. Best effort: failures are ignored.
+///
+/// @param topo  The NUMA topology. May be `NULL`.
+/// @param node  The index of the node in the topology. May be `-1`.
+/// @param mem   The buffer.
+/// @param size  The size of the buffer.
+///
+void
+numa_bind(const numa_topology *topo, int32_t node, void *mem, size_t size)
+{
+	if (topo == NULL || node < 0) {
+		return;
+	}
+
+	uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	uintptr_t start = ((uintptr_t)mem + page - 1) & ~(page - 1);
+	uintptr_t end = ((uintptr_t)mem + size) & ~(page - 1);
+
+	if (end <= start) {
+		return;
+	}
+
+	unsigned long mask = 1UL << topo->nodes[node].id;
+
+	// the kernel ignores the last bit of the mask size
+	if (syscall(SYS_mbind, start, end - start, MPOL_PREFERRED, &mask, 8 * sizeof mask + 1,
+			MPOL_MF_MOVE) < 0 && verbose) {
+		ver("Cannot bind buffer to NUMA node %u: %s", topo->nodes[node].id, strerror(errno));
+	}
+}
+
+#else
+
+///
+/// Reads the NUMA nodes. Only supported on Linux.
+///
+/// @param topo  The topology to be populated.
+///
+/// @result      Always `false`.
+///
+bool
+numa_init(numa_topology *topo)
+{
+	memset(topo, 0, sizeof (numa_topology));
+	err("NUMA placement is only supported on Linux");
+	return false;
+}
+
+///
+/// Initializes the attributes for a worker thread. Only supported on Linux.
+///
+/// @param topo   The NUMA topology.
+/// @param index  The worker's index.
+/// @param attr   The thread attributes to be initialized.
+///
+/// @result       Always `false`.
+///
+bool
+numa_thread_attr(const numa_topology *topo, uint32_t index, pthread_attr_t *attr)
+{
+	(void)topo;
+	(void)index;
+	(void)attr;
+	return false;
+}
+
+///
+/// Finds the NUMA node of the calling thread. Only supported on Linux.
+///
+/// @param topo  The NUMA topology.
+///
+/// @result      Always `-1`.
+///
+int32_t
+numa_current_node(const numa_topology *topo)
+{
+	(void)topo;
+	return -1;
+}
+
+///
+/// Binds a buffer to a NUMA node. Only supported on Linux, a no-op otherwise.
+///
+/// @param topo  The NUMA topology.
+/// @param node  The index of the node in the topology.
+/// @param mem   The buffer.
+/// @param size  The size of the buffer.
+///
+void
+numa_bind(const numa_topology *topo, int32_t node, void *mem, size_t size)
+{
+	(void)topo;
+	(void)node;
+	(void)mem;
+	(void)size;
+}
+
+#endif
@@ -29,14 +29,38 @@
 extern char *aerospike_client_version;  ///< The C client's version string.
 
 static volatile bool stop = false;  ///< Makes background threads exit.
+static volatile sig_atomic_t interrupted = 0;   ///< Set by the signal handler, which must not
+                                                ///  log, to have report_interrupt() log.
 
 static pthread_cond_t bandwidth_cond = PTHREAD_COND_INITIALIZER;    ///< Used by the counter thread
                                                                     ///  to signal newly available
                                                                     ///  bandwidth to the backup
                                                                     ///  threads.
 
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;        ///< Used by the validation
+                                                                    ///  pool to signal freed queue
+                                                                    ///  memory and drained nodes.
+
+static pthread_cond_t scan_cond = PTHREAD_COND_INITIALIZER;         ///< Used by the backup
+                                                                    ///  threads and the counter
+                                                                    ///  thread to signal freed and
+                                                                    ///  added scan slots.
+
+static pthread_cond_t rotate_cond = PTHREAD_COND_INITIALIZER;       ///< Used by the rotation
+                                                                    ///  thread to signal
+                                                                    ///  pre-opened backup files.
+
 static void config_default(backup_config *conf);
 
+static const uint64_t latency_bounds_us[N_LATENCY_BUCKETS] = {  ///< The upper bounds of the fix
+	500, 1000, 2000, 5000, 10000, 25000, 50000,                 ///  latency histogram buckets.
+	100000, 250000, 500000, 1000000, 2500000
+};
+
+static const char *phase_names[N_PHASES] = {    ///< The --profile phase labels.
+	"network", "check", "fix", "store", "throttle", "rotate", "queue"
+};
+
 ///
 /// Ensures that there is enough disk space available. Outputs a warning, if there isn't.
 ///
@@ -99,16 +123,14 @@ close_file(FILE **fd, void **fd_buf)
 			ver("Closing file descriptor");
 		}
 
-		int32_t fno = fileno(*fd);
-
-		if (fno < 0) {
-			err_code("Error while retrieving native file descriptor");
-			return false;
-		}
+		// an io_uring file has no native file descriptor and syncs itself when closed
+		if (!uring_is_file(*fd)) {
+			int32_t fno = fileno(*fd);
 
-		if (fsync(fno) < 0) {
-			err_code("Error while flushing kernel buffers");
-			return false;
+			if (fno < 0 || fsync(fno) < 0) {
+				err_code("Error while flushing kernel buffers");
+				return false;
+			}
 		}
 
 		if (fclose(*fd) == EOF) {
@@ -135,6 +157,9 @@ close_file(FILE **fd, void **fd_buf)
 /// @param file_path   The path of the backup file to be created.
 /// @param ns          The namespace that is being backed up.
 /// @param disk_space  An estimate of the required disk space for the backup file.
+/// @param uring       Write the backup file through io_uring.
+/// @param topo        The NUMA topology for the file's buffers. May be `NULL`.
+/// @param node        The NUMA node of the thread that's going to write the file. May be `-1`.
 /// @param fd          The file descriptor of the created backup file.
 /// @param fd_buf      The I/O buffer allocated for the file descriptor.
 ///
@@ -142,7 +167,8 @@ close_file(FILE **fd, void **fd_buf)
 ///
 static bool
 open_file(uint64_t *bytes, const char *file_path, const char *ns,
-		uint64_t disk_space, FILE **fd, void **fd_buf)
+		uint64_t disk_space, bool uring, const numa_topology *topo, int32_t node, FILE **fd,
+		void **fd_buf)
 {
 	if (verbose) {
 		ver("Opening output file %s", file_path);
@@ -173,7 +199,11 @@ open_file(uint64_t *bytes, const char *file_path, const char *ns,
 		disk_space_check(dir_path, disk_space);
 		cf_free(tmp_path);
 
-		if ((*fd = fopen(file_path, "w")) == NULL) {
+		if (uring) {
+			if ((*fd = uring_open(file_path, topo, node)) == NULL) {
+				return false;
+			}
+		} else if ((*fd = fopen(file_path, "w")) == NULL) {
 			err_code("Error while creating output file %s", file_path);
 			return false;
 		}
@@ -185,8 +215,15 @@ open_file(uint64_t *bytes, const char *file_path, const char *ns,
 		ver("Initializing output file");
 	}
 
-	*fd_buf = safe_malloc(IO_BUF_SIZE);
-	setbuffer(*fd, *fd_buf, IO_BUF_SIZE);
+	// io_uring files collect the output in their own buffers
+	if (uring && *fd != stdout) {
+		*fd_buf = NULL;
+		setvbuf(*fd, NULL, _IONBF, 0);
+	} else {
+		*fd_buf = safe_malloc(IO_BUF_SIZE);
+		numa_bind(topo, node, *fd_buf, IO_BUF_SIZE);
+		setbuffer(*fd, *fd_buf, IO_BUF_SIZE);
+	}
 
 	if (fprintf_bytes(bytes, *fd, "Validation Version " VERSION_1_1 "\n") < 0) {
 		err_code("Error while writing header to output file %s", file_path);
@@ -225,25 +262,86 @@ close_dir_file(per_node_context *pnc)
 }
 
 ///
-/// Wrapper around open_file(). Used when backing up to a directory.
+/// Generates the path of a backup file when backing up to a directory.
+///
+/// @param pnc        The per-node context of the backup thread that owns the backup file.
+/// @param index      The file number of the backup file.
+/// @param file_path  The output buffer for the path.
+/// @param size       The size of the output buffer.
+///
+/// @result           `true`, if successful.
+///
+static bool
+dir_file_path(const per_node_context *pnc, uint32_t index, char *file_path, size_t size)
+{
+	const scan_target *t = pnc->target;
+	int32_t len;
+
+	// several namespaces or sets: keep each one's findings in its own files
+	if (pnc->conf->n_targets > 1) {
+		len = snprintf(file_path, size, "%s/%s%s%s_%s_%05u.asb", pnc->conf->directory, t->ns,
+				t->set[0] == 0 ? "" : "_", t->set, pnc->node_name, index);
+	} else {
+		len = snprintf(file_path, size, "%s/%s_%05u.asb", pnc->conf->directory, pnc->node_name,
+				index);
+	}
+
+	if (len < 0 || (size_t)len >= size) {
+		err("Output file path too long");
+		return false;
+	}
+
+	return true;
+}
+
+///
+/// Writes the offset index of the node's current backup file, if offset indexes were requested.
+/// Used when backing up to a directory.
+///
+/// @param pnc  The per-node context of the backup thread that owns the backup file.
+///
+/// @result     `true`, if successful.
+///
+static bool
+write_dir_index(per_node_context *pnc)
+{
+	if (pnc->index == NULL) {
+		return true;
+	}
+
+	char file_path[PATH_MAX];
+
+	if (!dir_file_path(pnc, pnc->file_count - 1, file_path, sizeof file_path)) {
+		return false;
+	}
+
+	return index_write(pnc->index, file_path);
+}
+
+///
+/// Wrapper around open_file(). Creates a backup file, but doesn't make it the node's current
+/// backup file. Called by the backup threads as well as the rotation thread.
 ///
 ///   - Generates a backup file name.
 ///   - Estimates the disk space required for all remaining backup files based on the average
 ///     record size seen so far.
 ///   - Invokes open_file().
 ///
-/// @param pnc  The per-node context of the backup thread that's creating the backup file.
+/// @param pnc     The per-node context of the backup thread that owns the backup file.
+/// @param index   The file number of the backup file.
+/// @param bytes   The number of bytes written to the new backup file.
+/// @param fd      The file descriptor of the created backup file.
+/// @param fd_buf  The I/O buffer allocated for the file descriptor.
 ///
-/// @result     `true`, if successful.
+/// @result        `true`, if successful.
 ///
 static bool
-open_dir_file(per_node_context *pnc)
+create_dir_file(const per_node_context *pnc, uint32_t index, uint64_t *bytes, FILE **fd,
+		void **fd_buf)
 {
 	char file_path[PATH_MAX];
 
-	if ((size_t)snprintf(file_path, sizeof file_path, "%s/%s_%05d.asb", pnc->conf->directory,
-			pnc->node_name, pnc->file_count) >= sizeof file_path) {
-		err("Output file path too long");
+	if (!dir_file_path(pnc, index, file_path, sizeof file_path)) {
 		return false;
 	}
 
@@ -259,22 +357,342 @@ open_dir_file(per_node_context *pnc)
 				rec_size);
 	}
 
-	uint64_t bytes = 0;
+	*bytes = 0;
 
-	if (!open_file(&bytes, file_path, pnc->conf->scan->ns, rec_remain * rec_size,
-			&pnc->fd, &pnc->fd_buf)) {
-		return false;
-	}
+	// node-local buffers: the rotation thread pre-opens files, so don't rely on the first touch
+	return open_file(bytes, file_path, pnc->target->ns, rec_remain * rec_size,
+			pnc->conf->uring, pnc->conf->numa_topo, pnc->numa_node, fd, fd_buf);
+}
 
+///
+/// Makes a newly created backup file the node's current backup file.
+///
+/// @param pnc     The per-node context of the backup thread that owns the backup file.
+/// @param fd      The file descriptor of the backup file.
+/// @param fd_buf  The I/O buffer allocated for the file descriptor.
+/// @param bytes   The number of bytes already written to the backup file.
+///
+static void
+use_dir_file(per_node_context *pnc, FILE *fd, void *fd_buf, uint64_t bytes)
+{
+	pnc->fd = fd;
+	pnc->fd_buf = fd_buf;
 	pnc->rec_count_file = 0;
 	++pnc->file_count;
 
 	pnc->byte_count_file = bytes;
 	pnc->byte_count_node += bytes;
 	cf_atomic64_add(&pnc->conf->byte_count_total, (int64_t)bytes);
+
+	if (pnc->index != NULL) {
+		index_reset(pnc->index, bytes);
+	}
+}
+
+///
+/// Creates the node's next backup file and makes it the current backup file. Used when backing
+/// up to a directory.
+///
+/// @param pnc  The per-node context of the backup thread that's creating the backup file.
+///
+/// @result     `true`, if successful.
+///
+static bool
+open_dir_file(per_node_context *pnc)
+{
+	uint64_t bytes;
+	FILE *fd;
+	void *fd_buf;
+
+	if (!create_dir_file(pnc, pnc->file_count, &bytes, &fd, &fd_buf)) {
+		return false;
+	}
+
+	use_dir_file(pnc, fd, fd_buf, bytes);
+	return true;
+}
+
+///
+/// Asks the rotation thread to pre-open the node's next backup file, so that it's ready when the
+/// current backup file fills up.
+///
+/// @param pnc  The per-node context of the backup thread that owns the backup files.
+///
+static void
+request_next_file(per_node_context *pnc)
+{
+	cf_atomic32_set(&pnc->next_state, NEXT_PENDING);
+	rotate_job job = { pnc, pnc->file_count, NULL, NULL, 0, NULL, NULL };
+
+	if (cf_queue_push(pnc->conf->rotate_queue, &job) != CF_QUEUE_OK) {
+		err("Error while queueing output file for pre-opening");
+
+		// the next rotation opens the file itself
+		safe_lock();
+		cf_atomic32_set(&pnc->next_state, NEXT_FAILED);
+		safe_unlock();
+	}
+}
+
+///
+/// Takes the node's pre-opened next backup file. Waits for the rotation thread, if it's still
+/// opening the file.
+///
+/// @param pnc     The per-node context of the backup thread that owns the backup files.
+/// @param fd      The file descriptor of the pre-opened backup file.
+/// @param fd_buf  The I/O buffer of the pre-opened backup file.
+/// @param bytes   The number of bytes already written to the pre-opened backup file.
+///
+/// @result        `true`, if there was a pre-opened backup file.
+///
+static bool
+take_next_file(per_node_context *pnc, FILE **fd, void **fd_buf, uint64_t *bytes)
+{
+	safe_lock();
+
+	while (cf_atomic32_get(pnc->next_state) == NEXT_PENDING) {
+		safe_wait(&rotate_cond);
+	}
+
+	bool ready = cf_atomic32_get(pnc->next_state) == NEXT_READY;
+	*fd = pnc->next_fd;
+	*fd_buf = pnc->next_fd_buf;
+	*bytes = pnc->next_bytes;
+
+	cf_atomic32_set(&pnc->next_state, NEXT_NONE);
+	pnc->next_fd = NULL;
+	pnc->next_fd_buf = NULL;
+	pnc->next_bytes = 0;
+	safe_unlock();
+
+	return ready;
+}
+
+///
+/// Frees the offset index that a rotation job carries, if any.
+///
+/// @param job  The rotation job.
+///
+static void
+free_job_index(rotate_job *job)
+{
+	if (job->idx == NULL) {
+		return;
+	}
+
+	index_free(job->idx);
+	cf_free(job->idx);
+	cf_free(job->idx_path);
+	job->idx = NULL;
+	job->idx_path = NULL;
+}
+
+///
+/// Writes the offset index of a closed backup file and frees it.
+///
+/// @param job  The rotation job that closed the backup file.
+///
+/// @result     `true`, if successful.
+///
+static bool
+write_job_index(rotate_job *job)
+{
+	if (job->idx == NULL) {
+		return true;
+	}
+
+	bool res = index_write(job->idx, job->idx_path);
+	free_job_index(job);
+	return res;
+}
+
+///
+/// Switches the node to its next backup file. The full backup file is handed to the rotation
+/// thread, which flushes, syncs, and closes it in the background, then writes its offset index.
+/// The next backup file is the pre-opened one, if there is one; otherwise, it's opened here.
+///
+/// @param pnc  The per-node context of the backup thread that owns the backup files.
+///
+/// @result     `true`, if successful.
+///
+static bool
+rotate_dir_file(per_node_context *pnc)
+{
+	rotate_job job = { NULL, 0, pnc->fd, pnc->fd_buf, pnc->byte_count_file, NULL, NULL };
+
+	// the index must not appear before its file is complete, so it goes along with the file
+	if (pnc->index != NULL) {
+		char file_path[PATH_MAX];
+
+		if (!dir_file_path(pnc, pnc->file_count - 1, file_path, sizeof file_path)) {
+			return false;
+		}
+
+		job.idx = safe_malloc(sizeof (file_index));
+		*job.idx = *pnc->index;
+		job.idx_path = safe_strdup(file_path);
+		index_init(pnc->index, job.idx->interval);
+	}
+
+	pnc->fd = NULL;
+	pnc->fd_buf = NULL;
+
+	if (cf_queue_push(pnc->conf->rotate_queue, &job) != CF_QUEUE_OK) {
+		err("Error while queueing output file for closing");
+
+		if (!close_file(&job.fd, &job.fd_buf)) {
+			err("Error while closing old output file");
+			free_job_index(&job);
+			return false;
+		}
+
+		if (!write_job_index(&job)) {
+			err("Error while writing offset index of old output file");
+			return false;
+		}
+	}
+
+	uint64_t bytes;
+	FILE *fd;
+	void *fd_buf;
+
+	if (take_next_file(pnc, &fd, &fd_buf, &bytes)) {
+		use_dir_file(pnc, fd, fd_buf, bytes);
+		return true;
+	}
+
+	if (!open_dir_file(pnc)) {
+		err("Error while opening new output file");
+		return false;
+	}
+
+	return true;
+}
+
+///
+/// Closes and removes the node's pre-opened next backup file, if it ended up unused.
+///
+/// @param pnc  The per-node context of the backup thread that owns the backup files.
+///
+/// @result     `true`, if successful.
+///
+static bool
+discard_next_file(per_node_context *pnc)
+{
+	uint64_t bytes;
+	FILE *fd;
+	void *fd_buf;
+
+	if (!take_next_file(pnc, &fd, &fd_buf, &bytes)) {
+		return true;
+	}
+
+	if (!close_file(&fd, &fd_buf)) {
+		err("Error while closing unused output file");
+		return false;
+	}
+
+	char file_path[PATH_MAX];
+
+	if (!dir_file_path(pnc, pnc->file_count, file_path, sizeof file_path)) {
+		return false;
+	}
+
+	if (verbose) {
+		ver("Removing unused output file %s", file_path);
+	}
+
+	if (remove(file_path) < 0) {
+		err_code("Error while removing unused output file %s", file_path);
+		return false;
+	}
+
 	return true;
 }
 
+///
+/// Main thread function of the rotation thread. Closes the full backup files handed over by the
+/// backup threads and pre-opens their next backup files, so that the backup threads don't stall
+/// on `fsync()`, `fclose()`, and `fopen()`.
+///
+/// @param cont  The rotation queue.
+///
+/// @result      `EXIT_SUCCESS` on success, `EXIT_FAILURE` otherwise.
+///
+static void *
+rotate_thread_func(void *cont)
+{
+	if (verbose) {
+		ver("Entering rotation thread 0x%" PRIx64, (uint64_t)pthread_self());
+	}
+
+	cf_queue *rotate_queue = cont;
+	void *res = (void *)EXIT_SUCCESS;
+
+	while (true) {
+		rotate_job job;
+
+		if (cf_queue_pop(rotate_queue, &job, CF_QUEUE_FOREVER) != CF_QUEUE_OK) {
+			err("Error while picking up rotation job");
+			res = (void *)EXIT_FAILURE;
+			break;
+		}
+
+		if (job.pnc != NULL) {
+			uint64_t bytes;
+			FILE *fd;
+			void *fd_buf;
+			bool ok = create_dir_file(job.pnc, job.index, &bytes, &fd, &fd_buf);
+
+			if (!ok) {
+				err("Error while pre-opening output file");
+			}
+
+			safe_lock();
+			job.pnc->next_fd = ok ? fd : NULL;
+			job.pnc->next_fd_buf = ok ? fd_buf : NULL;
+			job.pnc->next_bytes = ok ? bytes : 0;
+			cf_atomic32_set(&job.pnc->next_state, ok ? NEXT_READY : NEXT_FAILED);
+			safe_signal(&rotate_cond);
+			safe_unlock();
+			continue;
+		}
+
+		if (job.fd == NULL) {
+			if (verbose) {
+				ver("Rotation thread detected exit marker");
+			}
+
+			break;
+		}
+
+		if (!close_file(&job.fd, &job.fd_buf)) {
+			err("Error while closing old output file");
+			free_job_index(&job);
+			res = (void *)EXIT_FAILURE;
+			stop = true;
+			continue;
+		}
+
+		if (!write_job_index(&job)) {
+			err("Error while writing offset index of old output file");
+			res = (void *)EXIT_FAILURE;
+			stop = true;
+			continue;
+		}
+
+		if (verbose) {
+			ver("File size is %" PRIu64, job.size);
+		}
+	}
+
+	if (verbose) {
+		ver("Leaving rotation thread");
+	}
+
+	return res;
+}
+
 typedef struct cdt_fix_s {
 	const uint8_t *contents;
 	uint32_t content_sz;
@@ -285,6 +703,7 @@ typedef struct cdt_fix_s {
 
 	bool nf_map_order;
 	bool nf_map_dupkey;
+	bool nf_map_nonstorage;
 
 	bool need_log;
 } cdt_fix;
@@ -323,12 +742,87 @@ cdt_check_sz(msgpack_in *mp, uint32_t sz, cdt_fix *cf, cdt_stats *stat)
 	return false;
 }
 
-static bool
-cdt_map_dup_key_check(uint32_t ele_count, const uint8_t *contents,
-		uint32_t content_sz)
+///
+/// Orders normalized CDT elements, ties broken by offset. Passed to `qsort()`.
+///
+/// @param left   The first cdt_key_ele to compare.
+/// @param right  The second cdt_key_ele to compare.
+///
+/// @result       Negative, zero, or positive, as expected by `qsort()`.
+///
+static int32_t
+compare_key_ele(const void *left, const void *right)
 {
-	if (ele_count <= 1) {
-		return false;
+	const cdt_key_ele *l = left;
+	const cdt_key_ele *r = right;
+	msgpack_cmp_type cmp = msgpack_key_cmp(&l->key, &r->key);
+
+	if (cmp != MSGPACK_CMP_EQUAL) {
+		return cmp == MSGPACK_CMP_LESS ? -1 : 1;
+	}
+
+	// keeps the sort stable
+	return l->off < r->off ? -1 : l->off > r->off ? 1 : 0;
+}
+
+///
+/// Normalizes the elements of a CDT.
+///
+/// @param contents    The CDT contents.
+/// @param content_sz  The size of the CDT contents.
+/// @param n           The number of elements to normalize.
+/// @param stride      The number of msgpack values per element, i.e., 1 for lists and 2 for
+///                    maps. Only the first value, i.e., the map key, is normalized.
+///
+/// @result            The normalized elements, `NULL` if an element isn't a scalar. To be freed
+///                    by the caller.
+///
+static cdt_key_ele *
+cdt_normalize(const uint8_t *contents, uint32_t content_sz, uint32_t n, uint32_t stride)
+{
+	msgpack_in mp = {
+			.buf = contents,
+			.buf_sz = content_sz
+	};
+
+	cdt_key_ele *eles = cf_malloc((size_t)n * sizeof (cdt_key_ele));
+
+	for (uint32_t i = 0; i < n; i++) {
+		eles[i].off = mp.offset;
+
+		if (! msgpack_get_key(&mp, &eles[i].key) ||
+				(stride > 1 && msgpack_sz_rep(&mp, stride - 1) == 0)) {
+			cf_free(eles);
+			return NULL;
+		}
+	}
+
+	return eles;
+}
+
+static bool
+cdt_map_dup_key_check(uint32_t ele_count, const uint8_t *contents,
+		uint32_t content_sz)
+{
+	if (ele_count <= 1) {
+		return false;
+	}
+
+	cdt_key_ele *eles = cdt_normalize(contents, content_sz, ele_count, 2);
+
+	// Scalar keys: sort, after which dup keys are adjacent.
+	if (eles != NULL) {
+		qsort(eles, ele_count, sizeof (cdt_key_ele), compare_key_ele);
+
+		bool dup = false;
+
+		for (uint32_t i = 1; i < ele_count && ! dup; i++) {
+			dup = msgpack_key_cmp(&eles[i - 1].key, &eles[i].key) ==
+					MSGPACK_CMP_EQUAL;
+		}
+
+		cf_free(eles);
+		return dup;
 	}
 
 	msgpack_in mp = {
@@ -351,6 +845,8 @@ cdt_map_dup_key_check(uint32_t ele_count, const uint8_t *contents,
 			if (msgpack_cmp(&mp, &rhs) == MSGPACK_CMP_EQUAL) {
 				return true;
 			}
+
+			msgpack_sz(&rhs); // skip value
 		}
 
 		mp.offset = next_off;
@@ -359,10 +855,129 @@ cdt_map_dup_key_check(uint32_t ele_count, const uint8_t *contents,
 	return false;
 }
 
+///
+/// Compares the next two elements of an ordered CDT and advances past them, like msgpack_cmp().
+/// Scalars are compared by their normalized keys instead. The key of the second element is kept
+/// for the next call, which compares it with the element after it.
+///
+/// @param mp_prev  The first element. Must be the second element of the previous call, if any.
+/// @param mp       The second element.
+/// @param prev     The key carried over from the previous call. Invalid before the first call.
+///
+/// @result         The comparison result, as returned by msgpack_cmp().
+///
+static msgpack_cmp_type
+cdt_cmp_next(msgpack_in *mp_prev, msgpack_in *mp, cdt_prev_key *prev)
+{
+	msgpack_in next = *mp;
+	msgpack_key key;
+
+	if (! msgpack_get_key(&next, &key)) {
+		prev->valid = false;
+		return msgpack_cmp(mp_prev, mp);
+	}
+
+	if (! prev->valid) {
+		msgpack_in prev_next = *mp_prev;
+
+		if (! msgpack_get_key(&prev_next, &prev->key)) {
+			msgpack_cmp_type cmp = msgpack_cmp(mp_prev, mp);
+
+			prev->key = key;
+			prev->end = mp->offset;
+			prev->valid = cmp != MSGPACK_CMP_ERROR;
+			return cmp;
+		}
+
+		prev->end = prev_next.offset;
+	}
+
+	msgpack_cmp_type cmp = msgpack_key_cmp(&prev->key, &key);
+
+	// msgpack_cmp() resets has_nonstorage to that of the compared elements
+	mp_prev->offset = prev->end;
+	mp_prev->has_nonstorage = false;
+	mp->offset = next.offset;
+	mp->has_nonstorage = false;
+
+	prev->key = key;
+	prev->end = next.offset;
+	prev->valid = true;
+	return cmp;
+}
+
+///
+/// Compares two list elements or map keys by their offsets within the CDT contents.
+///
+/// @param contents    The CDT contents.
+/// @param content_sz  The size of the CDT contents.
+/// @param off0        The offset of the first element.
+/// @param off1        The offset of the second element.
+///
+/// @result            The comparison result, MSGPACK_CMP_ERROR on malformed elements.
+///
+static inline msgpack_cmp_type
+cdt_ele_cmp(const uint8_t *contents, uint32_t content_sz, uint32_t off0, uint32_t off1)
+{
+	const msgpack_in mp0 = { .buf = contents, .buf_sz = content_sz, .offset = off0 };
+	const msgpack_in mp1 = { .buf = contents, .buf_sz = content_sz, .offset = off1 };
+
+	return msgpack_cmp_peek(&mp0, &mp1);
+}
+
+///
+/// Stable bottom-up merge sort of list element offsets. Stability keeps the first of several
+/// equal elements in front, which is the element that ADD_UNIQUE would have kept.
+///
+/// @param contents    The list contents.
+/// @param content_sz  The size of the list contents.
+/// @param offs        The element offsets to be sorted.
+/// @param tmp         Scratch space for n offsets.
+/// @param n           The number of elements.
+///
+/// @result            `true`, if successful.
+///
+static bool
+cdt_sort_offsets(const uint8_t *contents, uint32_t content_sz, uint32_t *offs, uint32_t *tmp,
+		uint32_t n)
+{
+	for (uint32_t width = 1; width < n; width *= 2) {
+		for (uint32_t lo = 0; lo < n; lo += 2 * width) {
+			uint32_t mid = lo + width < n ? lo + width : n;
+			uint32_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+			uint32_t i = lo;
+			uint32_t j = mid;
+			uint32_t k = lo;
+
+			while (i < mid && j < hi) {
+				msgpack_cmp_type cmp = cdt_ele_cmp(contents, content_sz, offs[j], offs[i]);
+
+				if (cmp == MSGPACK_CMP_ERROR || cmp == MSGPACK_CMP_END) {
+					return false;
+				}
+
+				tmp[k++] = cmp == MSGPACK_CMP_LESS ? offs[j++] : offs[i++];
+			}
+
+			while (i < mid) {
+				tmp[k++] = offs[i++];
+			}
+
+			while (j < hi) {
+				tmp[k++] = offs[j++];
+			}
+		}
+
+		memcpy(offs, tmp, n * sizeof (uint32_t));
+	}
+
+	return true;
+}
+
 // Return true for need fix.
 static bool
 cdt_map_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf,
-		backup_config *bc)
+		cdt_stats *stat)
 {
 	msgpack_in mp = {
 			.buf = buf,
@@ -373,8 +988,8 @@ cdt_map_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf,
 
 	if (! msgpack_get_map_ele_count(&mp, &ele_count)) {
 		cf->need_log = true;
-		cf_atomic32_incr(&bc->cdt_map.cannot_fix);
-		cf_atomic32_incr(&bc->cdt_map.cf_corrupt);
+		cf_atomic32_incr(&stat->cannot_fix);
+		cf_atomic32_incr(&stat->cf_corrupt);
 		return false;
 	}
 
@@ -382,7 +997,7 @@ cdt_map_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf,
 		cf->ele_count = ele_count;
 		cf->contents = mp.buf + mp.offset;
 		cf->content_sz = 0;
-		return cdt_check_sz(&mp, sz, cf, &bc->cdt_map);
+		return cdt_check_sz(&mp, sz, cf, stat);
 	}
 
 	msgpack_ext ext;
@@ -390,8 +1005,8 @@ cdt_map_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf,
 	if (msgpack_peek_is_ext(&mp)) {
 		if (! msgpack_get_ext(&mp, &ext) || msgpack_sz(&mp) == 0) {
 			cf->need_log = true;
-			cf_atomic32_incr(&bc->cdt_map.cannot_fix);
-			cf_atomic32_incr(&bc->cdt_map.cf_corrupt);
+			cf_atomic32_incr(&stat->cannot_fix);
+			cf_atomic32_incr(&stat->cf_corrupt);
 			return false; // corrupted ext
 		}
 	}
@@ -400,7 +1015,7 @@ cdt_map_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf,
 		cf->contents = mp.buf + mp.offset;
 
 		if (msgpack_sz_rep(&mp, 2 * ele_count) == 0 || mp.has_nonstorage) {
-			cdt_check_set_cannotfix(&mp, cf, &bc->cdt_map);
+			cdt_check_set_cannotfix(&mp, cf, stat);
 			return false;
 		}
 
@@ -408,12 +1023,12 @@ cdt_map_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf,
 
 		if (cdt_map_dup_key_check(ele_count, cf->contents, cf->content_sz)) {
 			cf->need_log = true;
-			cf_atomic32_incr(&bc->cdt_map.cannot_fix);
-			cf_atomic32_incr(&bc->cdt_map.cf_dupkey);
+			cf_atomic32_incr(&stat->cannot_fix);
+			cf_atomic32_incr(&stat->cf_dupkey);
 			return false;
 		}
 
-		return cdt_check_sz(&mp, sz, cf, &bc->cdt_map);
+		return cdt_check_sz(&mp, sz, cf, stat);
 	}
 
 	cf->ele_count = ele_count - 1;
@@ -421,22 +1036,23 @@ cdt_map_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf,
 
 	if (cf->ele_count == 0) {
 		cf->content_sz = 0;
-		return cdt_check_sz(&mp, sz, cf, &bc->cdt_map);
+		return cdt_check_sz(&mp, sz, cf, stat);
 	}
 
 	msgpack_in mp_prev = mp;
+	cdt_prev_key prev = { .valid = false };
 
 	if (msgpack_sz_rep(&mp, 2) == 0 || mp.has_nonstorage) {
-		cdt_check_set_cannotfix(&mp, cf, &bc->cdt_map);
+		cdt_check_set_cannotfix(&mp, cf, stat);
 		return false;
 	}
 
 	for (uint32_t i = 1; i < ele_count - 1; i++) {
-		msgpack_cmp_type cmp = msgpack_cmp(&mp_prev, &mp);
+		msgpack_cmp_type cmp = cdt_cmp_next(&mp_prev, &mp, &prev);
 
 		if (msgpack_sz(&mp_prev) == 0 || msgpack_sz(&mp) == 0 ||
 				mp.has_nonstorage) {
-			cdt_check_set_cannotfix(&mp, cf, &bc->cdt_map);
+			cdt_check_set_cannotfix(&mp, cf, stat);
 			return false;
 		}
 
@@ -444,7 +1060,7 @@ cdt_map_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf,
 			if (mp.has_nonstorage || (ele_count - i - 1 != 0 &&
 					(msgpack_sz_rep(&mp, 2 * (ele_count - i - 2)) == 0 ||
 							mp.has_nonstorage))) {
-				cdt_check_set_cannotfix(&mp, cf, &bc->cdt_map);
+				cdt_check_set_cannotfix(&mp, cf, stat);
 				return false;
 			}
 
@@ -455,16 +1071,16 @@ cdt_map_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf,
 				if (cdt_map_dup_key_check(ele_count, cf->contents,
 						cf->content_sz)) {
 					cf->need_log = true;
-					cf_atomic32_incr(&bc->cdt_map.cannot_fix);
-					cf_atomic32_incr(&bc->cdt_map.cf_dupkey);
+					cf_atomic32_incr(&stat->cannot_fix);
+					cf_atomic32_incr(&stat->cf_dupkey);
 					return false;
 				}
 
-				cf_atomic32_incr(&bc->cdt_map.need_fix);
-				cf_atomic32_incr(&bc->cdt_map.nf_order);
+				cf_atomic32_incr(&stat->need_fix);
+				cf_atomic32_incr(&stat->nf_order);
 
 				if (mp.offset != sz) {
-					cf_atomic32_incr(&bc->cdt_map.nf_padding);
+					cf_atomic32_incr(&stat->nf_padding);
 					cf->nf_padding = sz - mp.offset;
 				}
 
@@ -472,20 +1088,20 @@ cdt_map_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf,
 			}
 
 			cf->need_log = true;
-			cf_atomic32_incr(&bc->cdt_map.cannot_fix);
-			cf_atomic32_incr(&bc->cdt_map.cf_corrupt);
+			cf_atomic32_incr(&stat->cannot_fix);
+			cf_atomic32_incr(&stat->cf_corrupt);
 			return false;
 		}
 	}
 
 	cf->content_sz = (uint32_t)(mp.buf + mp.offset - cf->contents);
-	return cdt_check_sz(&mp, sz, cf, &bc->cdt_map);
+	return cdt_check_sz(&mp, sz, cf, stat);
 }
 
 // Return true for need fix.
 static bool
 cdt_list_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf,
-		backup_config *bc)
+		cdt_stats *stat)
 {
 	msgpack_in mp = {
 			.buf = buf,
@@ -496,8 +1112,8 @@ cdt_list_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf,
 
 	if (! msgpack_get_list_ele_count(&mp, &ele_count)) {
 		cf->need_log = true;
-		cf_atomic32_incr(&bc->cdt_list.cannot_fix);
-		cf_atomic32_incr(&bc->cdt_list.cf_corrupt);
+		cf_atomic32_incr(&stat->cannot_fix);
+		cf_atomic32_incr(&stat->cf_corrupt);
 		return false;
 	}
 
@@ -505,7 +1121,7 @@ cdt_list_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf,
 		cf->ele_count = ele_count;
 		cf->contents = mp.buf + mp.offset;
 		cf->content_sz = 0;
-		return cdt_check_sz(&mp, sz, cf, &bc->cdt_list);
+		return cdt_check_sz(&mp, sz, cf, stat);
 	}
 
 	msgpack_ext ext;
@@ -513,8 +1129,8 @@ cdt_list_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf,
 	if (msgpack_peek_is_ext(&mp)) {
 		if (! msgpack_get_ext(&mp, &ext)) {
 			cf->need_log = true;
-			cf_atomic32_incr(&bc->cdt_list.cannot_fix);
-			cf_atomic32_incr(&bc->cdt_list.cf_corrupt);
+			cf_atomic32_incr(&stat->cannot_fix);
+			cf_atomic32_incr(&stat->cf_corrupt);
 			return false; // corrupted ext
 		}
 	}
@@ -523,13 +1139,13 @@ cdt_list_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf,
 		cf->contents = mp.buf + mp.offset;
 
 		if (msgpack_sz_rep(&mp, ele_count) == 0 || mp.has_nonstorage) {
-			cdt_check_set_cannotfix(&mp, cf, &bc->cdt_list);
+			cdt_check_set_cannotfix(&mp, cf, stat);
 			return false;
 		}
 
 		cf->content_sz = (uint32_t)(mp.buf + mp.offset - cf->contents);
 
-		return cdt_check_sz(&mp, sz, cf, &bc->cdt_list);
+		return cdt_check_sz(&mp, sz, cf, stat);
 	}
 
 	cf->ele_count = ele_count - 1;
@@ -537,24 +1153,25 @@ cdt_list_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf,
 
 	if (cf->ele_count == 0) {
 		cf->content_sz = 0;
-		return cdt_check_sz(&mp, sz, cf, &bc->cdt_list);
+		return cdt_check_sz(&mp, sz, cf, stat);
 	}
 
 	msgpack_in mp_prev = mp;
+	cdt_prev_key prev = { .valid = false };
 
 	if (msgpack_sz_rep(&mp, 1) == 0 || mp.has_nonstorage) {
-		cdt_check_set_cannotfix(&mp, cf, &bc->cdt_list);
+		cdt_check_set_cannotfix(&mp, cf, stat);
 		return false;
 	}
 
 	for (uint32_t i = 1; i < ele_count - 1; i++) {
-		msgpack_cmp_type cmp = msgpack_cmp(&mp_prev, &mp);
+		msgpack_cmp_type cmp = cdt_cmp_next(&mp_prev, &mp, &prev);
 
 		if (cmp != MSGPACK_CMP_LESS && cmp != MSGPACK_CMP_EQUAL) {
 			if (mp.has_nonstorage || (ele_count - i - 2 != 0 &&
 					(msgpack_sz_rep(&mp, ele_count - i - 2) == 0 ||
 							mp.has_nonstorage))) {
-				cdt_check_set_cannotfix(&mp, cf, &bc->cdt_list);
+				cdt_check_set_cannotfix(&mp, cf, stat);
 				return false;
 			}
 
@@ -562,1080 +1179,3984 @@ cdt_list_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf,
 			cf->nf_list_order = true;
 
 			if (mp.offset <= sz) {
-				cf_atomic32_incr(&bc->cdt_list.need_fix);
-				cf_atomic32_incr(&bc->cdt_list.nf_order);
+				cf_atomic32_incr(&stat->need_fix);
+				cf_atomic32_incr(&stat->nf_order);
 
 				if (mp.offset != sz) {
-					cf_atomic32_incr(&bc->cdt_list.nf_padding);
+					cf_atomic32_incr(&stat->nf_padding);
 					cf->nf_padding = sz - mp.offset;
 				}
 
 				return true; // fix order and maybe padding
 			}
 
-			cf_atomic32_incr(&bc->cdt_list.cannot_fix);
-			cf_atomic32_incr(&bc->cdt_list.cf_corrupt);
+			cf_atomic32_incr(&stat->cannot_fix);
+			cf_atomic32_incr(&stat->cf_corrupt);
 			return false;
 		}
 	}
 
 	if (mp.has_nonstorage) {
 		cf->need_log = true;
-		cf_atomic32_incr(&bc->cdt_list.cannot_fix);
-		cf_atomic32_incr(&bc->cdt_list.cf_nonstorage);
+		cf_atomic32_incr(&stat->cannot_fix);
+		cf_atomic32_incr(&stat->cf_nonstorage);
 		return false;
 	}
 
 	cf->content_sz = (uint32_t)(mp.buf + mp.offset - cf->contents);
-	return cdt_check_sz(&mp, sz, cf, &bc->cdt_list);
+	return cdt_check_sz(&mp, sz, cf, stat);
 }
 
-// Return true to need fix.
-static bool
-cdt_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf,
-		backup_config *bc)
+///
+/// Atomically adds the counters increased by a CDT check to the stats.
+///
+/// @param stat   The stats to be updated.
+/// @param delta  The counters increased by the check.
+///
+static void
+add_check_delta(cdt_stats *stat, const cdt_stats *delta)
 {
-	switch (msgpack_buf_peek_type(buf, sz)) {
-	case MSGPACK_TYPE_LIST:
-		cf_atomic32_incr(&bc->cdt_list.count);
-		return cdt_list_need_fix(buf, sz, cf, bc);
-	case MSGPACK_TYPE_MAP:
-		cf_atomic32_incr(&bc->cdt_map.count);
-		return cdt_map_need_fix(buf, sz, cf, bc);
-	default:
-		break;
+	if (delta->count != 0) {
+		cf_atomic32_add(&stat->count, delta->count);
 	}
 
-	return false;
-}
+	if (delta->need_fix != 0) {
+		cf_atomic32_add(&stat->need_fix, delta->need_fix);
+	}
 
-extern bool
-as_cdt_add_packed(as_packer* pk, as_operations* ops, const as_bin_name name, as_operator op_type);
+	if (delta->nf_order != 0) {
+		cf_atomic32_add(&stat->nf_order, delta->nf_order);
+	}
 
-static void
-cdt_fix_list(aerospike *as, as_record *rec, as_bin *bin, cdt_fix *cf,
-		cdt_stats *stat)
-{
-	if (! cf->nf_list_order && cf->nf_padding != 0) { // fix padding only
-		as_error error;
-		as_bytes *b = (as_bytes *)bin->valuep;
+	if (delta->nf_padding != 0) {
+		cf_atomic32_add(&stat->nf_padding, delta->nf_padding);
+	}
 
-		as_bytes_truncate(b, cf->nf_padding);
+	if (delta->nf_dupkey != 0) {
+		cf_atomic32_add(&stat->nf_dupkey, delta->nf_dupkey);
+	}
 
-		if (aerospike_key_put(as, &error, NULL, &rec->key, rec) !=
-				AEROSPIKE_OK) {
-			err("aerospike_key_put() returned %d - %s", error.code, error.message);
-			cf_atomic32_incr(&stat->nf_failed);
-			return;
-		}
+	if (delta->nf_nonstorage != 0) {
+		cf_atomic32_add(&stat->nf_nonstorage, delta->nf_nonstorage);
+	}
 
-		cf_atomic32_incr(&stat->fixed);
-		return;
+	if (delta->cannot_fix != 0) {
+		cf_atomic32_add(&stat->cannot_fix, delta->cannot_fix);
 	}
 
-	as_operations ops;
-	as_operations_init(&ops, 2);
+	if (delta->cf_dupkey != 0) {
+		cf_atomic32_add(&stat->cf_dupkey, delta->cf_dupkey);
+	}
 
-	as_operations_add_list_clear(&ops, bin->name);
+	if (delta->cf_nonstorage != 0) {
+		cf_atomic32_add(&stat->cf_nonstorage, delta->cf_nonstorage);
+	}
 
-	uint32_t new_buf_sz =
-			as_pack_list_header_get_size(4) + // OP list hdr
-			1 + // append items OP code
-			as_pack_list_header_get_size(cf->ele_count) + // value_list hdr
-			cf->content_sz + // value_list contents
-			1 + // create flags
-			1; // modify flags
+	if (delta->cf_corrupt != 0) {
+		cf_atomic32_add(&stat->cf_corrupt, delta->cf_corrupt);
+	}
+}
 
-	// add list append items
-	as_packer pk = {
-			.buffer = malloc(new_buf_sz),
-			.capacity = new_buf_sz
+///
+/// Selects the pairs that a policy-driven rebuild of a map keeps. Drops the pairs that contain
+/// non-storage elements and all but one of the pairs with equal keys. The kept pairs end up
+/// sorted by key.
+///
+/// @param contents    The map contents, i.e., the key-value pairs.
+/// @param content_sz  The size of the map contents.
+/// @param n           The number of pairs.
+/// @param map_fix     The MAP_FIX_* policies.
+/// @param offs        Returns the offsets of the kept pairs. Room for n offsets.
+/// @param tmp         Scratch space for n offsets.
+/// @param dups        Returns the number of pairs dropped for their duplicate keys.
+/// @param nonstorage  Returns the number of pairs dropped for their non-storage elements.
+///
+/// @result            The number of kept pairs, UINT32_MAX if the map is corrupted or has
+///                    non-storage elements that the policies don't drop.
+///
+static uint32_t
+cdt_map_select(const uint8_t *contents, uint32_t content_sz, uint32_t n, uint32_t map_fix,
+		uint32_t *offs, uint32_t *tmp, uint32_t *dups, uint32_t *nonstorage)
+{
+	msgpack_in mp = {
+			.buf = contents,
+			.buf_sz = content_sz
 	};
 
-	as_pack_list_header(&pk, 4);
-	as_pack_uint64(&pk, 2); // list append items OP code
+	uint32_t kept = 0;
+	*dups = 0;
+	*nonstorage = 0;
 
-	as_pack_list_header(&pk, cf->ele_count);
-	memcpy(pk.buffer + pk.offset, cf->contents, cf->content_sz);
-	pk.offset += cf->content_sz;
+	for (uint32_t i = 0; i < n; i++) {
+		uint32_t off = mp.offset;
+		mp.has_nonstorage = false;
 
-	as_pack_uint64(&pk, AS_LIST_ORDERED); // create flags
-	as_pack_uint64(&pk, AS_LIST_WRITE_ADD_UNIQUE | AS_LIST_WRITE_NO_FAIL | AS_LIST_WRITE_PARTIAL); // modify flags
+		if (msgpack_sz_rep(&mp, 2) == 0) {
+			return UINT32_MAX;
+		}
 
-	if (! as_cdt_add_packed(&pk, &ops, bin->name, AS_OPERATOR_CDT_MODIFY)) {
-		err("as_cdt_add_packed() failed");
-		as_operations_destroy(&ops);
-		cf_atomic32_incr(&stat->nf_failed);
-		return;
-	}
+		if (mp.has_nonstorage) {
+			if ((map_fix & MAP_FIX_DROP_NONSTORAGE) == 0) {
+				return UINT32_MAX;
+			}
 
-	as_error error;
+			++*nonstorage;
+			continue;
+		}
 
-	if (aerospike_key_operate(as, &error, NULL, &rec->key, &ops, &rec) !=
-			AEROSPIKE_OK) {
-		err("as_testlist_op() returned %d - %s", error.code, error.message);
-		as_operations_destroy(&ops);
-		cf_atomic32_incr(&stat->nf_failed);
-		return;
+		offs[kept++] = off;
 	}
 
-	as_operations_destroy(&ops);
-	cf_atomic32_incr(&stat->fixed);
-}
+	// scalar keys sort by their normalized form, everything else by msgpack_cmp()
+	cdt_key_ele *eles = cf_malloc((size_t)kept * sizeof (cdt_key_ele));
 
-// Return true to log the record.
-static bool
-cdt_try_fix(aerospike *as, as_record *rec, backup_config *bc)
-{
-	bool need_log = false; // log record if any bin is corrupt
+	for (uint32_t i = 0; i < kept; i++) {
+		msgpack_in kp = {
+				.buf = contents,
+				.buf_sz = content_sz,
+				.offset = offs[i]
+		};
 
-	for (int32_t i = 0; i < rec->bins.size; ++i) {
-		as_bin *bin = &rec->bins.entries[i];
-		as_val *val = (as_val *)bin->valuep;
+		eles[i].off = offs[i];
 
-		if (val->type != AS_BYTES) {
-			continue;
+		if (! msgpack_get_key(&kp, &eles[i].key)) {
+			cf_free(eles);
+			eles = NULL;
+			break;
 		}
+	}
 
-		as_bytes *b = (as_bytes *)val;
-		as_bytes_type b_type = as_bytes_get_type(b);
+	if (eles != NULL) {
+		qsort(eles, kept, sizeof (cdt_key_ele), compare_key_ele);
 
-		if (b_type != AS_BYTES_LIST && b_type != AS_BYTES_MAP) {
-			continue;
+		for (uint32_t i = 0; i < kept; i++) {
+			offs[i] = eles[i].off;
 		}
+	} else if (! cdt_sort_offsets(contents, content_sz, offs, tmp, kept)) {
+		return UINT32_MAX;
+	}
 
-		uint8_t *buf = as_bytes_get(b);
-		uint32_t buf_sz = as_bytes_size(b);
-		cdt_fix cf = { NULL };
-		bool need_fix = cdt_need_fix(buf, buf_sz, &cf, bc);
+	// pairs with equal keys are adjacent now; the sort is stable, so the first one came first
+	uint32_t unique = 0;
 
-		if (cf.need_log) {
-			need_log = true;
-		}
+	for (uint32_t i = 0; i < kept; ) {
+		uint32_t j = i + 1;
 
-		if (! need_fix) {
-			continue;
+		while (j < kept && (eles != NULL ?
+				msgpack_key_cmp(&eles[i].key, &eles[j].key) :
+				cdt_ele_cmp(contents, content_sz, offs[i], offs[j])) == MSGPACK_CMP_EQUAL) {
+			++j;
 		}
 
-		need_log = true;
-
-		if (! bc->cdt_fix) {
-			continue;
-		}
+		offs[unique++] = (map_fix & MAP_FIX_KEEP_LAST) != 0 ? offs[j - 1] : offs[i];
+		*dups += j - i - 1;
+		i = j;
+	}
 
-		if (b_type == AS_BYTES_LIST) {
-			cdt_fix_list(as, rec, bin, &cf, &bc->cdt_list);
-		}
+	if (eles != NULL) {
+		cf_free(eles);
 	}
 
-	return need_log;
+	return unique;
 }
 
 ///
-/// Callback function for the cluster node scan. Passed to `aerospike_scan_node()`.
+/// Checks whether the --map-fix policies can repair a map that cdt_map_need_fix() found to have
+/// duplicate keys or non-storage elements. If so, sets up the repair and counts the map as
+/// fixable.
 ///
-/// @param val   The record to be processed. `NULL` indicates scan completion.
-/// @param cont  The user-specified context passed to `aerospike_scan_node()`.
+/// @param buf      The map bin's msgpack data.
+/// @param sz       The size of the map bin's msgpack data.
+/// @param cf       Returns the repair information.
+/// @param map_fix  The MAP_FIX_* policies.
+/// @param stat     The map stats to be updated, if the map is fixable.
 ///
-/// @result      `false` to abort the scan, `true` to keep going.
+/// @result         `true`, if the policies can repair the map.
 ///
 static bool
-scan_callback(const as_val *val, void *cont)
+cdt_map_policy_check(const uint8_t *buf, uint32_t sz, cdt_fix *cf, uint32_t map_fix,
+		cdt_stats *stat)
 {
-	if (val == NULL) {
-		if (verbose) {
-			ver("Received scan end marker");
-		}
+	msgpack_in mp = {
+			.buf = buf,
+			.buf_sz = sz
+	};
+
+	uint32_t ele_count;
 
+	if (! msgpack_get_map_ele_count(&mp, &ele_count)) {
 		return false;
 	}
 
-	if (stop) {
-		if (verbose) {
-			ver("Callback detected failure");
+	if (ele_count != 0 && msgpack_peek_is_ext(&mp)) {
+		msgpack_ext ext;
+
+		if (! msgpack_get_ext(&mp, &ext) || msgpack_sz(&mp) == 0) {
+			return false;
 		}
 
-		return false;
+		--ele_count;
 	}
 
-	as_record *rec = as_record_fromval(val);
-
-	if (rec == NULL) {
-		err("Received value of unexpected type %d", (int32_t)as_val_type(val));
+	if (ele_count == 0) {
 		return false;
 	}
 
-	if (rec->key.ns[0] == 0) {
-		err("Received record without namespace, generation %d, %d bin(s)", rec->gen,
-				rec->bins.size);
+	const uint8_t *contents = buf + mp.offset;
+
+	if (msgpack_sz_rep(&mp, 2 * ele_count) == 0) {
 		return false;
 	}
 
-	per_node_context *pnc = cont;
+	uint32_t content_sz = (uint32_t)(buf + mp.offset - contents);
+	uint32_t *offs = cf_malloc(2 * (size_t)ele_count * sizeof (uint32_t));
+	uint32_t dups;
+	uint32_t nonstorage;
+	uint32_t kept = cdt_map_select(contents, content_sz, ele_count, map_fix, offs,
+			offs + ele_count, &dups, &nonstorage);
 
-	cf_atomic64_incr(&pnc->conf->rec_count_checked);
+	cf_free(offs);
 
-	if (! cdt_try_fix(pnc->conf->as, rec, pnc->conf)) {
-		return true;
+	if (kept == UINT32_MAX || (dups == 0 && nonstorage == 0) ||
+			(dups != 0 && (map_fix & (MAP_FIX_KEEP_FIRST | MAP_FIX_KEEP_LAST)) == 0)) {
+		return false;
 	}
 
-	// backing up to a directory: switch backup files when reaching the file size limit
-	if (pnc->conf->directory != NULL && pnc->byte_count_file >= pnc->conf->file_limit) {
-		if (verbose) {
-			ver("Crossed %" PRIu64 " bytes, switching output file", pnc->conf->file_limit);
-		}
+	memset(cf, 0, sizeof (cdt_fix));
+	cf->contents = contents;
+	cf->content_sz = content_sz;
+	cf->ele_count = ele_count;
+	cf->nf_map_dupkey = dups != 0;
+	cf->nf_map_nonstorage = nonstorage != 0;
+	cf->need_log = true;
 
-		if (!close_dir_file(pnc)) {
-			err("Error while closing old output file");
-			return false;
-		}
+	cf_atomic32_incr(&stat->need_fix);
 
-		if (!open_dir_file(pnc)) {
-			err("Error while opening new output file");
-			return false;
-		}
+	if (dups != 0) {
+		cf_atomic32_incr(&stat->nf_dupkey);
 	}
 
-	// backing up to a single backup file: allow one thread at a time to write
-	if (pnc->conf->output_file != NULL) {
-		safe_lock();
+	if (nonstorage != 0) {
+		cf_atomic32_incr(&stat->nf_nonstorage);
 	}
 
-	uint64_t bytes = 0;
-	bool ok = pnc->conf->encoder->put_record(&bytes, pnc->fd, pnc->conf->compact, rec);
-
-	if (pnc->conf->output_file != NULL) {
-		safe_unlock();
+	if (mp.offset < sz) {
+		cf_atomic32_incr(&stat->nf_padding);
+		cf->nf_padding = sz - mp.offset;
 	}
 
-	if (!ok) {
-		err("Error while storing record in output file");
-		return false;
-	}
+	return true;
+}
 
-	++pnc->rec_count_file;
-	++pnc->rec_count_node;
-	cf_atomic64_incr(&pnc->conf->rec_count_total);
+// Return true to need fix.
+static bool
+cdt_need_fix(const uint8_t *buf, uint32_t sz, cdt_fix *cf, uint32_t map_fix,
+		cdt_stats *list_stat, cdt_stats *map_stat)
+{
+	switch (msgpack_buf_peek_type(buf, sz)) {
+	case MSGPACK_TYPE_LIST:
+		cf_atomic32_incr(&list_stat->count);
+		return cdt_list_need_fix(buf, sz, cf, list_stat);
+	case MSGPACK_TYPE_MAP: {
+		cf_atomic32_incr(&map_stat->count);
 
-	pnc->byte_count_file += bytes;
-	pnc->byte_count_node += bytes;
-	cf_atomic64_add(&pnc->conf->byte_count_total, (int64_t)bytes);
+		if (map_fix == 0) {
+			return cdt_map_need_fix(buf, sz, cf, map_stat);
+		}
 
-	if (pnc->conf->bandwidth > 0) {
-		safe_lock();
+		// check into scratch counters; a policy may yet make an unfixable map fixable
+		cdt_stats delta;
+		memset(&delta, 0, sizeof (cdt_stats));
 
-		while (cf_atomic64_get(pnc->conf->byte_count_total) >= pnc->conf->byte_count_limit &&
-				!stop) {
-			safe_wait(&bandwidth_cond);
+		bool need_fix = cdt_map_need_fix(buf, sz, cf, &delta);
+
+		if ((delta.cf_dupkey != 0 || delta.cf_nonstorage != 0) &&
+				cdt_map_policy_check(buf, sz, cf, map_fix, map_stat)) {
+			return true;
 		}
 
-		safe_unlock();
+		add_check_delta(map_stat, &delta);
+		return need_fix;
+	}
+	default:
+		break;
 	}
 
-	return true;
+	return false;
 }
 
 ///
-/// Main backup worker thread function.
+/// A cached cdt_need_fix() verdict for a CDT bin value.
 ///
-///   - Pops the backup_thread_args for a cluster node off the job queue.
-///   - Initializes a per_node_context for that cluster node.
-///   - If backing up to a single file: uses the provided shared file descriptor,
-///     backup_thread_args.shared_fd.
-///   - If backing up to a directory: creates a new backup file by invoking open_dir_file().
-///   - Initiates a node scan with scan_callback() as the callback and the initialized
-///     per_node_context as user-specified context.
+typedef struct {
+	uint64_t hash[2];                   ///< The 128-bit hash of the bin value.
+	uint32_t size;                      ///< The size of the bin value. `0` for an empty slot.
+	bool need_fix;                      ///< The result of cdt_need_fix().
+	bool map;                           ///< The bin value is a map.
+	uint32_t contents_off;              ///< The offset of `cf.contents` from the start of the
+	                                    ///  bin value. UINT32_MAX for `NULL`.
+	cdt_fix cf;                         ///< The repair details computed by cdt_need_fix().
+	cdt_stats delta;                    ///< The counters that cdt_need_fix() increased.
+} verdict_entry;
+
 ///
-/// @param cont  The job queue.
+/// A shard of the verdict cache. A direct-mapped table with its own lock.
 ///
-/// @result      `EXIT_SUCCESS` on success, `EXIT_FAILURE` otherwise.
+struct verdict_shard_s {
+	pthread_mutex_t lock;               ///< Protects the entries.
+	verdict_entry *entries;             ///< The cached verdicts.
+	uint32_t n_entries;                 ///< The number of entries.
+};
+
 ///
-static void *
-backup_thread_func(void *cont)
+/// Wrapper around cdt_need_fix() that consults the verdict cache first. Byte-identical bin values
+/// get the same verdict, so a repeated value only costs a hash and a lookup.
+///
+/// @param bc        The global backup configuration and stats.
+/// @param buf       The bin value.
+/// @param sz        The size of the bin value.
+/// @param cf        The repair details.
+/// @param list_stat The list stats to be updated.
+/// @param map_stat  The map stats to be updated.
+///
+/// @result          `true`, if the bin value needs a repair.
+///
+static bool
+cdt_need_fix_cached(backup_config *bc, const uint8_t *buf, uint32_t sz, cdt_fix *cf,
+		cdt_stats *list_stat, cdt_stats *map_stat)
 {
-	if (verbose) {
-		ver("Entering validation thread 0x%" PRIx64, (uint64_t)pthread_self());
+	if (bc->verdict_cache == NULL) {
+		return cdt_need_fix(buf, sz, cf, bc->map_fix, list_stat, map_stat);
 	}
 
-	cf_queue *job_queue = cont;
-	void *res = (void *)EXIT_FAILURE;
-
-	while (true) {
-		if (stop) {
-			if (verbose) {
-				ver("Validation thread detected failure");
-			}
-
-			break;
-		}
-
-		backup_thread_args args;
-		int32_t q_res = cf_queue_pop(job_queue, &args, CF_QUEUE_NOWAIT);
-
-		if (q_res == CF_QUEUE_EMPTY) {
-			if (verbose) {
-				ver("Job queue is empty");
-			}
+	uint64_t hash[2];
+	murmur_hash_128(buf, sz, hash);
 
-			res = (void *)EXIT_SUCCESS;
-			break;
-		}
+	verdict_shard *shard = &bc->verdict_cache[hash[0] % VERDICT_SHARDS];
+	verdict_entry *ent = &shard->entries[hash[1] % shard->n_entries];
 
-		if (q_res != CF_QUEUE_OK) {
-			err("Error while picking up validation job");
-			break;
-		}
+	pthread_mutex_lock(&shard->lock);
 
-		per_node_context pnc;
-		memcpy(pnc.node_name, args.node_name, AS_NODE_NAME_SIZE);
-		pnc.conf = args.conf;
-		pnc.shared_fd = args.shared_fd;
-		pnc.fd = NULL;
-		pnc.fd_buf = NULL;
-		pnc.rec_count_file = pnc.byte_count_file = 0;
-		pnc.file_count = 0;
-		pnc.rec_count_node = pnc.byte_count_node = 0;
+	if (ent->size == sz && ent->hash[0] == hash[0] && ent->hash[1] == hash[1]) {
+		bool need_fix = ent->need_fix;
+		bool map = ent->map;
+		uint32_t contents_off = ent->contents_off;
+		cdt_stats delta = ent->delta;
+		*cf = ent->cf;
+		pthread_mutex_unlock(&shard->lock);
 
-		inf("Starting validation for node %s", pnc.node_name);
+		cf->contents = contents_off == UINT32_MAX ? NULL : buf + contents_off;
+		add_check_delta(map ? map_stat : list_stat, &delta);
+		cf_atomic64_incr(&bc->verdict_hits);
+		return need_fix;
+	}
 
-		// backing up to a single backup file: use the provided shared file descriptor for
-		// the current job
-		if (pnc.conf->output_file != NULL) {
-			if (verbose) {
-				ver("Using shared file descriptor");
-			}
+	pthread_mutex_unlock(&shard->lock);
 
-			pnc.fd = pnc.shared_fd;
-		// backing up to a directory: create the first backup file for the current job
-		} else if (pnc.conf->directory != NULL && !open_dir_file(&pnc)) {
-			err("Error while opening first output file");
-			break;
-		}
+	// validate into scratch counters, so that we know what to replay on a hit
+	cdt_stats list_delta;
+	cdt_stats map_delta;
+	memset(&list_delta, 0, sizeof (cdt_stats));
+	memset(&map_delta, 0, sizeof (cdt_stats));
 
-		as_error ae;
+	bool need_fix = cdt_need_fix(buf, sz, cf, bc->map_fix, &list_delta, &map_delta);
+	bool map = map_delta.count != 0;
 
-		if (aerospike_scan_node(pnc.conf->as, &ae, pnc.conf->policy, pnc.conf->scan,
-				pnc.node_name, scan_callback, &pnc) != AEROSPIKE_OK) {
-			if (ae.code == AEROSPIKE_OK) {
-				inf("Node scan for %s aborted", pnc.node_name);
-			} else {
-				err("Error while running node scan for %s - code %d: %s at %s:%d", pnc.node_name,
-						ae.code, ae.message, ae.file, ae.line);
-			}
+	add_check_delta(list_stat, &list_delta);
+	add_check_delta(map_stat, &map_delta);
+	cf_atomic64_incr(&bc->verdict_misses);
 
-			stop = true;
-			goto close_file;
-		}
+	pthread_mutex_lock(&shard->lock);
+	ent->hash[0] = hash[0];
+	ent->hash[1] = hash[1];
+	ent->size = sz;
+	ent->need_fix = need_fix;
+	ent->map = map;
+	ent->contents_off = cf->contents == NULL ? UINT32_MAX : (uint32_t)(cf->contents - buf);
+	ent->cf = *cf;
+	ent->cf.contents = NULL;
+	ent->delta = map ? map_delta : list_delta;
+	pthread_mutex_unlock(&shard->lock);
 
-		inf("Completed validation for node %s, records: %" PRIu64 ", size: %" PRIu64 " "
-				"(~%" PRIu64 " B/rec)", pnc.node_name, pnc.rec_count_node,
-				pnc.byte_count_node,
-				pnc.rec_count_node == 0 ? 0 : pnc.byte_count_node / pnc.rec_count_node);
+	return need_fix;
+}
 
-	close_file:
-		// backing up to a single backup file: do nothing
-		if (pnc.conf->output_file != NULL) {
-			if (verbose) {
-				ver("Not closing shared file descriptor");
-			}
+///
+/// Allocates the verdict cache.
+///
+/// @param bc  The global backup configuration and stats.
+///
+static void
+init_verdict_cache(backup_config *bc)
+{
+	uint32_t per_shard = (bc->verdict_entries + VERDICT_SHARDS - 1) / VERDICT_SHARDS;
+	bc->verdict_cache = safe_malloc(VERDICT_SHARDS * sizeof (verdict_shard));
 
-			pnc.fd = NULL;
-		// backing up to a directory: close the last backup file for the current job
-		} else if (pnc.conf->directory != NULL && !close_dir_file(&pnc)) {
-			err("Error while closing output file");
-			break;
-		}
+	for (uint32_t i = 0; i < VERDICT_SHARDS; ++i) {
+		verdict_shard *shard = &bc->verdict_cache[i];
+		pthread_mutex_init(&shard->lock, NULL);
+		shard->n_entries = per_shard;
+		shard->entries = safe_malloc(per_shard * sizeof (verdict_entry));
+		memset(shard->entries, 0, per_shard * sizeof (verdict_entry));
 	}
+}
 
-	if (res != (void *)EXIT_SUCCESS) {
-		if (verbose) {
-			ver("Indicating failure to other threads");
-		}
-
-		stop = true;
+///
+/// Frees the verdict cache.
+///
+/// @param bc  The global backup configuration and stats.
+///
+static void
+free_verdict_cache(backup_config *bc)
+{
+	if (bc->verdict_cache == NULL) {
+		return;
 	}
 
-	if (verbose) {
-		ver("Leaving validation thread");
+	for (uint32_t i = 0; i < VERDICT_SHARDS; ++i) {
+		pthread_mutex_destroy(&bc->verdict_cache[i].lock);
+		cf_free(bc->verdict_cache[i].entries);
 	}
 
-	return res;
+	cf_free(bc->verdict_cache);
+	bc->verdict_cache = NULL;
 }
 
 ///
-/// Main counter thread function.
-///
-///   - Outputs human-readable and machine-readable progress information.
-///   - If throttling is active: increases the I/O quota every second.
+/// Rebuilds an out-of-order ordered list locally: sorts the elements, drops duplicates, and
+/// re-packs them behind the original ext header. Trailing padding isn't carried over.
 ///
-/// @param cont  The arguments for the thread, passed as a counter_thread_args.
+/// @param buf   The list bin's msgpack data.
+/// @param sz    The size of the list bin's msgpack data.
+/// @param cf    The repair information collected by cdt_need_fix().
+/// @param dups  Returns the number of dropped duplicate elements. May be `NULL`.
 ///
-/// @result      Always `EXIT_SUCCESS`.
+/// @result      The rebuilt list bin value, `NULL` on error.
 ///
-static void *
-counter_thread_func(void *cont)
+static as_bytes *
+cdt_list_rebuild(const uint8_t *buf, uint32_t sz, const cdt_fix *cf, uint32_t *dups)
 {
-	if (verbose) {
-		ver("Entering counter thread 0x%" PRIx64, (uint64_t)pthread_self());
-	}
-
-	counter_thread_args *args = (counter_thread_args *)cont;
-	backup_config *conf = args->conf;
-	uint32_t iter = 0;
-	cf_clock prev_ms = cf_getms();
-	uint64_t prev_recs = cf_atomic64_get(conf->rec_count_checked);
+	msgpack_in mp = {
+			.buf = buf,
+			.buf_sz = sz
+	};
 
-	while (true) {
-		sleep(1);
+	uint32_t orig_count;
 
-		cf_clock now_ms = cf_getms();
-		uint32_t ms = (uint32_t)(now_ms - prev_ms);
-		prev_ms = now_ms;
+	if (! msgpack_get_list_ele_count(&mp, &orig_count)) {
+		return NULL;
+	}
 
-		if (conf->rec_count_estimate > 0) {
-			uint64_t now_recs = cf_atomic64_get(conf->rec_count_checked);
+	const uint8_t *ext = buf + mp.offset;
+	uint32_t ext_sz = (uint32_t)(cf->contents - ext);
+	uint32_t n = cf->ele_count;
 
-			int32_t percent = (int32_t)(now_recs * 100 / conf->rec_count_estimate);
-			uint64_t recs = now_recs - prev_recs;
+	// element start offsets, followed by scratch space for the sort, and the end offsets
+	uint32_t *offs = cf_malloc(3 * (size_t)n * sizeof (uint32_t));
+	uint32_t *tmp = offs + n;
+	uint32_t *ends = offs + 2 * n;
+	cdt_key_ele *eles = NULL;
+	as_bytes *res = NULL;
 
-			int32_t eta = recs == 0 ? -1 :
-					(int32_t)(((uint64_t)conf->rec_count_estimate - now_recs) * ms / recs / 1000);
-			char eta_buff[ETA_BUF_SIZE];
-			format_eta(eta, eta_buff, sizeof eta_buff);
+	msgpack_in ep = {
+			.buf = cf->contents,
+			.buf_sz = cf->content_sz
+	};
 
-			prev_recs = now_recs;
+	for (uint32_t i = 0; i < n; i++) {
+		offs[i] = ep.offset;
 
-			// rec_count_estimate may be a little off, make sure that we only print up to 99%
-			if (percent < 100) {
-				if (iter++ % 10 == 0) {
-					inf("%d%% complete (~%" PRIu64 " rec/s)", percent, ms == 0 ? 0 : recs * 1000 / ms);
+		if (msgpack_sz(&ep) == 0) {
+			goto cleanup1;
+		}
+	}
 
-					if (eta >= 0) {
-						inf("~%s remaining", eta_buff);
-					}
-				}
+	// scalar elements sort by their normalized keys, everything else by msgpack_cmp()
+	eles = cdt_normalize(cf->contents, cf->content_sz, n, 1);
 
-				if (args->mach_fd != NULL) {
-					if ((fprintf(args->mach_fd, "PROGRESS:%d\n", percent) < 0 ||
-							fflush(args->mach_fd) == EOF)) {
-						err_code("Error while writing machine-readable progress");
-					}
+	if (eles != NULL) {
+		qsort(eles, n, sizeof (cdt_key_ele), compare_key_ele);
 
-					if (eta >= 0 && (fprintf(args->mach_fd, "REMAINING:%s\n", eta_buff) < 0 ||
-							fflush(args->mach_fd) == EOF)) {
-						err_code("Error while writing machine-readable remaining time");
-					}
-				}
-			}
+		for (uint32_t i = 0; i < n; i++) {
+			offs[i] = eles[i].off;
 		}
+	} else if (! cdt_sort_offsets(cf->contents, cf->content_sz, offs, tmp, n)) {
+		goto cleanup1;
+	}
 
-		safe_lock();
-
-		if (conf->bandwidth > 0) {
-			if (ms > 0) {
-				conf->byte_count_limit += conf->bandwidth * 1000 / ms;
-			}
+	// drop duplicates; they are adjacent now
+	uint32_t unique = 0;
+	uint32_t data_sz = 0;
+	uint32_t last = 0;
 
-			safe_signal(&bandwidth_cond);
+	for (uint32_t i = 0; i < n; i++) {
+		if (unique > 0 && (eles != NULL ?
+				msgpack_key_cmp(&eles[last].key, &eles[i].key) :
+				cdt_ele_cmp(cf->contents, cf->content_sz, offs[unique - 1], offs[i])) ==
+				MSGPACK_CMP_EQUAL) {
+			continue;
 		}
 
-		bool tmp_stop = stop;
-		safe_unlock();
+		last = i;
+		ep.offset = offs[i];
+		msgpack_sz(&ep);
 
-		if (tmp_stop) {
-			break;
-		}
+		offs[unique] = offs[i];
+		ends[unique] = ep.offset;
+		data_sz += ep.offset - offs[i];
+		++unique;
 	}
 
-	uint64_t records = cf_atomic64_get(conf->rec_count_total);
-	uint64_t bytes = cf_atomic64_get(conf->byte_count_total);
-	inf("Found %" PRIu64 " invalid record(s) from %u node(s), "
-			"%" PRIu64 " byte(s) in total (~%" PRIu64 " B/rec)", records,
-			args->n_node_names, bytes, records == 0 ? 0 : bytes / records);
+	uint32_t new_sz = as_pack_list_header_get_size(unique + 1) + ext_sz + data_sz;
+	as_packer pk = {
+			.buffer = cf_malloc(new_sz),
+			.capacity = new_sz
+	};
 
-	if (args->mach_fd != NULL && (fprintf(args->mach_fd,
-			"SUMMARY:%" PRIu64 ":%" PRIu64 ":%" PRIu64 "\n", records,
-			bytes, records == 0 ? 0 : bytes / records) < 0 ||
-			fflush(args->mach_fd) == EOF)) {
-		err_code("Error while writing machine-readable summary");
+	as_pack_list_header(&pk, unique + 1);
+	memcpy(pk.buffer + pk.offset, ext, ext_sz);
+	pk.offset += ext_sz;
+
+	for (uint32_t i = 0; i < unique; i++) {
+		memcpy(pk.buffer + pk.offset, cf->contents + offs[i], ends[i] - offs[i]);
+		pk.offset += ends[i] - offs[i];
 	}
 
-	inf("CDT Mode: %s", conf->cdt_fix ? "fix" : "validate");
-	inf("%10u Lists", conf->cdt_list.count);
-	inf("%10u   Unfixable", conf->cdt_list.cannot_fix);
-	inf("%10u     Has non-storage", conf->cdt_list.cf_nonstorage);
-	inf("%10u     Corrupted", conf->cdt_list.cf_corrupt);
-	inf("%10u   Need Fix", conf->cdt_list.need_fix);
-	inf("%10u     Fixed", conf->cdt_list.fixed);
-	inf("%10u     Fix failed", conf->cdt_list.nf_failed);
-	inf("%10u     Order", conf->cdt_list.nf_order);
-	inf("%10u     Padding", conf->cdt_list.nf_padding);
-
-	inf("%10u Maps", conf->cdt_map.count);
-	inf("%10u   Unfixable", conf->cdt_map.cannot_fix);
-	inf("%10u     Has duplicate keys", conf->cdt_map.cf_dupkey);
-	inf("%10u     Has non-storage", conf->cdt_map.cf_nonstorage);
-	inf("%10u     Corrupted", conf->cdt_map.cf_corrupt);
-	inf("%10u   Need Fix", conf->cdt_map.need_fix);
-	inf("%10u     Fixed", conf->cdt_map.fixed);
-	inf("%10u     Fix failed", conf->cdt_map.nf_failed);
-	inf("%10u     Order", conf->cdt_map.nf_order);
-	inf("%10u     Padding", conf->cdt_map.nf_padding);
+	res = as_bytes_new_wrap(pk.buffer, pk.offset, true);
+	as_bytes_set_type(res, AS_BYTES_LIST);
 
-	if (verbose) {
-		ver("Leaving counter thread");
+	if (dups != NULL) {
+		*dups = n - unique;
 	}
 
-	return (void *)EXIT_SUCCESS;
+cleanup1:
+	if (eles != NULL) {
+		cf_free(eles);
+	}
+
+	cf_free(offs);
+	return res;
 }
 
 ///
-/// Tests whether the given backup file exists.
+/// Adds the operation that repairs a list bin to the given record operations. Only the affected
+/// bin is rewritten.
 ///
-/// @param file_path  The path of the backup file.
-/// @param clear      What to do, if the file already exists. `true` to remove it, `false` to report
-///                   back an error.
+///   - Padding only: truncates the bin value and writes it back.
+///   - Out of order: rebuilds the list locally, sorted and without duplicates, and writes it back.
 ///
-/// @result           `true`, if successful.
+/// @param ops    The record operations.
+/// @param bin    The bin to be repaired.
+/// @param cf     The repair information collected by cdt_need_fix().
+/// @param bytes  Increased by the size of the value written to the bin.
+///
+/// @result       `true`, if successful.
 ///
 static bool
-clean_output_file(const char *file_path, bool clear)
+cdt_fix_list(as_operations *ops, as_bin *bin, const cdt_fix *cf, uint64_t *bytes)
 {
-	if (verbose) {
-		ver("Checking output file %s", file_path);
-	}
+	as_bytes *b = (as_bytes *)bin->valuep;
+	as_bytes *fixed;
 
-	if (strcmp(file_path, "-") == 0) {
-		return true;
-	}
+	if (! cf->nf_list_order && cf->nf_padding != 0) { // fix padding only
+		as_bytes_truncate(b, cf->nf_padding);
 
-	struct stat buf;
+		// the record keeps owning the buffer; the operation only wraps it
+		fixed = as_bytes_new_wrap(as_bytes_get(b), as_bytes_size(b), false);
+		as_bytes_set_type(fixed, AS_BYTES_LIST);
+	} else {
+		fixed = cdt_list_rebuild(as_bytes_get(b), as_bytes_size(b), cf, NULL);
 
-	if (stat(file_path, &buf) < 0) {
-		if (errno == ENOENT) {
-			return true;
+		if (fixed == NULL) {
+			err("Error while rebuilding list in bin %s", bin->name);
+			return false;
 		}
-
-		err_code("Error while checking output file %s", file_path);
-		return false;
 	}
 
-	if (!clear) {
-		err("Output file %s already exists; use -r to remove", file_path);
-		return false;
-	}
-
-	if (remove(file_path) < 0) {
-		err_code("Error while removing existing output file %s", file_path);
+	if (! as_operations_add_write(ops, bin->name, (as_bin_value *)fixed)) {
+		err("as_operations_add_write() failed");
+		as_bytes_destroy(fixed);
 		return false;
 	}
 
+	*bytes += as_bytes_size(fixed);
 	return true;
 }
 
 ///
-/// Prepares the given directory for a backup.
-///
-///   - Creates the directory, if it doesn't exist.
-///   - If the directory already contains backup files, removes them or reports an error.
+/// Computes what repairing a list bin would do, without changing or writing anything.
 ///
-/// @param dir_path  The path of the directory.
-/// @param clear     What to do, if the directory already contains backup files. `true` to remove
-///                  them, `false` to report back an error.
+/// @param bin    The bin to be repaired.
+/// @param cf     The repair information collected by cdt_need_fix().
+/// @param delta  Updated with the bin's bytes reclaimed, duplicates dropped, and bytes written.
 ///
-/// @result          'true', if successful.
+/// @result       `true`, if the repair could be computed.
 ///
 static bool
-clean_directory(const char *dir_path, bool clear)
+cdt_simulate_list(const as_bin *bin, const cdt_fix *cf, dry_run_stats *delta)
 {
-	if (verbose) {
-		ver("Preparing output directory %s", dir_path);
+	as_bytes *b = (as_bytes *)bin->valuep;
+	uint32_t old_sz = as_bytes_size(b);
+
+	if (! cf->nf_list_order && cf->nf_padding != 0) { // fix padding only
+		delta->bytes_reclaimed += cf->nf_padding;
+		delta->write_bytes += old_sz - cf->nf_padding;
+		return true;
 	}
 
-	DIR *dir = opendir(dir_path);
+	uint32_t dups = 0;
+	as_bytes *fixed = cdt_list_rebuild(as_bytes_get(b), old_sz, cf, &dups);
 
-	if (dir == NULL) {
-		if (errno != ENOENT) {
-			err_code("Error while opening directory %s", dir_path);
-			return false;
-		}
+	if (fixed == NULL) {
+		return false;
+	}
 
-		inf("Directory %s does not exist, creating", dir_path);
+	uint32_t new_sz = as_bytes_size(fixed);
+	delta->bytes_reclaimed += old_sz > new_sz ? old_sz - new_sz : 0;
+	delta->dup_elements += dups;
+	delta->write_bytes += new_sz;
 
-		if (mkdir(dir_path, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) < 0) {
-			err_code("Error while creating directory %s", dir_path);
-			return false;
-		}
+	as_bytes_destroy(fixed);
+	return true;
+}
 
-		dir = opendir(dir_path);
+///
+/// Rebuilds a map according to the --map-fix policies: drops pairs with non-storage elements and
+/// duplicate keys and re-packs the remaining pairs sorted by key behind the original ext header,
+/// if any. Trailing padding isn't carried over.
+///
+/// @param buf         The map bin's msgpack data.
+/// @param sz          The size of the map bin's msgpack data.
+/// @param cf          The repair information collected by cdt_need_fix().
+/// @param map_fix     The MAP_FIX_* policies.
+/// @param dups        Returns the number of pairs dropped for their duplicate keys. May be
+///                    `NULL`.
+/// @param nonstorage  Returns the number of pairs dropped for their non-storage elements. May be
+///                    `NULL`.
+///
+/// @result            The rebuilt map bin value, `NULL` on error.
+///
+static as_bytes *
+cdt_map_rebuild(const uint8_t *buf, uint32_t sz, const cdt_fix *cf, uint32_t map_fix,
+		uint32_t *dups, uint32_t *nonstorage)
+{
+	msgpack_in mp = {
+			.buf = buf,
+			.buf_sz = sz
+	};
 
-		if (dir == NULL) {
-			err_code("Error while opening directory %s", dir_path);
-			return false;
-		}
+	uint32_t orig_count;
+
+	if (! msgpack_get_map_ele_count(&mp, &orig_count)) {
+		return NULL;
 	}
 
-	struct dirent *entry;
+	const uint8_t *ext = buf + mp.offset;
+	uint32_t ext_sz = (uint32_t)(cf->contents - ext);
+	uint32_t n = cf->ele_count;
 
-	while ((entry = readdir(dir)) != NULL) {
-		if (strcmp(entry->d_name + strlen(entry->d_name) - 4, ".asb") == 0) {
-			if (!clear) {
-				err("Directory %s seems to contain an existing output; "
-						"use -r to clear directory", dir_path);
-				closedir(dir);
-				return false;
-			}
+	// kept pair offsets, followed by scratch space for the sort, and the end offsets
+	uint32_t *offs = cf_malloc(3 * (size_t)n * sizeof (uint32_t));
+	uint32_t *tmp = offs + n;
+	uint32_t *ends = offs + 2 * n;
+	as_bytes *res = NULL;
+	uint32_t n_dups;
+	uint32_t n_nonstorage;
+	uint32_t kept = cdt_map_select(cf->contents, cf->content_sz, n, map_fix, offs, tmp, &n_dups,
+			&n_nonstorage);
 
-			char file_path[PATH_MAX];
+	if (kept == UINT32_MAX) {
+		goto cleanup1;
+	}
 
-			if ((size_t)snprintf(file_path, sizeof file_path, "%s/%s", dir_path,
-					entry->d_name) >= sizeof file_path) {
-				err("File path too long (%s, %s)", dir_path, entry->d_name);
-				closedir(dir);
-				return false;
-			}
+	msgpack_in ep = {
+			.buf = cf->contents,
+			.buf_sz = cf->content_sz
+	};
 
-			if (remove(file_path) < 0) {
-				err_code("Error while removing existing output file %s", file_path);
-				closedir(dir);
-				return false;
-			}
-		}
+	uint32_t data_sz = 0;
+
+	for (uint32_t i = 0; i < kept; i++) {
+		ep.offset = offs[i];
+		msgpack_sz_rep(&ep, 2);
+		ends[i] = ep.offset;
+		data_sz += ends[i] - offs[i];
 	}
 
-	if (closedir(dir) < 0) {
-		err_code("Error while closing directory handle for %s", dir_path);
+	// an ordered map's ext header counts as a pair
+	uint32_t count = ext_sz != 0 ? kept + 1 : kept;
+	uint32_t new_sz = as_pack_map_header_get_size(count) + ext_sz + data_sz;
+	as_packer pk = {
+			.buffer = cf_malloc(new_sz),
+			.capacity = new_sz
+	};
+
+	as_pack_map_header(&pk, count);
+	memcpy(pk.buffer + pk.offset, ext, ext_sz);
+	pk.offset += ext_sz;
+
+	for (uint32_t i = 0; i < kept; i++) {
+		memcpy(pk.buffer + pk.offset, cf->contents + offs[i], ends[i] - offs[i]);
+		pk.offset += ends[i] - offs[i];
+	}
+
+	res = as_bytes_new_wrap(pk.buffer, pk.offset, true);
+	as_bytes_set_type(res, AS_BYTES_MAP);
+
+	if (dups != NULL) {
+		*dups = n_dups;
+	}
+
+	if (nonstorage != NULL) {
+		*nonstorage = n_nonstorage;
+	}
+
+cleanup1:
+	cf_free(offs);
+	return res;
+}
+
+///
+/// Adds the operation that repairs a map bin according to the --map-fix policies to the given
+/// record operations. Rebuilds the map locally and writes it back.
+///
+/// @param ops      The record operations.
+/// @param bin      The bin to be repaired.
+/// @param cf       The repair information collected by cdt_need_fix().
+/// @param map_fix  The MAP_FIX_* policies.
+/// @param bytes    Increased by the size of the value written to the bin.
+///
+/// @result         `true`, if successful.
+///
+static bool
+cdt_fix_map(as_operations *ops, as_bin *bin, const cdt_fix *cf, uint32_t map_fix,
+		uint64_t *bytes)
+{
+	as_bytes *b = (as_bytes *)bin->valuep;
+	as_bytes *fixed = cdt_map_rebuild(as_bytes_get(b), as_bytes_size(b), cf, map_fix, NULL,
+			NULL);
+
+	if (fixed == NULL) {
+		err("Error while rebuilding map in bin %s", bin->name);
 		return false;
 	}
 
-	inf("Directory %s prepared for output", dir_path);
+	if (! as_operations_add_write(ops, bin->name, (as_bin_value *)fixed)) {
+		err("as_operations_add_write() failed");
+		as_bytes_destroy(fixed);
+		return false;
+	}
+
+	*bytes += as_bytes_size(fixed);
 	return true;
 }
 
 ///
-/// Parses a `host:port[,host:port[,...]]` string of (IP address, port) or `host:tls_name:port[,host:tls_name:port[,...]]` string of (IP address, tls_name, port) pairs into an
-/// array of node_spec. tls_name being optional.
+/// Computes what repairing a map bin according to the --map-fix policies would do, without
+/// changing or writing anything.
 ///
-/// @param node_list     The string to be parsed.
-/// @param node_specs    The created array of node_spec.
-/// @param n_node_specs  The number of elements in the created array.
+/// @param bin      The bin to be repaired.
+/// @param cf       The repair information collected by cdt_need_fix().
+/// @param map_fix  The MAP_FIX_* policies.
+/// @param delta    Updated with the bin's bytes reclaimed, pairs dropped, and bytes written.
 ///
-/// @result              `true`, if successful.
+/// @result         `true`, if the repair could be computed.
 ///
 static bool
-parse_node_list(char *node_list, node_spec **node_specs, uint32_t *n_node_specs)
+cdt_simulate_map(const as_bin *bin, const cdt_fix *cf, uint32_t map_fix, dry_run_stats *delta)
 {
-	bool res = false;
-	char *clone = safe_strdup(node_list);
+	as_bytes *b = (as_bytes *)bin->valuep;
+	uint32_t old_sz = as_bytes_size(b);
+	uint32_t dups = 0;
+	uint32_t nonstorage = 0;
+	as_bytes *fixed = cdt_map_rebuild(as_bytes_get(b), old_sz, cf, map_fix, &dups, &nonstorage);
 
-	// also allow ";" (remain backwards compatible)
-	for (size_t i = 0; node_list[i] != 0; ++i) {
-		if (node_list[i] == ';') {
-			node_list[i] = ',';
-		}
+	if (fixed == NULL) {
+		return false;
 	}
 
-	as_vector node_vec;
-	as_vector_inita(&node_vec, sizeof (void *), 25);
+	uint32_t new_sz = as_bytes_size(fixed);
+	delta->bytes_reclaimed += old_sz > new_sz ? old_sz - new_sz : 0;
+	delta->dup_elements += dups;
+	delta->nonstorage_elements += nonstorage;
+	delta->write_bytes += new_sz;
 
-	if (node_list[0] == 0) {
-		err("Empty node list");
-		goto cleanup1;
-	}
+	as_bytes_destroy(fixed);
+	return true;
+}
 
-	split_string(node_list, ',', true, &node_vec);
+///
+/// Adds a record's simulated repairs to the per-set dry-run totals.
+///
+/// @param bc     The global backup configuration and stats.
+/// @param set    The record's set.
+/// @param delta  The record's simulated repairs.
+///
+static void
+dry_run_add(backup_config *bc, const char *set, const dry_run_stats *delta)
+{
+	safe_lock();
 
-	*n_node_specs = node_vec.size;
-	*node_specs = safe_malloc(sizeof (node_spec) * node_vec.size);
-	for (uint32_t i = 0; i < *n_node_specs; i++) {
-		(*node_specs)[i].tls_name_str = NULL;
+	dry_run_stats *stats = NULL;
+
+	for (uint32_t i = 0; i < bc->dry_run_sets.size; ++i) {
+		dry_run_stats *cur = as_vector_get(&bc->dry_run_sets, i);
+
+		if (strcmp(cur->set, set) == 0) {
+			stats = cur;
+			break;
+		}
 	}
 
-	for (uint32_t i = 0; i < node_vec.size; ++i) {
-		char *node_str = as_vector_get_ptr(&node_vec, i);
-		sa_family_t family;
-		char *colon;
+	if (stats == NULL) {
+		stats = as_vector_reserve(&bc->dry_run_sets);
+		as_strncpy(stats->set, set, sizeof stats->set);
+	}
 
-		if (node_str[0] == '[') {
-			family = AF_INET6;
-			char *closing = strchr(node_str, ']');
+	stats->records += delta->records;
+	stats->bins += delta->bins;
+	stats->failed += delta->failed;
+	stats->bytes_reclaimed += delta->bytes_reclaimed;
+	stats->dup_elements += delta->dup_elements;
+	stats->nonstorage_elements += delta->nonstorage_elements;
+	stats->write_bytes += delta->write_bytes;
 
-			if (closing == NULL) {
-				err("Invalid node list %s (missing \"]\"", clone);
-				goto cleanup1;
-			}
+	safe_unlock();
+}
 
-			if (closing[1] != ':') {
-				err("Invalid node list %s (missing \":\")", clone);
-				goto cleanup1;
-			}
+///
+/// Validates the CDT bins of a record and collects the repairs for the broken ones.
+///
+/// @param rec        The record.
+/// @param bc         The global backup configuration and stats.
+/// @param ops        The operations that receive the repairs. `NULL` to only validate.
+/// @param list_stat  The list stats to be updated.
+/// @param map_stat   The map stats to be updated.
+/// @param need_log   Set, if the record has broken bins and should be logged.
+/// @param counts     Increased by the repairs added to the operations. May be `NULL` without
+///                   operations.
+/// @param dry_run    If not `NULL`, simulates the repairs into this instead of adding them to
+///                   the operations.
+///
+/// @result           The number of list and map repairs added to the operations.
+///
+static uint32_t
+cdt_collect_fixes(backup_config *bc, as_record *rec, as_operations *ops, cdt_stats *list_stat,
+		cdt_stats *map_stat, bool *need_log, fix_counts *counts, dry_run_stats *dry_run)
+{
+	uint32_t fixes = 0;
 
-			colon = closing + 1;
-		} else {
-			family = AF_INET;
-			colon = strchr(node_str, ':');
+	for (int32_t i = 0; i < rec->bins.size; ++i) {
+		as_bin *bin = &rec->bins.entries[i];
+		as_val *val = (as_val *)bin->valuep;
 
-			if (colon == NULL) {
-				err("Invalid node list %s (missing \":\")", clone);
-				goto cleanup1;
-			}
+		if (val->type != AS_BYTES) {
+			continue;
 		}
 
-		size_t length = (size_t)(colon - node_str);
+		as_bytes *b = (as_bytes *)val;
+		as_bytes_type b_type = as_bytes_get_type(b);
 
-		if (family == AF_INET6) {
-			++node_str;
-			length -= 2;
+		if (b_type != AS_BYTES_LIST && b_type != AS_BYTES_MAP) {
+			continue;
 		}
 
-		if (length == 0 || length > IP_ADDR_SIZE - 1) {
-			err("Invalid node list %s (invalid IP address)", clone);
-			goto cleanup2;
+		uint8_t *buf = as_bytes_get(b);
+		uint32_t buf_sz = as_bytes_size(b);
+		cdt_fix cf = { NULL };
+		bool need_fix = cdt_need_fix_cached(bc, buf, buf_sz, &cf, list_stat, map_stat);
+
+		if (cf.need_log) {
+			*need_log = true;
 		}
 
-		char ip_addr[IP_ADDR_SIZE];
-		memcpy(ip_addr, node_str, length);
-		ip_addr[length] = 0;
+		if (! need_fix) {
+			continue;
+		}
 
-		union {
-			struct in_addr v4;
-			struct in6_addr v6;
-		} ver;
+		*need_log = true;
 
-		if (inet_pton(family, ip_addr, &ver) <= 0) {
-			err("Invalid node list %s (invalid IP address %s)", clone, ip_addr);
-			goto cleanup2;
+		// only the --map-fix policies make maps fixable; others just get logged
+		bool map_policy = b_type == AS_BYTES_MAP && (cf.nf_map_dupkey || cf.nf_map_nonstorage);
+
+		if (dry_run != NULL) {
+			bool ok;
+
+			if (b_type == AS_BYTES_LIST) {
+				ok = cdt_simulate_list(bin, &cf, dry_run);
+			} else if (map_policy) {
+				ok = cdt_simulate_map(bin, &cf, bc->map_fix, dry_run);
+			} else {
+				continue;
+			}
+
+			if (ok) {
+				++dry_run->bins;
+			} else {
+				++dry_run->failed;
+			}
+
+			continue;
 		}
 
-		uint64_t tmp;
-		
-		if (family == AF_INET6) {
-			length = length + 1;
+		if (ops == NULL) {
+			continue;
 		}
 
-		char *new_colon;
-		new_colon = strchr(node_str + length + 1, ':');
+		if (b_type == AS_BYTES_LIST && bc->cdt_fix) {
+			if (cdt_fix_list(ops, bin, &cf, &counts->list_bytes)) {
+				++counts->list_fixes;
+				++fixes;
+			} else {
+				cf_atomic32_incr(&list_stat->nf_failed);
+			}
+		} else if (map_policy) {
+			if (cdt_fix_map(ops, bin, &cf, bc->map_fix, &counts->map_bytes)) {
+				++counts->map_fixes;
+				++fixes;
+			} else {
+				cf_atomic32_incr(&map_stat->nf_failed);
+			}
+		}
+	}
 
-		if (new_colon != NULL) {
-			node_str = node_str + length + 1;
-			length = (size_t)(new_colon - node_str);
-			char tls_name[length + 1];
-			memcpy(tls_name, node_str, length);
-			tls_name[length] = '\0';
+	return fixes;
+}
 
-			(*node_specs)[i].tls_name_str = safe_malloc(sizeof(char) * (length + 1));
-			memcpy((*node_specs)[i].tls_name_str, tls_name, length + 1);
+///
+/// Starts timing a phase.
+///
+/// @param bc  The global backup configuration and stats.
+///
+/// @result    The current time in microseconds, `0` without phase timing.
+///
+static inline cf_clock
+phase_start(const backup_config *bc)
+{
+	return bc->phase_timing ? cf_getus() : 0;
+}
 
-			colon = new_colon;
+///
+/// Attributes the time since phase_start() to a phase.
+///
+/// @param bc     The global backup configuration and stats.
+/// @param nm     The metrics of the node that the time was spent for.
+/// @param phase  The phase.
+/// @param start  The result of phase_start().
+///
+static inline void
+phase_end(const backup_config *bc, node_metrics *nm, profile_phase phase, cf_clock start)
+{
+	if (bc->phase_timing) {
+		cf_atomic64_add(&nm->phase_us[phase], (int64_t)(cf_getus() - start));
+	}
+}
+
+///
+/// Adds a fix operate's latency to the fix latency histogram.
+///
+/// @param bc  The global backup configuration and stats.
+/// @param us  The latency in microseconds.
+///
+static void
+record_fix_latency(backup_config *bc, uint64_t us)
+{
+	uint32_t i = 0;
+
+	while (i < N_LATENCY_BUCKETS && us > latency_bounds_us[i]) {
+		++i;
+	}
+
+	cf_atomic64_incr(&bc->fix_latency[i]);
+	cf_atomic64_add(&bc->fix_latency_us, (int64_t)us);
+}
+
+// Return true to log the record.
+static bool
+cdt_try_fix(aerospike *as, as_record *rec, backup_config *bc, scan_target *t, node_metrics *nm)
+{
+	bool need_log = false; // log record if any bin is corrupt
+	cf_clock start = phase_start(bc);
+
+	if (bc->cdt_fix_dry_run) {
+		dry_run_stats delta = { .set = { 0 } };
+		cdt_collect_fixes(bc, rec, NULL, &t->cdt_list, &t->cdt_map, &need_log, NULL, &delta);
+
+		if (delta.bins > 0 || delta.failed > 0) {
+			delta.records = delta.bins > 0 ? 1 : 0;
+			dry_run_add(bc, rec->key.set, &delta);
 		}
 
-		if (!better_atoi(colon + 1, &tmp) || tmp < 1 || tmp > 65535) {
-			err("Invalid node list %s (invalid port value %s)", clone, colon + 1);
-			goto cleanup2;
+		phase_end(bc, nm, PHASE_CHECK, start);
+		return need_log;
+	}
+
+	if (! bc->cdt_fix && bc->map_fix == 0) {
+		cdt_collect_fixes(bc, rec, NULL, &t->cdt_list, &t->cdt_map, &need_log, NULL, NULL);
+		phase_end(bc, nm, PHASE_CHECK, start);
+		return need_log;
+	}
+
+	// all repairs of a record go out in a single operate that only touches the affected bins
+	as_operations ops;
+	as_operations_init(&ops, (uint16_t)rec->bins.size);
+
+	fix_counts scanned = { 0 };
+	uint32_t fixes = cdt_collect_fixes(bc, rec, &ops, &t->cdt_list, &t->cdt_map, &need_log,
+			&scanned, NULL);
+
+	phase_end(bc, nm, PHASE_CHECK, start);
+
+	if (fixes == 0) {
+		as_operations_destroy(&ops);
+		return need_log;
+	}
+
+	start = phase_start(bc);
+
+	// only write over the exact version that we validated; an application write in between
+	// makes us re-read the record and rebuild the repairs from the new contents
+	as_policy_operate policy;
+	as_policy_operate_init(&policy);
+	policy.gen = AS_POLICY_GEN_EQ;
+
+	as_record *fresh = NULL;
+	fix_counts counts = scanned;
+	as_error error;
+	as_status status;
+	const char *call = "aerospike_key_operate()";
+
+	for (uint32_t tries = 1; ; ++tries) {
+		ops.gen = fresh != NULL ? fresh->gen : rec->gen;
+		cf_clock start_us = cf_getus();
+		status = aerospike_key_operate(as, &error, &policy, &rec->key, &ops, NULL);
+		record_fix_latency(bc, cf_getus() - start_us);
+
+		if (status != AEROSPIKE_ERR_RECORD_GENERATION || tries == CDT_FIX_MAX_TRIES) {
+			break;
+		}
+
+		// counts holds the fixes of the attempt that just failed
+		if (counts.list_fixes > 0) {
+			cf_atomic32_incr(&t->cdt_list.fix_retries);
+		}
+
+		if (counts.map_fixes > 0) {
+			cf_atomic32_incr(&t->cdt_map.fix_retries);
+		}
+
+		if (fresh != NULL) {
+			as_record_destroy(fresh);
+			fresh = NULL;
+		}
+
+		// only re-read the bins that the scan read, so that excluded bins stay untouched
+		status = bc->fix_bins != NULL ?
+				aerospike_key_select(as, &error, NULL, &rec->key, bc->fix_bins, &fresh) :
+				aerospike_key_get(as, &error, NULL, &rec->key, &fresh);
+
+		// the record was deleted in the meantime; nothing left to repair
+		if (status == AEROSPIKE_ERR_RECORD_NOT_FOUND) {
+			memset(&counts, 0, sizeof (fix_counts));
+			status = AEROSPIKE_OK;
+			break;
+		}
+
+		if (status != AEROSPIKE_OK) {
+			call = bc->fix_bins != NULL ? "aerospike_key_select()" : "aerospike_key_get()";
+			break;
+		}
+
+		as_operations_destroy(&ops);
+		as_operations_init(&ops, fresh->bins.size);
+
+		// the stats already reflect the scanned version; don't count the re-read one
+		cdt_stats list_scratch = { 0 };
+		cdt_stats map_scratch = { 0 };
+		bool log_scratch = false;
+
+		memset(&counts, 0, sizeof (fix_counts));
+		fixes = cdt_collect_fixes(bc, fresh, &ops, &list_scratch, &map_scratch, &log_scratch,
+				&counts, NULL);
+
+		// the concurrent write left nothing to repair
+		if (fixes == 0) {
+			break;
+		}
+	}
+
+	if (status != AEROSPIKE_OK) {
+		err("%s returned %d - %s", call, error.code, error.message);
+		cf_atomic32_add(&t->cdt_list.nf_failed, (int32_t)scanned.list_fixes);
+		cf_atomic32_add(&t->cdt_map.nf_failed, (int32_t)scanned.map_fixes);
+	} else {
+		cf_atomic32_add(&t->cdt_list.fixed, (int32_t)counts.list_fixes);
+		cf_atomic64_add(&t->cdt_list.fix_bytes, (int64_t)counts.list_bytes);
+		cf_atomic32_add(&t->cdt_map.fixed, (int32_t)counts.map_fixes);
+		cf_atomic64_add(&t->cdt_map.fix_bytes, (int64_t)counts.map_bytes);
+	}
+
+	as_operations_destroy(&ops);
+
+	if (fresh != NULL) {
+		as_record_destroy(fresh);
+	}
+
+	phase_end(bc, nm, PHASE_FIX, start);
+	return need_log;
+}
+
+///
+/// Writes a validated record to the current backup file of its node and updates the counters.
+///
+/// @param pnc  The context of the node that the record came from.
+/// @param rec  The record to be written.
+/// @param buf  The calling thread's record formatting buffer.
+///
+/// @result     `true`, if successful.
+///
+static bool
+store_record(per_node_context *pnc, const as_record *rec, output_buffer *buf)
+{
+	// backing up to a directory: switch backup files when reaching the file size limit
+	if (pnc->conf->directory != NULL && pnc->byte_count_file >= pnc->conf->file_limit) {
+		if (verbose) {
+			ver("Crossed %" PRIu64 " bytes, switching output file", pnc->conf->file_limit);
+		}
+
+		cf_clock start = phase_start(pnc->conf);
+
+		if (!rotate_dir_file(pnc)) {
+			err("Error while switching output file");
+			return false;
+		}
+
+		phase_end(pnc->conf, pnc->metrics, PHASE_ROTATE, start);
+	// getting close to the file size limit: have the next backup file opened in the background
+	} else if (pnc->conf->directory != NULL &&
+			cf_atomic32_get(pnc->next_state) == NEXT_NONE &&
+			pnc->byte_count_file >= pnc->conf->file_limit * ROTATE_PREOPEN_PERCENT / 100) {
+		request_next_file(pnc);
+	}
+
+	cf_clock start = phase_start(pnc->conf);
+
+	// backing up to a single backup file: allow one thread at a time to write
+	if (pnc->conf->output_file != NULL) {
+		safe_lock();
+	}
+
+	uint64_t bytes = 0;
+	bool ok = pnc->conf->encoder->put_record(&bytes, pnc->fd, pnc->conf->compact, rec, buf);
+
+	if (ok && pnc->index != NULL) {
+		index_add(pnc->index, &rec->key.digest, bytes);
+	}
+
+	if (pnc->conf->output_file != NULL) {
+		safe_unlock();
+	}
+
+	phase_end(pnc->conf, pnc->metrics, PHASE_STORE, start);
+
+	if (!ok) {
+		err("Error while storing record in output file");
+		return false;
+	}
+
+	++pnc->rec_count_file;
+	++pnc->rec_count_node;
+	cf_atomic64_incr(&pnc->conf->rec_count_total);
+	cf_atomic64_incr(&pnc->target->rec_count_total);
+
+	pnc->byte_count_file += bytes;
+	pnc->byte_count_node += bytes;
+	cf_atomic64_add(&pnc->conf->byte_count_total, (int64_t)bytes);
+	cf_atomic64_add(&pnc->metrics->byte_count, (int64_t)bytes);
+	return true;
+}
+
+///
+/// Validates a record, fixes it, if requested, and writes it to the backup file, if it's
+/// invalid.
+///
+/// @param pnc  The context of the node that the record came from.
+/// @param rec  The record to be processed.
+/// @param buf  The calling thread's record formatting buffer.
+///
+/// @result     `true`, if successful.
+///
+static bool
+process_record(per_node_context *pnc, as_record *rec, output_buffer *buf)
+{
+	cf_atomic64_incr(&pnc->conf->rec_count_checked);
+	cf_atomic64_incr(&pnc->metrics->rec_count_checked);
+	cf_atomic64_incr(&pnc->target->rec_count_checked);
+
+	if (! cdt_try_fix(pnc->conf->as, rec, pnc->conf, pnc->target, pnc->metrics)) {
+		return true;
+	}
+
+	bool pool = pnc->conf->validation_threads > 0;
+
+	// validation pool: several pool threads may hold records of the same node
+	if (pool) {
+		pthread_mutex_lock(&pnc->out_lock);
+	}
+
+	bool ok = store_record(pnc, rec, buf);
+
+	if (pool) {
+		pthread_mutex_unlock(&pnc->out_lock);
+	}
+
+	if (!ok) {
+		return false;
+	}
+
+	if (pnc->conf->bandwidth > 0) {
+		safe_lock();
+
+		if (cf_atomic64_get(pnc->conf->byte_count_total) >= pnc->conf->byte_count_limit &&
+				!stop) {
+			cf_clock start_us = cf_getus();
+
+			while (cf_atomic64_get(pnc->conf->byte_count_total) >= pnc->conf->byte_count_limit &&
+					!stop) {
+				safe_wait(&bandwidth_cond);
+			}
+
+			uint64_t waited = cf_getus() - start_us;
+			cf_atomic64_add(&pnc->conf->throttle_us, (int64_t)waited);
+
+			if (pnc->conf->phase_timing) {
+				cf_atomic64_add(&pnc->metrics->phase_us[PHASE_THROTTLE], (int64_t)waited);
+			}
+		}
+
+		safe_unlock();
+	}
+
+	return true;
+}
+
+///
+/// Estimates the memory held by a record received from a scan. With deserialize_list_map
+/// disabled, CDTs arrive as BLOBs, so the BLOB and string sizes dominate.
+///
+/// @param rec  The record.
+///
+/// @result     The estimated size in bytes.
+///
+static uint64_t
+record_mem_size(const as_record *rec)
+{
+	uint64_t size = sizeof (as_record) + rec->bins.capacity * sizeof (as_bin);
+
+	for (int32_t i = 0; i < rec->bins.size; ++i) {
+		as_val *val = (as_val *)rec->bins.entries[i].valuep;
+
+		if (val == NULL) {
+			continue;
+		}
+
+		switch (as_val_type(val)) {
+		case AS_BYTES:
+			size += sizeof (as_bytes) + as_bytes_size(as_bytes_fromval(val));
+			break;
+
+		case AS_STRING:
+			size += sizeof (as_string) + as_string_len(as_string_fromval(val));
+			break;
+
+		default:
+			size += sizeof (as_bin_value);
+			break;
+		}
+	}
+
+	return size;
+}
+
+///
+/// Moves a scanned record to the heap. The scan builds its records on the stack of the client's
+/// scan thread and tears them down when the scan callback returns, regardless of their reference
+/// counts. The key and the bin values are moved, not copied, so the original record is left
+/// without them.
+///
+/// @param rec  The scanned record.
+///
+/// @result     The heap copy, to be released with `as_record_destroy()`.
+///
+static as_record *
+detach_record(as_record *rec)
+{
+	as_record *copy = as_record_new(rec->bins.size);
+	copy->gen = rec->gen;
+	copy->ttl = rec->ttl;
+
+	memcpy(&copy->key, &rec->key, sizeof (as_key));
+	copy->key._free = false;
+
+	// an inline key value has to point into the copy
+	if (rec->key.valuep == &rec->key.value) {
+		copy->key.valuep = &copy->key.value;
+	}
+
+	rec->key.valuep = NULL;
+
+	for (uint16_t i = 0; i < rec->bins.size; ++i) {
+		as_bin *from = &rec->bins.entries[i];
+		as_bin *to = &copy->bins.entries[i];
+		memcpy(to, from, sizeof (as_bin));
+
+		// integers, doubles, strings, and BLOBs live in the bin itself; the latter two own
+		// their buffers, which move along
+		if (from->valuep == &from->value) {
+			to->valuep = &to->value;
+		}
+
+		from->valuep = NULL;
+	}
+
+	copy->bins.size = rec->bins.size;
+	return copy;
+}
+
+///
+/// Hands a record to the validation pool. Blocks while the queued records exceed the memory cap,
+/// which in turn stalls the node scan.
+///
+/// @param pnc  The context of the node that the record came from.
+/// @param rec  The record to be queued.
+///
+/// @result     `true`, if successful.
+///
+static bool
+queue_record(per_node_context *pnc, as_record *rec)
+{
+	backup_config *conf = pnc->conf;
+	queued_record qr = { detach_record(rec), pnc, 0 };
+	qr.mem_size = record_mem_size(qr.rec);
+
+	cf_clock start = phase_start(conf);
+
+	// always admit a record into an empty queue, so that records larger than the cap still work
+	safe_lock();
+
+	while ((uint64_t)cf_atomic64_get(conf->queue_bytes) > 0 &&
+			(uint64_t)cf_atomic64_get(conf->queue_bytes) + qr.mem_size > conf->queue_memory &&
+			!stop) {
+		safe_wait(&queue_cond);
+	}
+
+	safe_unlock();
+	phase_end(conf, pnc->metrics, PHASE_QUEUE, start);
+
+	if (stop) {
+		as_record_destroy(qr.rec);
+		return false;
+	}
+
+	cf_atomic32_incr(&pnc->pending);
+	cf_atomic64_add(&conf->queue_bytes, (int64_t)qr.mem_size);
+
+	if (cf_queue_push(conf->record_queue, &qr) != CF_QUEUE_OK) {
+		err("Error while queueing record");
+		cf_atomic64_sub(&conf->queue_bytes, (int64_t)qr.mem_size);
+		cf_atomic32_decr(&pnc->pending);
+		as_record_destroy(qr.rec);
+		return false;
+	}
+
+	return true;
+}
+
+///
+/// Main validation pool thread function.
+///
+///   - Pops queued_record elements off backup_config.record_queue until it pops one with a `NULL`
+///     record.
+///   - Processes each record unless the stop flag is set, then releases it.
+///   - Wakes up the scan callbacks waiting for memory and the validation threads waiting for
+///     their node's records to drain.
+///
+/// @param cont  The global backup configuration and stats.
+///
+/// @result      `EXIT_SUCCESS` on success, `EXIT_FAILURE` otherwise.
+///
+static void *
+validation_thread_func(void *cont)
+{
+	if (verbose) {
+		ver("Entering validation pool thread 0x%" PRIx64, (uint64_t)pthread_self());
+	}
+
+	backup_config *conf = cont;
+	void *res = (void *)EXIT_SUCCESS;
+	output_buffer out_buf = { NULL, 0, 0 };
+
+	while (true) {
+		queued_record qr;
+
+		if (cf_queue_pop(conf->record_queue, &qr, CF_QUEUE_FOREVER) != CF_QUEUE_OK) {
+			err("Error while picking up queued record");
+			res = (void *)EXIT_FAILURE;
+			stop = true;
+			break;
+		}
+
+		if (qr.rec == NULL) {
+			break;
+		}
+
+		// keep draining after a failure, so that nobody waits for the pending records forever
+		if (!stop && !process_record(qr.pnc, qr.rec, &out_buf)) {
+			res = (void *)EXIT_FAILURE;
+			stop = true;
+		}
+
+		as_record_destroy(qr.rec);
+
+		uint64_t after = (uint64_t)cf_atomic64_sub(&conf->queue_bytes, (int64_t)qr.mem_size);
+		uint64_t before = after + qr.mem_size;
+		bool drained = cf_atomic32_decr(&qr.pnc->pending) == 0;
+
+		// a waiting scan callback needs either a free half of the cap or an empty queue; only
+		// wake up the others in these cases to stay off the global lock
+		if (drained || after == 0 || before >= conf->queue_memory / 2 || stop) {
+			safe_lock();
+			safe_signal(&queue_cond);
+			safe_unlock();
+		}
+	}
+
+	output_buffer_free(&out_buf);
+
+	if (verbose) {
+		ver("Leaving validation pool thread");
+	}
+
+	return res;
+}
+
+///
+/// Callback function for the cluster node scan. Passed to `aerospike_scan_node()`.
+///
+/// @param val   The record to be processed. `NULL` indicates scan completion.
+/// @param cont  The user-specified context passed to `aerospike_scan_node()`.
+///
+/// @result      `false` to abort the scan, `true` to keep going.
+///
+static bool
+scan_callback(const as_val *val, void *cont)
+{
+	if (val == NULL) {
+		if (verbose) {
+			ver("Received scan end marker");
+		}
+
+		return false;
+	}
+
+	if (stop) {
+		if (verbose) {
+			ver("Callback detected failure");
+		}
+
+		return false;
+	}
+
+	as_record *rec = as_record_fromval(val);
+
+	if (rec == NULL) {
+		err("Received value of unexpected type %d", (int32_t)as_val_type(val));
+		return false;
+	}
+
+	if (rec->key.ns[0] == 0) {
+		err("Received record without namespace, generation %d, %d bin(s)", rec->gen,
+				rec->bins.size);
+		return false;
+	}
+
+	per_node_context *pnc = cont;
+
+	// whatever happened since we last returned was the client waiting for and parsing records
+	phase_end(pnc->conf, pnc->metrics, PHASE_NETWORK, pnc->phase_mark);
+
+	bool res;
+
+	// validation pool: only hand the record over, keep the scan's socket moving
+	if (pnc->conf->validation_threads > 0) {
+		res = queue_record(pnc, rec);
+	} else {
+		res = process_record(pnc, rec, pnc->out_buf);
+	}
+
+	pnc->phase_mark = phase_start(pnc->conf);
+	return res;
+}
+
+///
+/// Waits until the validation pool is done with all queued records of a node. The records
+/// reference the node's context and output file, so both must stay around until then.
+///
+/// @param pnc  The context of the node.
+///
+static void
+wait_for_pending(per_node_context *pnc)
+{
+	if (pnc->conf->validation_threads == 0) {
+		return;
+	}
+
+	safe_lock();
+
+	while (cf_atomic32_get(pnc->pending) > 0) {
+		safe_wait(&queue_cond);
+	}
+
+	safe_unlock();
+}
+
+///
+/// Waits for a free scan slot. Without --adaptive-parallel, there always is one.
+///
+/// @param conf  The global backup configuration and stats.
+///
+/// @result      When the slot was taken, i.e., the node scan started, in milliseconds.
+///
+static cf_clock
+acquire_scan_slot(backup_config *conf)
+{
+	safe_lock();
+
+	while (conf->adaptive && conf->active_scans >= conf->scan_limit && !stop) {
+		safe_wait(&scan_cond);
+	}
+
+	++conf->active_scans;
+	cf_clock start_ms = cf_getms();
+
+	if (conf->first_scan_ms == 0) {
+		conf->first_scan_ms = start_ms;
+	}
+
+	safe_unlock();
+	return start_ms;
+}
+
+///
+/// Frees a scan slot taken by acquire_scan_slot() and adds the node scan to the makespan stats.
+///
+/// @param conf      The global backup configuration and stats.
+/// @param start_ms  The result of acquire_scan_slot().
+///
+static void
+release_scan_slot(backup_config *conf, cf_clock start_ms)
+{
+	safe_lock();
+	--conf->active_scans;
+
+	cf_clock end_ms = cf_getms();
+	uint64_t ms = end_ms - start_ms;
+	conf->last_scan_ms = end_ms;
+	conf->scan_busy_ms += ms;
+
+	if (ms > conf->longest_scan_ms) {
+		conf->longest_scan_ms = ms;
+	}
+
+	safe_signal(&scan_cond);
+	safe_unlock();
+}
+
+///
+/// Main backup worker thread function.
+///
+///   - Pops the backup_thread_args for a cluster node off the job queue.
+///   - Initializes a per_node_context for that cluster node.
+///   - If backing up to a single file: uses the provided shared file descriptor,
+///     backup_thread_args.shared_fd.
+///   - If backing up to a directory: creates a new backup file by invoking open_dir_file().
+///   - Initiates a node scan with scan_callback() as the callback and the initialized
+///     per_node_context as user-specified context.
+///
+/// @param cont  The job queue.
+///
+/// @result      `EXIT_SUCCESS` on success, `EXIT_FAILURE` otherwise.
+///
+static void *
+backup_thread_func(void *cont)
+{
+	if (verbose) {
+		ver("Entering validation thread 0x%" PRIx64, (uint64_t)pthread_self());
+	}
+
+	cf_queue *job_queue = cont;
+	void *res = (void *)EXIT_FAILURE;
+	output_buffer out_buf = { NULL, 0, 0 };
+	file_index dir_index;
+	bool has_dir_index = false;
+
+	while (true) {
+		if (stop) {
+			if (verbose) {
+				ver("Validation thread detected failure");
+			}
+
+			break;
+		}
+
+		backup_thread_args args;
+		int32_t q_res = cf_queue_pop(job_queue, &args, CF_QUEUE_NOWAIT);
+
+		if (q_res == CF_QUEUE_EMPTY) {
+			if (verbose) {
+				ver("Job queue is empty");
+			}
+
+			res = (void *)EXIT_SUCCESS;
+			break;
+		}
+
+		if (q_res != CF_QUEUE_OK) {
+			err("Error while picking up validation job");
+			break;
+		}
+
+		per_node_context pnc;
+		memcpy(pnc.node_name, args.node_name, AS_NODE_NAME_SIZE);
+		pnc.conf = args.conf;
+		pnc.shared_fd = args.shared_fd;
+		pnc.fd = NULL;
+		pnc.fd_buf = NULL;
+		pnc.out_buf = &out_buf;
+		pnc.rec_count_file = pnc.byte_count_file = 0;
+		pnc.file_count = 0;
+		pnc.rec_count_node = pnc.byte_count_node = 0;
+		pnc.metrics = args.metrics;
+		pnc.target = args.target;
+		cf_atomic32_set(&pnc.next_state, NEXT_NONE);
+		pnc.next_fd = NULL;
+		pnc.next_fd_buf = NULL;
+		pnc.next_bytes = 0;
+		pnc.numa_node = numa_current_node(pnc.conf->numa_topo);
+		pnc.index = NULL;
+
+		// the thread's files take turns using the same offset index
+		if (pnc.conf->index_interval > 0) {
+			if (!has_dir_index) {
+				index_init(&dir_index, pnc.conf->index_interval);
+				has_dir_index = true;
+			}
+
+			pnc.index = &dir_index;
+		}
+
+		inf("Starting validation for node %s (namespace %s, set %s)", pnc.node_name,
+				pnc.target->ns, pnc.target->set[0] == 0 ? "[all]" : pnc.target->set);
+
+		// backing up to a single backup file: use the provided shared file descriptor for
+		// the current job
+		if (pnc.conf->output_file != NULL) {
+			if (verbose) {
+				ver("Using shared file descriptor");
+			}
+
+			pnc.fd = pnc.shared_fd;
+		// backing up to a directory: create the first backup file for the current job
+		} else if (pnc.conf->directory != NULL && !open_dir_file(&pnc)) {
+			err("Error while opening first output file");
+			break;
+		}
+
+		pthread_mutex_init(&pnc.out_lock, NULL);
+		cf_atomic32_set(&pnc.pending, 0);
+
+		as_error ae;
+		cf_clock start_ms = acquire_scan_slot(pnc.conf);
+		pnc.phase_mark = phase_start(pnc.conf);
+
+		if (aerospike_scan_node(pnc.conf->as, &ae, pnc.conf->policy, &pnc.target->scan,
+				pnc.node_name, scan_callback, &pnc) != AEROSPIKE_OK) {
+			if (ae.code == AEROSPIKE_OK) {
+				inf("Node scan for %s aborted", pnc.node_name);
+			} else {
+				err("Error while running node scan for %s - code %d: %s at %s:%d", pnc.node_name,
+						ae.code, ae.message, ae.file, ae.line);
+			}
+
+			stop = true;
+			wait_for_pending(&pnc);
+			release_scan_slot(pnc.conf, start_ms);
+			goto close_file;
+		}
+
+		wait_for_pending(&pnc);
+		release_scan_slot(pnc.conf, start_ms);
+
+		inf("Completed validation for node %s, records: %" PRIu64 ", size: %" PRIu64 " "
+				"(~%" PRIu64 " B/rec)", pnc.node_name, pnc.rec_count_node,
+				pnc.byte_count_node,
+				pnc.rec_count_node == 0 ? 0 : pnc.byte_count_node / pnc.rec_count_node);
+
+	close_file:
+		// backing up to a single backup file: do nothing
+		if (pnc.conf->output_file != NULL) {
+			if (verbose) {
+				ver("Not closing shared file descriptor");
+			}
+
+			pnc.fd = NULL;
+		// backing up to a directory: close the last backup file for the current job and drop
+		// the next one, if it was pre-opened in vain
+		} else if (pnc.conf->directory != NULL &&
+				(!discard_next_file(&pnc) || !close_dir_file(&pnc) || !write_dir_index(&pnc))) {
+			err("Error while closing output file");
+			pthread_mutex_destroy(&pnc.out_lock);
+			break;
+		}
+
+		pthread_mutex_destroy(&pnc.out_lock);
+	}
+
+	if (res != (void *)EXIT_SUCCESS) {
+		if (verbose) {
+			ver("Indicating failure to other threads");
+		}
+
+		stop = true;
+	}
+
+	output_buffer_free(&out_buf);
+
+	if (has_dir_index) {
+		index_free(&dir_index);
+	}
+
+	if (verbose) {
+		ver("Leaving validation thread");
+	}
+
+	return res;
+}
+
+///
+/// Creates a validation thread or a validation pool thread. With --numa, consecutive threads
+/// get pinned to consecutive NUMA nodes. Their thread-local buffers then end up in node-local
+/// memory, as memory gets allocated on the node that first touches it.
+///
+/// @param conf    The global backup configuration and stats.
+/// @param index   The thread's index.
+/// @param thread  Returns the created thread.
+/// @param func    The thread function.
+/// @param arg     The argument to be passed to the thread function.
+///
+/// @result        `true`, if successful.
+///
+static bool
+create_worker(const backup_config *conf, uint32_t index, pthread_t *thread,
+		void *(*func)(void *), void *arg)
+{
+	if (conf->numa_topo == NULL) {
+		return pthread_create(thread, NULL, func, arg) == 0;
+	}
+
+	pthread_attr_t attr;
+
+	if (!numa_thread_attr(conf->numa_topo, index, &attr)) {
+		return false;
+	}
+
+	bool res = pthread_create(thread, &attr, func, arg) == 0;
+	pthread_attr_destroy(&attr);
+	return res;
+}
+
+///
+/// Formats one CDT counter of a namespace and set for the metrics endpoint.
+///
+/// @param buf       The output buffer.
+/// @param t         The namespace and set.
+/// @param type      The CDT type label, `list` or `map`.
+/// @param category  The category label.
+/// @param value     The counter value.
+///
+/// @result          `true`, if successful.
+///
+static bool
+render_cdt_count(output_buffer *buf, const scan_target *t, const char *type,
+		const char *category, int32_t value)
+{
+	return metrics_printf(buf, "asvalidation_cdt_total{namespace=\"%s\",set=\"%s\",type=\"%s\","
+			"category=\"%s\"} %d\n", t->ns, t->set, type, category, value);
+}
+
+///
+/// Formats the counters of one CDT type of a namespace and set for the metrics endpoint.
+///
+/// @param buf    The output buffer.
+/// @param t      The namespace and set.
+/// @param type   The CDT type label, `list` or `map`.
+/// @param stats  The counters.
+///
+/// @result       `true`, if successful.
+///
+static bool
+render_cdt_metrics(output_buffer *buf, const scan_target *t, const char *type,
+		const cdt_stats *stats)
+{
+	return render_cdt_count(buf, t, type, "checked", stats->count) &&
+			render_cdt_count(buf, t, type, "unfixable", stats->cannot_fix) &&
+			render_cdt_count(buf, t, type, "duplicate_keys", stats->cf_dupkey) &&
+			render_cdt_count(buf, t, type, "non_storage", stats->cf_nonstorage) &&
+			render_cdt_count(buf, t, type, "corrupted", stats->cf_corrupt) &&
+			render_cdt_count(buf, t, type, "need_fix", stats->need_fix) &&
+			render_cdt_count(buf, t, type, "fixed", stats->fixed) &&
+			render_cdt_count(buf, t, type, "fix_failed", stats->nf_failed) &&
+			render_cdt_count(buf, t, type, "fix_retried", stats->fix_retries) &&
+			render_cdt_count(buf, t, type, "order", stats->nf_order) &&
+			render_cdt_count(buf, t, type, "padding", stats->nf_padding) &&
+			render_cdt_count(buf, t, type, "fixable_duplicate_keys", stats->nf_dupkey) &&
+			render_cdt_count(buf, t, type, "fixable_non_storage", stats->nf_nonstorage) &&
+			metrics_printf(buf, "asvalidation_fix_bytes_total{namespace=\"%s\",set=\"%s\","
+					"type=\"%s\"} %" PRIu64 "\n", t->ns, t->set, type,
+					(uint64_t)cf_atomic64_get(stats->fix_bytes));
+}
+
+///
+/// Formats the current counters in the Prometheus text format. Passed to metrics_start().
+///
+/// @param buf    The output buffer.
+/// @param udata  The global backup configuration and stats.
+///
+/// @result       `true`, if successful.
+///
+static bool
+render_metrics(output_buffer *buf, void *udata)
+{
+	backup_config *conf = udata;
+
+	if (!metrics_printf(buf, "# TYPE asvalidation_records_checked_total counter\n")) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < conf->n_node_metrics; ++i) {
+		node_metrics *nm = &conf->node_metrics[i];
+
+		if (!metrics_printf(buf, "asvalidation_records_checked_total{node=\"%s\"} %" PRIu64 "\n",
+				nm->node_name, (uint64_t)cf_atomic64_get(nm->rec_count_checked))) {
+			return false;
+		}
+	}
+
+	if (!metrics_printf(buf, "# TYPE asvalidation_records_checked_rate gauge\n")) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < conf->n_node_metrics; ++i) {
+		node_metrics *nm = &conf->node_metrics[i];
+
+		if (!metrics_printf(buf, "asvalidation_records_checked_rate{node=\"%s\"} %" PRIu64 "\n",
+				nm->node_name, nm->rec_rate)) {
+			return false;
+		}
+	}
+
+	if (!metrics_printf(buf, "# TYPE asvalidation_output_bytes_total counter\n")) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < conf->n_node_metrics; ++i) {
+		node_metrics *nm = &conf->node_metrics[i];
+
+		if (!metrics_printf(buf, "asvalidation_output_bytes_total{node=\"%s\"} %" PRIu64 "\n",
+				nm->node_name, (uint64_t)cf_atomic64_get(nm->byte_count))) {
+			return false;
+		}
+	}
+
+	if (!metrics_printf(buf, "# TYPE asvalidation_records_estimate gauge\n"
+			"asvalidation_records_estimate %" PRIu64 "\n"
+			"# TYPE asvalidation_invalid_records_total counter\n", conf->rec_count_estimate)) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < conf->n_targets; ++i) {
+		scan_target *t = &conf->targets[i];
+
+		if (!metrics_printf(buf, "asvalidation_invalid_records_total{namespace=\"%s\","
+				"set=\"%s\"} %" PRIu64 "\n", t->ns, t->set,
+				(uint64_t)cf_atomic64_get(t->rec_count_total))) {
+			return false;
+		}
+	}
+
+	if (!metrics_printf(buf, "# TYPE asvalidation_cdt_total counter\n")) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < conf->n_targets; ++i) {
+		if (!render_cdt_metrics(buf, &conf->targets[i], "list", &conf->targets[i].cdt_list) ||
+				!render_cdt_metrics(buf, &conf->targets[i], "map", &conf->targets[i].cdt_map)) {
+			return false;
+		}
+	}
+
+	if (!metrics_printf(buf, "# TYPE asvalidation_fix_latency_seconds histogram\n")) {
+		return false;
+	}
+
+	uint64_t count = 0;
+
+	for (uint32_t i = 0; i <= N_LATENCY_BUCKETS; ++i) {
+		count += (uint64_t)cf_atomic64_get(conf->fix_latency[i]);
+
+		if (i < N_LATENCY_BUCKETS ?
+				!metrics_printf(buf, "asvalidation_fix_latency_seconds_bucket{le=\"%g\"} %" PRIu64
+						"\n", (double)latency_bounds_us[i] / 1e6, count) :
+				!metrics_printf(buf, "asvalidation_fix_latency_seconds_bucket{le=\"+Inf\"} %"
+						PRIu64 "\n", count)) {
+			return false;
+		}
+	}
+
+	// a metric family's lines must form one group
+	if (!metrics_printf(buf, "asvalidation_fix_latency_seconds_sum %.6f\n"
+			"asvalidation_fix_latency_seconds_count %" PRIu64 "\n",
+			(double)cf_atomic64_get(conf->fix_latency_us) / 1e6, count)) {
+		return false;
+	}
+
+	if (conf->phase_timing) {
+		if (!metrics_printf(buf, "# TYPE asvalidation_phase_seconds_total counter\n")) {
+			return false;
+		}
+
+		for (uint32_t i = 0; i < conf->n_node_metrics; ++i) {
+			node_metrics *nm = &conf->node_metrics[i];
+
+			for (uint32_t k = 0; k < N_PHASES; ++k) {
+				if (!metrics_printf(buf, "asvalidation_phase_seconds_total{node=\"%s\","
+						"phase=\"%s\"} %.6f\n", nm->node_name, phase_names[k],
+						(double)cf_atomic64_get(nm->phase_us[k]) / 1e6)) {
+					return false;
+				}
+			}
+		}
+	}
+
+	safe_lock();
+	uint32_t job_depth = conf->job_queue != NULL ? cf_queue_sz(conf->job_queue) : 0;
+	uint32_t rec_depth = conf->record_queue != NULL ? cf_queue_sz(conf->record_queue) : 0;
+	uint32_t active = conf->active_scans;
+	uint32_t limit = conf->adaptive ? conf->scan_limit : conf->max_scans;
+	safe_unlock();
+
+	return metrics_printf(buf, "# TYPE asvalidation_throttle_wait_seconds_total counter\n"
+			"asvalidation_throttle_wait_seconds_total %.6f\n"
+			"# TYPE asvalidation_active_scans gauge\n"
+			"asvalidation_active_scans %u\n"
+			"# TYPE asvalidation_scan_limit gauge\n"
+			"asvalidation_scan_limit %u\n"
+			"# TYPE asvalidation_job_queue_depth gauge\n"
+			"asvalidation_job_queue_depth %u\n"
+			"# TYPE asvalidation_record_queue_depth gauge\n"
+			"asvalidation_record_queue_depth %u\n"
+			"# TYPE asvalidation_record_queue_bytes gauge\n"
+			"asvalidation_record_queue_bytes %" PRIu64 "\n"
+			"# TYPE asvalidation_verdict_cache_total counter\n"
+			"asvalidation_verdict_cache_total{result=\"hit\"} %" PRIu64 "\n"
+			"asvalidation_verdict_cache_total{result=\"miss\"} %" PRIu64 "\n",
+			(double)cf_atomic64_get(conf->throttle_us) / 1e6, active, limit, job_depth, rec_depth,
+			(uint64_t)cf_atomic64_get(conf->queue_bytes),
+			(uint64_t)cf_atomic64_get(conf->verdict_hits),
+			(uint64_t)cf_atomic64_get(conf->verdict_misses));
+}
+
+///
+/// One step of the --adaptive-parallel controller. Hill-climbs the number of concurrent node
+/// scans: adds a scan while the previous one raised the record rate by at least ADAPT_GAIN
+/// percent, backs off when it didn't or when the scan or fix latency grew by more than
+/// ADAPT_LATENCY_FACTOR. A lowered limit only takes effect as running scans complete.
+///
+/// @param conf  The global backup configuration and stats.
+/// @param st    The controller state.
+/// @param ms    The time since the previous step in milliseconds.
+///
+static void
+adapt_parallel(backup_config *conf, adapt_state *st, uint32_t ms)
+{
+	uint64_t recs = cf_atomic64_get(conf->rec_count_checked);
+	uint64_t net_us = 0;
+
+	for (uint32_t i = 0; i < conf->n_node_metrics; ++i) {
+		net_us += (uint64_t)cf_atomic64_get(conf->node_metrics[i].phase_us[PHASE_NETWORK]);
+	}
+
+	uint64_t fix_us = (uint64_t)cf_atomic64_get(conf->fix_latency_us);
+	uint64_t fix_count = 0;
+
+	for (uint32_t i = 0; i <= N_LATENCY_BUCKETS; ++i) {
+		fix_count += (uint64_t)cf_atomic64_get(conf->fix_latency[i]);
+	}
+
+	uint64_t d_recs = recs - st->recs_prev;
+	uint64_t d_net_us = net_us - st->net_us_prev;
+	uint64_t d_fix_us = fix_us - st->fix_us_prev;
+	uint64_t d_fix_count = fix_count - st->fix_count_prev;
+
+	st->recs_prev = recs;
+	st->net_us_prev = net_us;
+	st->fix_us_prev = fix_us;
+	st->fix_count_prev = fix_count;
+
+	// nothing to judge by, e.g., between node scans
+	if (d_recs == 0 || ms == 0) {
+		return;
+	}
+
+	uint64_t rate = d_recs * 1000 / ms;
+	uint64_t latency = d_net_us / d_recs;
+	uint64_t fix_latency = d_fix_count == 0 ? 0 : d_fix_us / d_fix_count;
+
+	if (latency >= ADAPT_MIN_LATENCY &&
+			(st->base_latency == 0 || latency < st->base_latency)) {
+		st->base_latency = latency;
+	}
+
+	if (fix_latency >= ADAPT_MIN_LATENCY &&
+			(st->base_fix_latency == 0 || fix_latency < st->base_fix_latency)) {
+		st->base_fix_latency = fix_latency;
+	}
+
+	bool slow = (st->base_latency > 0 &&
+			latency > st->base_latency * ADAPT_LATENCY_FACTOR) ||
+			(st->base_fix_latency > 0 &&
+			fix_latency > st->base_fix_latency * ADAPT_LATENCY_FACTOR);
+
+	safe_lock();
+
+	uint32_t limit = conf->scan_limit;
+	int32_t step = 0;
+
+	if (slow) {
+		step = limit > 1 ? -1 : 0;
+		st->hold = ADAPT_HOLD;
+	} else if (st->last_step > 0 && rate * 100 < st->rate_prev * (100 + ADAPT_GAIN)) {
+		// the last additional scan didn't pay off, we're on the plateau
+		step = -1;
+		st->hold = ADAPT_HOLD;
+	} else if (st->hold > 0) {
+		--st->hold;
+	// only probe when the limit actually holds back a waiting scan
+	} else if (limit < conf->max_scans && conf->active_scans >= limit) {
+		step = 1;
+	}
+
+	conf->scan_limit = (uint32_t)((int32_t)limit + step);
+
+	if (step != 0) {
+		safe_signal(&scan_cond);
+	}
+
+	safe_unlock();
+
+	st->last_step = step;
+	st->rate_prev = rate;
+
+	if (step != 0) {
+		inf("Adaptive parallelism: %u -> %u concurrent scan(s) (~%" PRIu64 " rec/s, "
+				"%" PRIu64 " us/rec scan latency, %" PRIu64 " us fix latency)", limit,
+				conf->scan_limit, rate, latency, fix_latency);
+	}
+}
+
+///
+/// Logs the time from the start of the first node scan to the end of the last one, compared with
+/// a perfectly balanced schedule of the same node scans on the same number of threads.
+///
+/// @param conf  The global backup configuration and stats.
+///
+static void
+print_makespan(backup_config *conf)
+{
+	safe_lock();
+	cf_clock first = conf->first_scan_ms;
+	cf_clock last = conf->last_scan_ms;
+	uint64_t busy = conf->scan_busy_ms;
+	uint64_t longest = conf->longest_scan_ms;
+	safe_unlock();
+
+	if (first == 0 || last < first || conf->max_scans == 0) {
+		return;
+	}
+
+	// no schedule beats an even split of the work or the longest single node scan
+	uint64_t makespan = last - first;
+	uint64_t ideal = busy / conf->max_scans;
+	ideal = longest > ideal ? longest : ideal;
+
+	inf("Makespan %.1f s on %u thread(s), ideal balance %.1f s (%+.1f%%)",
+			(double)makespan / 1000.0, conf->max_scans, (double)ideal / 1000.0,
+			ideal == 0 ? 0.0 : ((double)makespan - (double)ideal) * 100.0 / (double)ideal);
+}
+
+///
+/// Adds CDT counters to a running total.
+///
+/// @param sum  The running total.
+/// @param add  The counters to be added.
+///
+static void
+add_cdt_stats(cdt_stats *sum, const cdt_stats *add)
+{
+	sum->count += add->count;
+	sum->fixed += add->fixed;
+	sum->need_fix += add->need_fix;
+	sum->nf_failed += add->nf_failed;
+	sum->nf_order += add->nf_order;
+	sum->nf_padding += add->nf_padding;
+	sum->nf_dupkey += add->nf_dupkey;
+	sum->nf_nonstorage += add->nf_nonstorage;
+	sum->cannot_fix += add->cannot_fix;
+	sum->cf_dupkey += add->cf_dupkey;
+	sum->cf_nonstorage += add->cf_nonstorage;
+	sum->cf_corrupt += add->cf_corrupt;
+	sum->fix_retries += add->fix_retries;
+	sum->fix_bytes += add->fix_bytes;
+}
+
+///
+/// Logs the list and map counters.
+///
+/// @param list  The list counters.
+/// @param map   The map counters.
+///
+static void
+print_cdt_stats(const cdt_stats *list, const cdt_stats *map)
+{
+	inf("%10u Lists", list->count);
+	inf("%10u   Unfixable", list->cannot_fix);
+	inf("%10u     Has non-storage", list->cf_nonstorage);
+	inf("%10u     Corrupted", list->cf_corrupt);
+	inf("%10u   Need Fix", list->need_fix);
+	inf("%10u     Fixed", list->fixed);
+	inf("%10u     Fix failed", list->nf_failed);
+	inf("%10u     Fix retried", list->fix_retries);
+	inf("%10u     Order", list->nf_order);
+	inf("%10u     Padding", list->nf_padding);
+	inf("%10" PRIu64 "   Bytes written by fixes", (uint64_t)list->fix_bytes);
+
+	inf("%10u Maps", map->count);
+	inf("%10u   Unfixable", map->cannot_fix);
+	inf("%10u     Has duplicate keys", map->cf_dupkey);
+	inf("%10u     Has non-storage", map->cf_nonstorage);
+	inf("%10u     Corrupted", map->cf_corrupt);
+	inf("%10u   Need Fix", map->need_fix);
+	inf("%10u     Fixed", map->fixed);
+	inf("%10u     Fix failed", map->nf_failed);
+	inf("%10u     Fix retried", map->fix_retries);
+	inf("%10u     Order", map->nf_order);
+	inf("%10u     Padding", map->nf_padding);
+	inf("%10u     Duplicate keys", map->nf_dupkey);
+	inf("%10u     Non-storage", map->nf_nonstorage);
+	inf("%10" PRIu64 "   Bytes written by fixes", (uint64_t)map->fix_bytes);
+}
+
+///
+/// Logs the --profile breakdown of each node's time since the previous call.
+///
+/// @param conf   The global backup configuration and stats.
+/// @param total  `true` to log the totals since the start instead.
+///
+static void
+print_profile(backup_config *conf, bool total)
+{
+	for (uint32_t i = 0; i < conf->n_node_metrics; ++i) {
+		node_metrics *nm = &conf->node_metrics[i];
+		uint64_t delta[N_PHASES];
+		uint64_t sum = 0;
+		uint32_t top = 0;
+
+		for (uint32_t k = 0; k < N_PHASES; ++k) {
+			uint64_t now = (uint64_t)cf_atomic64_get(nm->phase_us[k]);
+			delta[k] = total ? now : now - nm->phase_prev[k];
+			nm->phase_prev[k] = now;
+			sum += delta[k];
+
+			if (delta[k] > delta[top]) {
+				top = k;
+			}
+		}
+
+		// idle node, e.g., not picked up yet or already done
+		if (sum == 0) {
+			continue;
+		}
+
+		char line[500];
+		size_t len = 0;
+
+		for (uint32_t k = 0; k < N_PHASES; ++k) {
+			int32_t res = snprintf(line + len, sizeof line - len, "%s%s %.1fs (%" PRIu64 "%%)",
+					k == 0 ? "" : ", ", phase_names[k], (double)delta[k] / 1e6,
+					delta[k] * 100 / sum);
+
+			if (res < 0 || (size_t)res >= sizeof line - len) {
+				break;
+			}
+
+			len += (size_t)res;
+		}
+
+		inf("%s node %s: %s; mostly %s", total ? "Total time for" : "Time for", nm->node_name,
+				line, phase_names[top]);
+	}
+}
+
+///
+/// Logs the per-set totals of a fix dry run.
+///
+/// @param sets  The per-set dry_run_stats.
+///
+static void
+print_dry_run(const as_vector *sets)
+{
+	dry_run_stats total = { .set = { 0 } };
+
+	inf("Fix dry run:");
+	inf("%-24s %12s %10s %10s %14s %14s %14s", "Set", "Records", "Bins", "Failed", "Reclaimed B",
+			"Duplicates", "Non-storage");
+
+	for (uint32_t i = 0; i < sets->size; ++i) {
+		const dry_run_stats *cur = as_vector_get((as_vector *)sets, i);
+
+		inf("%-24s %12" PRIu64 " %10" PRIu64 " %10" PRIu64 " %14" PRIu64 " %14" PRIu64 " %14"
+				PRIu64, cur->set[0] == 0 ? "[none]" : cur->set, cur->records, cur->bins,
+				cur->failed, cur->bytes_reclaimed, cur->dup_elements, cur->nonstorage_elements);
+		inf("%-24s %12s Write volume: %" PRIu64 " B", "", "", cur->write_bytes);
+
+		total.records += cur->records;
+		total.bins += cur->bins;
+		total.failed += cur->failed;
+		total.bytes_reclaimed += cur->bytes_reclaimed;
+		total.dup_elements += cur->dup_elements;
+		total.nonstorage_elements += cur->nonstorage_elements;
+		total.write_bytes += cur->write_bytes;
+	}
+
+	inf("%-24s %12" PRIu64 " %10" PRIu64 " %10" PRIu64 " %14" PRIu64 " %14" PRIu64 " %14" PRIu64,
+			"[total]", total.records, total.bins, total.failed, total.bytes_reclaimed,
+			total.dup_elements, total.nonstorage_elements);
+	inf("%-24s %12s Write volume: %" PRIu64 " B", "", "", total.write_bytes);
+}
+
+///
+/// Computes the Wilson score interval for a binomial proportion.
+///
+/// Unlike the normal approximation, this stays within [0, 1] and remains meaningful for the
+/// very small rates that we typically see for corrupted CDTs.
+///
+/// @param hits  The number of positive samples.
+/// @param n     The number of samples.
+/// @param lo    Returns the lower bound of the interval.
+/// @param hi    Returns the upper bound of the interval.
+///
+static void
+wilson_interval(uint32_t hits, uint32_t n, double *lo, double *hi)
+{
+	if (n == 0) {
+		*lo = 0.0;
+		*hi = 1.0;
+		return;
+	}
+
+	double p = (double)hits / n;
+	double z2 = SAMPLE_Z * SAMPLE_Z;
+	double denom = 1.0 + z2 / n;
+	double center = (p + z2 / (2.0 * n)) / denom;
+	double margin = SAMPLE_Z * sqrt(p * (1.0 - p) / n + z2 / (4.0 * n * n)) / denom;
+
+	*lo = center - margin < 0.0 ? 0.0 : center - margin;
+	*hi = center + margin > 1.0 ? 1.0 : center + margin;
+}
+
+///
+/// Logs the estimated rate of a CDT category in sampling mode.
+///
+/// @param label  The name of the category.
+/// @param hits   The number of sampled CDTs in the category.
+/// @param n      The number of sampled CDTs.
+/// @param scale  The factor that extrapolates sample counts to the whole set.
+///
+static void
+print_estimate(const char *label, uint32_t hits, uint32_t n, double scale)
+{
+	double lo, hi;
+	wilson_interval(hits, n, &lo, &hi);
+
+	inf("%-28s %9.5f%% [%9.5f%%, %9.5f%%] (~%.0f total)", label,
+			n == 0 ? 0.0 : 100.0 * hits / n, 100.0 * lo, 100.0 * hi, hits * scale);
+}
+
+///
+/// Logs the estimated rates of all categories of the given CDT type in sampling mode.
+///
+/// @param type   The name of the CDT type.
+/// @param stats  The CDT stats collected from the sample.
+/// @param scale  The factor that extrapolates sample counts to the whole set.
+///
+static void
+print_estimates(const char *type, const cdt_stats *stats, double scale)
+{
+	uint32_t n = (uint32_t)stats->count;
+
+	inf("%s: %u sampled (~%.0f total)", type, n, n * scale);
+	print_estimate("  Unfixable", (uint32_t)stats->cannot_fix, n, scale);
+	print_estimate("    Has duplicate keys", (uint32_t)stats->cf_dupkey, n, scale);
+	print_estimate("    Has non-storage", (uint32_t)stats->cf_nonstorage, n, scale);
+	print_estimate("    Corrupted", (uint32_t)stats->cf_corrupt, n, scale);
+	print_estimate("  Need Fix", (uint32_t)stats->need_fix, n, scale);
+	print_estimate("    Order", (uint32_t)stats->nf_order, n, scale);
+	print_estimate("    Padding", (uint32_t)stats->nf_padding, n, scale);
+	print_estimate("    Duplicate keys", (uint32_t)stats->nf_dupkey, n, scale);
+	print_estimate("    Non-storage", (uint32_t)stats->nf_nonstorage, n, scale);
+}
+
+///
+/// Logs an interruption by `SIGINT` or `SIGTERM` once. The signal handler cannot log
+/// itself, as the log functions are not reentrant.
+///
+static void
+report_interrupt(void)
+{
+	if (interrupted == 1 && __sync_bool_compare_and_swap(&interrupted, 1, 2)) {
+		err("### Validation interrupted ###");
+	}
+}
+
+///
+/// Main counter thread function.
+///
+///   - Outputs human-readable and machine-readable progress information.
+///   - If throttling is active: increases the I/O quota every second.
+///
+/// @param cont  The arguments for the thread, passed as a counter_thread_args.
+///
+/// @result      Always `EXIT_SUCCESS`.
+///
+static void *
+counter_thread_func(void *cont)
+{
+	if (verbose) {
+		ver("Entering counter thread 0x%" PRIx64, (uint64_t)pthread_self());
+	}
+
+	counter_thread_args *args = (counter_thread_args *)cont;
+	backup_config *conf = args->conf;
+	uint32_t iter = 0;
+	uint32_t profile_iter = 0;
+	uint32_t adapt_iter = 0;
+	adapt_state adapt = { 0 };
+	cf_clock adapt_ms = cf_getms();
+	cf_clock prev_ms = cf_getms();
+	uint64_t prev_recs = cf_atomic64_get(conf->rec_count_checked);
+
+	while (true) {
+		sleep(1);
+		report_interrupt();
+
+		cf_clock now_ms = cf_getms();
+		uint32_t ms = (uint32_t)(now_ms - prev_ms);
+		prev_ms = now_ms;
+
+		if (conf->rec_count_estimate > 0) {
+			uint64_t now_recs = cf_atomic64_get(conf->rec_count_checked);
+
+			int32_t percent = (int32_t)(now_recs * 100 / conf->rec_count_estimate);
+			uint64_t recs = now_recs - prev_recs;
+
+			int32_t eta = recs == 0 ? -1 :
+					(int32_t)(((uint64_t)conf->rec_count_estimate - now_recs) * ms / recs / 1000);
+			char eta_buff[ETA_BUF_SIZE];
+			format_eta(eta, eta_buff, sizeof eta_buff);
+
+			prev_recs = now_recs;
+
+			// rec_count_estimate may be a little off, make sure that we only print up to 99%
+			if (percent < 100) {
+				if (iter++ % 10 == 0) {
+					inf("%d%% complete (~%" PRIu64 " rec/s)", percent, ms == 0 ? 0 : recs * 1000 / ms);
+
+					if (eta >= 0) {
+						inf("~%s remaining", eta_buff);
+					}
+				}
+
+				if (args->mach_fd != NULL) {
+					if ((fprintf(args->mach_fd, "PROGRESS:%d\n", percent) < 0 ||
+							fflush(args->mach_fd) == EOF)) {
+						err_code("Error while writing machine-readable progress");
+					}
+
+					if (eta >= 0 && (fprintf(args->mach_fd, "REMAINING:%s\n", eta_buff) < 0 ||
+							fflush(args->mach_fd) == EOF)) {
+						err_code("Error while writing machine-readable remaining time");
+					}
+				}
+			}
+		}
+
+		for (uint32_t i = 0; i < conf->n_node_metrics; ++i) {
+			node_metrics *nm = &conf->node_metrics[i];
+			uint64_t now = cf_atomic64_get(nm->rec_count_checked);
+			nm->rec_rate = ms == 0 ? 0 : (now - nm->rec_count_prev) * 1000 / ms;
+			nm->rec_count_prev = now;
+		}
+
+		if (conf->profile && ++profile_iter % PROFILE_INTERVAL == 0) {
+			print_profile(conf, false);
+		}
+
+		if (conf->adaptive && ++adapt_iter % ADAPT_INTERVAL == 0) {
+			adapt_parallel(conf, &adapt, (uint32_t)(now_ms - adapt_ms));
+			adapt_ms = now_ms;
+		}
+
+		safe_lock();
+
+		// make sure that backup threads waiting for a scan slot see the stop flag
+		if (conf->adaptive) {
+			safe_signal(&scan_cond);
+		}
+
+		if (conf->bandwidth > 0) {
+			if (ms > 0) {
+				conf->byte_count_limit += conf->bandwidth * 1000 / ms;
+			}
+
+			safe_signal(&bandwidth_cond);
+		}
+
+		bool tmp_stop = stop;
+		safe_unlock();
+
+		if (tmp_stop) {
+			break;
+		}
+	}
+
+	uint64_t records = cf_atomic64_get(conf->rec_count_total);
+	uint64_t bytes = cf_atomic64_get(conf->byte_count_total);
+	inf("Found %" PRIu64 " invalid record(s) from %u node(s), "
+			"%" PRIu64 " byte(s) in total (~%" PRIu64 " B/rec)", records,
+			args->n_node_names, bytes, records == 0 ? 0 : bytes / records);
+
+	print_makespan(conf);
+
+	if (args->mach_fd != NULL && (fprintf(args->mach_fd,
+			"SUMMARY:%" PRIu64 ":%" PRIu64 ":%" PRIu64 "\n", records,
+			bytes, records == 0 ? 0 : bytes / records) < 0 ||
+			fflush(args->mach_fd) == EOF)) {
+		err_code("Error while writing machine-readable summary");
+	}
+
+	inf("CDT Mode: %s", conf->cdt_fix_dry_run ? "fix dry run" :
+			conf->cdt_fix || conf->map_fix != 0 ? "fix" : "validate");
+	cdt_stats list_total = { 0 };
+	cdt_stats map_total = { 0 };
+
+	for (uint32_t i = 0; i < conf->n_targets; ++i) {
+		scan_target *t = &conf->targets[i];
+		add_cdt_stats(&list_total, &t->cdt_list);
+		add_cdt_stats(&map_total, &t->cdt_map);
+
+		// several namespaces or sets: break the counts down before the totals
+		if (conf->n_targets > 1) {
+			inf("Namespace %s, set %s: %" PRIu64 " record(s) checked, %" PRIu64 " invalid",
+					t->ns, t->set[0] == 0 ? "[all]" : t->set,
+					(uint64_t)cf_atomic64_get(t->rec_count_checked),
+					(uint64_t)cf_atomic64_get(t->rec_count_total));
+			print_cdt_stats(&t->cdt_list, &t->cdt_map);
+		}
+	}
+
+	if (conf->n_targets > 1) {
+		inf("All namespaces and sets:");
+	}
+
+	print_cdt_stats(&list_total, &map_total);
+
+	if (conf->verdict_cache != NULL) {
+		uint64_t hits = cf_atomic64_get(conf->verdict_hits);
+		uint64_t lookups = hits + cf_atomic64_get(conf->verdict_misses);
+
+		inf("Verdict cache: %" PRIu64 " hit(s) in %" PRIu64 " lookup(s) (%.1f%%)", hits,
+				lookups, lookups == 0 ? 0.0 : 100.0 * (double)hits / (double)lookups);
+	}
+
+	if (conf->cdt_fix_dry_run) {
+		print_dry_run(&conf->dry_run_sets);
+	}
+
+	if (conf->profile) {
+		print_profile(conf, true);
+	}
+
+	// sampling mode: the counts above only cover the sample; extrapolate with 95% confidence
+	// intervals; note that CDTs are sampled by record, so CDTs of the same record aren't
+	// independent and records with many CDTs make the intervals optimistic
+	if (conf->sample < 100) {
+		double scale = 100.0 / conf->sample;
+
+		inf("Estimates from a %u%% sample (95%% confidence intervals):", conf->sample);
+		print_estimates("Lists", &list_total, scale);
+		print_estimates("Maps", &map_total, scale);
+	}
+
+	if (verbose) {
+		ver("Leaving counter thread");
+	}
+
+	return (void *)EXIT_SUCCESS;
+}
+
+///
+/// Tests whether the given backup file exists.
+///
+/// @param file_path  The path of the backup file.
+/// @param clear      What to do, if the file already exists. `true` to remove it, `false` to report
+///                   back an error.
+///
+/// @result           `true`, if successful.
+///
+static bool
+clean_output_file(const char *file_path, bool clear)
+{
+	if (verbose) {
+		ver("Checking output file %s", file_path);
+	}
+
+	if (strcmp(file_path, "-") == 0) {
+		return true;
+	}
+
+	struct stat buf;
+
+	if (stat(file_path, &buf) < 0) {
+		if (errno == ENOENT) {
+			return true;
+		}
+
+		err_code("Error while checking output file %s", file_path);
+		return false;
+	}
+
+	if (!clear) {
+		err("Output file %s already exists; use -r to remove", file_path);
+		return false;
+	}
+
+	if (remove(file_path) < 0) {
+		err_code("Error while removing existing output file %s", file_path);
+		return false;
+	}
+
+	return true;
+}
+
+///
+/// Prepares the given directory for a backup.
+///
+///   - Creates the directory, if it doesn't exist.
+///   - If the directory already contains backup files, removes them or reports an error.
+///
+/// @param dir_path  The path of the directory.
+/// @param clear     What to do, if the directory already contains backup files. `true` to remove
+///                  them, `false` to report back an error.
+///
+/// @result          'true', if successful.
+///
+static bool
+clean_directory(const char *dir_path, bool clear)
+{
+	if (verbose) {
+		ver("Preparing output directory %s", dir_path);
+	}
+
+	DIR *dir = opendir(dir_path);
+
+	if (dir == NULL) {
+		if (errno != ENOENT) {
+			err_code("Error while opening directory %s", dir_path);
+			return false;
+		}
+
+		inf("Directory %s does not exist, creating", dir_path);
+
+		if (mkdir(dir_path, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) < 0) {
+			err_code("Error while creating directory %s", dir_path);
+			return false;
+		}
+
+		dir = opendir(dir_path);
+
+		if (dir == NULL) {
+			err_code("Error while opening directory %s", dir_path);
+			return false;
+		}
+	}
+
+	struct dirent *entry;
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (strcmp(entry->d_name + strlen(entry->d_name) - 4, ".asb") == 0) {
+			if (!clear) {
+				err("Directory %s seems to contain an existing output; "
+						"use -r to clear directory", dir_path);
+				closedir(dir);
+				return false;
+			}
+
+			char file_path[PATH_MAX];
+
+			if ((size_t)snprintf(file_path, sizeof file_path, "%s/%s", dir_path,
+					entry->d_name) >= sizeof file_path) {
+				err("File path too long (%s, %s)", dir_path, entry->d_name);
+				closedir(dir);
+				return false;
+			}
+
+			if (remove(file_path) < 0) {
+				err_code("Error while removing existing output file %s", file_path);
+				closedir(dir);
+				return false;
+			}
+		}
+	}
+
+	if (closedir(dir) < 0) {
+		err_code("Error while closing directory handle for %s", dir_path);
+		return false;
+	}
+
+	inf("Directory %s prepared for output", dir_path);
+	return true;
+}
+
+///
+/// Adds a namespace and set to the validation targets.
+///
+/// @param conf  The global backup configuration and stats.
+/// @param ns    The namespace.
+/// @param set   The set. Empty for all sets.
+///
+/// @result      `true`, if successful.
+///
+static bool
+add_target(backup_config *conf, const char *ns, const char *set)
+{
+	if (ns[0] == 0 || strlen(ns) >= AS_NAMESPACE_MAX_SIZE) {
+		err("Invalid namespace %s", ns);
+		return false;
+	}
+
+	if (strlen(set) >= AS_SET_MAX_SIZE) {
+		err("Invalid set %s", set);
+		return false;
+	}
+
+	for (uint32_t i = 0; i < conf->n_targets; ++i) {
+		if (strcmp(conf->targets[i].ns, ns) == 0 && strcmp(conf->targets[i].set, set) == 0) {
+			err("Duplicate namespace %s, set %s", ns, set[0] == 0 ? "[all]" : set);
+			return false;
+		}
+	}
+
+	if (conf->n_targets == MAX_TARGETS) {
+		err("Too many namespaces and sets, the maximum is %d", MAX_TARGETS);
+		return false;
+	}
+
+	scan_target *t = &conf->targets[conf->n_targets++];
+	memset(t, 0, sizeof (scan_target));
+	as_strncpy(t->ns, ns, AS_NAMESPACE_MAX_SIZE);
+	as_strncpy(t->set, set, AS_SET_MAX_SIZE);
+	return true;
+}
+
+///
+/// Builds the validation targets from the namespace list, `ns[/set][,...]`, and the set list,
+/// `set[,...]`. A namespace without an explicit set is validated for each set in the set list,
+/// or for all sets, if there is no set list.
+///
+/// @param conf  The global backup configuration and stats.
+///
+/// @result      `true`, if successful.
+///
+static bool
+parse_targets(backup_config *conf)
+{
+	bool res = false;
+	char *ns_clone = safe_strdup(conf->ns_list);
+	char *set_clone = conf->set_list != NULL ? safe_strdup(conf->set_list) : NULL;
+
+	as_vector ns_vec;
+	as_vector_inita(&ns_vec, sizeof (void *), 25);
+	split_string(ns_clone, ',', true, &ns_vec);
+
+	as_vector set_vec;
+	as_vector_inita(&set_vec, sizeof (void *), 25);
+
+	if (set_clone != NULL && set_clone[0] != 0) {
+		split_string(set_clone, ',', true, &set_vec);
+	}
+
+	conf->targets = safe_malloc(MAX_TARGETS * sizeof (scan_target));
+	conf->n_targets = 0;
+
+	for (uint32_t i = 0; i < ns_vec.size; ++i) {
+		char *ns = as_vector_get_ptr(&ns_vec, i);
+		char *slash = strchr(ns, '/');
+
+		if (slash != NULL) {
+			*slash = 0;
+
+			if (!add_target(conf, ns, slash + 1)) {
+				goto cleanup1;
+			}
+
+			continue;
+		}
+
+		if (set_vec.size == 0) {
+			if (!add_target(conf, ns, "")) {
+				goto cleanup1;
+			}
+
+			continue;
+		}
+
+		for (uint32_t k = 0; k < set_vec.size; ++k) {
+			char *set = as_vector_get_ptr(&set_vec, k);
+
+			if (set[0] == 0) {
+				err("Empty item in set list %s", conf->set_list);
+				goto cleanup1;
+			}
+
+			if (!add_target(conf, ns, set)) {
+				goto cleanup1;
+			}
+		}
+	}
+
+	res = true;
+
+cleanup1:
+	as_vector_destroy(&set_vec);
+	as_vector_destroy(&ns_vec);
+
+	if (set_clone != NULL) {
+		cf_free(set_clone);
+	}
+
+	cf_free(ns_clone);
+	return res;
+}
+
+///
+/// Frees the validation targets built by parse_targets().
+///
+/// @param conf  The global backup configuration and stats.
+///
+static void
+free_targets(backup_config *conf)
+{
+	if (conf->targets == NULL) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < conf->n_targets; ++i) {
+		if (conf->targets[i].node_counts != NULL) {
+			cf_free(conf->targets[i].node_counts);
+		}
+	}
+
+	cf_free(conf->targets);
+	conf->targets = NULL;
+	conf->n_targets = 0;
+}
+
+///
+/// Parses the --map-fix policies, `policy[,...]`, where a policy is `keep-first`, `keep-last`,
+/// or `drop-nonstorage`.
+///
+/// @param policies  The policy list.
+/// @param map_fix   Returns the MAP_FIX_* bit mask.
+///
+/// @result          `true`, if successful.
+///
+static bool
+parse_map_fix(const char *policies, uint32_t *map_fix)
+{
+	bool res = false;
+	char *clone = safe_strdup(policies);
+
+	as_vector pol_vec;
+	as_vector_inita(&pol_vec, sizeof (void *), 25);
+	split_string(clone, ',', true, &pol_vec);
+
+	*map_fix = 0;
+
+	for (uint32_t i = 0; i < pol_vec.size; ++i) {
+		char *pol = as_vector_get_ptr(&pol_vec, i);
+
+		if (strcmp(pol, "keep-first") == 0) {
+			*map_fix |= MAP_FIX_KEEP_FIRST;
+		} else if (strcmp(pol, "keep-last") == 0) {
+			*map_fix |= MAP_FIX_KEEP_LAST;
+		} else if (strcmp(pol, "drop-nonstorage") == 0) {
+			*map_fix |= MAP_FIX_DROP_NONSTORAGE;
+		} else {
+			err("Invalid map fix policy %s", pol);
+			goto cleanup1;
+		}
+	}
+
+	if ((*map_fix & MAP_FIX_KEEP_FIRST) != 0 && (*map_fix & MAP_FIX_KEEP_LAST) != 0) {
+		err("Map fix policies keep-first and keep-last are mutually exclusive");
+		goto cleanup1;
+	}
+
+	res = true;
+
+cleanup1:
+	as_vector_destroy(&pol_vec);
+	cf_free(clone);
+	return res;
+}
+
+///
+/// Joins the namespaces or sets of all validation targets into a comma-separated list. Identifies
+/// the targets in the state file. With a single target, that's just its namespace or set.
+///
+/// @param conf  The global backup configuration and stats.
+/// @param sets  `true` to join the sets, `false` to join the namespaces.
+/// @param buf   The output buffer.
+/// @param size  The size of the output buffer.
+///
+static void
+join_targets(const backup_config *conf, bool sets, char *buf, size_t size)
+{
+	size_t len = 0;
+	buf[0] = 0;
+
+	for (uint32_t i = 0; i < conf->n_targets; ++i) {
+		const char *item = sets ? conf->targets[i].set : conf->targets[i].ns;
+		int32_t res = snprintf(buf + len, size - len, "%s%s", i == 0 ? "" : ",", item);
+
+		if (res < 0 || (size_t)res >= size - len) {
+			break;
+		}
+
+		len += (size_t)res;
+	}
+}
+
+///
+/// Reads the watermark of the last successful incremental validation from the state file.
+///
+/// @param file_path  The path of the state file.
+/// @param ns         The namespaces of the current run, as formatted by join_targets(). Must
+///                   match the state file.
+/// @param set        The sets of the current run, as formatted by join_targets(). Must match the
+///                   state file.
+/// @param nanos      Returns the watermark in nanoseconds since the epoch, 0 if the state file
+///                   doesn't exist yet.
+///
+/// @result           `true`, if successful.
+///
+static bool
+read_state_file(const char *file_path, const char *ns, const char *set, int64_t *nanos)
+{
+	if (verbose) {
+		ver("Reading state file %s", file_path);
+	}
+
+	FILE *fd = fopen(file_path, "r");
+
+	if (fd == NULL) {
+		if (errno == ENOENT) {
+			inf("State file %s doesn't exist yet, validating all records", file_path);
+			*nanos = 0;
+			return true;
+		}
+
+		err_code("Error while opening state file %s", file_path);
+		return false;
+	}
+
+	bool res = false;
+	char line_ns[STATE_LINE_SIZE + 1];
+	char line_set[STATE_LINE_SIZE + 1];
+
+	if (fscanf(fd, "%" SCNd64 "\n", nanos) != 1 || *nanos < 0 ||
+			fgets(line_ns, sizeof line_ns, fd) == NULL ||
+			fgets(line_set, sizeof line_set, fd) == NULL) {
+		err("Invalid state file %s", file_path);
+		goto cleanup1;
+	}
+
+	line_ns[strcspn(line_ns, "\n")] = 0;
+	line_set[strcspn(line_set, "\n")] = 0;
+
+	if (strcmp(line_ns, ns) != 0 || strcmp(line_set, set) != 0) {
+		err("State file %s belongs to namespace %s, set %s", file_path, line_ns,
+				line_set[0] == 0 ? "[all]" : line_set);
+		goto cleanup1;
+	}
+
+	res = true;
+
+cleanup1:
+	fclose(fd);
+	return res;
+}
+
+///
+/// Atomically replaces the state file with the given watermark. Written to a temporary file first
+/// and then renamed, so that a crash never leaves a truncated state file behind.
+///
+/// @param file_path  The path of the state file.
+/// @param ns         The namespaces of the current run, as formatted by join_targets().
+/// @param set        The sets of the current run, as formatted by join_targets().
+/// @param nanos      The new watermark in nanoseconds since the epoch.
+///
+/// @result           `true`, if successful.
+///
+static bool
+write_state_file(const char *file_path, const char *ns, const char *set, int64_t nanos)
+{
+	if (verbose) {
+		ver("Writing state file %s", file_path);
+	}
+
+	size_t len = strlen(file_path);
+	char *tmp_path = safe_malloc(len + 5);
+	memcpy(tmp_path, file_path, len);
+	memcpy(tmp_path + len, ".tmp", 5);
+
+	bool res = false;
+	FILE *fd = fopen(tmp_path, "w");
+
+	if (fd == NULL) {
+		err_code("Error while creating state file %s", tmp_path);
+		goto cleanup1;
+	}
+
+	if (fprintf(fd, "%" PRId64 "\n%s\n%s\n", nanos, ns, set) < 0) {
+		err_code("Error while writing state file %s", tmp_path);
+		fclose(fd);
+		goto cleanup2;
+	}
+
+	if (fflush(fd) == EOF || fsync(fileno(fd)) < 0) {
+		err_code("Error while flushing state file %s", tmp_path);
+		fclose(fd);
+		goto cleanup2;
+	}
+
+	if (fclose(fd) == EOF) {
+		err_code("Error while closing state file %s", tmp_path);
+		goto cleanup2;
+	}
+
+	if (rename(tmp_path, file_path) < 0) {
+		err_code("Error while renaming state file %s to %s", tmp_path, file_path);
+		goto cleanup2;
+	}
+
+	res = true;
+	goto cleanup1;
+
+cleanup2:
+	remove(tmp_path);
+
+cleanup1:
+	cf_free(tmp_path);
+	return res;
+}
+
+///
+/// Parses a `host:port[,host:port[,...]]` string of (IP address, port) or `host:tls_name:port[,host:tls_name:port[,...]]` string of (IP address, tls_name, port) pairs into an
+/// array of node_spec. tls_name being optional.
+///
+/// @param node_list     The string to be parsed.
+/// @param node_specs    The created array of node_spec.
+/// @param n_node_specs  The number of elements in the created array.
+///
+/// @result              `true`, if successful.
+///
+static bool
+parse_node_list(char *node_list, node_spec **node_specs, uint32_t *n_node_specs)
+{
+	bool res = false;
+	char *clone = safe_strdup(node_list);
+
+	// also allow ";" (remain backwards compatible)
+	for (size_t i = 0; node_list[i] != 0; ++i) {
+		if (node_list[i] == ';') {
+			node_list[i] = ',';
+		}
+	}
+
+	as_vector node_vec;
+	as_vector_inita(&node_vec, sizeof (void *), 25);
+
+	if (node_list[0] == 0) {
+		err("Empty node list");
+		goto cleanup1;
+	}
+
+	split_string(node_list, ',', true, &node_vec);
+
+	*n_node_specs = node_vec.size;
+	*node_specs = safe_malloc(sizeof (node_spec) * node_vec.size);
+	for (uint32_t i = 0; i < *n_node_specs; i++) {
+		(*node_specs)[i].tls_name_str = NULL;
+	}
+
+	for (uint32_t i = 0; i < node_vec.size; ++i) {
+		char *node_str = as_vector_get_ptr(&node_vec, i);
+		sa_family_t family;
+		char *colon;
+
+		if (node_str[0] == '[') {
+			family = AF_INET6;
+			char *closing = strchr(node_str, ']');
+
+			if (closing == NULL) {
+				err("Invalid node list %s (missing \"]\"", clone);
+				goto cleanup1;
+			}
+
+			if (closing[1] != ':') {
+				err("Invalid node list %s (missing \":\")", clone);
+				goto cleanup1;
+			}
+
+			colon = closing + 1;
+		} else {
+			family = AF_INET;
+			colon = strchr(node_str, ':');
+
+			if (colon == NULL) {
+				err("Invalid node list %s (missing \":\")", clone);
+				goto cleanup1;
+			}
+		}
+
+		size_t length = (size_t)(colon - node_str);
+
+		if (family == AF_INET6) {
+			++node_str;
+			length -= 2;
+		}
+
+		if (length == 0 || length > IP_ADDR_SIZE - 1) {
+			err("Invalid node list %s (invalid IP address)", clone);
+			goto cleanup2;
+		}
+
+		char ip_addr[IP_ADDR_SIZE];
+		memcpy(ip_addr, node_str, length);
+		ip_addr[length] = 0;
+
+		union {
+			struct in_addr v4;
+			struct in6_addr v6;
+		} ver;
+
+		if (inet_pton(family, ip_addr, &ver) <= 0) {
+			err("Invalid node list %s (invalid IP address %s)", clone, ip_addr);
+			goto cleanup2;
+		}
+
+		uint64_t tmp;
+		
+		if (family == AF_INET6) {
+			length = length + 1;
+		}
+
+		char *new_colon;
+		new_colon = strchr(node_str + length + 1, ':');
+
+		if (new_colon != NULL) {
+			node_str = node_str + length + 1;
+			length = (size_t)(new_colon - node_str);
+			char tls_name[length + 1];
+			memcpy(tls_name, node_str, length);
+			tls_name[length] = '\0';
+
+			(*node_specs)[i].tls_name_str = safe_malloc(sizeof(char) * (length + 1));
+			memcpy((*node_specs)[i].tls_name_str, tls_name, length + 1);
+
+			colon = new_colon;
+		}
+
+		if (!better_atoi(colon + 1, &tmp) || tmp < 1 || tmp > 65535) {
+			err("Invalid node list %s (invalid port value %s)", clone, colon + 1);
+			goto cleanup2;
+		}
+
+		memcpy((*node_specs)[i].addr_string, ip_addr, IP_ADDR_SIZE);
+		(*node_specs)[i].family = family;
+		memcpy(&(*node_specs)[i].ver, &ver, sizeof ver);
+		(*node_specs)[i].port = htons((in_port_t)tmp);
+	}
+
+	res = true;
+	goto cleanup1;
+
+cleanup2:
+	for (uint32_t i = 0; i < *n_node_specs; i++) {
+		cf_free((*node_specs)[i].tls_name_str);
+		(*node_specs)[i].tls_name_str = NULL;
+	}
+	cf_free(*node_specs);
+	*node_specs = NULL;
+	*n_node_specs = 0;
+
+cleanup1:
+	as_vector_destroy(&node_vec);
+	cf_free(clone);
+	return res;
+}
+
+///
+/// Parses a `bin-name[,bin-name[,...]]` string of bin names and initializes a scan from it.
+///
+/// @param bin_list  The string to be parsed.
+/// @param scan      The scan to be initialized.
+///
+/// @result          `true`, if successful.
+///
+static bool
+init_scan_bins(char *bin_list, as_scan *scan)
+{
+	bool res = false;
+	char *clone = safe_strdup(bin_list);
+	as_vector bin_vec;
+	as_vector_inita(&bin_vec, sizeof (void *), 25);
+
+	if (bin_list[0] == 0) {
+		err("Empty bin list");
+		goto cleanup1;
+	}
+
+	split_string(clone, ',', true, &bin_vec);
+
+	as_scan_select_init(scan, (uint16_t)bin_vec.size);
+
+	for (uint32_t i = 0; i < bin_vec.size; ++i) {
+		if (!as_scan_select(scan, as_vector_get_ptr(&bin_vec, i))) {
+			err("Error while selecting bin %s", (char *)as_vector_get_ptr(&bin_vec, i));
+			goto cleanup1;
+		}
+	}
+
+	res = true;
+
+cleanup1:
+	as_vector_destroy(&bin_vec);
+	cf_free(clone);
+	return res;
+}
+
+///
+/// The callback passed to get_info() to parse the namespace object count and replication factor.
+///
+/// @param context_  The ns_count_context for the parsed result.
+/// @param key       The key of the current key-value pair.
+/// @param value     The corresponding value.
+///
+/// @result          `true`, if successful.
+///
+static bool
+ns_count_callback(void *context_, const char *key, const char *value)
+{
+	ns_count_context *context = (ns_count_context *)context_;
+	uint64_t tmp;
+
+	if (strcmp(key, "objects") == 0) {
+		if (!better_atoi(value, &tmp)) {
+			err("Invalid object count %s", value);
+			return false;
+		}
+
+		context->count = tmp;
+		return true;
+	}
+
+	if (strcmp(key, "repl-factor") == 0 || strcmp(key, "effective_replication_factor") == 0) {
+		if (!better_atoi(value, &tmp) || tmp == 0 || tmp > 100) {
+			err("Invalid replication factor %s", value);
+			return false;
+		}
+
+		context->factor = (uint32_t)tmp;
+		return true;
+	}
+
+	return true;
+}
+
+///
+/// The callback passed to get_info() to parse the set object count.
+///
+/// @param context_  The set_count_context for the parsed result.
+/// @param key       The key of the current key-value pair. Not used.
+/// @param value     A string of the form "<k1>=<v1>[:<k2>=<v2>[:...]]".
+///
+/// @result          `true`, if successful.
+///
+static bool
+set_count_callback(void *context_, const char *key_, const char *value_)
+{
+	(void)key_;
+	set_count_context *context = (set_count_context *)context_;
+	bool res = false;
+
+	// The server sends a trailing semicolon, which results in an empty last string. Skip it.
+	if (value_[0] == 0) {
+		res = true;
+		goto cleanup0;
+	}
+
+	char *info = safe_strdup(value_);
+	as_vector info_vec;
+	as_vector_inita(&info_vec, sizeof (void *), 25);
+	split_string(info, ':', false, &info_vec);
+
+	bool match = true;
+	uint64_t count = 0;
+
+	for (uint32_t i = 0; i < info_vec.size; ++i) {
+		char *key = as_vector_get_ptr(&info_vec, i);
+		char *equals = strchr(key, '=');
+
+		if (equals == NULL) {
+			err("Invalid info string %s (missing \"=\")", value_);
+			goto cleanup1;
+		}
+
+		*equals = 0;
+		char *value = equals + 1;
+
+		if ((strcmp(key, "ns_name") == 0 || strcmp(key, "ns") == 0) &&
+				strcmp(value, context->ns) != 0) {
+			match = false;
+		}
+
+		if ((strcmp(key, "set_name") == 0 || strcmp(key, "set") == 0) &&
+				strcmp(value, context->set) != 0) {
+			match = false;
+		}
+
+		if ((strcmp(key, "n_objects") == 0 || strcmp(key, "objects") == 0) &&
+				!better_atoi(value, &count)) {
+			err("Invalid object count %s", value);
+			goto cleanup1;
+		}
+	}
+
+	if (match) {
+		context->count += count;
+	}
+
+	res = true;
+
+cleanup1:
+	as_vector_destroy(&info_vec);
+	cf_free(info);
+
+cleanup0:
+	return res;
+}
+
+///
+/// Retrieves the total number of objects stored in the given namespace on the given nodes.
+///
+/// Queries each cluster node individually, sums up the reported numbers, and then divides by the
+/// replication count.
+///
+/// @param as            The Aerospike client instance.
+/// @param namespace     The namespace that we are interested in.
+/// @param set           The set that we are interested in.
+/// @param node_names    The array of node IDs of the cluster nodes to be queried.
+/// @param n_node_names  The number of elements in the node ID array.
+/// @param obj_count     The number of objects.
+/// @param node_counts   Receives the number of objects per node, divided by the replication
+///                      count. One element for each node. May be `NULL`.
+///
+/// @result              `true`, if successful.
+///
+static bool
+get_object_count(aerospike *as, const char *namespace, const char *set,
+		char (*node_names)[][AS_NODE_NAME_SIZE], uint32_t n_node_names, uint64_t *obj_count,
+		uint64_t *node_counts)
+{
+	if (verbose) {
+		ver("Getting cluster object count");
+	}
+
+	*obj_count = 0;
+
+	size_t value_size = sizeof "namespace/" - 1 + strlen(namespace) + 1;
+	char value[value_size];
+	snprintf(value, value_size, "namespace/%s", namespace);
+	inf("%-20s%-15s%-15s", "Node ID", "Objects", "Replication");
+	ns_count_context ns_context = { 0, 0 };
+
+	for (uint32_t i = 0; i < n_node_names; ++i) {
+		if (verbose) {
+			ver("Getting object count for node %s", (*node_names)[i]);
+		}
+
+		if (!get_info(as, value, (*node_names)[i], &ns_context, ns_count_callback, true)) {
+			err("Error while getting namespace object count for node %s", (*node_names)[i]);
+			return false;
+		}
+
+		if (ns_context.factor == 0) {
+			err("Invalid namespace %s", namespace);
+			return false;
+		}
+
+		uint64_t count;
+
+		if (set[0] == 0) {
+			count =  ns_context.count;
+		} else {
+			set_count_context set_context = { namespace, set, 0 };
+
+			if (!get_info(as, "sets", (*node_names)[i], &set_context, set_count_callback, false)) {
+				err("Error while getting set object count for node %s", (*node_names)[i]);
+				return false;
+			}
+
+			count = set_context.count;
+		}
+
+		inf("%-20s%-15" PRIu64 "%-15d", (*node_names)[i], count, ns_context.factor);
+		*obj_count += count;
+
+		if (node_counts != NULL) {
+			node_counts[i] = count / ns_context.factor;
+		}
+	}
+
+	*obj_count /= ns_context.factor;
+	return true;
+}
+
+///
+/// Orders node jobs by decreasing record count. Passed to `qsort()`.
+///
+/// @param left   The first backup_thread_args to compare.
+/// @param right  The second backup_thread_args to compare.
+///
+/// @result       Negative, zero, or positive, as expected by `qsort()`.
+///
+static int32_t
+compare_job_size(const void *left, const void *right)
+{
+	const backup_thread_args *l = left;
+	const backup_thread_args *r = right;
+
+	if (l->rec_count_estimate != r->rec_count_estimate) {
+		return l->rec_count_estimate > r->rec_count_estimate ? -1 : 1;
+	}
+
+	// keep the order deterministic
+	int32_t res = strcmp(l->target->ns, r->target->ns);
+
+	if (res == 0) {
+		res = strcmp(l->target->set, r->target->set);
+	}
+
+	return res != 0 ? res : strcmp(l->node_name, r->node_name);
+}
+
+///
+/// Signal handler for `SIGINT` and `SIGTERM`.
+///
+/// @param sig  The signal number.
+///
+static void
+sig_hand(int32_t sig)
+{
+	(void)sig;
+	interrupted = 1;
+	stop = true;
+}
+
+///
+/// Joins a thread and expects it to exit within a reasonable amount of time after `stop` was
+/// set to abort all threads.
+///
+/// @param thread      The thread to be joined.
+/// @param thread_res  The joined thread's return value.
+///
+/// @result            `ETIMEDOUT` on a timeout, otherwise the same as `pthread_join()`.
+///
+static int32_t
+safe_join(pthread_t thread, void **thread_res)
+{
+	if (verbose) {
+		ver("Joining thread 0x%" PRIx64, (uint64_t)thread);
+	}
+
+	int32_t since_stop = 0;
+
+	while (true) {
+#if !defined __APPLE__
+		time_t deadline = time(NULL) + 5;
+		struct timespec ts = { deadline, 0 };
+		int32_t res = pthread_timedjoin_np(thread, thread_res, &ts);
+#else
+		int32_t res = pthread_join(thread, thread_res);
+#endif
+		report_interrupt();
+
+		if (res == 0 || res != ETIMEDOUT) {
+			return res;
+		}
+
+		if (!stop) {
+			continue;
+		}
+
+		if (verbose) {
+			ver("Expecting thread 0x%" PRIx64 " to finish (%d)", (uint64_t)thread, since_stop);
+		}
+
+		if (++since_stop >= 4) {
+			err("Stuck thread detected");
+			errno = ETIMEDOUT;
+			return ETIMEDOUT;
+		}
+	}
+}
+
+///
+/// Orders recheck keys by namespace and digest. Passed to `qsort()`.
+///
+/// @param left   The first recheck_key to compare.
+/// @param right  The second recheck_key to compare.
+///
+/// @result       Negative, zero, or positive, as expected by `qsort()`.
+///
+static int32_t
+compare_recheck_key(const void *left, const void *right)
+{
+	const recheck_key *l = left;
+	const recheck_key *r = right;
+
+	if (l->ns != r->ns) {
+		return l->ns < r->ns ? -1 : 1;
+	}
+
+	return memcmp(l->digest, r->digest, AS_DIGEST_VALUE_SIZE);
+}
+
+///
+/// Looks up a namespace of the digest list. Adds the namespace, if it's new.
+///
+/// @param rs     The recheck state.
+/// @param ns     The namespace. Doesn't need to be NUL-terminated.
+/// @param len    The length of the namespace.
+/// @param index  Returns the index of the namespace in recheck_state.namespaces.
+///
+/// @result       `true`, if successful.
+///
+static bool
+recheck_namespace(recheck_state *rs, const char *ns, size_t len, uint32_t *index)
+{
+	if (len == 0 || len >= AS_NAMESPACE_MAX_SIZE) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < rs->namespaces.size; ++i) {
+		const char *name = as_vector_get(&rs->namespaces, i);
+
+		if (strncmp(name, ns, len) == 0 && name[len] == 0) {
+			*index = i;
+			return true;
+		}
+	}
+
+	char name[AS_NAMESPACE_MAX_SIZE] = { 0 };
+	memcpy(name, ns, len);
+	as_vector_append(&rs->namespaces, name);
+	*index = rs->namespaces.size - 1;
+	return true;
+}
+
+///
+/// Decodes a base-64 digest.
+///
+/// @param text    The base-64 text. Doesn't need to be NUL-terminated.
+/// @param len     The length of the base-64 text.
+/// @param digest  Returns the digest.
+///
+/// @result        `true`, if successful.
+///
+static bool
+decode_digest(const char *text, size_t len, uint8_t *digest)
+{
+	if (len != (AS_DIGEST_VALUE_SIZE + 2) / 3 * 4) {
+		return false;
+	}
+
+	for (size_t i = 0; i < len; ++i) {
+		if (b64map[(uint8_t)text[i]] == 0xff) {
+			return false;
 		}
-
-		memcpy((*node_specs)[i].addr_string, ip_addr, IP_ADDR_SIZE);
-		(*node_specs)[i].family = family;
-		memcpy(&(*node_specs)[i].ver, &ver, sizeof ver);
-		(*node_specs)[i].port = htons((in_port_t)tmp);
 	}
 
-	res = true;
-	goto cleanup1;
+	uint8_t buf[(AS_DIGEST_VALUE_SIZE + 2) / 3 * 3];
+	uint32_t size;
+	cf_b64_decode(text, (uint32_t)len, buf, &size);
 
-cleanup2:
-	for (uint32_t i = 0; i < *n_node_specs; i++) {
-		cf_free((*node_specs)[i].tls_name_str);
-		(*node_specs)[i].tls_name_str = NULL;
+	if (size != AS_DIGEST_VALUE_SIZE) {
+		return false;
 	}
-	cf_free(*node_specs);
-	*node_specs = NULL;
-	*n_node_specs = 0;
 
-cleanup1:
-	as_vector_destroy(&node_vec);
-	cf_free(clone);
-	return res;
+	memcpy(digest, buf, AS_DIGEST_VALUE_SIZE);
+	return true;
 }
 
 ///
-/// Parses a `bin-name[,bin-name[,...]]` string of bin names and initializes a scan from it.
+/// Adds the records of a previous run to the digest list. Reads the offset indexes of the run's
+/// backup files.
 ///
-/// @param bin_list  The string to be parsed.
-/// @param scan      The scan to be initialized.
+/// @param rs    The recheck state.
+/// @param name  The run's backup directory or backup file.
 ///
-/// @result          `true`, if successful.
+/// @result      `true`, if successful.
 ///
 static bool
-init_scan_bins(char *bin_list, as_scan *scan)
+recheck_load_run(recheck_state *rs, const char *name)
 {
 	bool res = false;
-	char *clone = safe_strdup(bin_list);
-	as_vector bin_vec;
-	as_vector_inita(&bin_vec, sizeof (void *), 25);
+	as_vector paths;
+	as_vector_init(&paths, sizeof (char *), 64);
 
-	if (bin_list[0] == 0) {
-		err("Empty bin list");
+	if (!index_backup_files(name, &paths)) {
 		goto cleanup1;
 	}
 
-	split_string(bin_list, ',', true, &bin_vec);
-
-	as_scan_select_init(scan, (uint16_t)bin_vec.size);
+	for (uint32_t i = 0; i < paths.size; ++i) {
+		const char *path = *(char **)as_vector_get(&paths, i);
+		char ns[AS_NAMESPACE_MAX_SIZE];
+		recheck_key key;
 
-	for (uint32_t i = 0; i < bin_vec.size; ++i) {
-		if (!as_scan_select(scan, as_vector_get_ptr(&bin_vec, i))) {
-			err("Error while selecting bin %s", (char *)as_vector_get_ptr(&bin_vec, i));
+		if (!index_namespace(path, ns, sizeof ns) ||
+				!recheck_namespace(rs, ns, strlen(ns), &key.ns)) {
 			goto cleanup1;
 		}
-	}
 
-	res = true;
+		index_reader ir;
 
-cleanup1:
-	as_vector_destroy(&bin_vec);
-	cf_free(clone);
-	return res;
-}
+		if (!index_open(&ir, path)) {
+			err("Output file %s has no offset index, see --offset-index", path);
+			goto cleanup1;
+		}
 
-///
-/// The callback passed to get_info() to parse the namespace object count and replication factor.
-///
-/// @param context_  The ns_count_context for the parsed result.
-/// @param key       The key of the current key-value pair.
-/// @param value     The corresponding value.
-///
-/// @result          `true`, if successful.
-///
-static bool
-ns_count_callback(void *context_, const char *key, const char *value)
-{
-	ns_count_context *context = (ns_count_context *)context_;
-	uint64_t tmp;
+		while (ir.next < ir.n_entries) {
+			index_entry entry;
 
-	if (strcmp(key, "objects") == 0) {
-		if (!better_atoi(value, &tmp)) {
-			err("Invalid object count %s", value);
-			return false;
+			if (!index_next(&ir, &entry)) {
+				index_close(&ir);
+				goto cleanup1;
+			}
+
+			memcpy(key.digest, entry.digest, AS_DIGEST_VALUE_SIZE);
+			as_vector_append(&rs->keys, &key);
 		}
 
-		context->count = tmp;
-		return true;
+		index_close(&ir);
 	}
 
-	if (strcmp(key, "repl-factor") == 0 || strcmp(key, "effective_replication_factor") == 0) {
-		if (!better_atoi(value, &tmp) || tmp == 0 || tmp > 100) {
-			err("Invalid replication factor %s", value);
-			return false;
-		}
+	res = true;
 
-		context->factor = (uint32_t)tmp;
-		return true;
+cleanup1:
+	for (uint32_t i = 0; i < paths.size; ++i) {
+		cf_free(*(char **)as_vector_get(&paths, i));
 	}
 
-	return true;
+	as_vector_destroy(&paths);
+	return res;
 }
 
 ///
-/// The callback passed to get_info() to parse the set object count.
+/// Adds the records of a text file to the digest list. Each line is either `<namespace>
+/// <digest>` or a record line printed by `asdiff`, i.e., `<kind> <namespace> <digest> <file>
+/// <offset>`. Empty lines and lines that start with `#` are ignored.
 ///
-/// @param context_  The set_count_context for the parsed result.
-/// @param key       The key of the current key-value pair. Not used.
-/// @param value     A string of the form "<k1>=<v1>[:<k2>=<v2>[:...]]".
+/// @param rs    The recheck state.
+/// @param path  The text file.
 ///
-/// @result          `true`, if successful.
+/// @result      `true`, if successful.
 ///
 static bool
-set_count_callback(void *context_, const char *key_, const char *value_)
+recheck_load_list(recheck_state *rs, const char *path)
 {
-	(void)key_;
-	set_count_context *context = (set_count_context *)context_;
 	bool res = false;
+	FILE *fd = fopen(path, "r");
 
-	// The server sends a trailing semicolon, which results in an empty last string. Skip it.
-	if (value_[0] == 0) {
-		res = true;
+	if (fd == NULL) {
+		err_code("Error while opening digest list %s", path);
 		goto cleanup0;
 	}
 
-	char *info = safe_strdup(value_);
-	as_vector info_vec;
-	as_vector_inita(&info_vec, sizeof (void *), 25);
-	split_string(info, ':', false, &info_vec);
+	char *line = NULL;
+	size_t line_size = 0;
+	uint32_t line_no = 0;
 
-	bool match = true;
-	uint64_t count = 0;
+	while (getline(&line, &line_size, fd) >= 0) {
+		++line_no;
 
-	for (uint32_t i = 0; i < info_vec.size; ++i) {
-		char *key = as_vector_get_ptr(&info_vec, i);
-		char *equals = strchr(key, '=');
+		const char *tokens[5];
+		size_t lens[5];
+		uint32_t n_tokens = 0;
+		char *pos = line;
 
-		if (equals == NULL) {
-			err("Invalid info string %s (missing \"=\")", value_);
-			goto cleanup1;
-		}
+		while (true) {
+			pos += strspn(pos, " \t\r\n");
 
-		*equals = 0;
-		char *value = equals + 1;
+			if (*pos == 0) {
+				break;
+			}
 
-		if ((strcmp(key, "ns_name") == 0 || strcmp(key, "ns") == 0) &&
-				strcmp(value, context->ns) != 0) {
-			match = false;
+			size_t len = strcspn(pos, " \t\r\n");
+
+			if (n_tokens < 5) {
+				tokens[n_tokens] = pos;
+				lens[n_tokens] = len;
+			}
+
+			++n_tokens;
+			pos += len;
 		}
 
-		if ((strcmp(key, "set_name") == 0 || strcmp(key, "set") == 0) &&
-				strcmp(value, context->set) != 0) {
-			match = false;
+		if (n_tokens == 0 || tokens[0][0] == '#') {
+			continue;
 		}
 
-		if ((strcmp(key, "n_objects") == 0 || strcmp(key, "objects") == 0) &&
-				!better_atoi(value, &count)) {
-			err("Invalid object count %s", value);
-			goto cleanup1;
+		// skip the kind of an asdiff record line; its file path may contain spaces
+		uint32_t first = n_tokens >= 4 ? 1 : 0;
+		recheck_key key;
+
+		if ((n_tokens != 2 && n_tokens < 4) ||
+				!recheck_namespace(rs, tokens[first], lens[first], &key.ns) ||
+				!decode_digest(tokens[first + 1], lens[first + 1], key.digest)) {
+			err("Invalid record in digest list %s (line %u)", path, line_no);
+			goto cleanup2;
 		}
+
+		as_vector_append(&rs->keys, &key);
 	}
 
-	if (match) {
-		context->count += count;
+	if (ferror(fd)) {
+		err_code("Error while reading digest list %s", path);
+		goto cleanup2;
 	}
 
 	res = true;
 
-cleanup1:
-	as_vector_destroy(&info_vec);
-	cf_free(info);
+cleanup2:
+	free(line);
+	fclose(fd);
 
 cleanup0:
 	return res;
 }
 
 ///
-/// Retrieves the total number of objects stored in the given namespace on the given nodes.
-///
-/// Queries each cluster node individually, sums up the reported numbers, and then divides by the
-/// replication count.
+/// Loads the digest list of a --recheck run: a previous run's backup directory or backup file,
+/// if it has offset indexes, otherwise a text file. Sorts the records and drops duplicates.
 ///
-/// @param as            The Aerospike client instance.
-/// @param namespace     The namespace that we are interested in.
-/// @param set           The set that we are interested in.
-/// @param node_names    The array of node IDs of the cluster nodes to be queried.
-/// @param n_node_names  The number of elements in the node ID array.
-/// @param obj_count     The number of objects.
+/// @param rs    The recheck state.
+/// @param path  The digest list.
 ///
-/// @result              `true`, if successful.
+/// @result      `true`, if successful.
 ///
 static bool
-get_object_count(aerospike *as, const char *namespace, const char *set,
-		char (*node_names)[][AS_NODE_NAME_SIZE], uint32_t n_node_names, uint64_t *obj_count)
+recheck_load(recheck_state *rs, const char *path)
 {
-	if (verbose) {
-		ver("Getting cluster object count");
+	struct stat sb;
+
+	if (stat(path, &sb) < 0) {
+		err_code("Error while accessing digest list %s", path);
+		return false;
 	}
 
-	*obj_count = 0;
+	char idx_path[PATH_MAX];
 
-	size_t value_size = sizeof "namespace/" - 1 + strlen(namespace) + 1;
-	char value[value_size];
-	snprintf(value, value_size, "namespace/%s", namespace);
-	inf("%-20s%-15s%-15s", "Node ID", "Objects", "Replication");
-	ns_count_context ns_context = { 0, 0 };
+	if ((size_t)snprintf(idx_path, sizeof idx_path, "%s%s", path, INDEX_SUFFIX) >=
+			sizeof idx_path) {
+		err("Digest list path too long");
+		return false;
+	}
 
-	for (uint32_t i = 0; i < n_node_names; ++i) {
-		if (verbose) {
-			ver("Getting object count for node %s", (*node_names)[i]);
+	struct stat idx_sb;
+	bool run = S_ISDIR(sb.st_mode) || stat(idx_path, &idx_sb) == 0;
+
+	if (!(run ? recheck_load_run(rs, path) : recheck_load_list(rs, path))) {
+		return false;
+	}
+
+	if (rs->keys.size == 0) {
+		return true;
+	}
+
+	// overlapping backup files or lists can name a record more than once
+	qsort(rs->keys.list, rs->keys.size, sizeof (recheck_key), compare_recheck_key);
+	uint32_t n_keys = 1;
+
+	for (uint32_t i = 1; i < rs->keys.size; ++i) {
+		recheck_key *key = as_vector_get(&rs->keys, i);
+
+		if (compare_recheck_key(as_vector_get(&rs->keys, n_keys - 1), key) != 0) {
+			as_vector_set(&rs->keys, n_keys++, key);
 		}
+	}
 
-		if (!get_info(as, value, (*node_names)[i], &ns_context, ns_count_callback, true)) {
-			err("Error while getting namespace object count for node %s", (*node_names)[i]);
-			return false;
+	rs->keys.size = n_keys;
+	return true;
+}
+
+///
+/// Callback function for aerospike_batch_get(). Validates the records of a batch.
+///
+/// @param results  The records of the batch.
+/// @param n        The number of records.
+/// @param cont     The recheck state.
+///
+/// @result         Always `true`.
+///
+static bool
+recheck_callback(const as_batch_read *results, uint32_t n, void *cont)
+{
+	recheck_state *rs = cont;
+
+	for (uint32_t i = 0; i < n; ++i) {
+		const as_batch_read *res = &results[i];
+
+		if (res->result == AEROSPIKE_ERR_RECORD_NOT_FOUND) {
+			cf_atomic64_incr(&rs->missing);
+			continue;
 		}
 
-		if (ns_context.factor == 0) {
-			err("Invalid namespace %s", namespace);
-			return false;
+		if (res->result != AEROSPIKE_OK) {
+			cf_atomic64_incr(&rs->failed);
+			continue;
 		}
 
-		uint64_t count;
+		cf_atomic64_incr(&rs->found);
+		bool need_log = false;
+		cdt_collect_fixes(rs->conf, (as_record *)&res->record, NULL, &rs->cdt_list, &rs->cdt_map,
+				&need_log, NULL, NULL);
 
-		if (set[0] == 0) {
-			count =  ns_context.count;
-		} else {
-			set_count_context set_context = { namespace, set, 0 };
+		if (!need_log) {
+			continue;
+		}
 
-			if (!get_info(as, "sets", (*node_names)[i], &set_context, set_count_callback, false)) {
-				err("Error while getting set object count for node %s", (*node_names)[i]);
-				return false;
-			}
+		cf_atomic64_incr(&rs->broken);
 
-			count = set_context.count;
-		}
+		// print the records that are still broken as a digest list for the next recheck
+		char digest[(AS_DIGEST_VALUE_SIZE + 2) / 3 * 4 + 1];
+		cf_b64_encode(res->key.digest.value, AS_DIGEST_VALUE_SIZE, digest);
+		digest[sizeof digest - 1] = 0;
 
-		inf("%-20s%-15" PRIu64 "%-15d", (*node_names)[i], count, ns_context.factor);
-		*obj_count += count;
+		safe_lock();
+		printf("%s %s\n", res->key.ns, digest);
+		safe_unlock();
 	}
 
-	*obj_count /= ns_context.factor;
 	return true;
 }
 
 ///
-/// Signal handler for `SIGINT` and `SIGTERM`.
+/// Main thread function of the recheck threads. Claims batches of the digest list and reads and
+/// validates their records, until the digest list is exhausted. The threads keep several batches
+/// in flight at the same time.
 ///
-/// @param sig  The signal number.
+/// @param cont  The recheck state.
 ///
-static void
-sig_hand(int32_t sig)
+/// @result      `EXIT_SUCCESS` on success, `EXIT_FAILURE` otherwise.
+///
+static void *
+recheck_thread_func(void *cont)
 {
-	(void)sig;
-	err("### Validation interrupted ###");
-	stop = true;
+	if (verbose) {
+		ver("Entering recheck thread 0x%" PRIx64, (uint64_t)pthread_self());
+	}
+
+	recheck_state *rs = cont;
+	backup_config *conf = rs->conf;
+	uint32_t batch_size = conf->recheck_batch;
+	void *res = (void *)EXIT_FAILURE;
+
+	as_policy_batch policy;
+	as_policy_batch_init(&policy);
+	policy.concurrent = true;
+
+	while (true) {
+		if (stop) {
+			goto cleanup1;
+		}
+
+		uint64_t first = (uint64_t)cf_atomic64_add(&rs->next, batch_size) - batch_size;
+
+		if (first >= rs->keys.size) {
+			break;
+		}
+
+		uint32_t n = rs->keys.size - (uint32_t)first < batch_size ?
+				rs->keys.size - (uint32_t)first : batch_size;
+		as_batch batch;
+		as_batch_init(&batch, n);
+
+		for (uint32_t i = 0; i < n; ++i) {
+			recheck_key *key = as_vector_get(&rs->keys, (uint32_t)first + i);
+			as_key_init_digest(as_batch_keyat(&batch, i), as_vector_get(&rs->namespaces, key->ns),
+					"", key->digest);
+		}
+
+		as_error ae;
+		as_status status = rs->bins != NULL ?
+				aerospike_batch_get_bins(conf->as, &ae, &policy, &batch, rs->bins, rs->n_bins,
+						recheck_callback, rs) :
+				aerospike_batch_get(conf->as, &ae, &policy, &batch, recheck_callback, rs);
+
+		if (status != AEROSPIKE_OK) {
+			err("Error while reading a batch of %u record(s) - code %d: %s at %s:%d", n, ae.code,
+					ae.message, ae.file, ae.line);
+			cf_atomic64_add(&rs->failed, n);
+		}
+
+		as_batch_destroy(&batch);
+	}
+
+	res = (void *)EXIT_SUCCESS;
+
+cleanup1:
+	if (verbose) {
+		ver("Leaving recheck thread");
+	}
+
+	return res;
 }
 
 ///
-/// Joins a thread and expects it to exit within a reasonable amount of time after `stop` was
-/// set to abort all threads.
+/// Rechecks the records of a digest list instead of scanning the namespaces. Reads the records
+/// with batch reads and validates them like a scan would. Prints the records that are still
+/// broken to stdout.
 ///
-/// @param thread      The thread to be joined.
-/// @param thread_res  The joined thread's return value.
+/// @param conf  The global backup configuration and stats.
 ///
-/// @result            `ETIMEDOUT` on a timeout, otherwise the same as `pthread_join()`.
+/// @result      `true`, if successful.
 ///
-static int32_t
-safe_join(pthread_t thread, void **thread_res)
+static bool
+run_recheck(backup_config *conf)
 {
-	if (verbose) {
-		ver("Joining thread 0x%" PRIx64, (uint64_t)thread);
+	bool res = false;
+	recheck_state rs;
+	memset(&rs, 0, sizeof (recheck_state));
+	rs.conf = conf;
+	as_vector_init(&rs.namespaces, AS_NAMESPACE_MAX_SIZE, 4);
+	as_vector_init(&rs.keys, sizeof (recheck_key), 1024);
+
+	// only read the bins that a scan would read
+	char *bin_clone = NULL;
+	as_vector bin_vec;
+	as_vector_inita(&bin_vec, sizeof (void *), 25);
+
+	if (conf->bin_list != NULL) {
+		bin_clone = safe_strdup(conf->bin_list);
+		split_string(bin_clone, ',', true, &bin_vec);
+		rs.bins = (const char **)bin_vec.list;
+		rs.n_bins = bin_vec.size;
 	}
 
-	int32_t since_stop = 0;
+	if (!recheck_load(&rs, conf->recheck)) {
+		err("Error while loading digest list %s", conf->recheck);
+		goto cleanup1;
+	}
 
-	while (true) {
-#if !defined __APPLE__
-		time_t deadline = time(NULL) + 5;
-		struct timespec ts = { deadline, 0 };
-		int32_t res = pthread_timedjoin_np(thread, thread_res, &ts);
-#else
-		int32_t res = pthread_join(thread, thread_res);
-#endif
+	uint32_t n_batches = (rs.keys.size + conf->recheck_batch - 1) / conf->recheck_batch;
+	uint32_t n_threads = (uint32_t)conf->parallel < n_batches ? (uint32_t)conf->parallel :
+			n_batches;
+	inf("Rechecking %u record(s) in %u batch(es), %u at a time", rs.keys.size, n_batches,
+			n_threads);
 
-		if (res == 0 || res != ETIMEDOUT) {
-			return res;
-		}
+	cf_clock start_ms = cf_getms();
+	pthread_t threads[MAX_PARALLEL];
+	uint32_t n_created = 0;
+	res = true;
 
-		if (!stop) {
-			continue;
+	for (uint32_t i = 0; i < n_threads; ++i) {
+		if (!create_worker(conf, i, &threads[i], recheck_thread_func, &rs)) {
+			err_code("Error while creating recheck thread");
+			stop = true;
+			res = false;
+			break;
 		}
 
-		if (verbose) {
-			ver("Expecting thread 0x%" PRIx64 " to finish (%d)", (uint64_t)thread, since_stop);
-		}
+		++n_created;
+	}
 
-		if (++since_stop >= 4) {
-			err("Stuck thread detected");
-			errno = ETIMEDOUT;
-			return ETIMEDOUT;
+	for (uint32_t i = 0; i < n_created; ++i) {
+		void *thread_res;
+
+		if (safe_join(threads[i], &thread_res) != 0) {
+			err_code("Error while joining recheck thread");
+			stop = true;
+			res = false;
+		} else if (thread_res != (void *)EXIT_SUCCESS) {
+			res = false;
 		}
 	}
+
+	uint64_t ms = cf_getms() - start_ms;
+	inf("Rechecked %u record(s) in %" PRIu64 " ms", rs.keys.size, ms);
+	inf("%10" PRIu64 " Read", cf_atomic64_get(rs.found));
+	inf("%10" PRIu64 "   Still broken", cf_atomic64_get(rs.broken));
+	inf("%10" PRIu64 " Not found", cf_atomic64_get(rs.missing));
+	inf("%10" PRIu64 " Read failed", cf_atomic64_get(rs.failed));
+	print_cdt_stats(&rs.cdt_list, &rs.cdt_map);
+
+	if (cf_atomic64_get(rs.failed) > 0) {
+		res = false;
+	}
+
+cleanup1:
+	as_vector_destroy(&bin_vec);
+
+	if (bin_clone != NULL) {
+		cf_free(bin_clone);
+	}
+
+	as_vector_destroy(&rs.keys);
+	as_vector_destroy(&rs.namespaces);
+	return res;
 }
 
 ///
@@ -1671,6 +5192,22 @@ usage(const char *name)
 
 	fprintf(stderr, " --cdt-fix-ordered-list-unique\n");
 	fprintf(stderr, "                      Fix CDT ordered list records.\n");
+	fprintf(stderr, " --fix-dry-run\n");
+	fprintf(stderr, "                      Compute the fixes for broken lists without applying\n");
+	fprintf(stderr, "                      them and report per set how many bytes they would\n");
+	fprintf(stderr, "                      reclaim, how many duplicate elements they would drop,\n");
+	fprintf(stderr, "                      and how many bytes they would write.\n");
+	fprintf(stderr, " --map-fix <policy>[,<policy>]\n");
+	fprintf(stderr, "                      Fix maps with duplicate keys or non-storage elements\n");
+	fprintf(stderr, "                      by rebuilding them according to the given policies:\n");
+	fprintf(stderr, "                      keep-first or keep-last keeps the first or the last\n");
+	fprintf(stderr, "                      pair of each duplicate key, drop-nonstorage drops the\n");
+	fprintf(stderr, "                      pairs that contain non-storage elements. With\n");
+	fprintf(stderr, "                      --fix-dry-run, only computes these fixes.\n");
+	fprintf(stderr, " --sample <percent>\n");
+	fprintf(stderr, "                      Only validate the given percentage of records and\n");
+	fprintf(stderr, "                      report estimated rates with 95%% confidence intervals.\n");
+	fprintf(stderr, "                      Default: 100, i.e., validate all records.\n");
 
 	fprintf(stderr, "\n");
 	fprintf(stderr, "Configuration File Allowed Options\n");
@@ -1754,20 +5291,39 @@ usage(const char *name)
 
 
 	fprintf(stderr, "[asvalidation]\n");
-	fprintf(stderr, "  -n, --namespace <namespace>\n");
-	fprintf(stderr, "                      The namespace to be validated. Required.\n");
-	fprintf(stderr, "  -s, --set <set>\n");
-	fprintf(stderr, "                      The set to be validated. Default: all sets.\n");
+	fprintf(stderr, "  -n, --namespace <namespace>[/<set>][,...]\n");
+	fprintf(stderr, "                      The namespace(s) to be validated. An entry can name its\n");
+	fprintf(stderr, "                      set explicitly. Required, unless --recheck.\n");
+	fprintf(stderr, "  -s, --set <set>[,...]\n");
+	fprintf(stderr, "                      The set(s) to be validated in each namespace without an\n");
+	fprintf(stderr, "                      explicit set. Default: all sets.\n");
 	fprintf(stderr, "  -d, --directory <directory>\n");
 	fprintf(stderr, "                      The directory that holds the output files. Required, \n");
 	fprintf(stderr, "                      unless -o.\n");
 	fprintf(stderr, "  -o, --output-file <file>\n");
 	fprintf(stderr, "                      Write to a single output file. Use - for stdout.\n");
-	fprintf(stderr, "                      Required, unless -d.\n");
+	fprintf(stderr, "                      Required, unless -d. Supports a single namespace.\n");
 	fprintf(stderr, "  -F, --file-limit\n");
 	fprintf(stderr, "                      Rotate output files, when their size crosses the given\n");
 	fprintf(stderr, "                      value (in MiB) Only used when backing up to a directory.\n");
 	fprintf(stderr, "                      Default: 250.\n");
+	fprintf(stderr, "  --offset-index <n>\n");
+	fprintf(stderr, "                      Write an offset index next to each output file that maps\n");
+	fprintf(stderr, "                      the records' digests to their offsets and has the offset\n");
+	fprintf(stderr, "                      of every n-th record. Requires -d. Default: 0 (disabled).\n");
+	fprintf(stderr, "  --recheck <list>\n");
+	fprintf(stderr, "                      Instead of scanning, read the records of the given digest\n");
+	fprintf(stderr, "                      list with batch reads and validate them. The list is a\n");
+	fprintf(stderr, "                      previous run's output directory or output file with\n");
+	fprintf(stderr, "                      offset indexes, or a text file with one \"<namespace>\n");
+	fprintf(stderr, "                      <digest>\" per line, or asdiff output. Prints the records\n");
+	fprintf(stderr, "                      that are still broken to stdout in the same format.\n");
+	fprintf(stderr, "                      --parallel sets the number of batches in flight.\n");
+	fprintf(stderr, "  --recheck-batch <n>\n");
+	fprintf(stderr, "                      The number of records per --recheck batch. Default: 5000.\n");
+	fprintf(stderr, "  --io-uring\n");
+	fprintf(stderr, "                      Write output files asynchronously through io_uring. Linux\n");
+	fprintf(stderr, "                      only; requires a build with USE_IO_URING=1.\n");
 	fprintf(stderr, "  -L, --records-per-second <rps>\n");
 	fprintf(stderr, "                      Limit returned records per second (rps) rate for each server.\n");
 	fprintf(stderr, "                      Do not apply rps limit if records-per-second is zero.\n");
@@ -1782,6 +5338,10 @@ usage(const char *name)
 	fprintf(stderr, "                      Default: include all bins.\n");
 	fprintf(stderr, "  -w, --parallel <# nodes>\n");
 	fprintf(stderr, "                      Maximal number of nodes validated in parallel. Default: 10.\n");
+	fprintf(stderr, "  --adaptive-parallel\n");
+	fprintf(stderr, "                      Start with a single node scan and add scans, up to\n");
+	fprintf(stderr, "                      --parallel, while they raise the record rate without\n");
+	fprintf(stderr, "                      raising the latency. Back off otherwise.\n");
 	fprintf(stderr, "  -l, --node-list     <IP addr 1>:<port 1>[,<IP addr 2>:<port 2>[,...]]\n");
 	fprintf(stderr, "                      <IP addr 1>:<TLS_NAME 1>:<port 1>[,<IP addr 2>:<TLS_NAME 2>:<port 2>[,...]]\n");
 	fprintf(stderr, "                      Validate the given cluster nodes only. Default: validate the \n");
@@ -1800,7 +5360,37 @@ usage(const char *name)
 	fprintf(stderr, "  -b, --modified-before <YYYY-MM-DD_HH:MM:SS>\n");
 	fprintf(stderr, "                      Only include records that last changed before the given\n");
 	fprintf(stderr, "                      date and time. May combined with --modified-after to specify\n");
-	fprintf(stderr, "                      a range.\n\n");
+	fprintf(stderr, "                      a range.\n");
+	fprintf(stderr, "  --validation-threads <n>\n");
+	fprintf(stderr, "                      Validate records on a pool of n threads. The scans then\n");
+	fprintf(stderr, "                      only queue records and never wait for large CDTs.\n");
+	fprintf(stderr, "                      Default: 0, i.e., validate on the scan threads.\n");
+	fprintf(stderr, "  --queue-memory <MiB>\n");
+	fprintf(stderr, "                      Pause the scans while the records queued for the\n");
+	fprintf(stderr, "                      validation pool exceed this size. Default: 256.\n");
+	fprintf(stderr, "  --verdict-cache <entries>\n");
+	fprintf(stderr, "                      Remember the verdicts for up to this many distinct CDT\n");
+	fprintf(stderr, "                      bin values, so that byte-identical values are only\n");
+	fprintf(stderr, "                      validated once. Default: 0 (disabled).\n");
+	fprintf(stderr, "  --numa\n");
+	fprintf(stderr, "                      Spread the validation threads and the validation pool\n");
+	fprintf(stderr, "                      across the NUMA nodes, pin them to the nodes' CPUs, and\n");
+	fprintf(stderr, "                      keep their buffers in node-local memory. Linux only.\n");
+	fprintf(stderr, "  --state-file <path>\n");
+	fprintf(stderr, "                      Perform an incremental validation against the given state\n");
+	fprintf(stderr, "                      file; only include records that changed after the start of\n");
+	fprintf(stderr, "                      the last successful run that used the same state file.\n");
+	fprintf(stderr, "                      The file is created by the first run, which includes all\n");
+	fprintf(stderr, "                      records. Not updated by sampling or node-list runs.\n");
+	fprintf(stderr, "  --metrics <[host:]port|unix:path>\n");
+	fprintf(stderr, "                      Serve live metrics in the Prometheus text format over\n");
+	fprintf(stderr, "                      HTTP on the given TCP port or Unix domain socket.\n");
+	fprintf(stderr, "                      The host defaults to 127.0.0.1.\n");
+	fprintf(stderr, "  --profile\n");
+	fprintf(stderr, "                      Break down the validation threads' time into network\n");
+	fprintf(stderr, "                      wait, CDT checks, fixes, output, bandwidth throttling,\n");
+	fprintf(stderr, "                      file rotation, and queueing, and log it per node every\n");
+	fprintf(stderr, "                      %d seconds and at the end.\n\n", PROFILE_INTERVAL);
 
 	fprintf(stderr, "\n\n");
 	fprintf(stderr, "Default configuration files are read from the following files in the given order:\n");
@@ -1837,6 +5427,14 @@ main(int32_t argc, char **argv)
 		{ "only-config-file", required_argument, 0, CONFIG_FILE_OPT_ONLY_CONFIG_FILE},
 
 		{ "cdt-fix-ordered-list-unique", no_argument, NULL, CDT_FIX_OPT },
+		{ "fix-dry-run", no_argument, NULL, FIX_DRY_RUN_OPT },
+		{ "map-fix", required_argument, NULL, MAP_FIX_OPT },
+		{ "metrics", required_argument, NULL, METRICS_OPT },
+		{ "profile", no_argument, NULL, PROFILE_OPT },
+		{ "io-uring", no_argument, NULL, IO_URING_OPT },
+		{ "numa", no_argument, NULL, NUMA_OPT },
+		{ "adaptive-parallel", no_argument, NULL, ADAPTIVE_OPT },
+		{ "sample", required_argument, NULL, SAMPLE_OPT },
 
 		// Config options
 		{ "host", required_argument, 0, 'h'},
@@ -1880,6 +5478,9 @@ main(int32_t argc, char **argv)
 		{ "directory", required_argument, NULL, 'd' },
 		{ "output-file", required_argument, NULL, 'o' },
 		{ "file-limit", required_argument, NULL, 'F' },
+		{ "offset-index", required_argument, NULL, OFFSET_INDEX_OPT },
+		{ "recheck", required_argument, NULL, RECHECK_OPT },
+		{ "recheck-batch", required_argument, NULL, RECHECK_BATCH_OPT },
 		{ "remove-files", no_argument, NULL, 'r' },
 		{ "node-list", required_argument, NULL, 'l' },
 		{ "modified-after", required_argument, NULL, 'a' },
@@ -1887,6 +5488,10 @@ main(int32_t argc, char **argv)
 		{ "records-per-second", required_argument, NULL, 'L' },
 		{ "machine", required_argument, NULL, 'm' },
 		{ "nice", required_argument, NULL, 'N' },
+		{ "state-file", required_argument, NULL, STATE_FILE_OPT },
+		{ "validation-threads", required_argument, NULL, VALIDATION_THREADS_OPT },
+		{ "queue-memory", required_argument, NULL, QUEUE_MEMORY_OPT },
+		{ "verdict-cache", required_argument, NULL, VERDICT_CACHE_OPT },
 		{ NULL, 0, NULL, 0 }
 	};
 
@@ -2025,11 +5630,19 @@ main(int32_t argc, char **argv)
 			break;
 
 		case 'n':
-			as_strncpy(scan.ns, optarg, AS_NAMESPACE_MAX_SIZE);
+			if (conf.ns_list != NULL) {
+				cf_free(conf.ns_list);
+			}
+
+			conf.ns_list = safe_strdup(optarg);
 			break;
 
 		case 's':
-			as_strncpy(scan.set, optarg, AS_SET_MAX_SIZE);
+			if (conf.set_list != NULL) {
+				cf_free(conf.set_list);
+			}
+
+			conf.set_list = safe_strdup(optarg);
 			break;
 
 		case 'd':
@@ -2191,6 +5804,99 @@ main(int32_t argc, char **argv)
 			conf.cdt_fix = true;
 			break;
 
+		case VALIDATION_THREADS_OPT:
+			if (!better_atoi(optarg, &tmp) || tmp > MAX_VALIDATION_THREADS) {
+				err("Invalid validation-threads value %s", optarg);
+				goto cleanup1;
+			}
+
+			conf.validation_threads = (uint32_t)tmp;
+			break;
+
+		case QUEUE_MEMORY_OPT:
+			if (!better_atoi(optarg, &tmp) || tmp < 1) {
+				err("Invalid queue-memory value %s", optarg);
+				goto cleanup1;
+			}
+
+			conf.queue_memory = tmp * 1024 * 1024;
+			break;
+
+		case OFFSET_INDEX_OPT:
+			if (!better_atoi(optarg, &tmp) || tmp > MAX_INDEX_INTERVAL) {
+				err("Invalid offset index interval %s", optarg);
+				goto cleanup1;
+			}
+
+			conf.index_interval = (uint32_t)tmp;
+			break;
+
+		case RECHECK_OPT:
+			conf.recheck = optarg;
+			break;
+
+		case RECHECK_BATCH_OPT:
+			if (!better_atoi(optarg, &tmp) || tmp < 1 || tmp > MAX_RECHECK_BATCH) {
+				err("Invalid recheck batch size %s", optarg);
+				goto cleanup1;
+			}
+
+			conf.recheck_batch = (uint32_t)tmp;
+			break;
+
+		case VERDICT_CACHE_OPT:
+			if (!better_atoi(optarg, &tmp) || tmp > MAX_VERDICT_ENTRIES) {
+				err("Invalid verdict cache size %s", optarg);
+				goto cleanup1;
+			}
+
+			conf.verdict_entries = (uint32_t)tmp;
+			break;
+
+		case STATE_FILE_OPT:
+			conf.state_file = optarg;
+			break;
+
+		case METRICS_OPT:
+			conf.metrics = optarg;
+			break;
+
+		case IO_URING_OPT:
+			conf.uring = true;
+			break;
+
+		case NUMA_OPT:
+			conf.numa = true;
+			break;
+
+		case PROFILE_OPT:
+			conf.profile = true;
+			break;
+
+		case ADAPTIVE_OPT:
+			conf.adaptive = true;
+			break;
+
+		case FIX_DRY_RUN_OPT:
+			conf.cdt_fix_dry_run = true;
+			break;
+
+		case MAP_FIX_OPT:
+			if (!parse_map_fix(optarg, &conf.map_fix)) {
+				goto cleanup1;
+			}
+
+			break;
+
+		case SAMPLE_OPT:
+			if (!better_atoi(optarg, &tmp) || tmp < 1 || tmp > 100) {
+				err("Invalid sample percentage %s", optarg);
+				goto cleanup1;
+			}
+
+			conf.sample = (uint32_t)tmp;
+			break;
+
 		default:
 			usage(argv[0]);
 			goto cleanup1;
@@ -2202,6 +5908,49 @@ main(int32_t argc, char **argv)
 		goto cleanup1;
 	}
 
+	conf.phase_timing = conf.profile || conf.adaptive;
+
+	if (conf.uring && !uring_probe()) {
+		err("Cannot write output files through io_uring (--io-uring option)");
+		goto cleanup1;
+	}
+
+	// a single output file would need an unbounded in-memory index of all of its records
+	if (conf.index_interval > 0 && conf.output_file != NULL) {
+		err("Invalid options: --offset-index requires an output directory (-d), not -o.");
+		goto cleanup1;
+	}
+
+	if (conf.recheck != NULL && (conf.cdt_fix || conf.cdt_fix_dry_run || conf.map_fix != 0 ||
+			conf.state_file != NULL)) {
+		err("Invalid options: --recheck only validates records; it cannot be combined with fixes "
+				"or --state-file.");
+		goto cleanup1;
+	}
+
+	// the still broken records go to stdout, there are no output files
+	if (conf.recheck != NULL && (conf.directory != NULL || conf.output_file != NULL ||
+			conf.index_interval > 0)) {
+		err("Invalid options: --recheck prints to stdout; it cannot be combined with -d, -o, "
+				"or --offset-index.");
+		goto cleanup1;
+	}
+
+	if (conf.verdict_entries > 0) {
+		init_verdict_cache(&conf);
+	}
+
+	if (conf.numa) {
+		conf.numa_topo = safe_malloc(sizeof (numa_topology));
+
+		if (!numa_init(conf.numa_topo)) {
+			err("Cannot place the validation threads on NUMA nodes (--numa option)");
+			goto cleanup1;
+		}
+
+		inf("Spreading the validation threads across %u NUMA node(s)", conf.numa_topo->n_nodes);
+	}
+
 	if ((conf.port >= 0 || conf.host != NULL) && conf.node_list != NULL) {
 		err("Invalid options: --host and --port are mutually exclusive with --node-list.");
 		goto cleanup1;
@@ -2215,11 +5964,16 @@ main(int32_t argc, char **argv)
 		conf.host = DEFAULT_HOST;
 	}
 
-	if (scan.ns[0] == 0) {
+	if (conf.ns_list == NULL && conf.recheck == NULL) {
 		err("Please specify a namespace (-n option)");
 		goto cleanup1;
 	}
 
+	if (conf.ns_list != NULL && !parse_targets(&conf)) {
+		err("Error while parsing namespace and set lists");
+		goto cleanup1;
+	}
+
 	int32_t out_count = 0;
 	out_count += conf.directory != NULL ? 1 : 0;
 	out_count += conf.output_file != NULL ? 1 : 0;
@@ -2229,11 +5983,29 @@ main(int32_t argc, char **argv)
 		goto cleanup1;
 	}
 
-	if (out_count == 0) {
+	if (out_count == 0 && conf.recheck == NULL) {
 		err("Please specify a directory (-d), an output file (-o).");
 		goto cleanup1;
 	}
 
+	// the shared output file's header names a single namespace for all of its records
+	if (conf.output_file != NULL) {
+		for (uint32_t i = 1; i < conf.n_targets; ++i) {
+			if (strcmp(conf.targets[i].ns, conf.targets[0].ns) != 0) {
+				err("Invalid options: --output-file only supports a single namespace, "
+						"use --directory for %s and %s", conf.targets[0].ns,
+						conf.targets[i].ns);
+				goto cleanup1;
+			}
+		}
+	}
+
+	if (conf.cdt_fix && conf.cdt_fix_dry_run) {
+		err("Invalid options: --cdt-fix-ordered-list-unique and --fix-dry-run are mutually "
+				"exclusive.");
+		goto cleanup1;
+	}
+
 	node_spec *node_specs = NULL;
 	uint32_t n_node_specs = 0;
 
@@ -2267,6 +6039,8 @@ main(int32_t argc, char **argv)
 		}
 	}
 
+	// from here on, the validation threads' log messages go through the log thread
+	log_start();
 	signal(SIGINT, sig_hand);
 	signal(SIGTERM, sig_hand);
 
@@ -2275,6 +6049,33 @@ main(int32_t argc, char **argv)
 	char before_buff[100];
 	char after_buff[100];
 
+	// incremental validation: the next run picks up from this run's start; back off by a margin
+	// to tolerate clock skew between us and the cluster nodes
+	int64_t state_nanos = ((int64_t)time(NULL) - STATE_CLOCK_MARGIN) * 1000000000;
+	char state_ns[STATE_LINE_SIZE];
+	char state_set[STATE_LINE_SIZE];
+	join_targets(&conf, false, state_ns, sizeof state_ns);
+	join_targets(&conf, true, state_set, sizeof state_set);
+
+	// a --modified-after later than the watermark skips records that the state file says still
+	// need validating
+	bool after_watermark = false;
+
+	if (conf.state_file != NULL) {
+		int64_t last_nanos;
+
+		if (!read_state_file(conf.state_file, state_ns, state_set, &last_nanos)) {
+			goto cleanup2;
+		}
+
+		if (conf.mod_after > 0) {
+			inf("Using --modified-after instead of state file watermark");
+			after_watermark = conf.mod_after > last_nanos;
+		} else {
+			conf.mod_after = last_nanos;
+		}
+	}
+
 	if (conf.mod_before > 0 && conf.mod_after > 0) {
 		as_scan_predexp_inita(&scan, 7);
 	} else if (conf.mod_before > 0 || conf.mod_after > 0) {
@@ -2315,19 +6116,35 @@ main(int32_t argc, char **argv)
 		as_scan_predexp_add(&scan, as_predexp_and(2));
 	}
 
-	inf("Starting validation of %s (namespace: %s, set: %s, bins: %s, after: %s, before: %s) to %s",
-			conf.host, scan.ns, scan.set[0] == 0 ? "[all]" : scan.set,
-			conf.bin_list == NULL ? "[all]" : conf.bin_list, after, before,
-			conf.output_file != NULL ?
-					strcmp(conf.output_file, "-") == 0 ? "[stdout]" : conf.output_file :
-					conf.directory != NULL ?
-							conf.directory : "[none]");
+	if (conf.recheck != NULL) {
+		inf("Starting recheck of %s (bins: %s) from %s", conf.host,
+				conf.bin_list == NULL ? "[all]" : conf.bin_list, conf.recheck);
+	} else {
+		inf("Starting validation of %s (namespace: %s, set: %s, bins: %s, after: %s, before: %s) "
+				"to %s", conf.host, conf.ns_list, conf.set_list == NULL ? "[all]" : conf.set_list,
+				conf.bin_list == NULL ? "[all]" : conf.bin_list, after, before,
+				conf.output_file != NULL ?
+						strcmp(conf.output_file, "-") == 0 ? "[stdout]" : conf.output_file :
+						conf.directory != NULL ?
+								conf.directory : "[none]");
+	}
 
 	if (conf.bin_list != NULL && !init_scan_bins(conf.bin_list, &scan)) {
 		err("Error while setting scan bin list");
 		goto cleanup2;
 	}
 
+	// the scan's bin names stay around until the end
+	if (conf.bin_list != NULL) {
+		conf.fix_bins = safe_malloc((scan.select.size + 1u) * sizeof (char *));
+
+		for (uint16_t i = 0; i < scan.select.size; ++i) {
+			conf.fix_bins[i] = scan.select.entries[i];
+		}
+
+		conf.fix_bins[scan.select.size] = NULL;
+	}
+
 	FILE *mach_fd = NULL;
 
 	if (conf.machine != NULL && (mach_fd = fopen(conf.machine, "a")) == NULL) {
@@ -2399,20 +6216,62 @@ main(int32_t argc, char **argv)
 		goto cleanup5;
 	}
 
+	if (conf.recheck != NULL) {
+		res = run_recheck(&conf) ? EXIT_SUCCESS : EXIT_FAILURE;
+		goto cleanup5;
+	}
+
 	inf("Processing %u node(s)", n_node_names);
+
+	conf.node_metrics = safe_malloc(n_node_names * sizeof (node_metrics));
+	memset(conf.node_metrics, 0, n_node_names * sizeof (node_metrics));
+	conf.n_node_metrics = n_node_names;
+
+	for (uint32_t i = 0; i < n_node_names; ++i) {
+		memcpy(conf.node_metrics[i].node_name, (*node_names)[i], AS_NODE_NAME_SIZE);
+	}
+
 	cf_atomic64_set(&conf.rec_count_total, 0);
 	cf_atomic64_set(&conf.byte_count_total, 0);
 	cf_atomic64_set(&conf.rec_count_checked, 0);
 	conf.byte_count_limit = conf.bandwidth;
-	uint64_t rec_count_estimate;
+	uint64_t rec_count_estimate = 0;
 
-	if (!get_object_count(&as, scan.ns, scan.set, node_names, n_node_names, &rec_count_estimate)) {
-		err("Error while counting cluster objects");
-		goto cleanup5;
+	for (uint32_t i = 0; i < conf.n_targets; ++i) {
+		scan_target *t = &conf.targets[i];
+		t->node_counts = safe_malloc(n_node_names * sizeof (uint64_t));
+
+		if (!get_object_count(&as, t->ns, t->set, node_names, n_node_names,
+				&t->rec_count_estimate, t->node_counts)) {
+			err("Error while counting cluster objects");
+			goto cleanup5;
+		}
+
+		rec_count_estimate += t->rec_count_estimate;
+	}
+
+	if (conf.sample < 100) {
+		inf("Sampling %u%% of the records", conf.sample);
+		as_scan_set_percent(&scan, (uint8_t)conf.sample);
+		rec_count_estimate = rec_count_estimate * conf.sample / 100;
 	}
 
 	conf.rec_count_estimate = rec_count_estimate;
 
+	// each target scans with its own namespace and set, but the shared settings
+	for (uint32_t i = 0; i < conf.n_targets; ++i) {
+		scan_target *t = &conf.targets[i];
+		memcpy(&t->scan, &scan, sizeof (as_scan));
+		as_strncpy(t->scan.ns, t->ns, AS_NAMESPACE_MAX_SIZE);
+		as_strncpy(t->scan.set, t->set, AS_SET_MAX_SIZE);
+		t->rec_count_estimate = t->rec_count_estimate * conf.sample / 100;
+
+		if (conf.n_targets > 1) {
+			inf("Namespace %s, set %s contains %" PRIu64 " record(s)", t->ns,
+					t->set[0] == 0 ? "[all]" : t->set, t->rec_count_estimate);
+		}
+	}
+
 	inf("Namespace contains %" PRIu64 " record(s)", conf.rec_count_estimate);
 
 	if (conf.directory != NULL && !clean_directory(conf.directory, conf.remove_files)) {
@@ -2423,6 +6282,13 @@ main(int32_t argc, char **argv)
 		goto cleanup5;
 	}
 
+	metrics_server metrics = { .fd = -1 };
+
+	if (conf.metrics != NULL && !metrics_start(&metrics, conf.metrics, render_metrics, &conf)) {
+		err("Error while starting metrics endpoint on %s", conf.metrics);
+		goto cleanup5;
+	}
+
 	pthread_t counter_thread;
 	counter_thread_args counter_args;
 	counter_args.conf = &conf;
@@ -2436,12 +6302,18 @@ main(int32_t argc, char **argv)
 
 	if (pthread_create(&counter_thread, NULL, counter_thread_func, &counter_args) != 0) {
 		err_code("Error while creating counter thread");
-		goto cleanup5;
+		goto cleanup11;
 	}
 
 	pthread_t backup_threads[MAX_PARALLEL];
 	uint32_t n_threads = (uint32_t)conf.parallel > n_node_names ? n_node_names :
 			(uint32_t)conf.parallel;
+
+	// adaptive parallelism: start with a single scan, --parallel becomes the upper bound
+	safe_lock();
+	conf.max_scans = n_threads;
+	conf.scan_limit = conf.adaptive ? 1 : n_threads;
+	safe_unlock();
 	backup_thread_args backup_args;
 	backup_args.conf = &conf;
 	backup_args.shared_fd = NULL;
@@ -2453,29 +6325,110 @@ main(int32_t argc, char **argv)
 		goto cleanup6;
 	}
 
+	conf.job_queue = job_queue;
+
 	void *fd_buf = NULL;
 
 	// backing up to a single backup file: open the file now and store the file descriptor in
 	// backup_args.shared_fd; it'll be shared by all backup threads
-	if (conf.output_file != NULL && !open_file(&backup_args.bytes, conf.output_file, conf.scan->ns,
-			0, &backup_args.shared_fd, &fd_buf)) {
+	if (conf.output_file != NULL && !open_file(&backup_args.bytes, conf.output_file,
+			conf.targets[0].ns, 0, conf.uring, NULL, -1, &backup_args.shared_fd, &fd_buf)) {
 		err("Error while opening shared output file");
 		goto cleanup7;
 	}
 
+	// one job for each namespace or set on each node
+	uint32_t n_jobs = conf.n_targets * n_node_names;
+	backup_thread_args *jobs = safe_malloc(n_jobs * sizeof (backup_thread_args));
+
+	for (uint32_t i = 0; i < conf.n_targets; ++i) {
+		for (uint32_t k = 0; k < n_node_names; ++k) {
+			backup_thread_args *job = &jobs[i * n_node_names + k];
+			memcpy(job, &backup_args, sizeof (backup_thread_args));
+			memcpy(job->node_name, (*node_names)[k], AS_NODE_NAME_SIZE);
+			job->metrics = &conf.node_metrics[k];
+			job->target = &conf.targets[i];
+			job->rec_count_estimate = conf.targets[i].node_counts[k];
+		}
+	}
+
+	// largest first, so that the run doesn't end with a big job that was started last
+	qsort(jobs, n_jobs, sizeof (backup_thread_args), compare_job_size);
+
 	if (verbose) {
-		ver("Pushing %u job(s) to job queue", n_node_names);
+		ver("Pushing %u job(s) to job queue", n_jobs);
 	}
 
-	for (uint32_t i = 0; i < n_node_names; ++i) {
-		memcpy(backup_args.node_name, (*node_names)[i], AS_NODE_NAME_SIZE);
+	for (uint32_t i = 0; i < n_jobs; ++i) {
+		if (verbose) {
+			ver("Job %u: node %s, namespace %s, set %s, ~%" PRIu64 " record(s)", i + 1,
+					jobs[i].node_name, jobs[i].target->ns,
+					jobs[i].target->set[0] == 0 ? "[all]" : jobs[i].target->set,
+					jobs[i].rec_count_estimate);
+		}
 
-		if (cf_queue_push(job_queue, &backup_args) != CF_QUEUE_OK) {
+		if (cf_queue_push(job_queue, &jobs[i]) != CF_QUEUE_OK) {
 			err("Error while queueing validation job");
+			cf_free(jobs);
+			goto cleanup8;
+		}
+	}
+
+	cf_free(jobs);
+
+	pthread_t rotate_thread;
+
+	// backing up to a directory: full backup files are closed and their successors opened in
+	// the background
+	if (conf.directory != NULL) {
+		conf.rotate_queue = cf_queue_create(sizeof (rotate_job), true);
+
+		if (conf.rotate_queue == NULL) {
+			err_code("Error while allocating rotation queue");
+			goto cleanup8;
+		}
+
+		if (verbose) {
+			ver("Creating rotation thread");
+		}
+
+		if (pthread_create(&rotate_thread, NULL, rotate_thread_func, conf.rotate_queue) != 0) {
+			err_code("Error while creating rotation thread");
+			cf_queue_destroy(conf.rotate_queue);
+			conf.rotate_queue = NULL;
 			goto cleanup8;
 		}
 	}
 
+	pthread_t validation_threads[MAX_VALIDATION_THREADS];
+	uint32_t n_validation_ok = 0;
+
+	// validation pool: the scan callbacks only queue records, the pool validates them
+	if (conf.validation_threads > 0) {
+		conf.record_queue = cf_queue_create(sizeof (queued_record), true);
+
+		if (conf.record_queue == NULL) {
+			err_code("Error while allocating record queue");
+			stop = true;
+			goto cleanup10;
+		}
+
+		if (verbose) {
+			ver("Creating %u validation pool thread(s)", conf.validation_threads);
+		}
+
+		for (uint32_t i = 0; i < conf.validation_threads; ++i) {
+			if (!create_worker(&conf, i, &validation_threads[i], validation_thread_func,
+					&conf)) {
+				err_code("Error while creating validation pool thread");
+				stop = true;
+				goto cleanup10;
+			}
+
+			++n_validation_ok;
+		}
+	}
+
 	uint32_t n_threads_ok = 0;
 
 	if (verbose) {
@@ -2483,7 +6436,7 @@ main(int32_t argc, char **argv)
 	}
 
 	for (uint32_t i = 0; i < n_threads; ++i) {
-		if (pthread_create(&backup_threads[i], NULL, backup_thread_func, job_queue) != 0) {
+		if (!create_worker(&conf, i, &backup_threads[i], backup_thread_func, job_queue)) {
 			err_code("Error while creating validation thread");
 			goto cleanup9;
 		}
@@ -2515,14 +6468,98 @@ cleanup9:
 		}
 	}
 
+cleanup10:
+	if (n_validation_ok > 0) {
+		if (verbose) {
+			ver("Waiting for %u validation pool thread(s)", n_validation_ok);
+		}
+
+		queued_record exit_marker = { NULL, NULL, 0 };
+
+		for (uint32_t i = 0; i < n_validation_ok; ++i) {
+			if (cf_queue_push(conf.record_queue, &exit_marker) != CF_QUEUE_OK) {
+				err("Error while queueing exit marker; exiting");
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		for (uint32_t i = 0; i < n_validation_ok; ++i) {
+			void *pool_res;
+
+			if (safe_join(validation_threads[i], &pool_res) != 0) {
+				err_code("Error while joining validation pool thread");
+				stop = true;
+				res = EXIT_FAILURE;
+			} else if (pool_res != (void *)EXIT_SUCCESS) {
+				if (verbose) {
+					ver("Validation pool thread failed");
+				}
+
+				res = EXIT_FAILURE;
+			}
+		}
+	}
+
+	if (conf.record_queue != NULL) {
+		// the metrics endpoint may be looking at the queue
+		safe_lock();
+		cf_queue_destroy(conf.record_queue);
+		conf.record_queue = NULL;
+		safe_unlock();
+	}
+
+	if (conf.rotate_queue != NULL) {
+		if (verbose) {
+			ver("Waiting for rotation thread");
+		}
+
+		rotate_job exit_marker = { NULL, 0, NULL, NULL, 0, NULL, NULL };
+
+		if (cf_queue_push(conf.rotate_queue, &exit_marker) != CF_QUEUE_OK) {
+			err("Error while queueing exit marker; exiting");
+			exit(EXIT_FAILURE);
+		}
+
+		void *rotate_res;
+
+		if (safe_join(rotate_thread, &rotate_res) != 0) {
+			err_code("Error while joining rotation thread");
+			stop = true;
+			res = EXIT_FAILURE;
+		} else if (rotate_res != (void *)EXIT_SUCCESS) {
+			if (verbose) {
+				ver("Rotation thread failed");
+			}
+
+			res = EXIT_FAILURE;
+		}
+
+		cf_queue_destroy(conf.rotate_queue);
+		conf.rotate_queue = NULL;
+	}
+
 cleanup8:
 	if (conf.output_file != NULL && !close_file(&backup_args.shared_fd, &fd_buf)) {
 		err("Error while closing shared output file");
 		res = EXIT_FAILURE;
 	}
 
+	// only a complete, successful run may advance the watermark
+	if (res == EXIT_SUCCESS && conf.state_file != NULL) {
+		if (conf.sample < 100 || conf.node_list != NULL || conf.mod_before > 0 ||
+				after_watermark) {
+			inf("Partial validation, not updating state file %s", conf.state_file);
+		} else if (!write_state_file(conf.state_file, state_ns, state_set, state_nanos)) {
+			err("Error while updating state file %s", conf.state_file);
+			res = EXIT_FAILURE;
+		}
+	}
+
 cleanup7:
+	safe_lock();
 	cf_queue_destroy(job_queue);
+	conf.job_queue = NULL;
+	safe_unlock();
 
 cleanup6:
 	stop = true;
@@ -2536,7 +6573,14 @@ cleanup6:
 		res = EXIT_FAILURE;
 	}
 
+cleanup11:
+	metrics_stop(&metrics);
+
 cleanup5:
+	if (conf.node_metrics != NULL) {
+		cf_free(conf.node_metrics);
+	}
+
 	if (node_names != NULL) {
 		cf_free(node_names);
 	}
@@ -2557,6 +6601,22 @@ cleanup2:
 	}
 
 cleanup1:
+	as_vector_destroy(&conf.dry_run_sets);
+	free_verdict_cache(&conf);
+
+	if (conf.numa_topo != NULL) {
+		cf_free(conf.numa_topo);
+	}
+	free_targets(&conf);
+
+	if (conf.ns_list != NULL) {
+		cf_free(conf.ns_list);
+	}
+
+	if (conf.set_list != NULL) {
+		cf_free(conf.set_list);
+	}
+
 	if (conf.node_list != NULL) {
 		cf_free(conf.node_list);
 	}
@@ -2597,12 +6657,19 @@ cleanup1:
 		cf_free(conf.tls.certfile);
 	}
 
+	if (conf.fix_bins != NULL) {
+		cf_free(conf.fix_bins);
+	}
+
 	as_scan_destroy(&scan);
 
+	report_interrupt();
+
 	if (verbose) {
 		ver("Exiting with status code %d", res);
 	}
 
+	log_stop();
 	return res;
 }
 
@@ -2618,6 +6685,7 @@ config_default(backup_config *conf)
 
 	conf->remove_files = false;
 	conf->bin_list = NULL;
+	conf->fix_bins = NULL;
 	conf->node_list = NULL;
 	conf->mod_after = 0;
 	conf->mod_before = 0;
@@ -2628,6 +6696,42 @@ config_default(backup_config *conf)
 	conf->machine = NULL;
 	conf->bandwidth = 0;
 	conf->file_limit = DEFAULT_FILE_LIMIT * 1024 * 1024;
+	conf->sample = 100;
+	conf->state_file = NULL;
+	conf->validation_threads = 0;
+	conf->queue_memory = DEFAULT_QUEUE_MEMORY * 1024 * 1024;
+	conf->record_queue = NULL;
+	cf_atomic64_set(&conf->queue_bytes, 0);
+	conf->cdt_fix_dry_run = false;
+	conf->map_fix = 0;
+	conf->metrics = NULL;
+	conf->profile = false;
+	conf->phase_timing = false;
+	conf->adaptive = false;
+	conf->scan_limit = 0;
+	conf->active_scans = 0;
+	conf->max_scans = 0;
+	conf->ns_list = NULL;
+	conf->set_list = NULL;
+	conf->targets = NULL;
+	conf->n_targets = 0;
+	conf->rotate_queue = NULL;
+	conf->uring = false;
+	conf->numa = false;
+	conf->numa_topo = NULL;
+	conf->index_interval = 0;
+	conf->recheck = NULL;
+	conf->recheck_batch = DEFAULT_RECHECK_BATCH;
+	conf->verdict_entries = 0;
+	conf->verdict_cache = NULL;
+	conf->first_scan_ms = 0;
+	conf->last_scan_ms = 0;
+	conf->scan_busy_ms = 0;
+	conf->longest_scan_ms = 0;
+	conf->node_metrics = NULL;
+	conf->n_node_metrics = 0;
+	conf->job_queue = NULL;
+	as_vector_init(&conf->dry_run_sets, sizeof(dry_run_stats), 16);
 
 	memset(&conf->tls, 0, sizeof(as_config_tls));
 }
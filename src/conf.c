@@ -549,7 +549,6 @@ config_backup(toml_table_t *conftab, backup_config *c, const char *instance,
 	const char *name;
 	const char *value;
 
-	char *s;
 	int64_t i_val;
 
 	for (uint8_t k = 0; 0 != (name = toml_key_in(curtab, k)); k++) {
@@ -561,19 +560,10 @@ config_backup(toml_table_t *conftab, backup_config *c, const char *instance,
 		bool status;
 
 		if (! strcasecmp("namespace", name)) {
-			status = config_str(curtab, name, (void*)&s);
-			if (status) {
-				as_strncpy(c->scan->ns, s, AS_NAMESPACE_MAX_SIZE);
-				free(s);
-			}
+			status = config_str(curtab, name, (void*)&c->ns_list);
 
 		} else if (! strcasecmp("set", name)) {
-
-			status = config_str(curtab, name, (void*)&s);
-			if (status) {
-				as_strncpy(c->scan->set, s, AS_SET_MAX_SIZE);
-				free(s);
-			}
+			status = config_str(curtab, name, (void*)&c->set_list);
 
 		} else if (! strcasecmp("directory", name)) {
 			status = config_str(curtab, name, (void*)&c->directory);
@@ -594,6 +584,72 @@ config_backup(toml_table_t *conftab, backup_config *c, const char *instance,
 
 			status = config_int(curtab, name, (void*)&c->policy->records_per_second);
 
+		} else if (! strcasecmp("validation-threads", name)) {
+			status = config_int(curtab, name, (void*)&i_val);
+			if (i_val >= 0 && i_val <= MAX_VALIDATION_THREADS) {
+				c->validation_threads = (uint32_t)i_val;
+			} else {
+				status = false;
+			}
+
+		} else if (! strcasecmp("queue-memory", name)) {
+			status = config_int(curtab, name, (void*)&i_val);
+			if (i_val >= 1) {
+				c->queue_memory = (uint64_t)i_val * 1024 * 1024;
+			} else {
+				status = false;
+			}
+
+		} else if (! strcasecmp("offset-index", name)) {
+			status = config_int(curtab, name, (void*)&i_val);
+			if (i_val >= 0 && i_val <= MAX_INDEX_INTERVAL) {
+				c->index_interval = (uint32_t)i_val;
+			} else {
+				status = false;
+			}
+
+		} else if (! strcasecmp("recheck-batch", name)) {
+			status = config_int(curtab, name, (void*)&i_val);
+			if (i_val >= 1 && i_val <= MAX_RECHECK_BATCH) {
+				c->recheck_batch = (uint32_t)i_val;
+			} else {
+				status = false;
+			}
+
+		} else if (! strcasecmp("verdict-cache", name)) {
+			status = config_int(curtab, name, (void*)&i_val);
+			if (i_val >= 0 && i_val <= MAX_VERDICT_ENTRIES) {
+				c->verdict_entries = (uint32_t)i_val;
+			} else {
+				status = false;
+			}
+
+		} else if (! strcasecmp("state-file", name)) {
+			status = config_str(curtab, name, (void*)&c->state_file);
+
+		} else if (! strcasecmp("metrics", name)) {
+			status = config_str(curtab, name, (void*)&c->metrics);
+
+		} else if (! strcasecmp("io-uring", name)) {
+			status = config_bool(curtab, name, (void*)&c->uring);
+
+		} else if (! strcasecmp("numa", name)) {
+			status = config_bool(curtab, name, (void*)&c->numa);
+
+		} else if (! strcasecmp("profile", name)) {
+			status = config_bool(curtab, name, (void*)&c->profile);
+
+		} else if (! strcasecmp("adaptive-parallel", name)) {
+			status = config_bool(curtab, name, (void*)&c->adaptive);
+
+		} else if (! strcasecmp("sample", name)) {
+			status = config_int(curtab, name, (void*)&i_val);
+			if (i_val >= 1 && i_val <= 100) {
+				c->sample = (uint32_t)i_val;
+			} else {
+				status = false;
+			}
+
 		} else if (! strcasecmp("no-bins", name)) {
 			status = config_bool(curtab, name, (void*)&c->scan->no_bins);
 
@@ -727,6 +783,14 @@ config_restore(toml_table_t *conftab, restore_config *c, const char *instance,
 				status = false;
 			}
 
+		} else if (! strcasecmp("max-async", name)) {
+			status = config_int(curtab, name, (void*)&i_val);
+			if (i_val >= 0 && i_val <= MAX_ASYNC) {
+				c->max_async = (uint32_t)i_val;
+			} else {
+				status = false;
+			}
+
 		} else {
 			fprintf(stderr, "Unknown parameter `%s` in `%s` section\n", name,
 					asrestore);
@@ -303,6 +303,35 @@ text_read_double(FILE *fd, uint32_t *line_no, uint32_t *col_no, int64_t *bytes,
 	return true;
 }
 
+///
+/// Allocates memory for a value, either from the given value arena or from the heap.
+///
+/// @param arena  The value arena. `NULL` to allocate from the heap.
+/// @param size   The number of bytes to allocate.
+///
+/// @result       The allocated memory.
+///
+static inline void *
+text_alloc(value_arena *arena, size_t size)
+{
+	return arena != NULL ? value_arena_alloc(arena, size) : safe_malloc(size);
+}
+
+///
+/// Frees memory allocated by text_alloc(). A no-op for memory from a value arena, which is
+/// released when the arena is reset.
+///
+/// @param arena   The value arena. `NULL`, if the memory came from the heap.
+/// @param buffer  The memory to be freed.
+///
+static inline void
+text_free(value_arena *arena, void *buffer)
+{
+	if (arena == NULL) {
+		cf_free(buffer);
+	}
+}
+
 ///
 /// Reads and parses a string from the backup file.
 ///
@@ -316,12 +345,13 @@ text_read_double(FILE *fd, uint32_t *line_no, uint32_t *col_no, int64_t *bytes,
 /// @param buffer   The buffer allocated for the string.
 /// @param size     The size of the string.
 /// @param extra    The amount of extra memory to allocate.
+/// @param arena    The value arena to allocate from. `NULL` to allocate from the heap.
 ///
 /// @result         `true`, if successful.
 ///
 static bool
 text_parse_string(FILE *fd, uint32_t *line_no, uint32_t *col_no, int64_t *bytes,
-		void **buffer, size_t *size, size_t extra)
+		void **buffer, size_t *size, size_t extra, value_arena *arena)
 {
 	if (!text_read_size(fd, line_no, col_no, bytes, size, " ")) {
 		err("Error while reading string size");
@@ -332,11 +362,11 @@ text_parse_string(FILE *fd, uint32_t *line_no, uint32_t *col_no, int64_t *bytes,
 		return false;
 	}
 
-	*buffer = safe_malloc(*size + extra);
+	*buffer = text_alloc(arena, *size + extra);
 
 	if (!read_block(fd, line_no, col_no, bytes, *buffer, *size)) {
 		err("Error while reading string data");
-		cf_free(*buffer);
+		text_free(arena, *buffer);
 		return false;
 	}
 
@@ -353,12 +383,13 @@ text_parse_string(FILE *fd, uint32_t *line_no, uint32_t *col_no, int64_t *bytes,
 /// @param buffer   The buffer allocated for the BLOB.
 /// @param size     The size of the BLOB.
 /// @param extra    The amount of extra memory to allocate.
+/// @param arena    The value arena to allocate from. `NULL` to allocate from the heap.
 ///
 /// @result         `true`, if successful.
 ///
 static bool
 text_parse_data(FILE *fd, uint32_t *line_no, uint32_t *col_no, int64_t *bytes,
-		void **buffer, size_t *size, size_t extra)
+		void **buffer, size_t *size, size_t extra, value_arena *arena)
 {
 	if (!text_read_size(fd, line_no, col_no, bytes, size, " ")) {
 		err("Error while reading data size");
@@ -369,11 +400,11 @@ text_parse_data(FILE *fd, uint32_t *line_no, uint32_t *col_no, int64_t *bytes,
 		return false;
 	}
 
-	*buffer = safe_malloc(*size + extra);
+	*buffer = text_alloc(arena, *size + extra);
 
 	if (!read_block(fd, line_no, col_no, bytes, *buffer, *size)) {
 		err("Error while reading data");
-		cf_free(*buffer);
+		text_free(arena, *buffer);
 		return false;
 	}
 
@@ -390,12 +421,13 @@ text_parse_data(FILE *fd, uint32_t *line_no, uint32_t *col_no, int64_t *bytes,
 /// @param buffer   The buffer allocated for the string.
 /// @param size     The size of the string.
 /// @param extra    The amount of extra memory to allocate.
+/// @param arena    The value arena to allocate from. `NULL` to allocate from the heap.
 ///
 /// @result         `true`, if successful.
 ///
 static bool
 text_parse_data_dec(FILE *fd, uint32_t *line_no, uint32_t *col_no, int64_t *bytes,
-		void **buffer, size_t *size, size_t extra)
+		void **buffer, size_t *size, size_t extra, value_arena *arena)
 {
 	size_t enc_size;
 
@@ -417,18 +449,18 @@ text_parse_data_dec(FILE *fd, uint32_t *line_no, uint32_t *col_no, int64_t *byte
 	b64_context b64_cont = { 0, 9999, { 99, 99 }};
 	// over-estimates the decoded size by up to 2 bytes (includes the padding)
 	size_t dec_size = enc_size / 4 * 3;
-	*buffer = safe_malloc(dec_size + extra);
+	*buffer = text_alloc(arena, dec_size + extra);
 
 	if (!read_block_dec(fd, line_no, col_no, bytes, *buffer, dec_size, &b64_cont)) {
 		err("Error while reading encoded data");
-		cf_free(*buffer);
+		text_free(arena, *buffer);
 		return false;
 	}
 
 	if ((size_t)(*bytes - orig_bytes) != enc_size) {
 		err("Encoded data size mismatch: %zu vs. %" PRId64 " (line %u, col %u)", enc_size,
 				*bytes - orig_bytes, line_no[0], col_no[0]);
-		cf_free(*buffer);
+		text_free(arena, *buffer);
 		return false;
 	}
 
@@ -445,12 +477,13 @@ text_parse_data_dec(FILE *fd, uint32_t *line_no, uint32_t *col_no, int64_t *byte
 /// @param col_no   The current column number.
 /// @param bytes    Increased by the number of bytes read from the file descriptor.
 /// @param rec      The record to receive the key value.
+/// @param arena    The value arena for the key value. `NULL` to allocate from the heap.
 ///
 /// @result         `true`, if successful.
 ///
 static bool
 text_parse_key(FILE *fd, uint32_t *line_no, uint32_t *col_no, int64_t *bytes,
-		as_record *rec)
+		as_record *rec, value_arena *arena)
 {
 	int32_t ch = read_char(fd, line_no, col_no, bytes);
 
@@ -508,22 +541,22 @@ text_parse_key(FILE *fd, uint32_t *line_no, uint32_t *col_no, int64_t *bytes,
 		}
 
 		if (ch == 'S' && !text_parse_string(fd, line_no, col_no, bytes,
-				&buffer, &size, 1)) {
+				&buffer, &size, 1, arena)) {
 			err("Error while reading string key value");
 			return false;
 		}
 
 		if (ch == 'X' && !text_parse_data_dec(fd, line_no, col_no, bytes,
-				&buffer, &size, 1)) {
+				&buffer, &size, 1, arena)) {
 			err("Error while reading encoded string key value");
 			return false;
 		}
 
 		((char *)buffer)[size] = 0;
 
-		if (as_string_init_wlen(&rec->key.value.string, buffer, size, true) == NULL) {
+		if (as_string_init_wlen(&rec->key.value.string, buffer, size, arena == NULL) == NULL) {
 			err("Error while initializing string key value");
-			cf_free(buffer);
+			text_free(arena, buffer);
 			return false;
 		}
 
@@ -546,13 +579,13 @@ text_parse_key(FILE *fd, uint32_t *line_no, uint32_t *col_no, int64_t *bytes,
 		}
 
 		if (compact &&
-				!text_parse_data(fd, line_no, col_no, bytes, &buffer, &size, 0)) {
+				!text_parse_data(fd, line_no, col_no, bytes, &buffer, &size, 0, arena)) {
 			err("Error while reading key bytes");
 			return false;
 		}
 
 		if (!compact && !text_parse_data_dec(fd, line_no, col_no, bytes,
-				&buffer, &size, 0)) {
+				&buffer, &size, 0, arena)) {
 			err("Error while reading encoded key bytes");
 			return false;
 		}
@@ -562,7 +595,8 @@ text_parse_key(FILE *fd, uint32_t *line_no, uint32_t *col_no, int64_t *bytes,
 			return false;
 		}
 
-		if (as_bytes_init_wrap(&rec->key.value.bytes, buffer, (uint32_t)size, true) == NULL) {
+		if (as_bytes_init_wrap(&rec->key.value.bytes, buffer, (uint32_t)size,
+				arena == NULL) == NULL) {
 			err("Error while initializing key bytes");
 			return false;
 		}
@@ -789,12 +823,13 @@ text_bytes_label_to_type(int32_t label, as_bytes_type *type)
 /// @param col_no   The current column number.
 /// @param bytes    Increased by the number of bytes read from the file descriptor.
 /// @param rec      The record to receive the bin.
+/// @param arena    The value arena for the bin value. `NULL` to allocate from the heap.
 ///
 /// @result         `true`, if successful.
 ///
 static bool
 text_parse_bin(FILE *fd, as_vector *bin_vec, uint32_t *line_no, uint32_t *col_no,
-		int64_t *bytes, as_record *rec)
+		int64_t *bytes, as_record *rec, value_arena *arena)
 {
 	if (!expect_char(fd, line_no, col_no, bytes, '-') ||
 			!expect_char(fd, line_no, col_no, bytes, ' ')) {
@@ -910,13 +945,13 @@ text_parse_bin(FILE *fd, as_vector *bin_vec, uint32_t *line_no, uint32_t *col_no
 		size_t size;
 
 		if (ch == 'S' && !text_parse_string(fd, line_no, col_no, bytes,
-				&buffer, &size, 1)) {
+				&buffer, &size, 1, arena)) {
 			err("Error while reading string bin value");
 			return false;
 		}
 
 		if (ch == 'X' && !text_parse_data_dec(fd, line_no, col_no, bytes,
-				&buffer, &size, 1)) {
+				&buffer, &size, 1, arena)) {
 			err("Error while reading encoded string bin value");
 			return false;
 		}
@@ -926,16 +961,19 @@ text_parse_bin(FILE *fd, as_vector *bin_vec, uint32_t *line_no, uint32_t *col_no
 		}
 
 		if (!match) {
-			cf_free(buffer);
+			text_free(arena, buffer);
 			return true;
 		}
 
 		((char *)buffer)[size] = 0;
-		as_string *string = as_string_new_wlen(buffer, size, true);
+		as_string *string = arena != NULL ?
+				as_string_init_wlen(value_arena_alloc(arena, sizeof (as_string)), buffer, size,
+						false) :
+				as_string_new_wlen(buffer, size, true);
 
 		if (string == NULL) {
 			err("Error while allocating string bin value");
-			cf_free(buffer);
+			text_free(arena, buffer);
 			return false;
 		}
 
@@ -943,7 +981,7 @@ text_parse_bin(FILE *fd, as_vector *bin_vec, uint32_t *line_no, uint32_t *col_no
 			err("Error while setting string bin %s to %s (line %u, col %u)", name, (char *)buffer,
 					line_no[0], col_no[0]);
 			as_string_destroy(string);
-			cf_free(buffer);
+			text_free(arena, buffer);
 			return false;
 		}
 
@@ -954,7 +992,7 @@ text_parse_bin(FILE *fd, as_vector *bin_vec, uint32_t *line_no, uint32_t *col_no
 		void *buffer;
 		size_t size;
 
-		if (!text_parse_string(fd, line_no, col_no, bytes, &buffer, &size, 1)) {
+		if (!text_parse_string(fd, line_no, col_no, bytes, &buffer, &size, 1, arena)) {
 			err("Error while reading geojson bin value");
 			return false;
 		}
@@ -964,16 +1002,19 @@ text_parse_bin(FILE *fd, as_vector *bin_vec, uint32_t *line_no, uint32_t *col_no
 		}
 
 		if (!match) {
-			cf_free(buffer);
+			text_free(arena, buffer);
 			return true;
 		}
 
 		((char *)buffer)[size] = 0;
-		as_geojson *geojson = as_geojson_new_wlen(buffer, size, true);
+		as_geojson *geojson = arena != NULL ?
+				as_geojson_init_wlen(value_arena_alloc(arena, sizeof (as_geojson)), buffer, size,
+						false) :
+				as_geojson_new_wlen(buffer, size, true);
 
 		if (geojson == NULL) {
 			err("Error while allocating geojson bin value");
-			cf_free(buffer);
+			text_free(arena, buffer);
 			return false;
 		}
 
@@ -981,7 +1022,7 @@ text_parse_bin(FILE *fd, as_vector *bin_vec, uint32_t *line_no, uint32_t *col_no
 			err("Error while setting geojson bin %s to %s (line %u, col %u)", name, (char *)buffer,
 					line_no[0], col_no[0]);
 			as_geojson_destroy(geojson);
-			cf_free(buffer);
+			text_free(arena, buffer);
 			return false;
 		}
 
@@ -998,12 +1039,13 @@ text_parse_bin(FILE *fd, as_vector *bin_vec, uint32_t *line_no, uint32_t *col_no
 		return false;
 	}
 
-	if (compact && !text_parse_data(fd, line_no, col_no, bytes, &buffer, &size, 0)) {
+	if (compact && !text_parse_data(fd, line_no, col_no, bytes, &buffer, &size, 0, arena)) {
 		err("Error while reading data bin value");
 		return false;
 	}
 
-	if (!compact && !text_parse_data_dec(fd, line_no, col_no, bytes, &buffer, &size, 0)) {
+	if (!compact && !text_parse_data_dec(fd, line_no, col_no, bytes, &buffer, &size, 0,
+			arena)) {
 		err("Error while reading encoded data bin value");
 		return false;
 	}
@@ -1018,11 +1060,12 @@ text_parse_bin(FILE *fd, as_vector *bin_vec, uint32_t *line_no, uint32_t *col_no
 	}
 
 	if (!match) {
-		cf_free(buffer);
+		text_free(arena, buffer);
 		return true;
 	}
 
-	if (!as_record_set_raw_typep(rec, name, buffer, (uint32_t)size, type, true)) {
+	if (!as_record_set_raw_typep(rec, name, buffer, (uint32_t)size, type,
+			arena == NULL)) {
 		err("Error while setting encoded data bin %s (line %u, col %u)", name, line_no[0],
 				col_no[0]);
 		return false;
@@ -1040,12 +1083,13 @@ text_parse_bin(FILE *fd, as_vector *bin_vec, uint32_t *line_no, uint32_t *col_no
 /// @param col_no   The current column number.
 /// @param bytes    Increased by the number of bytes read from the file descriptor.
 /// @param rec      The record to receive the bins.
+/// @param arena    The value arena for the bin values. `NULL` to allocate from the heap.
 ///
 /// @result         `true`, if successful.
 ///
 static bool
 text_parse_bins(FILE *fd, as_vector *bin_vec, uint32_t *line_no, uint32_t *col_no,
-		int64_t *bytes, as_record *rec)
+		int64_t *bytes, as_record *rec, value_arena *arena)
 {
 	int64_t val;
 
@@ -1072,7 +1116,7 @@ text_parse_bins(FILE *fd, as_vector *bin_vec, uint32_t *line_no, uint32_t *col_n
 	}
 
 	for (uint32_t i = 0; i < n_bins; ++i) {
-		if (!text_parse_bin(fd, bin_vec, line_no, col_no, bytes, rec)) {
+		if (!text_parse_bin(fd, bin_vec, line_no, col_no, bytes, rec, arena)) {
 			return false;
 		}
 	}
@@ -1080,6 +1124,34 @@ text_parse_bins(FILE *fd, as_vector *bin_vec, uint32_t *line_no, uint32_t *col_n
 	return true;
 }
 
+///
+/// Prepares a record that was returned by a previous text_parse() call for the next record.
+/// Keeps the record's bin array and releases its values at once by resetting the value arena.
+///
+/// @param rec    The record.
+/// @param arena  The value arena that holds the record's values.
+///
+static void
+text_recycle_record(as_record *rec, value_arena *arena)
+{
+	// the values come from the arena, so this only runs their (non-freeing) destructors
+	for (uint16_t i = 0; i < rec->bins.size; ++i) {
+		as_val_destroy((as_val *)rec->bins.entries[i].valuep);
+	}
+
+	as_key_destroy(&rec->key);
+
+	as_bin *entries = rec->bins.entries;
+	uint16_t capacity = rec->bins.capacity;
+
+	as_record_init(rec, 0);
+	rec->bins.entries = entries;
+	rec->bins.capacity = capacity;
+	rec->bins._free = true;
+
+	value_arena_reset(arena);
+}
+
 ///
 /// Reads and parses a record from the backup file.
 ///
@@ -1089,14 +1161,16 @@ text_parse_bins(FILE *fd, as_vector *bin_vec, uint32_t *line_no, uint32_t *col_n
 /// @param line_no  The current line number.
 /// @param col_no   The current column number.
 /// @param bytes    Increased by the number of bytes read from the file descriptor.
-/// @param rec      The record to be populated.
+/// @param rec      The record to be populated. With a value arena, a record that was initialized
+///                 by the caller and is reused across calls.
 /// @param expired  Indicates that the record is expired.
+/// @param arena    The value arena for the record's values. `NULL` to allocate from the heap.
 ///
 /// @result         See @ref decoder_status.
 ///
 static decoder_status
 text_parse_record(FILE *fd, as_vector *ns_vec, as_vector *bin_vec, uint32_t *line_no,
-		uint32_t *col_no, int64_t *bytes, as_record *rec, bool *expired)
+		uint32_t *col_no, int64_t *bytes, as_record *rec, bool *expired, value_arena *arena)
 {
 	decoder_status res = DECODER_ERROR;
 	bool tmp_expired = false;
@@ -1107,7 +1181,12 @@ text_parse_record(FILE *fd, as_vector *ns_vec, as_vector *bin_vec, uint32_t *lin
 	}
 
 	static char EXPECTED[8] = "kndsgtb";
-	as_record_init(rec, 100);
+
+	if (arena != NULL) {
+		text_recycle_record(rec, arena);
+	} else {
+		as_record_init(rec, 100);
+	}
 
 	for (uint32_t i = 0; i < 7; ++i) {
 		if (!expect_char(fd, line_no, col_no, bytes, ' ')) {
@@ -1139,7 +1218,7 @@ text_parse_record(FILE *fd, as_vector *ns_vec, as_vector *bin_vec, uint32_t *lin
 
 		switch (i) {
 		case 0:
-			ok = text_parse_key(fd, line_no, col_no, bytes, rec);
+			ok = text_parse_key(fd, line_no, col_no, bytes, rec, arena);
 			break;
 
 		case 1:
@@ -1163,7 +1242,7 @@ text_parse_record(FILE *fd, as_vector *ns_vec, as_vector *bin_vec, uint32_t *lin
 			break;
 
 		case 6:
-			ok = text_parse_bins(fd, bin_vec, line_no, col_no, bytes, rec);
+			ok = text_parse_bins(fd, bin_vec, line_no, col_no, bytes, rec, arena);
 			break;
 		}
 
@@ -1184,7 +1263,10 @@ text_parse_record(FILE *fd, as_vector *ns_vec, as_vector *bin_vec, uint32_t *lin
 	goto cleanup0;
 
 cleanup1:
-	as_record_destroy(rec);
+	// a reused record stays with the caller, who destroys it
+	if (arena == NULL) {
+		as_record_destroy(rec);
+	}
 
 cleanup0:
 	return res;
@@ -1226,7 +1308,7 @@ text_parse_global(FILE *fd, uint32_t *line_no, uint32_t *col_no, int64_t *bytes)
 ///
 decoder_status
 text_parse(FILE *fd, as_vector *ns_vec, as_vector *bin_vec, uint32_t *orig_line_no,
-		cf_atomic64 *total, as_record *rec, bool *expired)
+		cf_atomic64 *total, as_record *rec, bool *expired, value_arena *arena)
 {
 	decoder_status res = DECODER_ERROR;
 	int64_t bytes = 0;
@@ -1259,7 +1341,7 @@ text_parse(FILE *fd, as_vector *ns_vec, as_vector *bin_vec, uint32_t *orig_line_
 
 	if (ch == RECORD_META_PREFIX[0]) {
 		res = text_parse_record(fd, ns_vec, bin_vec, line_no, col_no, &bytes, rec,
-				expired);
+				expired, arena);
 		goto out;
 	}
 
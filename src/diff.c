@@ -0,0 +1,512 @@
+/*
+ * Aerospike Validation Run Diff
+ *
+ * Copyright (c) 2008-2017 Aerospike, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <diff.h>
+
+static const char *kind_names[DIFF_N_KINDS] = {
+	"new", "still", "repaired"
+};
+
+///
+/// Orders records by namespace and digest.
+///
+/// @param ns1      The namespace of the first record.
+/// @param digest1  The digest of the first record.
+/// @param ns2      The namespace of the second record.
+/// @param digest2  The digest of the second record.
+///
+/// @result         Negative, zero, or positive, like `memcmp()`.
+///
+static int32_t
+compare_key(const char *ns1, const uint8_t *digest1, const char *ns2, const uint8_t *digest2)
+{
+	int32_t res = strcmp(ns1, ns2);
+	return res != 0 ? res : memcmp(digest1, digest2, AS_DIGEST_VALUE_SIZE);
+}
+
+///
+/// Orders streams by their current records.
+///
+/// @param s1  The first stream.
+/// @param s2  The second stream.
+///
+/// @result    Negative, zero, or positive, like `memcmp()`.
+///
+static inline int32_t
+compare_stream(const diff_stream *s1, const diff_stream *s2)
+{
+	return compare_key(s1->ns, s1->cur.digest, s2->ns, s2->cur.digest);
+}
+
+///
+/// Restores the min-heap property of a run's stream heap below the given position.
+///
+/// @param run  The validation run.
+/// @param pos  The position.
+///
+static void
+heap_down(diff_run *run, uint32_t pos)
+{
+	while (true) {
+		uint32_t min = pos;
+		uint32_t left = 2 * pos + 1;
+		uint32_t right = left + 1;
+
+		if (left < run->heap_size && compare_stream(run->heap[left], run->heap[min]) < 0) {
+			min = left;
+		}
+
+		if (right < run->heap_size && compare_stream(run->heap[right], run->heap[min]) < 0) {
+			min = right;
+		}
+
+		if (min == pos) {
+			return;
+		}
+
+		diff_stream *tmp = run->heap[pos];
+		run->heap[pos] = run->heap[min];
+		run->heap[min] = tmp;
+		pos = min;
+	}
+}
+
+///
+/// Reads the next block of records of a stream from its offset index. Unless the stream keeps
+/// its offset index open, the index is reopened for this and closed again.
+///
+/// @param stream  The stream. Must have records left.
+///
+/// @result        `true`, if successful.
+///
+static bool
+stream_fill(diff_stream *stream)
+{
+	index_reader *ir = &stream->reader;
+
+	if (ir->fd == NULL && !index_reopen(ir, stream->path)) {
+		return false;
+	}
+
+	uint64_t left = ir->n_entries - ir->next;
+	uint32_t n = left < DIFF_BLOCK ? (uint32_t)left : DIFF_BLOCK;
+
+	for (uint32_t i = 0; i < n; ++i) {
+		if (!index_next(ir, &stream->block[i])) {
+			return false;
+		}
+	}
+
+	stream->block_size = n;
+	stream->block_pos = 0;
+
+	if (!stream->keep_open || ir->next == ir->n_entries) {
+		index_close(ir);
+	}
+
+	return true;
+}
+
+///
+/// Moves a stream to its next record.
+///
+/// @param stream  The stream.
+/// @param has     Returns whether the stream had a next record.
+///
+/// @result        `true`, if successful.
+///
+static bool
+stream_next(diff_stream *stream, bool *has)
+{
+	if (stream->block_pos == stream->block_size) {
+		if (stream->reader.next == stream->reader.n_entries) {
+			*has = false;
+			return true;
+		}
+
+		if (!stream_fill(stream)) {
+			return false;
+		}
+	}
+
+	stream->cur = stream->block[stream->block_pos++];
+	*has = true;
+	return true;
+}
+
+///
+/// Frees the resources held by a run's streams and heap.
+///
+/// @param run  The validation run. May be partially opened.
+///
+static void
+run_close(diff_run *run)
+{
+	for (uint32_t i = 0; i < run->n_streams; ++i) {
+		index_close(&run->streams[i].reader);
+		cf_free(run->streams[i].path);
+	}
+
+	cf_free(run->streams);
+	cf_free(run->heap);
+	run->streams = NULL;
+	run->heap = NULL;
+	run->n_streams = 0;
+	run->heap_size = 0;
+}
+
+///
+/// Opens the offset indexes of a run's output files and merges them into a single stream of
+/// records in namespace and digest order.
+///
+/// @param run       The validation run to be initialized.
+/// @param name      The run's output directory or output file.
+/// @param max_open  The number of offset indexes that may stay open between reads. The other
+///                  ones get reopened for each block of records.
+///
+/// @result          `true`, if successful.
+///
+static bool
+run_open(diff_run *run, const char *name, uint32_t max_open)
+{
+	memset(run, 0, sizeof (diff_run));
+	run->name = name;
+
+	as_vector paths;
+	as_vector_init(&paths, sizeof (char *), 64);
+
+	if (!index_backup_files(name, &paths)) {
+		goto cleanup1;
+	}
+
+	if (paths.size == 0) {
+		err("No output files in %s", name);
+		goto cleanup1;
+	}
+
+	run->streams = safe_malloc(paths.size * sizeof (diff_stream));
+	run->heap = safe_malloc(paths.size * sizeof (diff_stream *));
+	memset(run->streams, 0, paths.size * sizeof (diff_stream));
+
+	for (uint32_t i = 0; i < paths.size; ++i) {
+		diff_stream *stream = &run->streams[i];
+		stream->path = *(char **)as_vector_get(&paths, i);
+		stream->keep_open = i < max_open;
+		++run->n_streams;
+
+		if (!index_namespace(stream->path, stream->ns, sizeof stream->ns)) {
+			goto cleanup2;
+		}
+
+		if (!index_open(&stream->reader, stream->path)) {
+			err("Output file %s has no offset index, see --offset-index", stream->path);
+			goto cleanup2;
+		}
+
+		bool has;
+
+		if (!stream_next(stream, &has)) {
+			goto cleanup2;
+		}
+
+		if (has) {
+			run->heap[run->heap_size++] = stream;
+		}
+	}
+
+	for (uint32_t i = run->heap_size / 2; i > 0; --i) {
+		heap_down(run, i - 1);
+	}
+
+	as_vector_destroy(&paths);
+	return true;
+
+cleanup2:
+	// the streams own the paths that they took
+	for (uint32_t i = run->n_streams; i < paths.size; ++i) {
+		cf_free(*(char **)as_vector_get(&paths, i));
+	}
+
+	run_close(run);
+	as_vector_destroy(&paths);
+	return false;
+
+cleanup1:
+	for (uint32_t i = 0; i < paths.size; ++i) {
+		cf_free(*(char **)as_vector_get(&paths, i));
+	}
+
+	as_vector_destroy(&paths);
+	return false;
+}
+
+///
+/// Returns a run's next record in namespace and digest order. A record that the run found more
+/// than once, e.g., because it migrated during the run, is only returned once.
+///
+/// @param run  The validation run.
+/// @param rec  Returns the record.
+/// @param has  Returns whether there was a next record.
+///
+/// @result     `true`, if successful.
+///
+static bool
+run_next(diff_run *run, diff_record *rec, bool *has)
+{
+	while (run->heap_size > 0) {
+		diff_stream *top = run->heap[0];
+		rec->stream = top;
+		rec->entry = top->cur;
+
+		bool more;
+
+		if (!stream_next(top, &more)) {
+			return false;
+		}
+
+		if (!more) {
+			run->heap[0] = run->heap[--run->heap_size];
+		}
+
+		heap_down(run, 0);
+
+		if (run->prev_ns != NULL && compare_key(run->prev_ns, run->prev_digest,
+				rec->stream->ns, rec->entry.digest) == 0) {
+			continue;
+		}
+
+		run->prev_ns = rec->stream->ns;
+		memcpy(run->prev_digest, rec->entry.digest, AS_DIGEST_VALUE_SIZE);
+		++run->n_records;
+		*has = true;
+		return true;
+	}
+
+	*has = false;
+	return true;
+}
+
+///
+/// Prints a record of the given kind to stdout: the kind, the namespace, the base-64 encoded
+/// digest, and where to find the record.
+///
+/// @param kind  The kind.
+/// @param rec   The record.
+///
+static void
+print_record(diff_kind kind, const diff_record *rec)
+{
+	char digest[(AS_DIGEST_VALUE_SIZE + 2) / 3 * 4 + 1];
+	cf_b64_encode(rec->entry.digest, AS_DIGEST_VALUE_SIZE, digest);
+	digest[sizeof digest - 1] = 0;
+
+	printf("%s %s %s %s %" PRIu64 "\n", kind_names[kind], rec->stream->ns, digest,
+			rec->stream->path, rec->entry.offset);
+}
+
+///
+/// Parses a comma-separated list of diff_kind names.
+///
+/// @param list   The list.
+/// @param kinds  Returns the diff_kind bit mask.
+///
+/// @result       `true`, if successful.
+///
+static bool
+parse_kinds(const char *list, uint32_t *kinds)
+{
+	bool res = false;
+	char *clone = safe_strdup(list);
+	as_vector names;
+	as_vector_inita(&names, sizeof (char *), 5);
+	split_string(clone, ',', true, &names);
+	*kinds = 0;
+
+	for (uint32_t i = 0; i < names.size; ++i) {
+		const char *name = as_vector_get_ptr(&names, i);
+		uint32_t k;
+
+		for (k = 0; k < DIFF_N_KINDS; ++k) {
+			if (strcmp(name, kind_names[k]) == 0) {
+				break;
+			}
+		}
+
+		if (k == DIFF_N_KINDS) {
+			err("Invalid record kind %s", name);
+			goto cleanup1;
+		}
+
+		*kinds |= 1u << k;
+	}
+
+	res = true;
+
+cleanup1:
+	as_vector_destroy(&names);
+	cf_free(clone);
+	return res;
+}
+
+///
+/// Displays usage information.
+///
+/// @param name  The actual name of the `asdiff` binary.
+///
+static void
+usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS] <before> <after>\n", name);
+	fprintf(stderr, "------------------------------------------------------------------------------");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Compares the output directories or output files of two validation runs, which\n");
+	fprintf(stderr, "must have been made with --offset-index.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, " -Z, --usage          Display this message.\n");
+	fprintf(stderr, " -v, --verbose        Enable verbose output. Default: disabled\n");
+	fprintf(stderr, " -l, --list <list>    Print the records of the given comma-separated kinds:\n");
+	fprintf(stderr, "                      new (only in <after>), still (in both), repaired (only\n");
+	fprintf(stderr, "                      in <before>). Default: none, only print the counts\n");
+}
+
+///
+/// It all starts here.
+///
+int32_t
+main(int32_t argc, char **argv)
+{
+	static struct option options[] = {
+		{ "usage", no_argument, NULL, 'Z' },
+		{ "verbose", no_argument, NULL, 'v' },
+		{ "list", required_argument, NULL, 'l' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	int32_t res = EXIT_FAILURE;
+	uint32_t list = 0;
+	int32_t opt;
+
+	while ((opt = getopt_long(argc, argv, "Zvl:", options, 0)) != -1) {
+		switch (opt) {
+		case 'v':
+			verbose = true;
+			break;
+
+		case 'l':
+			if (!parse_kinds(optarg, &list)) {
+				goto cleanup0;
+			}
+
+			break;
+
+		case 'Z':
+			usage(argv[0]);
+			res = EXIT_SUCCESS;
+			goto cleanup0;
+
+		default:
+			usage(argv[0]);
+			goto cleanup0;
+		}
+	}
+
+	if (argc - optind != 2) {
+		err("Please specify the output directories or output files of two validation runs");
+		goto cleanup0;
+	}
+
+	// split the file descriptors between the two runs
+	uint32_t max_open = DIFF_MAX_OPEN;
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY) {
+		uint64_t avail = rl.rlim_cur > DIFF_RESERVED_FDS ?
+				(uint64_t)(rl.rlim_cur - DIFF_RESERVED_FDS) / 2 : 0;
+		max_open = avail < max_open ? (uint32_t)avail : max_open;
+	}
+
+	if (verbose) {
+		ver("Keeping up to %u offset index(es) per run open", max_open);
+	}
+
+	diff_run before;
+	diff_run after;
+
+	if (!run_open(&before, argv[optind], max_open)) {
+		goto cleanup0;
+	}
+
+	if (!run_open(&after, argv[optind + 1], max_open)) {
+		goto cleanup1;
+	}
+
+	inf("Comparing %u output file(s) of %s with %u output file(s) of %s", before.n_streams,
+			before.name, after.n_streams, after.name);
+
+	diff_record rec_b;
+	diff_record rec_a;
+	bool has_b;
+	bool has_a;
+	uint64_t counts[DIFF_N_KINDS] = { 0 };
+
+	if (!run_next(&before, &rec_b, &has_b) || !run_next(&after, &rec_a, &has_a)) {
+		goto cleanup2;
+	}
+
+	// both runs come in the same order, so a single merge pass classifies every record
+	while (has_b || has_a) {
+		int32_t cmp = !has_a ? -1 : !has_b ? 1 : compare_key(rec_b.stream->ns,
+				rec_b.entry.digest, rec_a.stream->ns, rec_a.entry.digest);
+		diff_kind kind = cmp < 0 ? DIFF_REPAIRED : cmp > 0 ? DIFF_NEW : DIFF_STILL;
+		++counts[kind];
+
+		if ((list & (1u << kind)) != 0) {
+			print_record(kind, cmp < 0 ? &rec_b : &rec_a);
+		}
+
+		if (cmp <= 0 && !run_next(&before, &rec_b, &has_b)) {
+			goto cleanup2;
+		}
+
+		if (cmp >= 0 && !run_next(&after, &rec_a, &has_a)) {
+			goto cleanup2;
+		}
+	}
+
+	inf("%s: %" PRIu64 " record(s), %s: %" PRIu64 " record(s)", before.name, before.n_records,
+			after.name, after.n_records);
+	inf("Newly broken: %" PRIu64 ", still broken: %" PRIu64 ", repaired: %" PRIu64,
+			counts[DIFF_NEW], counts[DIFF_STILL], counts[DIFF_REPAIRED]);
+	res = EXIT_SUCCESS;
+
+cleanup2:
+	run_close(&after);
+
+cleanup1:
+	run_close(&before);
+
+cleanup0:
+	return res;
+}
@@ -55,24 +55,133 @@ text_bytes_type_to_label(as_bytes_type type)
 }
 
 ///
-/// Writes a signed 64-bit integer to the backup file.
+/// Appends a string of known length to the output buffer.
 ///
-/// @param bytes    Increased by the number of bytes written to the backup file.
-/// @param fd       The file descriptor of the backup file.
+/// @param buf   The output buffer.
+/// @param str   The string to be appended.
+/// @param len   The length of the string.
+///
+/// @result      `true`, if successful.
+///
+static inline bool
+text_put_raw(output_buffer *buf, const void *str, size_t len)
+{
+	if (UNLIKELY(!output_buffer_reserve(buf, len))) {
+		return false;
+	}
+
+	memcpy(buf->data + buf->size, str, len);
+	buf->size += len;
+	return true;
+}
+
+///
+/// Appends a NUL-terminated string to the output buffer.
+///
+/// @param buf   The output buffer.
+/// @param str   The string to be appended.
+///
+/// @result      `true`, if successful.
+///
+static inline bool
+text_put_string(output_buffer *buf, const char *str)
+{
+	return text_put_raw(buf, str, strlen(str));
+}
+
+///
+/// Appends a '\'-escaped string to the output buffer. Produces the same output as the
+/// @ref escape() macro, but in a single pass and without a temporary buffer.
+///
+/// @param buf   The output buffer.
+/// @param str   The string to be escaped and appended.
+///
+/// @result      `true`, if successful.
+///
+static inline bool
+text_put_escaped(output_buffer *buf, const char *str)
+{
+	size_t len = strlen(str);
+
+	if (UNLIKELY(!output_buffer_reserve(buf, 2 * len))) {
+		return false;
+	}
+
+	char *out = buf->data + buf->size;
+
+	for (size_t i = 0; i < len; ++i) {
+		char ch = str[i];
+
+		if (ch == '\\' || ch == ' ' || ch == '\n') {
+			*out++ = '\\';
+		}
+
+		*out++ = ch;
+	}
+
+	buf->size = (size_t)(out - buf->data);
+	return true;
+}
+
+///
+/// Appends the decimal representation of an unsigned 64-bit integer to the output buffer.
+///
+/// @param buf   The output buffer.
+/// @param val   The integer value.
+///
+/// @result      `true`, if successful.
+///
+static inline bool
+text_put_uint(output_buffer *buf, uint64_t val)
+{
+	char tmp[20];
+	size_t k = sizeof tmp;
+
+	do {
+		tmp[--k] = (char)('0' + val % 10);
+		val /= 10;
+	} while (val != 0);
+
+	return text_put_raw(buf, tmp + k, sizeof tmp - k);
+}
+
+///
+/// Appends the decimal representation of a signed 64-bit integer to the output buffer.
+///
+/// @param buf   The output buffer.
+/// @param val   The integer value.
+///
+/// @result      `true`, if successful.
+///
+static inline bool
+text_put_int(output_buffer *buf, int64_t val)
+{
+	if (val >= 0) {
+		return text_put_uint(buf, (uint64_t)val);
+	}
+
+	return text_put_raw(buf, "-", 1) && text_put_uint(buf, (uint64_t)0 - (uint64_t)val);
+}
+
+///
+/// Writes a signed 64-bit integer to the output buffer.
+///
+/// @param buf      The output buffer.
 /// @param prefix1  The first string prefix.
-/// @param prefix2  The second string prefix.
+/// @param prefix2  The second string prefix. '\'-escaped on output.
 /// @param val      The integer value to be written.
 ///
 /// @result         `true`, if successful.
 ///
 static bool
-text_output_integer(uint64_t *bytes, FILE *fd, const char *prefix1, const char *prefix2,
-		as_val *val)
+text_output_integer(output_buffer *buf, const char *prefix1, const char *prefix2, as_val *val)
 {
 	as_integer *v = as_integer_fromval(val);
 
-	if (fprintf_bytes(bytes, fd, "%s%s %" PRId64 "\n", prefix1, prefix2, v->value) < 0) {
-		err_code("Error while writing integer to validation file");
+	if (!text_put_string(buf, prefix1) || !text_put_escaped(buf, prefix2) ||
+			!text_put_raw(buf, " ", 1) || !text_put_int(buf, v->value) ||
+			!text_put_raw(buf, "\n", 1)) {
+		err("Error while writing integer to validation file");
 		return false;
 	}
 
@@ -80,60 +189,61 @@ text_output_integer(uint64_t *bytes, FILE *fd, const char *prefix1, const char *
 }
 
 ///
-/// Writes a double-precision floating-point value to the backup file.
+/// Writes a double-precision floating-point value to the output buffer.
 ///
-/// Using 17 significant digits makes sure that we read back the same value that we wrote.
+/// Using 17 significant digits makes sure that we read back the same value that we wrote. The
+/// digits themselves still come from `snprintf()`, which rounds exactly; we only avoid the
+/// stdio stream.
 ///
-/// @param bytes    Increased by the number of bytes written to the backup file.
-/// @param fd       The file descriptor of the backup file.
+/// @param buf      The output buffer.
 /// @param prefix1  The first string prefix.
-/// @param prefix2  The second string prefix.
+/// @param prefix2  The second string prefix. '\'-escaped on output.
 /// @param val      The floating point value to be written.
 ///
 /// @result         `true`, if successful.
 ///
 static bool
-text_output_double(uint64_t *bytes, FILE *fd, const char *prefix1, const char *prefix2,
-		as_val *val)
+text_output_double(output_buffer *buf, const char *prefix1, const char *prefix2, as_val *val)
 {
 	as_double *v = as_double_fromval(val);
 
-	if (fprintf_bytes(bytes, fd, "%s%s %.17g\n", prefix1, prefix2, v->value) < 0) {
-		err_code("Error while writing double to validation file");
+	if (!text_put_string(buf, prefix1) || !text_put_escaped(buf, prefix2) ||
+			!output_buffer_reserve(buf, 32)) {
+		err("Error while writing double to validation file");
 		return false;
 	}
 
+	int32_t len = snprintf(buf->data + buf->size, 32, " %.17g\n", v->value);
+
+	if (len < 0 || len >= 32) {
+		err("Error while writing double to validation file");
+		return false;
+	}
+
+	buf->size += (size_t)len;
 	return true;
 }
 
 ///
-/// Writes a BLOB to the backup file.
+/// Writes a BLOB to the output buffer.
 ///
-/// @param bytes    Increased by the number of bytes written to the backup file.
-/// @param fd       The file descriptor of the backup file.
+/// @param buf      The output buffer.
 /// @param prefix1  The first string prefix.
-/// @param prefix2  The second string prefix.
+/// @param prefix2  The second string prefix. '\'-escaped on output.
 /// @param buffer   The data of the BLOB to be written.
 /// @param size     The size of the BLOB to be written.
 ///
 /// @result         `true`, if successful.
 ///
 static bool
-text_output_data(uint64_t *bytes, FILE *fd, const char *prefix1, const char *prefix2,
-		void *buffer, size_t size)
+text_output_data(output_buffer *buf, const char *prefix1, const char *prefix2,
+		const void *buffer, size_t size)
 {
-	if (fprintf_bytes(bytes, fd, "%s%s %zu ", prefix1, prefix2, size) < 0) {
-		err_code("Error while writing data to validation file [1]");
-		return false;
-	}
-
-	if (fwrite_bytes(bytes, buffer, size, 1, fd) != 1) {
-		err_code("Error while writing data to validation file [2]");
-		return false;
-	}
-
-	if (fprintf_bytes(bytes, fd, "\n") < 0) {
-		err_code("Error while writing data to validation file [3]");
+	if (!text_put_string(buf, prefix1) || !text_put_escaped(buf, prefix2) ||
+			!text_put_raw(buf, " ", 1) || !text_put_uint(buf, size) ||
+			!text_put_raw(buf, " ", 1) || !text_put_raw(buf, buffer, size) ||
+			!text_put_raw(buf, "\n", 1)) {
+		err("Error while writing data to validation file");
 		return false;
 	}
 
@@ -141,19 +251,19 @@ text_output_data(uint64_t *bytes, FILE *fd, const char *prefix1, const char *pre
 }
 
 ///
-/// Writes an encoded BLOB to the backup file.
+/// Writes an encoded BLOB to the output buffer. The base-64 encoder writes straight into the
+/// output buffer.
 ///
-/// @param bytes    Increased by the number of bytes written to the backup file.
-/// @param fd       The file descriptor of the backup file.
+/// @param buf      The output buffer.
 /// @param prefix1  The first string prefix.
-/// @param prefix2  The second string prefix.
+/// @param prefix2  The second string prefix. '\'-escaped on output.
 /// @param buffer   The data of the BLOB to be written.
 /// @param size     The size of the BLOB to be written.
 ///
 /// @result         `true`, if successful.
 ///
 static bool
-text_output_data_enc(uint64_t *bytes, FILE *fd, const char *prefix1, const char *prefix2,
+text_output_data_enc(output_buffer *buf, const char *prefix1, const char *prefix2,
 		void *buffer, uint32_t size)
 {
 	uint32_t enc_size = cf_b64_encoded_len(size);
@@ -163,103 +273,100 @@ text_output_data_enc(uint64_t *bytes, FILE *fd, const char *prefix1, const char
 		return false;
 	}
 
-	char *enc = buffer_init(enc_size);
-	cf_b64_encode(buffer, size, enc);
-
-	if (!text_output_data(bytes, fd, prefix1, prefix2, enc, enc_size)) {
-		buffer_free(enc, enc_size);
+	if (!text_put_string(buf, prefix1) || !text_put_escaped(buf, prefix2) ||
+			!text_put_raw(buf, " ", 1) || !text_put_uint(buf, enc_size) ||
+			!text_put_raw(buf, " ", 1) || !output_buffer_reserve(buf, enc_size + 1)) {
+		err("Error while writing data to validation file");
 		return false;
 	}
 
-	buffer_free(enc, enc_size);
+	cf_b64_encode(buffer, size, buf->data + buf->size);
+	buf->size += enc_size;
+	buf->data[buf->size++] = '\n';
 	return true;
 }
 
 ///
-/// Writes a string to the backup file.
+/// Writes a string to the output buffer.
 ///
-/// @param bytes    Increased by the number of bytes written to the backup file.
-/// @param fd       The file descriptor of the backup file.
+/// @param buf      The output buffer.
 /// @param prefix1  The first string prefix.
-/// @param prefix2  The second string prefix.
+/// @param prefix2  The second string prefix. '\'-escaped on output.
 /// @param val      The string to be written.
 ///
 /// @result         `true`, if successful.
 ///
 static bool
-text_output_string(uint64_t *bytes, FILE *fd, const char *prefix1, const char *prefix2, as_val *val)
+text_output_string(output_buffer *buf, const char *prefix1, const char *prefix2, as_val *val)
 {
 	as_string *v = as_string_fromval(val);
-	return text_output_data(bytes, fd, prefix1, prefix2, v->value, v->len);
+	return text_output_data(buf, prefix1, prefix2, v->value, v->len);
 }
 
 ///
-/// Writes a geojson to the backup file.
+/// Writes a geojson to the output buffer.
 ///
-/// @param bytes    Increased by the number of bytes written to the backup file.
-/// @param fd       The file descriptor of the backup file.
+/// @param buf      The output buffer.
 /// @param prefix1  The first string prefix.
-/// @param prefix2  The second string prefix.
+/// @param prefix2  The second string prefix. '\'-escaped on output.
 /// @param val      The geojson to be written.
 ///
 /// @result         `true`, if successful.
 ///
 static bool
-text_output_geojson(uint64_t *bytes, FILE *fd, const char *prefix1, const char *prefix2, as_val *val)
+text_output_geojson(output_buffer *buf, const char *prefix1, const char *prefix2, as_val *val)
 {
 	as_geojson *v = as_geojson_fromval(val);
-	return text_output_data(bytes, fd, prefix1, prefix2, v->value, v->len);
+	return text_output_data(buf, prefix1, prefix2, v->value, v->len);
 }
 
 ///
-/// Writes a bytes value to the backup file.
+/// Writes a bytes value to the output buffer.
 ///
-/// @param bytes    Increased by the number of bytes written to the backup file.
-/// @param fd       The file descriptor of the backup file.
+/// @param buf      The output buffer.
 /// @param compact  Indicates compact mode.
 /// @param prefix1  The first string prefix.
-/// @param prefix2  The second string prefix.
+/// @param prefix2  The second string prefix. '\'-escaped on output.
 /// @param val      The bytes value to be written.
 ///
 /// @result         `true`, if successful.
 ///
 static bool
-text_output_bytes(uint64_t *bytes, FILE *fd, bool compact, const char *prefix1, const char *prefix2,
+text_output_bytes(output_buffer *buf, bool compact, const char *prefix1, const char *prefix2,
 		as_val *val)
 {
 	as_bytes *v = as_bytes_fromval(val);
 	return compact ?
-			text_output_data(bytes, fd, prefix1, prefix2, v->value, v->size) :
-			text_output_data_enc(bytes, fd, prefix1, prefix2, v->value, v->size);
+			text_output_data(buf, prefix1, prefix2, v->value, v->size) :
+			text_output_data_enc(buf, prefix1, prefix2, v->value, v->size);
 }
 
 ///
-/// Writes a key to the backup file.
+/// Writes a key to the output buffer.
 ///
-/// @param bytes    Increased by the number of bytes written to the backup file.
-/// @param fd       The file descriptor of the backup file.
+/// @param buf      The output buffer.
 /// @param compact  Indicates compact mode.
 /// @param key      The key to be written.
 ///
 /// @result         `true`, if successful.
 ///
 static bool
-text_output_key(uint64_t *bytes, FILE *fd, bool compact, as_val *key)
+text_output_key(output_buffer *buf, bool compact, as_val *key)
 {
 	switch (key->type) {
 	case AS_INTEGER:
-		return text_output_integer(bytes, fd, "+ k I", "", key);
+		return text_output_integer(buf, "+ k I", "", key);
 
 	case AS_DOUBLE:
-		return text_output_double(bytes, fd, "+ k D", "", key);
+		return text_output_double(buf, "+ k D", "", key);
 
 	case AS_STRING:
-		return text_output_string(bytes, fd, "+ k S", "", key);
+		return text_output_string(buf, "+ k S", "", key);
 
 	case AS_BYTES:
 		return compact ?
-			text_output_bytes(bytes, fd, true, "+ k B!", "", key) :
-			text_output_bytes(bytes, fd, false, "+ k B", "", key);
+			text_output_bytes(buf, true, "+ k B!", "", key) :
+			text_output_bytes(buf, false, "+ k B", "", key);
 
 	default:
 		err("Invalid key type %d", (int32_t)key->type);
@@ -268,22 +375,22 @@ text_output_key(uint64_t *bytes, FILE *fd, bool compact, as_val *key)
 }
 
 ///
-/// Writes a bin to the backup file.
+/// Writes a bin to the output buffer.
 ///
-/// @param bytes     Increased by the number of bytes written to the backup file.
-/// @param fd        The file descriptor of the backup file.
+/// @param buf       The output buffer.
 /// @param compact   Indicates compact mode.
-/// @param bin_name  The name of the bin to be written.
+/// @param bin_name  The name of the bin to be written. '\'-escaped on output.
 /// @param val       The bin value to be written.
 ///
 /// @result         `true`, if successful.
 ///
 static bool
-text_output_value(uint64_t *bytes, FILE *fd, bool compact, const char *bin_name, as_val *val)
+text_output_value(output_buffer *buf, bool compact, const char *bin_name, as_val *val)
 {
 	if (val == NULL || val->type == AS_NIL) {
-		if (fprintf_bytes(bytes, fd, "- N %s\n", bin_name) < 0) {
-			err_code("Error while writing NIL value to validation file");
+		if (!text_put_raw(buf, "- N ", 4) || !text_put_escaped(buf, bin_name) ||
+				!text_put_raw(buf, "\n", 1)) {
+			err("Error while writing NIL value to validation file");
 			return false;
 		}
 
@@ -292,16 +399,16 @@ text_output_value(uint64_t *bytes, FILE *fd, bool compact, const char *bin_name,
 
 	switch (val->type) {
 	case AS_INTEGER:
-		return text_output_integer(bytes, fd, "- I ", bin_name, val);
+		return text_output_integer(buf, "- I ", bin_name, val);
 
 	case AS_DOUBLE:
-		return text_output_double(bytes, fd, "- D ", bin_name, val);
+		return text_output_double(buf, "- D ", bin_name, val);
 
 	case AS_STRING:
-		return text_output_string(bytes, fd, "- S ", bin_name, val);
+		return text_output_string(buf, "- S ", bin_name, val);
 
 	case AS_GEOJSON:
-		return text_output_geojson(bytes, fd, "- G ", bin_name, val);
+		return text_output_geojson(buf, "- G ", bin_name, val);
 
 	case AS_BYTES: {
 		int32_t type = text_bytes_type_to_label(as_bytes_fromval(val)->type);
@@ -313,12 +420,12 @@ text_output_value(uint64_t *bytes, FILE *fd, bool compact, const char *bin_name,
 		if (compact) {
 			char prefix[6] = "-  ! ";
 			prefix[2] = (char)type;
-			return text_output_bytes(bytes, fd, true, prefix, bin_name, val);
+			return text_output_bytes(buf, true, prefix, bin_name, val);
 		}
 
 		char prefix[5] = "-   ";
 		prefix[2] = (char)type;
-		return text_output_bytes(bytes, fd, false, prefix, bin_name, val);
+		return text_output_bytes(buf, false, prefix, bin_name, val);
 	}
 
 	case AS_LIST:
@@ -336,47 +443,56 @@ text_output_value(uint64_t *bytes, FILE *fd, bool compact, const char *bin_name,
 }
 
 ///
-/// Part of the interface exposed by the text backup file format encoder.
+/// Formats a record into the given output buffer.
 ///
-/// See backup_encoder.put_record for details.
+/// @param buf      The output buffer. Formatting appends to the buffer's current contents.
+/// @param compact  If true, don't use base-64 encoding on BLOB bin values.
+/// @param rec      The record to be formatted.
 ///
-bool
-text_put_record(uint64_t *bytes, FILE *fd, bool compact, const as_record *rec)
+/// @result         `true`, if successful.
+///
+static bool
+text_format_record(output_buffer *buf, bool compact, const as_record *rec)
 {
-	uint32_t enc_size = cf_b64_encoded_len(sizeof (as_digest_value)) + 1;
-	char *enc = alloca(enc_size);
-	cf_b64_encode(rec->key.digest.value, sizeof (as_digest_value), enc);
-	enc[enc_size - 1] = 0;
-
 	// map -1 TTL (= never expire) to 0; restore maps it back
 	uint32_t expire = rec->ttl == (uint32_t)-1 ? 0 : (uint32_t)cf_secs_since_clepoch() + rec->ttl;
 
 	if (rec->key.valuep != NULL &&
-			!text_output_key(bytes, fd, compact, (as_val *)rec->key.valuep)) {
+			!text_output_key(buf, compact, (as_val *)rec->key.valuep)) {
 		err("Error while writing record key");
 		return false;
 	}
 
-	if (fprintf_bytes(bytes, fd, "+ n %s\n+ d %s\n", escape(rec->key.ns), enc) < 0) {
-		err_code("Error while writing record meta data to validation file [1]");
+	uint32_t enc_size = cf_b64_encoded_len(sizeof (as_digest_value));
+
+	if (!text_put_raw(buf, "+ n ", 4) || !text_put_escaped(buf, rec->key.ns) ||
+			!text_put_raw(buf, "\n+ d ", 5) || !output_buffer_reserve(buf, enc_size + 1)) {
+		err("Error while writing record meta data to validation file [1]");
 		return false;
 	}
 
-	if (rec->key.set[0] != 0 && fprintf_bytes(bytes, fd, "+ s %s\n", escape(rec->key.set)) < 0) {
-		err_code("Error while writing record meta data to validation file [2]");
+	cf_b64_encode(rec->key.digest.value, sizeof (as_digest_value), buf->data + buf->size);
+	buf->size += enc_size;
+	buf->data[buf->size++] = '\n';
+
+	if (rec->key.set[0] != 0 && (!text_put_raw(buf, "+ s ", 4) ||
+			!text_put_escaped(buf, rec->key.set) || !text_put_raw(buf, "\n", 1))) {
+		err("Error while writing record meta data to validation file [2]");
 		return false;
 	}
 
-	if (fprintf_bytes(bytes, fd, "+ g %d\n+ t %u\n+ b %d\n", rec->gen, expire,
-			rec->bins.size) < 0) {
-		err_code("Error while writing record meta data to validation file [3]");
+	if (!text_put_raw(buf, "+ g ", 4) || !text_put_uint(buf, rec->gen) ||
+			!text_put_raw(buf, "\n+ t ", 5) || !text_put_uint(buf, expire) ||
+			!text_put_raw(buf, "\n+ b ", 5) || !text_put_uint(buf, rec->bins.size) ||
+			!text_put_raw(buf, "\n", 1)) {
+		err("Error while writing record meta data to validation file [3]");
 		return false;
 	}
 
 	for (int32_t i = 0; i < rec->bins.size; ++i) {
 		as_bin *bin = &rec->bins.entries[i];
 
-		if (!text_output_value(bytes, fd, compact, escape(bin->name), (as_val *)bin->valuep)) {
+		if (!text_output_value(buf, compact, bin->name, (as_val *)bin->valuep)) {
 			err("Error while writing record bin %s", bin->name);
 			return false;
 		}
@@ -384,3 +500,26 @@ text_put_record(uint64_t *bytes, FILE *fd, bool compact, const as_record *rec)
 
 	return true;
 }
+
+///
+/// Part of the interface exposed by the text backup file format encoder.
+///
+/// See backup_encoder.put_record for details.
+///
+bool
+text_put_record(uint64_t *bytes, FILE *fd, bool compact, const as_record *rec,
+		output_buffer *buf)
+{
+	buf->size = 0;
+
+	if (!text_format_record(buf, compact, rec)) {
+		return false;
+	}
+
+	if (fwrite_bytes(bytes, buf->data, buf->size, 1, fd) != 1) {
+		err_code("Error while writing record to validation file");
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,1432 @@
+/*
+ * Aerospike Validation Corpus Generator
+ *
+ * Copyright (c) 2008-2017 Aerospike, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+
+#include <enc_text.h>
+#include <gen.h>
+#include <utils.h>
+
+#include "msgpack_in.h"
+
+#define GEN_NO_UNIQ UINT64_MAX          ///< Marks a generated value that needn't be unique.
+
+#define PACKED_FLAG_ORDERED 0x01        ///< The ext flag of ordered lists and key-ordered maps.
+
+static volatile bool stop = false;  ///< Makes the generator threads exit.
+static volatile sig_atomic_t interrupted = 0;   ///< Set by the signal handler, which must not
+                                                ///  log, for the main thread to log.
+
+static const char *break_names[BREAK_N_KINDS] = {
+	"none", "order", "padding", "dupkey", "nonstorage"
+};
+
+///
+/// Advances the pseudo-random state of a generator thread (xorshift64*).
+///
+/// @param ctx  The generator thread's state.
+///
+/// @result     The next pseudo-random number.
+///
+static inline uint64_t
+gen_rand(gen_context *ctx)
+{
+	ctx->rnd ^= ctx->rnd >> 12;
+	ctx->rnd ^= ctx->rnd << 25;
+	ctx->rnd ^= ctx->rnd >> 27;
+	return ctx->rnd * 0x2545f4914f6cdd1dULL;
+}
+
+///
+/// Seeds the pseudo-random state for a record, so that a record's contents only depend on the
+/// seed and the record's index, not on the thread that generates it (splitmix64).
+///
+/// @param ctx    The generator thread's state.
+/// @param index  The record's index.
+///
+static void
+gen_seed(gen_context *ctx, uint64_t index)
+{
+	uint64_t z = ctx->conf->seed + (index + 1) * 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	z ^= z >> 31;
+	ctx->rnd = z != 0 ? z : 1;
+}
+
+///
+/// Calculates the maximal size of a generated value, so that the value buffer can be sized once.
+///
+/// @param spec  The value specification.
+/// @param top   Indicates a bin value, as opposed to a value nested in a CDT.
+///
+/// @result      The maximal size.
+///
+static uint64_t
+gen_max_size(const spec_value *spec, bool top)
+{
+	switch (spec->type) {
+	case SPEC_NIL:
+		return 1;
+
+	case SPEC_INTEGER:
+	case SPEC_DOUBLE:
+		return 9;
+
+	case SPEC_STRING:
+	case SPEC_BYTES:
+		// header + type byte + data + NUL for bin values
+		return 5 + 1 + (uint64_t)spec->size + 1;
+
+	case SPEC_LIST:
+		return 5 + 3 + (uint64_t)spec->size * gen_max_size(spec->sub1, false) +
+				(top ? MAX_GEN_PADDING : 0);
+
+	case SPEC_MAP:
+	default:
+		return 5 + 4 + (uint64_t)spec->size * (gen_max_size(spec->sub1, false) +
+				gen_max_size(spec->sub2, false)) + (top ? MAX_GEN_PADDING : 0);
+	}
+}
+
+///
+/// Appends a byte to a value buffer. The buffer was sized by gen_max_size().
+///
+static inline void
+gen_put_byte(output_buffer *buf, uint8_t byte)
+{
+	buf->data[buf->size++] = (char)byte;
+}
+
+///
+/// Appends a big-endian number to a value buffer.
+///
+static inline void
+gen_put_be(output_buffer *buf, uint64_t val, uint32_t n_bytes)
+{
+	for (uint32_t i = n_bytes; i > 0; --i) {
+		gen_put_byte(buf, (uint8_t)(val >> (8 * (i - 1))));
+	}
+}
+
+///
+/// Appends a msgpack list or map header.
+///
+/// @param buf    The value buffer.
+/// @param count  The element count.
+/// @param fix    The fixarray or fixmap tag.
+/// @param tag16  The array 16 or map 16 tag, followed by the 32-bit tag.
+///
+static void
+gen_pack_header(output_buffer *buf, uint32_t count, uint8_t fix, uint8_t tag16)
+{
+	if (count < 16) {
+		gen_put_byte(buf, (uint8_t)(fix | count));
+	} else if (count <= UINT16_MAX) {
+		gen_put_byte(buf, tag16);
+		gen_put_be(buf, count, 2);
+	} else {
+		gen_put_byte(buf, (uint8_t)(tag16 + 1));
+		gen_put_be(buf, count, 4);
+	}
+}
+
+///
+/// Appends a msgpack integer in its shortest encoding.
+///
+static void
+gen_pack_int(output_buffer *buf, int64_t val)
+{
+	if (val >= 0) {
+		uint64_t u = (uint64_t)val;
+
+		if (u < 128) {
+			gen_put_byte(buf, (uint8_t)u);
+		} else if (u <= UINT8_MAX) {
+			gen_put_byte(buf, 0xcc);
+			gen_put_be(buf, u, 1);
+		} else if (u <= UINT16_MAX) {
+			gen_put_byte(buf, 0xcd);
+			gen_put_be(buf, u, 2);
+		} else if (u <= UINT32_MAX) {
+			gen_put_byte(buf, 0xce);
+			gen_put_be(buf, u, 4);
+		} else {
+			gen_put_byte(buf, 0xcf);
+			gen_put_be(buf, u, 8);
+		}
+
+		return;
+	}
+
+	if (val >= -32) {
+		gen_put_byte(buf, (uint8_t)val);
+	} else if (val >= INT8_MIN) {
+		gen_put_byte(buf, 0xd0);
+		gen_put_be(buf, (uint64_t)val, 1);
+	} else if (val >= INT16_MIN) {
+		gen_put_byte(buf, 0xd1);
+		gen_put_be(buf, (uint64_t)val, 2);
+	} else if (val >= INT32_MIN) {
+		gen_put_byte(buf, 0xd2);
+		gen_put_be(buf, (uint64_t)val, 4);
+	} else {
+		gen_put_byte(buf, 0xd3);
+		gen_put_be(buf, (uint64_t)val, 8);
+	}
+}
+
+///
+/// Appends a msgpack string header for the given size, like the client does for strings and
+/// BLOBs, i.e., including the Aerospike type byte.
+///
+static void
+gen_pack_str_header(output_buffer *buf, uint32_t size, uint8_t type)
+{
+	if (size < 32) {
+		gen_put_byte(buf, (uint8_t)(0xa0 | size));
+	} else if (size <= UINT8_MAX) {
+		gen_put_byte(buf, 0xd9);
+		gen_put_be(buf, size, 1);
+	} else if (size <= UINT16_MAX) {
+		gen_put_byte(buf, 0xda);
+		gen_put_be(buf, size, 2);
+	} else {
+		gen_put_byte(buf, 0xdb);
+		gen_put_be(buf, size, 4);
+	}
+
+	gen_put_byte(buf, type);
+}
+
+///
+/// Generates a random integer. Unique values are unique among all values generated with a
+/// different `uniq`.
+///
+static int64_t
+gen_int(gen_context *ctx, uint64_t uniq)
+{
+	uint64_t r = gen_rand(ctx);
+	return uniq == GEN_NO_UNIQ ? (int64_t)r : (int64_t)(((r >> 40) << 24) | (uniq & 0xffffff));
+}
+
+///
+/// Generates a random double. Unique values are unique among all values generated with a
+/// different `uniq`.
+///
+static double
+gen_double(gen_context *ctx, uint64_t uniq)
+{
+	double frac = (double)(gen_rand(ctx) >> 11) * 0x1p-53;
+	return uniq == GEN_NO_UNIQ ? frac * 1e9 : (double)uniq + frac;
+}
+
+///
+/// Generates random alphanumeric characters. Unique values start with the base-36 digits of
+/// `uniq`.
+///
+static void
+gen_chars(gen_context *ctx, output_buffer *buf, uint32_t len, uint64_t uniq)
+{
+	static const char chars[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+	uint32_t i = 0;
+
+	if (uniq != GEN_NO_UNIQ) {
+		while (i < len) {
+			buf->data[buf->size++] = chars[uniq % 36];
+			uniq /= 36;
+			++i;
+
+			if (uniq == 0) {
+				break;
+			}
+		}
+	}
+
+	uint64_t r = 0;
+
+	for (; i < len; ++i) {
+		if (i % 10 == 0) {
+			r = gen_rand(ctx);
+		}
+
+		buf->data[buf->size++] = chars[r % 36];
+		r /= 36;
+	}
+}
+
+///
+/// Generates random bytes. Unique values start with the little-endian bytes of `uniq`.
+///
+static void
+gen_bytes(gen_context *ctx, output_buffer *buf, uint32_t len, uint64_t uniq)
+{
+	uint32_t i = 0;
+
+	if (uniq != GEN_NO_UNIQ) {
+		for (; i < len && i < 8; ++i) {
+			gen_put_byte(buf, (uint8_t)(uniq >> (8 * i)));
+		}
+	}
+
+	uint64_t r = 0;
+
+	for (; i < len; ++i) {
+		if (i % 8 == 0) {
+			r = gen_rand(ctx);
+		}
+
+		gen_put_byte(buf, (uint8_t)r);
+		r >>= 8;
+	}
+}
+
+///
+/// Appends a non-storage wildcard value, which is only valid in CDT operations.
+///
+static void
+gen_pack_nonstorage(output_buffer *buf)
+{
+	gen_put_byte(buf, 0xd4);    // fixext 1
+	gen_put_byte(buf, 0xff);    // CDT comparison type
+	gen_put_byte(buf, 0x00);    // wildcard
+}
+
+///
+/// Swaps two adjacent byte ranges in place.
+///
+static void
+gen_reverse(char *data, size_t len)
+{
+	for (size_t i = 0; i < len / 2; ++i) {
+		char tmp = data[i];
+		data[i] = data[len - 1 - i];
+		data[len - 1 - i] = tmp;
+	}
+}
+
+///
+/// Makes sure that the elements of a generated CDT are out of order: keeps them, if they
+/// already are, or swaps two adjacent elements that are in order.
+///
+/// @param buf     The value buffer.
+/// @param start   The offset of the first element.
+/// @param n       The number of elements.
+/// @param stride  The number of msgpack values per element: 1 for lists, 2 for maps.
+///
+/// @result        `true`, if the elements are out of order now. `false`, if all elements
+///                compare equal.
+///
+static bool
+gen_unorder(output_buffer *buf, size_t start, uint32_t n, uint32_t stride)
+{
+	const uint8_t *data = (const uint8_t *)buf->data + start;
+	uint32_t sz = (uint32_t)(buf->size - start);
+	msgpack_in mp = { .buf = data, .buf_sz = sz };
+
+	uint32_t prev = 0;
+	msgpack_sz_rep(&mp, stride);
+
+	bool have = false;
+	uint32_t a = 0, b = 0, c = 0;
+
+	for (uint32_t i = 1; i < n; ++i) {
+		uint32_t cur = mp.offset;
+		msgpack_in lhs = { .buf = data, .buf_sz = sz, .offset = prev };
+		msgpack_in rhs = { .buf = data, .buf_sz = sz, .offset = cur };
+		msgpack_cmp_type cmp = msgpack_cmp_peek(&lhs, &rhs);
+
+		msgpack_sz_rep(&mp, stride);
+
+		if (cmp == MSGPACK_CMP_GREATER) {
+			return true;
+		}
+
+		if (cmp == MSGPACK_CMP_LESS && !have) {
+			have = true;
+			a = prev;
+			b = cur;
+			c = mp.offset;
+		}
+
+		prev = cur;
+	}
+
+	if (!have) {
+		return false;
+	}
+
+	char *swap = buf->data + start;
+	gen_reverse(swap + a, b - a);
+	gen_reverse(swap + b, c - b);
+	gen_reverse(swap + a, c - a);
+	return true;
+}
+
+static void gen_pack_value(gen_context *ctx, const spec_value *spec, uint64_t uniq);
+
+///
+/// Appends a msgpack list, possibly broken.
+///
+/// @result  `true`, if the requested breakage was applied.
+///
+static bool
+gen_pack_list(gen_context *ctx, const spec_value *spec, break_kind brk)
+{
+	output_buffer *buf = &ctx->vals;
+	uint32_t n = spec->size;
+
+	if (brk == BREAK_ORDER) {
+		gen_pack_header(buf, n + 1, 0x90, 0xdc);
+		gen_put_byte(buf, 0xc7);    // ext 8
+		gen_put_byte(buf, 0x00);
+		gen_put_byte(buf, PACKED_FLAG_ORDERED);
+	} else {
+		gen_pack_header(buf, n, 0x90, 0xdc);
+	}
+
+	size_t start = buf->size;
+
+	for (uint32_t i = 0; i < n; ++i) {
+		if (brk == BREAK_NONSTORAGE && i == 0) {
+			gen_pack_nonstorage(buf);
+			continue;
+		}
+
+		gen_pack_value(ctx, spec->sub1, GEN_NO_UNIQ);
+	}
+
+	return brk != BREAK_ORDER || gen_unorder(buf, start, n, 1);
+}
+
+///
+/// Appends a msgpack map, possibly broken. Keys are unique, unless broken.
+///
+/// @result  `true`, if the requested breakage was applied.
+///
+static bool
+gen_pack_map(gen_context *ctx, const spec_value *spec, break_kind brk)
+{
+	output_buffer *buf = &ctx->vals;
+	uint32_t n = spec->size;
+
+	if (brk == BREAK_ORDER) {
+		gen_pack_header(buf, n + 1, 0x80, 0xde);
+		gen_put_byte(buf, 0xc7);    // ext 8
+		gen_put_byte(buf, 0x00);
+		gen_put_byte(buf, PACKED_FLAG_ORDERED);
+		gen_put_byte(buf, 0xc0);    // nil
+	} else {
+		gen_pack_header(buf, n, 0x80, 0xde);
+	}
+
+	size_t start = buf->size;
+	size_t key0_end = 0;
+
+	for (uint32_t i = 0; i < n; ++i) {
+		if (brk == BREAK_DUPKEY && i == 1) {
+			size_t key0_sz = key0_end - start;
+			memcpy(buf->data + buf->size, buf->data + start, key0_sz);
+			buf->size += key0_sz;
+		} else {
+			gen_pack_value(ctx, spec->sub1, i);
+		}
+
+		if (i == 0) {
+			key0_end = buf->size;
+		}
+
+		if (brk == BREAK_NONSTORAGE && i == 0) {
+			gen_pack_nonstorage(buf);
+			continue;
+		}
+
+		gen_pack_value(ctx, spec->sub2, GEN_NO_UNIQ);
+	}
+
+	return brk != BREAK_ORDER || gen_unorder(buf, start, n, 2);
+}
+
+///
+/// Appends a msgpack value. Nested CDTs are always valid.
+///
+/// @param ctx   The generator thread's state.
+/// @param spec  The value specification.
+/// @param uniq  Makes the value unique among the values with a different `uniq`. GEN_NO_UNIQ
+///              for random values.
+///
+static void
+gen_pack_value(gen_context *ctx, const spec_value *spec, uint64_t uniq)
+{
+	output_buffer *buf = &ctx->vals;
+
+	switch (spec->type) {
+	case SPEC_NIL:
+		gen_put_byte(buf, 0xc0);
+		break;
+
+	case SPEC_INTEGER:
+		gen_pack_int(buf, gen_int(ctx, uniq));
+		break;
+
+	case SPEC_DOUBLE: {
+		double d = gen_double(ctx, uniq);
+		uint64_t bits;
+		memcpy(&bits, &d, sizeof bits);
+		gen_put_byte(buf, 0xcb);
+		gen_put_be(buf, bits, 8);
+		break;
+	}
+
+	case SPEC_STRING:
+		gen_pack_str_header(buf, spec->size + 1, AS_BYTES_STRING);
+		gen_chars(ctx, buf, spec->size, uniq);
+		break;
+
+	case SPEC_BYTES:
+		gen_pack_str_header(buf, spec->size + 1, AS_BYTES_BLOB);
+		gen_bytes(ctx, buf, spec->size, uniq);
+		break;
+
+	case SPEC_LIST:
+		gen_pack_list(ctx, spec, BREAK_NONE);
+		break;
+
+	case SPEC_MAP:
+		gen_pack_map(ctx, spec, BREAK_NONE);
+		break;
+	}
+}
+
+///
+/// Checks whether a breakage can be applied to a bin value.
+///
+/// @param spec  The bin's value specification.
+/// @param brk   The breakage.
+///
+/// @result      `true`, if the breakage can be applied.
+///
+static bool
+gen_can_break(const spec_value *spec, break_kind brk)
+{
+	if (spec->type != SPEC_LIST && spec->type != SPEC_MAP) {
+		return false;
+	}
+
+	switch (brk) {
+	case BREAK_ORDER:
+		return spec->size >= 2;
+
+	case BREAK_PADDING:
+		return true;
+
+	case BREAK_DUPKEY:
+		return spec->type == SPEC_MAP && spec->size >= 2;
+
+	case BREAK_NONSTORAGE:
+		return spec->size >= 1;
+
+	default:
+		return false;
+	}
+}
+
+///
+/// Picks the breakage for the current record, if any.
+///
+/// @param ctx  The generator thread's state.
+///
+/// @result     The breakage, BREAK_NONE for a valid record.
+///
+static break_kind
+gen_pick_break(gen_context *ctx)
+{
+	gen_config *conf = ctx->conf;
+
+	if (conf->broken == 0 || gen_rand(ctx) % 100 >= conf->broken) {
+		return BREAK_NONE;
+	}
+
+	uint32_t n_kinds = (uint32_t)__builtin_popcount(conf->kinds);
+	uint32_t pick = (uint32_t)(gen_rand(ctx) % n_kinds);
+
+	for (uint32_t k = BREAK_NONE + 1; k < BREAK_N_KINDS; ++k) {
+		if ((conf->kinds & (1u << k)) != 0 && pick-- == 0) {
+			return (break_kind)k;
+		}
+	}
+
+	return BREAK_NONE;
+}
+
+///
+/// Generates the bin values of a record into the value buffer. The first CDT bin to which the
+/// picked breakage applies is broken.
+///
+/// @param ctx    The generator thread's state.
+/// @param index  The record's index.
+///
+/// @result       The applied breakage, BREAK_NONE for a valid record.
+///
+static break_kind
+gen_values(gen_context *ctx, uint64_t index)
+{
+	gen_config *conf = ctx->conf;
+	output_buffer *buf = &ctx->vals;
+
+	gen_seed(ctx, index);
+	break_kind brk = gen_pick_break(ctx);
+	break_kind applied = BREAK_NONE;
+
+	buf->size = 0;
+	uint32_t n = 0;
+
+	for (uint32_t i = 0; i < conf->spec->bins.size; ++i) {
+		spec_bins *bins = as_vector_get((as_vector *)&conf->spec->bins, i);
+
+		for (uint32_t k = 0; k < bins->count; ++k) {
+			const spec_value *spec = bins->value;
+			ctx->bin_offs[n++] = (uint32_t)buf->size;
+
+			switch (spec->type) {
+			case SPEC_NIL:
+				break;
+
+			case SPEC_INTEGER: {
+				int64_t val = gen_int(ctx, GEN_NO_UNIQ);
+				memcpy(buf->data + buf->size, &val, sizeof val);
+				buf->size += sizeof val;
+				break;
+			}
+
+			case SPEC_DOUBLE: {
+				double val = gen_double(ctx, GEN_NO_UNIQ);
+				memcpy(buf->data + buf->size, &val, sizeof val);
+				buf->size += sizeof val;
+				break;
+			}
+
+			case SPEC_STRING:
+				gen_chars(ctx, buf, spec->size, GEN_NO_UNIQ);
+				buf->data[buf->size++] = 0;
+				break;
+
+			case SPEC_BYTES:
+				gen_bytes(ctx, buf, spec->size, GEN_NO_UNIQ);
+				break;
+
+			case SPEC_LIST:
+			case SPEC_MAP: {
+				break_kind bin_brk = applied == BREAK_NONE && gen_can_break(spec, brk) ?
+						brk : BREAK_NONE;
+				bool ok = spec->type == SPEC_LIST ? gen_pack_list(ctx, spec, bin_brk) :
+						gen_pack_map(ctx, spec, bin_brk);
+
+				if (bin_brk == BREAK_PADDING) {
+					gen_bytes(ctx, buf, 1 + (uint32_t)(gen_rand(ctx) % MAX_GEN_PADDING),
+							GEN_NO_UNIQ);
+				}
+
+				if (bin_brk != BREAK_NONE && ok) {
+					applied = bin_brk;
+				}
+
+				break;
+			}
+			}
+		}
+	}
+
+	ctx->bin_offs[n] = (uint32_t)buf->size;
+	return applied;
+}
+
+///
+/// Populates the reused record from the generated bin values.
+///
+/// @param ctx    The generator thread's state.
+/// @param index  The record's index.
+///
+static void
+gen_set_record(gen_context *ctx, uint64_t index)
+{
+	gen_config *conf = ctx->conf;
+	as_record *rec = &ctx->rec;
+	char *data = ctx->vals.data;
+	uint32_t n = 0;
+
+	as_key_init_int64(&rec->key, conf->ns, conf->set, (int64_t)(conf->first_key + index));
+	as_key_digest(&rec->key);
+
+	for (uint32_t i = 0; i < conf->spec->bins.size; ++i) {
+		spec_bins *bins = as_vector_get((as_vector *)&conf->spec->bins, i);
+
+		for (uint32_t k = 0; k < bins->count; ++k, ++n) {
+			const char *name = conf->bin_names[n];
+			char *val = data + ctx->bin_offs[n];
+			uint32_t size = ctx->bin_offs[n + 1] - ctx->bin_offs[n];
+
+			switch (bins->value->type) {
+			case SPEC_NIL:
+				as_record_set_nil(rec, name);
+				break;
+
+			case SPEC_INTEGER: {
+				int64_t i_val;
+				memcpy(&i_val, val, sizeof i_val);
+				as_record_set_int64(rec, name, i_val);
+				break;
+			}
+
+			case SPEC_DOUBLE: {
+				double d_val;
+				memcpy(&d_val, val, sizeof d_val);
+				as_record_set_double(rec, name, d_val);
+				break;
+			}
+
+			case SPEC_STRING:
+				as_record_set_str(rec, name, val);
+				break;
+
+			case SPEC_BYTES:
+				as_record_set_raw_typep(rec, name, (uint8_t *)val, size, AS_BYTES_BLOB, false);
+				break;
+
+			case SPEC_LIST:
+				as_record_set_raw_typep(rec, name, (uint8_t *)val, size, AS_BYTES_LIST, false);
+				break;
+
+			case SPEC_MAP:
+				as_record_set_raw_typep(rec, name, (uint8_t *)val, size, AS_BYTES_MAP, false);
+				break;
+			}
+		}
+	}
+}
+
+///
+/// Formats the CDT bin values of the current record as a raw corpus entry: each value is
+/// preceded by its 32-bit big-endian size.
+///
+/// @param ctx  The generator thread's state.
+///
+/// @result     `true`, if successful.
+///
+static bool
+gen_format_raw(gen_context *ctx)
+{
+	gen_config *conf = ctx->conf;
+	output_buffer *out = &ctx->out;
+	uint32_t n = 0;
+
+	out->size = 0;
+
+	for (uint32_t i = 0; i < conf->spec->bins.size; ++i) {
+		spec_bins *bins = as_vector_get((as_vector *)&conf->spec->bins, i);
+
+		for (uint32_t k = 0; k < bins->count; ++k, ++n) {
+			if (bins->value->type != SPEC_LIST && bins->value->type != SPEC_MAP) {
+				continue;
+			}
+
+			uint32_t size = ctx->bin_offs[n + 1] - ctx->bin_offs[n];
+
+			if (!output_buffer_reserve(out, 4 + (size_t)size)) {
+				return false;
+			}
+
+			gen_put_be(out, size, 4);
+			memcpy(out->data + out->size, ctx->vals.data + ctx->bin_offs[n], size);
+			out->size += size;
+		}
+	}
+
+	return true;
+}
+
+///
+/// Closes the current output file of a generator thread.
+///
+/// @param ctx  The generator thread's state.
+///
+/// @result     `true`, if successful.
+///
+static bool
+gen_close_file(gen_context *ctx)
+{
+	if (ctx->fd == NULL) {
+		return true;
+	}
+
+	bool res = true;
+
+	if (fclose(ctx->fd) == EOF) {
+		err_code("Error while closing output file");
+		res = false;
+	}
+
+	cf_free(ctx->fd_buf);
+	ctx->byte_count_done += ctx->byte_count_file;
+	ctx->byte_count_file = 0;
+	ctx->fd = NULL;
+	ctx->fd_buf = NULL;
+	return res;
+}
+
+///
+/// Starts the next output file of a generator thread.
+///
+/// @param ctx  The generator thread's state.
+///
+/// @result     `true`, if successful.
+///
+static bool
+gen_open_file(gen_context *ctx)
+{
+	gen_config *conf = ctx->conf;
+	char file_path[PATH_MAX];
+
+	if (conf->bench > 0) {
+		as_strncpy(file_path, "/dev/null", sizeof file_path);
+	} else if ((size_t)snprintf(file_path, sizeof file_path, "%s/%s_%03u_%06u.%s",
+			conf->directory, conf->spec->name, ctx->index, ctx->file_count,
+			conf->raw ? "msgpack" : "asb") >= sizeof file_path) {
+		err("File path too long (%s, %s)", conf->directory, conf->spec->name);
+		return false;
+	}
+
+	if ((ctx->fd = fopen(file_path, "w")) == NULL) {
+		err_code("Error while creating output file %s", file_path);
+		return false;
+	}
+
+	if (verbose) {
+		ver("Created new output file %s", file_path);
+	}
+
+	ctx->fd_buf = safe_malloc(IO_BUF_SIZE);
+	setbuffer(ctx->fd, ctx->fd_buf, IO_BUF_SIZE);
+
+	++ctx->file_count;
+	ctx->byte_count_file = 0;
+
+	if (conf->raw) {
+		return true;
+	}
+
+	if (fprintf_bytes(&ctx->byte_count_file, ctx->fd, "Validation Version " VERSION_1_1 "\n") < 0 ||
+			fprintf_bytes(&ctx->byte_count_file, ctx->fd, META_PREFIX META_NAMESPACE " %s\n",
+					escape(conf->ns)) < 0) {
+		err_code("Error while writing header to output file %s", file_path);
+		gen_close_file(ctx);
+		return false;
+	}
+
+	return true;
+}
+
+///
+/// Returns the CPU time consumed by the calling thread.
+///
+/// @result  The CPU time in nanoseconds.
+///
+static uint64_t
+thread_cpu_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+///
+/// Formats the current record repeatedly in benchmark mode and accounts for the CPU time
+/// that this takes.
+///
+/// @param ctx  The generator thread's state.
+///
+/// @result     `true`, if successful.
+///
+static bool
+gen_bench_record(gen_context *ctx)
+{
+	gen_config *conf = ctx->conf;
+	uint64_t start = thread_cpu_ns();
+
+	for (uint32_t i = 0; i < conf->bench; ++i) {
+		if (!text_put_record(&ctx->byte_count_file, ctx->fd, conf->compact, &ctx->rec,
+				&ctx->out)) {
+			return false;
+		}
+	}
+
+	ctx->bench_ns += thread_cpu_ns() - start;
+	ctx->bench_recs += conf->bench;
+	return true;
+}
+
+///
+/// Generates a record and writes it to the current output file.
+///
+/// @param ctx    The generator thread's state.
+/// @param index  The record's index.
+/// @param brk    Returns the applied breakage.
+///
+/// @result       `true`, if successful.
+///
+static bool
+gen_record(gen_context *ctx, uint64_t index, break_kind *brk)
+{
+	gen_config *conf = ctx->conf;
+
+	if (ctx->fd == NULL || (conf->file_limit > 0 && ctx->byte_count_file >= conf->file_limit)) {
+		if (!gen_close_file(ctx) || !gen_open_file(ctx)) {
+			return false;
+		}
+	}
+
+	*brk = gen_values(ctx, index);
+
+	if (conf->raw) {
+		if (!gen_format_raw(ctx)) {
+			return false;
+		}
+
+		if (fwrite_bytes(&ctx->byte_count_file, ctx->out.data, ctx->out.size, 1,
+				ctx->fd) != 1) {
+			err_code("Error while writing corpus entry");
+			return false;
+		}
+
+		return true;
+	}
+
+	gen_set_record(ctx, index);
+
+	if (conf->bench > 0) {
+		return gen_bench_record(ctx);
+	}
+
+	return text_put_record(&ctx->byte_count_file, ctx->fd, conf->compact, &ctx->rec,
+			&ctx->out);
+}
+
+///
+/// Main generator thread function. Claims chunks of record indexes until all records are
+/// generated.
+///
+/// @param cont  The generator thread's state.
+///
+/// @result      `(void *)EXIT_SUCCESS` or `(void *)EXIT_FAILURE`.
+///
+static void *
+gen_thread_func(void *cont)
+{
+	gen_context *ctx = cont;
+	gen_config *conf = ctx->conf;
+	void *res = (void *)EXIT_FAILURE;
+
+	uint64_t max_size = 0;
+
+	for (uint32_t i = 0; i < conf->spec->bins.size; ++i) {
+		spec_bins *bins = as_vector_get((as_vector *)&conf->spec->bins, i);
+		max_size += bins->count * gen_max_size(bins->value, true);
+	}
+
+	if (max_size > UINT32_MAX) {
+		err("Record specification %s yields records of up to %" PRIu64 " byte(s)",
+				conf->spec->name, max_size);
+		goto cleanup0;
+	}
+
+	if (!output_buffer_reserve(&ctx->vals, (size_t)max_size)) {
+		goto cleanup0;
+	}
+
+	ctx->bin_offs = safe_malloc((conf->spec->n_bins + 1) * sizeof (uint32_t));
+	as_record_init(&ctx->rec, (uint16_t)conf->spec->n_bins);
+
+	while (!stop) {
+		uint64_t start = (uint64_t)cf_atomic64_add(&conf->next, GEN_CHUNK) - GEN_CHUNK;
+
+		if (start >= conf->count) {
+			res = (void *)EXIT_SUCCESS;
+			break;
+		}
+
+		uint64_t end = start + GEN_CHUNK < conf->count ? start + GEN_CHUNK : conf->count;
+		uint64_t bytes = ctx->byte_count_done + ctx->byte_count_file;
+		uint64_t broken[BREAK_N_KINDS] = { 0 };
+		uint64_t index;
+
+		for (index = start; index < end && !stop; ++index) {
+			break_kind brk;
+
+			if (!gen_record(ctx, index, &brk)) {
+				stop = true;
+				break;
+			}
+
+			++broken[brk];
+		}
+
+		cf_atomic64_add(&conf->rec_count, index - start);
+		cf_atomic64_add(&conf->byte_count, ctx->byte_count_done + ctx->byte_count_file - bytes);
+
+		for (uint32_t k = BREAK_NONE + 1; k < BREAK_N_KINDS; ++k) {
+			cf_atomic64_add(&conf->broken_count[k], broken[k]);
+		}
+	}
+
+	if (!gen_close_file(ctx)) {
+		res = (void *)EXIT_FAILURE;
+	}
+
+	as_record_destroy(&ctx->rec);
+	cf_free(ctx->bin_offs);
+
+cleanup0:
+	if (res != (void *)EXIT_SUCCESS) {
+		cf_atomic32_incr(&conf->failed);
+		stop = true;
+	}
+
+	output_buffer_free(&ctx->vals);
+	output_buffer_free(&ctx->out);
+	cf_atomic32_incr(&conf->done);
+	return res;
+}
+
+///
+/// Parses a comma-separated list of break kinds into a bit mask.
+///
+/// @param list   The list of break kinds.
+/// @param kinds  The bit mask.
+///
+/// @result       `true`, if successful.
+///
+static bool
+parse_break_kinds(const char *list, uint32_t *kinds)
+{
+	bool res = false;
+	char *clone = safe_strdup(list);
+	as_vector names;
+	as_vector_inita(&names, sizeof (void *), 25);
+	split_string(clone, ',', true, &names);
+
+	*kinds = 0;
+
+	for (uint32_t i = 0; i < names.size; ++i) {
+		const char *name = as_vector_get_ptr(&names, i);
+		uint32_t k;
+
+		for (k = BREAK_NONE + 1; k < BREAK_N_KINDS; ++k) {
+			if (strcmp(name, break_names[k]) == 0) {
+				break;
+			}
+		}
+
+		if (k == BREAK_N_KINDS) {
+			err("Invalid break kind %s", name);
+			goto cleanup1;
+		}
+
+		*kinds |= 1u << k;
+	}
+
+	res = *kinds != 0;
+
+cleanup1:
+	as_vector_destroy(&names);
+	cf_free(clone);
+	return res;
+}
+
+///
+/// Signal handler for `SIGINT` and `SIGTERM`.
+///
+/// @param sig  The signal number.
+///
+static void
+sig_hand(int32_t sig)
+{
+	(void)sig;
+	interrupted = 1;
+	stop = true;
+}
+
+///
+/// Displays usage information.
+///
+/// @param name  The actual name of the `asgen` binary.
+///
+static void
+usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n", name);
+	fprintf(stderr, "------------------------------------------------------------------------------");
+	fprintf(stderr, "\n");
+	fprintf(stderr, " -Z, --usage          Display this message.\n");
+	fprintf(stderr, " -v, --verbose        Enable verbose output. Default: disabled\n");
+	fprintf(stderr, " -f, --spec-file <file>\n");
+	fprintf(stderr, "                      The record specification file. Default: " DEFAULT_SPEC_FILE "\n");
+	fprintf(stderr, " -r, --record <name>  The record specification to generate.\n");
+	fprintf(stderr, " -c, --count <n>      The number of records to generate.\n");
+	fprintf(stderr, " -d, --directory <dir>\n");
+	fprintf(stderr, "                      The output directory. Each thread writes its own\n");
+	fprintf(stderr, "                      sequence of files.\n");
+	fprintf(stderr, " -n, --namespace <ns> The namespace of the records. Default: " DEFAULT_GEN_NAMESPACE "\n");
+	fprintf(stderr, " -s, --set <set>      The set of the records. Default: none\n");
+	fprintf(stderr, " -k, --first-key <n>  The integer key of the first record. Default: 0\n");
+	fprintf(stderr, " -t, --threads <n>    The number of generator threads. Default: %d\n",
+			DEFAULT_GEN_THREADS);
+	fprintf(stderr, " -F, --file-limit <MiB>\n");
+	fprintf(stderr, "                      Start a new file when the current file crosses this\n");
+	fprintf(stderr, "                      size. 0 disables rotation. Default: %d\n",
+			DEFAULT_GEN_FILE_LIMIT);
+	fprintf(stderr, " -b, --broken <percent>\n");
+	fprintf(stderr, "                      The percentage of records with a broken CDT bin.\n");
+	fprintf(stderr, "                      Default: 0\n");
+	fprintf(stderr, " -K, --break-kinds <list>\n");
+	fprintf(stderr, "                      Comma-separated kinds of broken CDTs: order, padding,\n");
+	fprintf(stderr, "                      dupkey, nonstorage. Default: all\n");
+	fprintf(stderr, " -e, --seed <n>       The pseudo-random seed. Default: 0\n");
+	fprintf(stderr, " -R, --raw            Write the CDT bin values as msgpack, each preceded by\n");
+	fprintf(stderr, "                      its 32-bit big-endian size, instead of validation\n");
+	fprintf(stderr, "                      files.\n");
+	fprintf(stderr, " -C, --compact        Do not apply base-64 encoding to BLOBs.\n");
+	fprintf(stderr, " -B, --bench <n>      Benchmark the validation file encoder. Format each\n");
+	fprintf(stderr, "                      record n times to /dev/null and report the records\n");
+	fprintf(stderr, "                      per second per core. Default: disabled\n");
+}
+
+///
+/// It all starts here.
+///
+int32_t
+main(int32_t argc, char **argv)
+{
+	static struct option options[] = {
+		{ "usage", no_argument, NULL, 'Z' },
+		{ "verbose", no_argument, NULL, 'v' },
+		{ "spec-file", required_argument, NULL, 'f' },
+		{ "record", required_argument, NULL, 'r' },
+		{ "count", required_argument, NULL, 'c' },
+		{ "directory", required_argument, NULL, 'd' },
+		{ "namespace", required_argument, NULL, 'n' },
+		{ "set", required_argument, NULL, 's' },
+		{ "first-key", required_argument, NULL, 'k' },
+		{ "threads", required_argument, NULL, 't' },
+		{ "file-limit", required_argument, NULL, 'F' },
+		{ "broken", required_argument, NULL, 'b' },
+		{ "break-kinds", required_argument, NULL, 'K' },
+		{ "seed", required_argument, NULL, 'e' },
+		{ "raw", no_argument, NULL, 'R' },
+		{ "compact", no_argument, NULL, 'C' },
+		{ "bench", required_argument, NULL, 'B' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	int32_t res = EXIT_FAILURE;
+
+	gen_config conf;
+	memset(&conf, 0, sizeof conf);
+	as_strncpy(conf.ns, DEFAULT_GEN_NAMESPACE, sizeof conf.ns);
+	conf.threads = DEFAULT_GEN_THREADS;
+	conf.file_limit = DEFAULT_GEN_FILE_LIMIT * 1024 * 1024;
+	conf.kinds = ((1u << BREAK_N_KINDS) - 1) & ~(1u << BREAK_NONE);
+
+	const char *spec_file = DEFAULT_SPEC_FILE;
+	const char *record = NULL;
+	bool have_count = false;
+
+	int32_t opt;
+	uint64_t tmp;
+
+	while ((opt = getopt_long(argc, argv, "Zvf:r:c:d:n:s:k:t:F:b:K:e:RCB:", options, 0)) != -1) {
+		switch (opt) {
+		case 'v':
+			verbose = true;
+			break;
+
+		case 'f':
+			spec_file = optarg;
+			break;
+
+		case 'r':
+			record = optarg;
+			break;
+
+		case 'c':
+			if (!better_atoi(optarg, &conf.count)) {
+				err("Invalid record count %s", optarg);
+				goto cleanup0;
+			}
+
+			have_count = true;
+			break;
+
+		case 'd':
+			conf.directory = optarg;
+			break;
+
+		case 'n':
+			if (strlen(optarg) >= sizeof conf.ns) {
+				err("Invalid namespace %s", optarg);
+				goto cleanup0;
+			}
+
+			as_strncpy(conf.ns, optarg, sizeof conf.ns);
+			break;
+
+		case 's':
+			if (strlen(optarg) >= sizeof conf.set) {
+				err("Invalid set %s", optarg);
+				goto cleanup0;
+			}
+
+			as_strncpy(conf.set, optarg, sizeof conf.set);
+			break;
+
+		case 'k':
+			if (!better_atoi(optarg, &conf.first_key) || conf.first_key > INT64_MAX) {
+				err("Invalid first key %s", optarg);
+				goto cleanup0;
+			}
+
+			break;
+
+		case 't':
+			if (!better_atoi(optarg, &tmp) || tmp < 1 || tmp > 1024) {
+				err("Invalid thread count %s", optarg);
+				goto cleanup0;
+			}
+
+			conf.threads = (uint32_t)tmp;
+			break;
+
+		case 'F':
+			if (!better_atoi(optarg, &tmp)) {
+				err("Invalid file limit %s", optarg);
+				goto cleanup0;
+			}
+
+			conf.file_limit = tmp * 1024 * 1024;
+			break;
+
+		case 'b':
+			if (!better_atoi(optarg, &tmp) || tmp > 100) {
+				err("Invalid broken percentage %s", optarg);
+				goto cleanup0;
+			}
+
+			conf.broken = (uint32_t)tmp;
+			break;
+
+		case 'K':
+			if (!parse_break_kinds(optarg, &conf.kinds)) {
+				err("Invalid break kinds %s", optarg);
+				goto cleanup0;
+			}
+
+			break;
+
+		case 'e':
+			if (!better_atoi(optarg, &conf.seed)) {
+				err("Invalid seed %s", optarg);
+				goto cleanup0;
+			}
+
+			break;
+
+		case 'R':
+			conf.raw = true;
+			break;
+
+		case 'C':
+			conf.compact = true;
+			break;
+
+		case 'B':
+			if (!better_atoi(optarg, &tmp) || tmp < 1 || tmp > UINT32_MAX) {
+				err("Invalid benchmark repetition count %s", optarg);
+				goto cleanup0;
+			}
+
+			conf.bench = (uint32_t)tmp;
+			break;
+
+		case 'Z':
+			usage(argv[0]);
+			res = EXIT_SUCCESS;
+			goto cleanup0;
+
+		default:
+			usage(argv[0]);
+			goto cleanup0;
+		}
+	}
+
+	if (optind < argc) {
+		err("Unexpected trailing argument %s", argv[optind]);
+		goto cleanup0;
+	}
+
+	if (conf.bench > 0) {
+		if (conf.raw || conf.directory != NULL) {
+			err("Benchmark mode (-B) does not write files, please omit -R and -d");
+			goto cleanup0;
+		}
+
+		conf.file_limit = 0;
+	}
+
+	if (record == NULL || !have_count || (conf.directory == NULL && conf.bench == 0)) {
+		err("Please specify a record specification (-r), a count (-c), and a directory (-d)");
+		goto cleanup0;
+	}
+
+	if (conf.directory != NULL && mkdir(conf.directory, 0755) < 0 && errno != EEXIST) {
+		err_code("Error while creating directory %s", conf.directory);
+		goto cleanup0;
+	}
+
+	as_vector specs;
+
+	if (!spec_parse_file(spec_file, &specs)) {
+		err("Error while parsing specification file %s", spec_file);
+		goto cleanup0;
+	}
+
+	if ((conf.spec = spec_find(&specs, record)) == NULL) {
+		err("Record specification %s not found in %s", record, spec_file);
+		goto cleanup1;
+	}
+
+	if (conf.spec->n_bins > UINT16_MAX) {
+		err("Record specification %s has too many bins", record);
+		goto cleanup1;
+	}
+
+	conf.bin_names = safe_malloc(conf.spec->n_bins * sizeof conf.bin_names[0]);
+
+	for (uint32_t i = 0; i < conf.spec->n_bins; ++i) {
+		snprintf(conf.bin_names[i], sizeof conf.bin_names[i], "b%u", i);
+	}
+
+	inf("Generating %" PRIu64 " record(s) of %s with %u thread(s), %u%% broken",
+			conf.count, record, conf.threads, conf.broken);
+
+	// the generator threads' log messages go through the log thread from here on
+	log_start();
+	signal(SIGINT, sig_hand);
+	signal(SIGTERM, sig_hand);
+
+	gen_context *ctxs = safe_malloc(conf.threads * sizeof (gen_context));
+	pthread_t *threads = safe_malloc(conf.threads * sizeof (pthread_t));
+	uint32_t n_threads;
+
+	memset(ctxs, 0, conf.threads * sizeof (gen_context));
+	cf_clock start = cf_getms();
+
+	for (n_threads = 0; n_threads < conf.threads; ++n_threads) {
+		ctxs[n_threads].conf = &conf;
+		ctxs[n_threads].index = n_threads;
+
+		if (pthread_create(&threads[n_threads], NULL, gen_thread_func,
+				&ctxs[n_threads]) != 0) {
+			err_code("Error while creating generator thread");
+			stop = true;
+			break;
+		}
+	}
+
+	uint32_t iter = 0;
+
+	while ((uint32_t)cf_atomic32_get(conf.done) < n_threads) {
+		usleep(100000);
+
+		if (interrupted == 1) {
+			interrupted = 2;
+			err("### Generation interrupted ###");
+		}
+
+		if (++iter % 100 != 0) {
+			continue;
+		}
+
+		uint64_t recs = cf_atomic64_get(conf.rec_count);
+		cf_clock ms = cf_getms() - start;
+		inf("%d%% complete, %" PRIu64 " record(s), %" PRIu64 " byte(s), %" PRIu64 " rec/s",
+				conf.count == 0 ? 100 : (int32_t)(recs * 100 / conf.count), recs,
+				cf_atomic64_get(conf.byte_count), ms == 0 ? 0 : recs * 1000 / ms);
+	}
+
+	for (uint32_t i = 0; i < n_threads; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+
+	if (interrupted == 1) {
+		err("### Generation interrupted ###");
+	}
+
+	inf("Generated %" PRIu64 " record(s), %" PRIu64 " byte(s) in %" PRIu64 " ms",
+			cf_atomic64_get(conf.rec_count), cf_atomic64_get(conf.byte_count),
+			(uint64_t)(cf_getms() - start));
+
+	for (uint32_t k = BREAK_NONE + 1; k < BREAK_N_KINDS; ++k) {
+		inf("%10" PRIu64 " Broken (%s)", cf_atomic64_get(conf.broken_count[k]), break_names[k]);
+	}
+
+	if (conf.bench > 0) {
+		uint64_t recs = 0;
+		uint64_t ns = 0;
+
+		for (uint32_t i = 0; i < n_threads; ++i) {
+			recs += ctxs[i].bench_recs;
+			ns += ctxs[i].bench_ns;
+		}
+
+		uint64_t bytes = cf_atomic64_get(conf.byte_count);
+		inf("Encoded %" PRIu64 " record(s) in %" PRIu64 " ms of CPU time, %" PRIu64
+				" rec/s per core, %" PRIu64 " byte(s)/rec", recs, ns / 1000000,
+				ns == 0 ? 0 : (uint64_t)((double)recs * 1e9 / (double)ns),
+				recs == 0 ? 0 : bytes / recs);
+	}
+
+	if (n_threads == conf.threads && cf_atomic32_get(conf.failed) == 0 && !stop) {
+		res = EXIT_SUCCESS;
+	}
+
+	cf_free(threads);
+	cf_free(ctxs);
+	cf_free(conf.bin_names);
+
+cleanup1:
+	spec_free(&specs);
+
+cleanup0:
+	log_stop();
+	return res;
+}
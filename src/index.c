@@ -0,0 +1,467 @@
+/*
+ * Aerospike Backup File Offset Index
+ *
+ * Copyright (c) 2008-2017 Aerospike, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <index.h>
+
+///
+/// Orders index entries by digest. Entries with the same digest keep their file order. Passed
+/// to `qsort()`.
+///
+/// @param left   The first index_entry to compare.
+/// @param right  The second index_entry to compare.
+///
+/// @result       Negative, zero, or positive, as expected by `qsort()`.
+///
+static int32_t
+compare_index_entry(const void *left, const void *right)
+{
+	const index_entry *l = left;
+	const index_entry *r = right;
+	int32_t res = memcmp(l->digest, r->digest, AS_DIGEST_VALUE_SIZE);
+
+	if (res != 0) {
+		return res;
+	}
+
+	return l->offset < r->offset ? -1 : l->offset > r->offset ? 1 : 0;
+}
+
+///
+/// Stores a 64-bit integer in big-endian byte order.
+///
+/// @param buf  The output buffer.
+/// @param val  The integer.
+///
+static inline void
+put_be64(uint8_t *buf, uint64_t val)
+{
+	uint64_t be = cf_swap_to_be64(val);
+	memcpy(buf, &be, sizeof be);
+}
+
+///
+/// Loads a 64-bit integer stored in big-endian byte order.
+///
+/// @param buf  The input buffer.
+///
+/// @result     The integer.
+///
+static inline uint64_t
+get_be64(const uint8_t *buf)
+{
+	uint64_t be;
+	memcpy(&be, buf, sizeof be);
+	return cf_swap_from_be64(be);
+}
+
+///
+/// Initializes an empty offset index.
+///
+/// @param index     The offset index.
+/// @param interval  Add a checkpoint every this many records.
+///
+void
+index_init(file_index *index, uint32_t interval)
+{
+	index->interval = interval;
+	index->offset = 0;
+	as_vector_init(&index->entries, sizeof (index_entry), 1024);
+	as_vector_init(&index->checkpoints, sizeof (uint64_t), 64);
+}
+
+///
+/// Empties an offset index for a new backup file.
+///
+/// @param index   The offset index.
+/// @param offset  The size of the new backup file's header, i.e., the offset of its first
+///                record.
+///
+void
+index_reset(file_index *index, uint64_t offset)
+{
+	index->offset = offset;
+	as_vector_clear(&index->entries);
+	as_vector_clear(&index->checkpoints);
+}
+
+///
+/// Adds the record that was just written to the backup file to the offset index.
+///
+/// @param index   The offset index.
+/// @param digest  The record's digest.
+/// @param bytes   The size of the record in the backup file.
+///
+void
+index_add(file_index *index, const as_digest *digest, uint64_t bytes)
+{
+	if (index->entries.size % index->interval == 0) {
+		as_vector_append(&index->checkpoints, &index->offset);
+	}
+
+	index_entry entry;
+	memcpy(entry.digest, digest->value, AS_DIGEST_VALUE_SIZE);
+	entry.offset = index->offset;
+	as_vector_append(&index->entries, &entry);
+
+	index->offset += bytes;
+}
+
+///
+/// Writes the offset index of a backup file to `<file_path>.idx`. Goes through a temporary file
+/// that's renamed into place, so that an index is either complete or absent.
+///
+/// @param index      The offset index. Its entries end up sorted by digest.
+/// @param file_path  The path of the backup file.
+///
+/// @result           `true`, if successful.
+///
+bool
+index_write(file_index *index, const char *file_path)
+{
+	bool res = false;
+	char idx_path[PATH_MAX];
+	char tmp_path[PATH_MAX];
+
+	if (snprintf(idx_path, sizeof idx_path, "%s" INDEX_SUFFIX, file_path) >=
+			(int32_t)sizeof idx_path ||
+			snprintf(tmp_path, sizeof tmp_path, "%s.tmp", idx_path) >= (int32_t)sizeof tmp_path) {
+		err("Index file path too long");
+		goto cleanup0;
+	}
+
+	if (verbose) {
+		ver("Writing offset index %s, %u record(s)", idx_path, index->entries.size);
+	}
+
+	qsort(index->entries.list, index->entries.size, sizeof (index_entry), compare_index_entry);
+
+	FILE *fd = fopen(tmp_path, "w");
+
+	if (fd == NULL) {
+		err_code("Error while creating index file %s", tmp_path);
+		goto cleanup0;
+	}
+
+	uint8_t head[INDEX_HEADER_SIZE];
+	uint32_t interval = cf_swap_to_be32(index->interval);
+	memcpy(head, INDEX_MAGIC, 8);
+	memcpy(head + 8, &interval, sizeof interval);
+	put_be64(head + 12, index->entries.size);
+	put_be64(head + 20, index->checkpoints.size);
+
+	if (fwrite(head, sizeof head, 1, fd) != 1) {
+		goto cleanup2;
+	}
+
+	for (uint32_t i = 0; i < index->entries.size; ++i) {
+		index_entry *entry = as_vector_get(&index->entries, i);
+		uint8_t buf[INDEX_ENTRY_SIZE];
+		memcpy(buf, entry->digest, AS_DIGEST_VALUE_SIZE);
+		put_be64(buf + AS_DIGEST_VALUE_SIZE, entry->offset);
+
+		if (fwrite(buf, sizeof buf, 1, fd) != 1) {
+			goto cleanup2;
+		}
+	}
+
+	for (uint32_t i = 0; i < index->checkpoints.size; ++i) {
+		uint8_t buf[8];
+		put_be64(buf, *(uint64_t *)as_vector_get(&index->checkpoints, i));
+
+		if (fwrite(buf, sizeof buf, 1, fd) != 1) {
+			goto cleanup2;
+		}
+	}
+
+	if (fclose(fd) == EOF) {
+		err_code("Error while closing index file %s", tmp_path);
+		goto cleanup1;
+	}
+
+	if (rename(tmp_path, idx_path) < 0) {
+		err_code("Error while renaming index file %s to %s", tmp_path, idx_path);
+		goto cleanup1;
+	}
+
+	res = true;
+	goto cleanup0;
+
+cleanup2:
+	err_code("Error while writing index file %s", tmp_path);
+	fclose(fd);
+
+cleanup1:
+	remove(tmp_path);
+
+cleanup0:
+	return res;
+}
+
+///
+/// Frees the memory held by an offset index.
+///
+/// @param index  The offset index.
+///
+void
+index_free(file_index *index)
+{
+	as_vector_destroy(&index->entries);
+	as_vector_destroy(&index->checkpoints);
+}
+
+///
+/// Opens the offset index of a backup file for reading its digests.
+///
+/// @param ir         The index reader to be initialized.
+/// @param file_path  The path of the backup file, i.e., without the `.idx` suffix.
+///
+/// @result           `true`, if successful.
+///
+bool
+index_open(index_reader *ir, const char *file_path)
+{
+	char idx_path[PATH_MAX];
+
+	if (snprintf(idx_path, sizeof idx_path, "%s" INDEX_SUFFIX, file_path) >=
+			(int32_t)sizeof idx_path) {
+		err("Index file path too long");
+		return false;
+	}
+
+	if ((ir->fd = fopen(idx_path, "r")) == NULL) {
+		err_code("Error while opening index file %s", idx_path);
+		return false;
+	}
+
+	uint8_t head[INDEX_HEADER_SIZE];
+	struct stat sb;
+
+	if (fread(head, sizeof head, 1, ir->fd) != 1 || fstat(fileno(ir->fd), &sb) < 0) {
+		err_code("Error while reading header of index file %s", idx_path);
+		goto cleanup1;
+	}
+
+	if (memcmp(head, INDEX_MAGIC, 8) != 0) {
+		err("Invalid index file %s", idx_path);
+		goto cleanup1;
+	}
+
+	uint32_t interval;
+	memcpy(&interval, head + 8, sizeof interval);
+	ir->interval = cf_swap_from_be32(interval);
+	ir->n_entries = get_be64(head + 12);
+	ir->n_checkpoints = get_be64(head + 20);
+	ir->next = 0;
+
+	// also catches an overflow of the counts
+	if (ir->n_entries > (uint64_t)sb.st_size || ir->n_checkpoints > (uint64_t)sb.st_size ||
+			INDEX_HEADER_SIZE + ir->n_entries * INDEX_ENTRY_SIZE + ir->n_checkpoints * 8 !=
+			(uint64_t)sb.st_size) {
+		err("Index file %s has an invalid size", idx_path);
+		goto cleanup1;
+	}
+
+	return true;
+
+cleanup1:
+	fclose(ir->fd);
+	ir->fd = NULL;
+	return false;
+}
+
+///
+/// Reads the next digest from an offset index. The caller stops when index_reader.next reaches
+/// index_reader.n_entries.
+///
+/// @param ir     The index reader.
+/// @param entry  Returns the digest and the offset of its record.
+///
+/// @result       `true`, if successful.
+///
+bool
+index_next(index_reader *ir, index_entry *entry)
+{
+	uint8_t buf[INDEX_ENTRY_SIZE];
+
+	if (fread(buf, sizeof buf, 1, ir->fd) != 1) {
+		err_code("Error while reading index file");
+		return false;
+	}
+
+	memcpy(entry->digest, buf, AS_DIGEST_VALUE_SIZE);
+	entry->offset = get_be64(buf + AS_DIGEST_VALUE_SIZE);
+	++ir->next;
+	return true;
+}
+
+///
+/// Reopens an offset index that was closed by index_close() after index_open() and continues
+/// reading at the next digest.
+///
+/// @param ir         The index reader.
+/// @param file_path  The path of the backup file, i.e., without the `.idx` suffix.
+///
+/// @result           `true`, if successful.
+///
+bool
+index_reopen(index_reader *ir, const char *file_path)
+{
+	char idx_path[PATH_MAX];
+
+	if (snprintf(idx_path, sizeof idx_path, "%s" INDEX_SUFFIX, file_path) >=
+			(int32_t)sizeof idx_path) {
+		err("Index file path too long");
+		return false;
+	}
+
+	if ((ir->fd = fopen(idx_path, "r")) == NULL) {
+		err_code("Error while reopening index file %s", idx_path);
+		return false;
+	}
+
+	if (fseeko(ir->fd, (off_t)(INDEX_HEADER_SIZE + ir->next * INDEX_ENTRY_SIZE), SEEK_SET) < 0) {
+		err_code("Error while seeking in index file %s", idx_path);
+		fclose(ir->fd);
+		ir->fd = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+///
+/// Closes an offset index opened by index_open() or index_reopen(). index_reopen() continues
+/// where reading left off.
+///
+/// @param ir  The index reader.
+///
+void
+index_close(index_reader *ir)
+{
+	if (ir->fd != NULL) {
+		fclose(ir->fd);
+		ir->fd = NULL;
+	}
+}
+
+///
+/// Reads the namespace from the meta data section of a backup file.
+///
+/// @param path  The backup file.
+/// @param ns    Returns the namespace.
+/// @param size  The size of the namespace buffer.
+///
+/// @result      `true`, if successful.
+///
+bool
+index_namespace(const char *path, char *ns, size_t size)
+{
+	bool res = false;
+	FILE *fd = fopen(path, "r");
+
+	if (fd == NULL) {
+		err_code("Error while opening backup file %s", path);
+		goto cleanup0;
+	}
+
+	char line[1024];
+	static const char prefix[] = META_PREFIX META_NAMESPACE " ";
+
+	// the version line, then the namespace line
+	if (fgets(line, sizeof line, fd) == NULL || fgets(line, sizeof line, fd) == NULL ||
+			strncmp(line, prefix, sizeof prefix - 1) != 0) {
+		err("Backup file %s lacks a namespace", path);
+		goto cleanup1;
+	}
+
+	char *val = line + sizeof prefix - 1;
+	size_t len = strcspn(val, "\n");
+
+	if (len == 0 || len >= size) {
+		err("Invalid namespace in backup file %s", path);
+		goto cleanup1;
+	}
+
+	memcpy(ns, val, len);
+	ns[len] = 0;
+	res = true;
+
+cleanup1:
+	fclose(fd);
+
+cleanup0:
+	return res;
+}
+
+///
+/// Collects the backup files of a validation run: either all `.asb` files in its backup
+/// directory or its single backup file.
+///
+/// @param name   The run's backup directory or backup file.
+/// @param paths  Returns the paths of the backup files, as allocated strings.
+///
+/// @result       `true`, if successful.
+///
+bool
+index_backup_files(const char *name, as_vector *paths)
+{
+	struct stat sb;
+
+	if (stat(name, &sb) < 0) {
+		err_code("Error while accessing %s", name);
+		return false;
+	}
+
+	if (!S_ISDIR(sb.st_mode)) {
+		char *path = safe_strdup(name);
+		as_vector_append(paths, &path);
+		return true;
+	}
+
+	DIR *dir = opendir(name);
+
+	if (dir == NULL) {
+		err_code("Error while opening directory %s", name);
+		return false;
+	}
+
+	struct dirent *ent;
+	size_t suff_len = strlen(BACKUP_FILE_SUFFIX);
+
+	while ((ent = readdir(dir)) != NULL) {
+		size_t len = strlen(ent->d_name);
+
+		if (len <= suff_len || strcmp(ent->d_name + len - suff_len, BACKUP_FILE_SUFFIX) != 0) {
+			continue;
+		}
+
+		char *path = safe_malloc(strlen(name) + 1 + len + 1);
+		sprintf(path, "%s/%s", name, ent->d_name);
+		as_vector_append(paths, &path);
+	}
+
+	closedir(dir);
+	return true;
+}
@@ -0,0 +1,403 @@
+/*
+ * Aerospike Metrics Endpoint
+ *
+ * Copyright (c) 2008-2017 Aerospike, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <metrics.h>
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+///
+/// Appends formatted text to an output buffer.
+///
+/// @param buf     The output buffer.
+/// @param format  The format string.
+///
+/// @result        `true`, if successful.
+///
+bool
+metrics_printf(output_buffer *buf, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	int32_t len = vsnprintf(NULL, 0, format, args);
+	va_end(args);
+
+	if (len < 0 || !output_buffer_reserve(buf, (size_t)len + 1)) {
+		return false;
+	}
+
+	va_start(args, format);
+	vsnprintf(buf->data + buf->size, (size_t)len + 1, format, args);
+	va_end(args);
+
+	buf->size += (size_t)len;
+	return true;
+}
+
+///
+/// Writes all of the given data to a socket.
+///
+/// @param fd    The socket.
+/// @param data  The data to be written.
+/// @param len   The size of the data.
+///
+/// @result      `true`, if successful.
+///
+static bool
+metrics_send(int32_t fd, const char *data, size_t len)
+{
+	while (len > 0) {
+		ssize_t res = send(fd, data, len, MSG_NOSIGNAL);
+
+		if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return false;
+		}
+
+		data += res;
+		len -= (size_t)res;
+	}
+
+	return true;
+}
+
+///
+/// Reads an HTTP request and answers it with the current metrics.
+///
+/// @param srv  The metrics endpoint.
+/// @param fd   The client connection.
+/// @param buf  The response buffer. Reused across requests.
+///
+static void
+metrics_serve(metrics_server *srv, int32_t fd, output_buffer *buf)
+{
+	struct timeval tv = { .tv_sec = 1, .tv_usec = 0 };
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+
+	char req[METRICS_MAX_REQUEST + 1];
+	size_t len = 0;
+
+	// we answer every request the same way, so only wait for the end of the headers
+	while (len < METRICS_MAX_REQUEST) {
+		ssize_t res = recv(fd, req + len, METRICS_MAX_REQUEST - len, 0);
+
+		if (res <= 0) {
+			break;
+		}
+
+		len += (size_t)res;
+		req[len] = 0;
+
+		if (strstr(req, "\r\n\r\n") != NULL || strstr(req, "\n\n") != NULL) {
+			break;
+		}
+	}
+
+	if (len < 4 || strncmp(req, "GET ", 4) != 0) {
+		static const char bad[] = "HTTP/1.0 405 Method Not Allowed\r\nConnection: close\r\n\r\n";
+		metrics_send(fd, bad, sizeof bad - 1);
+		return;
+	}
+
+	buf->size = 0;
+
+	if (!srv->render(buf, srv->udata)) {
+		static const char fail[] =
+				"HTTP/1.0 500 Internal Server Error\r\nConnection: close\r\n\r\n";
+		metrics_send(fd, fail, sizeof fail - 1);
+		return;
+	}
+
+	char head[200];
+	int32_t head_len = snprintf(head, sizeof head, "HTTP/1.0 200 OK\r\n"
+			"Content-Type: text/plain; version=0.0.4\r\n"
+			"Content-Length: %zu\r\nConnection: close\r\n\r\n", buf->size);
+
+	if (metrics_send(fd, head, (size_t)head_len)) {
+		metrics_send(fd, buf->data, buf->size);
+	}
+}
+
+///
+/// Main thread function of the metrics endpoint. Accepts and serves one connection at a time
+/// until metrics_stop() is called.
+///
+/// @param cont  The metrics endpoint.
+///
+/// @result      Always `EXIT_SUCCESS`.
+///
+static void *
+metrics_thread_func(void *cont)
+{
+	if (verbose) {
+		ver("Entering metrics thread 0x%" PRIx64, (uint64_t)pthread_self());
+	}
+
+	metrics_server *srv = cont;
+	output_buffer buf = { NULL, 0, 0 };
+
+	while (!srv->stop) {
+		struct pollfd pfd = { .fd = srv->fd, .events = POLLIN, .revents = 0 };
+		int32_t res = poll(&pfd, 1, 1000);
+
+		if (res <= 0) {
+			if (res < 0 && errno != EINTR) {
+				err_code("Error while waiting for metrics requests");
+				break;
+			}
+
+			continue;
+		}
+
+		int32_t fd = accept(srv->fd, NULL, NULL);
+
+		if (fd < 0) {
+			if (errno != EINTR && errno != EAGAIN && errno != ECONNABORTED) {
+				err_code("Error while accepting metrics request");
+			}
+
+			continue;
+		}
+
+		metrics_serve(srv, fd, &buf);
+		close(fd);
+	}
+
+	output_buffer_free(&buf);
+
+	if (verbose) {
+		ver("Leaving metrics thread");
+	}
+
+	return (void *)EXIT_SUCCESS;
+}
+
+///
+/// Creates the listening socket for a Unix domain socket path.
+///
+/// @param srv   The metrics endpoint.
+/// @param path  The socket path.
+///
+/// @result      `true`, if successful.
+///
+static bool
+metrics_listen_unix(metrics_server *srv, const char *path)
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+
+	if (strlen(path) >= sizeof addr.sun_path) {
+		err("Metrics socket path %s too long", path);
+		return false;
+	}
+
+	strcpy(addr.sun_path, path);
+
+	if ((srv->fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		err_code("Error while creating metrics socket");
+		return false;
+	}
+
+	// a previous run may have left its socket behind; never remove anything else
+	struct stat st;
+
+	if (lstat(path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			err("Metrics socket path %s exists and is not a socket", path);
+			close(srv->fd);
+			return false;
+		}
+
+		if (unlink(path) < 0) {
+			err_code("Error while removing stale metrics socket %s", path);
+			close(srv->fd);
+			return false;
+		}
+	} else if (errno != ENOENT) {
+		err_code("Error while checking metrics socket path %s", path);
+		close(srv->fd);
+		return false;
+	}
+
+	if (bind(srv->fd, (struct sockaddr *)&addr, sizeof addr) < 0) {
+		err_code("Error while binding metrics socket %s", path);
+		close(srv->fd);
+		return false;
+	}
+
+	srv->unix_path = safe_strdup(path);
+	return true;
+}
+
+///
+/// Creates the listening socket for a `[host:]port` address.
+///
+/// @param srv      The metrics endpoint.
+/// @param address  The address.
+///
+/// @result         `true`, if successful.
+///
+static bool
+metrics_listen_tcp(metrics_server *srv, const char *address)
+{
+	char *clone = safe_strdup(address);
+	char *host = NULL;
+	char *port = strrchr(clone, ':');
+	bool res = false;
+
+	if (port != NULL) {
+		*port++ = 0;
+		host = clone;
+
+		// [IPv6]:port
+		if (host[0] == '[' && host[strlen(host) - 1] == ']') {
+			host[strlen(host) - 1] = 0;
+			++host;
+		}
+	} else {
+		port = clone;
+	}
+
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof hints);
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+
+	struct addrinfo *info;
+	int32_t gai = getaddrinfo(host != NULL ? host : METRICS_DEFAULT_HOST, port, &hints, &info);
+
+	if (gai != 0) {
+		err("Invalid metrics address %s: %s", address, gai_strerror(gai));
+		goto cleanup1;
+	}
+
+	if ((srv->fd = socket(info->ai_family, SOCK_STREAM, 0)) < 0) {
+		err_code("Error while creating metrics socket");
+		goto cleanup2;
+	}
+
+	int32_t one = 1;
+	setsockopt(srv->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+
+	if (bind(srv->fd, info->ai_addr, info->ai_addrlen) < 0) {
+		err_code("Error while binding metrics socket to %s", address);
+		close(srv->fd);
+		goto cleanup2;
+	}
+
+	res = true;
+
+cleanup2:
+	freeaddrinfo(info);
+
+cleanup1:
+	cf_free(clone);
+	return res;
+}
+
+///
+/// Starts a metrics endpoint.
+///
+/// @param srv          The metrics endpoint to be initialized.
+/// @param listen_addr  The listen address: `port`, `host:port`, or `unix:<path>`.
+/// @param render       Formats the metrics for each request.
+/// @param udata        Passed to `render`.
+///
+/// @result             `true`, if successful.
+///
+bool
+metrics_start(metrics_server *srv, const char *listen_addr, metrics_render render, void *udata)
+{
+	memset(srv, 0, sizeof (metrics_server));
+	srv->fd = -1;
+	srv->render = render;
+	srv->udata = udata;
+
+	size_t pref_len = strlen(METRICS_UNIX_PREFIX);
+	bool ok = strncmp(listen_addr, METRICS_UNIX_PREFIX, pref_len) == 0 ?
+			metrics_listen_unix(srv, listen_addr + pref_len) :
+			metrics_listen_tcp(srv, listen_addr);
+
+	if (!ok) {
+		srv->fd = -1;
+		return false;
+	}
+
+	if (listen(srv->fd, 16) < 0) {
+		err_code("Error while listening on metrics socket");
+		goto cleanup1;
+	}
+
+	if (pthread_create(&srv->thread, NULL, metrics_thread_func, srv) != 0) {
+		err_code("Error while creating metrics thread");
+		goto cleanup1;
+	}
+
+	inf("Serving metrics on %s", listen_addr);
+	return true;
+
+cleanup1:
+	close(srv->fd);
+	srv->fd = -1;
+
+	if (srv->unix_path != NULL) {
+		unlink(srv->unix_path);
+		cf_free(srv->unix_path);
+		srv->unix_path = NULL;
+	}
+
+	return false;
+}
+
+///
+/// Stops a metrics endpoint started by metrics_start().
+///
+/// @param srv  The metrics endpoint.
+///
+void
+metrics_stop(metrics_server *srv)
+{
+	if (srv->fd < 0) {
+		return;
+	}
+
+	srv->stop = true;
+	pthread_join(srv->thread, NULL);
+	close(srv->fd);
+	srv->fd = -1;
+
+	if (srv->unix_path != NULL) {
+		unlink(srv->unix_path);
+		cf_free(srv->unix_path);
+		srv->unix_path = NULL;
+	}
+}
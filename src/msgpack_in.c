@@ -72,7 +72,10 @@ static inline const uint8_t *msgpack_sz_internal(const uint8_t *buf, const uint8
 static inline uint64_t extract_uint64(const uint8_t *ptr, uint8_t sz);
 static inline uint64_t extract_neg_int64(const uint8_t *ptr, uint8_t sz);
 static inline void cmp_parse_container(parse_meta *meta, uint32_t count);
+static inline void msgpack_cmp_parse(parse_meta *meta);
 static inline msgpack_cmp_type msgpack_cmp_internal(parse_meta *meta0, parse_meta *meta1);
+static inline uint64_t key_double_prefix(double x);
+static inline uint64_t key_bytes_prefix(const uint8_t *data, uint32_t len);
 
 
 //==========================================================
@@ -658,6 +661,62 @@ msgpack_get_map_ele_count(msgpack_in *mp, uint32_t *count_r)
 	return true;
 }
 
+// Returns false for elements that don't normalize - containers, ext, NaN and
+// malformed elements - leaving mp unchanged. Compare those with msgpack_cmp().
+bool
+msgpack_get_key(msgpack_in *mp, msgpack_key *key)
+{
+	parse_meta meta = {
+			.buf = mp->buf + mp->offset,
+			.end = mp->buf + mp->buf_sz,
+			.remain = 1
+	};
+
+	msgpack_cmp_parse(&meta);
+
+	if (meta.buf == NULL || meta.buf > meta.end) {
+		return false;
+	}
+
+	key->data = NULL;
+	key->len = 0;
+	key->type = meta.type;
+
+	switch (meta.type) {
+	case MSGPACK_TYPE_NIL:
+	case MSGPACK_TYPE_FALSE:
+	case MSGPACK_TYPE_TRUE:
+		key->prefix = 0;
+		break;
+	case MSGPACK_TYPE_NEGINT:
+	case MSGPACK_TYPE_INT:
+		// NEGINT ranks below INT, and two's complement orders within NEGINT.
+		key->prefix = meta.i_num;
+		break;
+	case MSGPACK_TYPE_DOUBLE:
+		// msgpack_cmp() finds NaN equal to any double - no total order.
+		if (meta.d_num != meta.d_num) {
+			return false;
+		}
+
+		key->prefix = key_double_prefix(meta.d_num);
+		break;
+	case MSGPACK_TYPE_STRING:
+	case MSGPACK_TYPE_BYTES:
+	case MSGPACK_TYPE_GEOJSON:
+		key->prefix = key_bytes_prefix(meta.data, meta.len);
+		key->data = meta.data;
+		key->len = meta.len;
+		break;
+	default:
+		return false;
+	}
+
+	mp->offset = (uint32_t)(meta.buf - mp->buf);
+
+	return true;
+}
+
 
 //==========================================================
 // Local helpers.
@@ -1314,3 +1373,32 @@ msgpack_cmp_internal(parse_meta *meta0, parse_meta *meta1)
 
 	return end_result;
 }
+
+// Maps doubles to unsigned ints of the same order - flip negatives entirely,
+// set the sign bit of positives. -0.0 maps like 0.0, as they compare equal.
+static inline uint64_t
+key_double_prefix(double x)
+{
+	if (x == 0.0) {
+		x = 0.0;
+	}
+
+	uint64_t bits;
+
+	memcpy(&bits, &x, sizeof(bits));
+
+	return (bits & 0x8000000000000000ULL) != 0 ?
+			~bits : bits | 0x8000000000000000ULL;
+}
+
+// First 8 bytes as a big-endian int, zero-padded. Padding sorts a shorter
+// contents first, like msgpack_cmp()'s length tie-break.
+static inline uint64_t
+key_bytes_prefix(const uint8_t *data, uint32_t len)
+{
+	uint64_t prefix = 0;
+
+	memcpy(&prefix, data, len < 8 ? len : 8);
+
+	return cf_swap_from_be64(prefix);
+}
@@ -25,12 +25,18 @@
 extern char *aerospike_client_version;  ///< The C client's version string.
 
 static volatile bool stop = false;  ///< Makes background threads exit.
+static volatile sig_atomic_t interrupted = 0;   ///< Set by the signal handler, which must not
+                                                ///  log, to have report_interrupt() log.
 
 static pthread_cond_t limit_cond = PTHREAD_COND_INITIALIZER;    ///< Used by the counter thread
                                                                 ///  to signal newly available
                                                                 ///  bandwidth or transactions to
                                                                 ///  the restore threads.
 
+static pthread_cond_t async_cond = PTHREAD_COND_INITIALIZER;    ///< Signals completed or
+                                                                ///  retry-queued asynchronous
+                                                                ///  writes to the restore threads.
+
 static void print_stat(per_thread_context *, cf_clock *, uint64_t *, cf_clock *, cf_clock *, cf_clock *);
 
 static void config_default(restore_config *conf);
@@ -417,6 +423,256 @@ cdt_print_rec(as_record *rec)
 	}
 }
 
+///
+/// Classifies the result of a record write and updates the stats accordingly.
+///
+/// @param conf   The global restore configuration and stats.
+/// @param put    The result of the write.
+/// @param ae     The error details. Only used, if the write failed.
+/// @param tries  The number of failed tries before this one.
+///
+/// @result       `true`, if the write should be retried.
+///
+static bool
+check_put_status(restore_config *conf, as_status put, const as_error *ae, int32_t tries)
+{
+	switch (put) {
+		// System level permanent errors. No point in 
+		// continuing. Fail immediately. The list
+		// is by no means complete, all missed cases would
+		// fall into default and go through n_retries cycle
+		// and eventually fail.
+		case AEROSPIKE_ERR_SERVER_FULL:
+		case AEROSPIKE_ROLE_VIOLATION:
+			err("Error while storing record - code %d: %s at %s:%d",
+					ae->code, ae->message, ae->file, ae->line);
+			stop = true;
+			return false;
+
+		// Record specific error either ignored or restore
+		// is aborted. retry is meaningless
+		case AEROSPIKE_ERR_RECORD_TOO_BIG:
+		case AEROSPIKE_ERR_RECORD_KEY_MISMATCH:
+		case AEROSPIKE_ERR_BIN_NAME:
+		case AEROSPIKE_ERR_ALWAYS_FORBIDDEN:
+			if (verbose) {
+				ver("Error while storing record - code %d: %s at %s:%d",
+						ae->code, ae->message, ae->file, ae->line);
+			}
+
+			if (! conf->ignore_rec_error) {
+				stop = true;
+				err("Error while storing record - code %d: %s at %s:%d", ae->code, ae->message, ae->file, ae->line);
+				err("Encountered error while restoring. Skipping retries and aborting!!");
+			}
+			cf_atomic64_incr(&conf->ignored_records);
+			return false;
+
+		// Conditional error based on input config. No
+		// retries.
+		case AEROSPIKE_ERR_RECORD_GENERATION:
+			cf_atomic64_incr(&conf->fresher_records);
+			return false;
+
+		case AEROSPIKE_ERR_RECORD_EXISTS:
+			cf_atomic64_incr(&conf->existed_records);
+			return false;
+
+		case AEROSPIKE_OK:
+			cf_atomic64_incr(&conf->inserted_records);
+			return false;
+
+		// All other cases attempt retry.
+		default: 
+			if (tries == MAX_TRIES - 1) {
+				err("Error while storing record - code %d: %s at %s:%d",
+						ae->code, ae->message, ae->file, ae->line);
+				err("Encountered too many errors while restoring. Aborting!!");
+				stop = true;
+				return false;
+			}
+
+			if (verbose) {
+				ver("Error while storing record - code %d: %s at %s:%d",
+						ae->code, ae->message, ae->file,
+						ae->line);
+			}
+
+			return true;
+	}
+}
+
+///
+/// Waits before retrying a failed write.
+///
+/// @param conf     The global restore configuration and stats.
+/// @param put      The result of the failed write.
+/// @param backoff  The current backoff delay. Doubled for overloaded devices, reset otherwise.
+///
+static void
+retry_backoff(restore_config *conf, as_status put, useconds_t *backoff)
+{
+	// DEVICE_OVERLOAD error always retry with
+	// backoff and sleep.
+	if (put == AEROSPIKE_ERR_DEVICE_OVERLOAD) {
+		usleep(*backoff);
+		*backoff *= 2;
+		cf_atomic64_incr(&conf->backoff_count);
+	} else {
+		*backoff = INITIAL_BACKOFF * 1000;
+		sleep(1);
+	}
+}
+
+///
+/// Marks an asynchronous write as completed, frees it, and wakes up restore threads that wait for
+/// a free in-flight slot.
+///
+/// @param aw  The completed asynchronous write.
+///
+static void
+async_write_done(async_write *aw)
+{
+	restore_config *conf = aw->conf;
+
+	as_record_destroy(&aw->rec);
+	cf_free(aw);
+
+	safe_lock();
+	cf_atomic32_decr(&conf->async_pending);
+	safe_signal(&async_cond);
+	safe_unlock();
+}
+
+///
+/// Completion callback for asynchronous writes. Invoked on an event loop thread.
+///
+/// Transient errors hand the write back to the restore threads via restore_config.async_retries,
+/// so that the event loop never blocks on a backoff delay.
+///
+/// @param ae          The error details, `NULL` on success.
+/// @param udata       The completed asynchronous write.
+/// @param event_loop  The event loop that processed the write.
+///
+static void
+async_write_listener(as_error *ae, void *udata, as_event_loop *event_loop)
+{
+	(void)event_loop;
+	async_write *aw = udata;
+	restore_config *conf = aw->conf;
+	as_status put = ae == NULL ? AEROSPIKE_OK : ae->code;
+
+	if (stop || !check_put_status(conf, put, ae, aw->tries)) {
+		async_write_done(aw);
+		return;
+	}
+
+	++aw->tries;
+	aw->last = put;
+
+	if (cf_queue_push(conf->async_retries, &aw) != CF_QUEUE_OK) {
+		err("Error while queueing write retry");
+		stop = true;
+		async_write_done(aw);
+		return;
+	}
+
+	safe_lock();
+	safe_signal(&async_cond);
+	safe_unlock();
+}
+
+///
+/// Issues an asynchronous write. The caller must have accounted for the write in
+/// restore_config.async_pending.
+///
+/// @param aw  The asynchronous write to be issued.
+///
+static void
+async_write_issue(async_write *aw)
+{
+	as_error ae;
+	aw->policy.key = aw->rec.key.valuep != NULL ? AS_POLICY_KEY_SEND : AS_POLICY_KEY_DIGEST;
+
+	if (aerospike_key_put_async(aw->conf->as, &ae, &aw->policy, &aw->rec.key, &aw->rec,
+			async_write_listener, aw, NULL, NULL) != AEROSPIKE_OK) {
+		async_write_listener(&ae, aw, NULL);
+	}
+}
+
+///
+/// Re-issues queued asynchronous writes that failed with a transient error.
+///
+/// @param conf  The global restore configuration and stats.
+///
+/// @result      `true`, if at least one write was processed.
+///
+static bool
+async_write_retry(restore_config *conf)
+{
+	bool any = false;
+	async_write *aw;
+
+	while (cf_queue_pop(conf->async_retries, &aw, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+		any = true;
+
+		if (stop) {
+			async_write_done(aw);
+			continue;
+		}
+
+		retry_backoff(conf, aw->last, &aw->backoff);
+		async_write_issue(aw);
+	}
+
+	return any;
+}
+
+///
+/// Waits until the number of in-flight asynchronous writes drops below the given limit. Processes
+/// queued retries while waiting.
+///
+/// @param conf   The global restore configuration and stats.
+/// @param limit  The limit. 1 waits for all in-flight writes to complete.
+/// @param take   Account for a new write, once the limit allows it.
+///
+/// @result       `false`, if we were asked to stop while waiting for a slot.
+///
+static bool
+async_write_wait(restore_config *conf, uint32_t limit, bool take)
+{
+	while (true) {
+		if (async_write_retry(conf)) {
+			continue;
+		}
+
+		safe_lock();
+
+		if ((uint32_t)cf_atomic32_get(conf->async_pending) < limit) {
+			bool ok = !take || !stop;
+
+			if (take && ok) {
+				cf_atomic32_incr(&conf->async_pending);
+			}
+
+			safe_unlock();
+			return ok;
+		}
+
+		if (take && stop) {
+			safe_unlock();
+			return false;
+		}
+
+		// the listener signals after queueing a retry; checking under the lock avoids missing it
+		if (cf_queue_sz(conf->async_retries) == 0) {
+			safe_wait(&async_cond);
+		}
+
+		safe_unlock();
+	}
+}
+
 ///
 /// Main restore worker thread function.
 ///
@@ -445,6 +701,13 @@ restore_thread_func(void *cont)
 	cf_queue *job_queue = cont;
 	void *res = (void *)EXIT_FAILURE;
 
+	// synchronous writes are done with a record before the next one gets decoded, so they all
+	// decode into the same record and bin values
+	as_record pool_rec;
+	as_record_init(&pool_rec, 100);
+	value_arena pool_arena;
+	value_arena_init(&pool_arena);
+
 	while (true) {
 		if (stop) {
 			if (verbose) {
@@ -511,8 +774,6 @@ restore_thread_func(void *cont)
 		policy.base.total_timeout = ptc.conf->timeout;
 		policy.base.max_retries = 0;
 
-		bool flag_ignore_rec_error = false;
-
 		if (ptc.conf->replace) {
 			policy.exists = AS_POLICY_EXISTS_CREATE_OR_REPLACE;
 
@@ -529,10 +790,6 @@ restore_thread_func(void *cont)
 			ver("Existence policy is default");
 		}
 
-		if (ptc.conf->ignore_rec_error) {
-			flag_ignore_rec_error = true;
-		}
-
 		if (!ptc.conf->no_generation) {
 			policy.gen = AS_POLICY_GEN_GT;
 
@@ -547,9 +804,20 @@ restore_thread_func(void *cont)
 		uint64_t prev_records = 0;
 
 		while (true) {
-			as_record rec;
+			as_record *rec = &pool_rec;
+			value_arena *arena = &pool_arena;
+			async_write *aw = NULL;
 			bool expired;
 
+			// asynchronous writes: decode straight into the write context, as as_key points into
+			// itself and thus cannot be moved after decoding; the write owns the record and its
+			// values until it completes, so they come from the heap
+			if (ptc.conf->max_async > 0) {
+				aw = safe_malloc(sizeof (async_write));
+				rec = &aw->rec;
+				arena = NULL;
+			}
+
 			// restoring from a single backup file: allow one thread at a time to read
 			if (ptc.conf->input_file != NULL) {
 				safe_lock();
@@ -563,12 +831,13 @@ restore_thread_func(void *cont)
 					safe_unlock();
 				}
 
+				cf_free(aw);
 				break;
 			}
 
 			cf_clock read_start = verbose ? cf_getus() : 0;
 			decoder_status res = ptc.conf->decoder->parse(ptc.fd, ptc.ns_vec,
-					ptc.bin_vec, ptc.line_no, &ptc.conf->total_bytes, &rec, &expired);
+					ptc.bin_vec, ptc.line_no, &ptc.conf->total_bytes, rec, &expired, arena);
 			cf_clock read_time = verbose ? cf_getus() - read_start : 0;
 
 			// set the stop flag inside the critical section; see check above
@@ -585,130 +854,69 @@ restore_thread_func(void *cont)
 					ver("End of validation file reached");
 				}
 
+				cf_free(aw);
 				break;
 			}
 
 			if (res == DECODER_ERROR) {
 				err("Error while restoring validation file %s (line %u)", ptc.path, *ptc.line_no);
+				cf_free(aw);
 				break;
 			}
 
 			if (res == DECODER_RECORD) {
 				if (ptc.conf->cdt_print) {
-					cdt_print_rec(&rec);
+					cdt_print_rec(rec);
 				}
 				else if (expired) {
 					cf_atomic64_incr(&ptc.conf->expired_records);
-				} else if (rec.bins.size == 0 || !check_set(rec.key.set, ptc.set_vec)) {
+				} else if (rec->bins.size == 0 || !check_set(rec->key.set, ptc.set_vec)) {
 					cf_atomic64_incr(&ptc.conf->skipped_records);
+				} else if (aw != NULL) {
+					// the write owns the record from here on
+					if (async_write_wait(ptc.conf, ptc.conf->async_limit, true)) {
+						aw->conf = ptc.conf;
+						aw->policy = policy;
+						aw->tries = 0;
+						aw->last = AEROSPIKE_OK;
+						aw->backoff = INITIAL_BACKOFF * 1000;
+						async_write_issue(aw);
+						aw = NULL;
+					}
 				} else {
 					useconds_t backoff = INITIAL_BACKOFF * 1000;
 					int32_t tries;
 
 					for (tries = 0; tries < MAX_TRIES && !stop; ++tries) {
 						as_error ae;
-						policy.key = rec.key.valuep != NULL ? AS_POLICY_KEY_SEND :
+						policy.key = rec->key.valuep != NULL ? AS_POLICY_KEY_SEND :
 								AS_POLICY_KEY_DIGEST;
 						cf_clock store_start = verbose ? cf_getus() : 0;
-						as_status put = aerospike_key_put(ptc.conf->as, &ae, &policy, &rec.key,
-								&rec);
+						as_status put = aerospike_key_put(ptc.conf->as, &ae, &policy, &rec->key,
+								rec);
 						cf_clock now = verbose ? cf_getus() : 0;
 						cf_clock store_time = now - store_start;
 
-						bool do_retry = false;
-
-						switch (put) {
-							// System level permanent errors. No point in 
-							// continuing. Fail immediately. The list
-							// is by no means complete, all missed cases would
-							// fall into default and go through n_retries cycle
-							// and eventually fail.
-							case AEROSPIKE_ERR_SERVER_FULL:
-							case AEROSPIKE_ROLE_VIOLATION:
-								err("Error while storing record - code %d: %s at %s:%d",
-										ae.code, ae.message, ae.file, ae.line);
-								stop = true;
-								break;
-
-							// Record specific error either ignored or restore
-							// is aborted. retry is meaningless
-							case AEROSPIKE_ERR_RECORD_TOO_BIG:
-							case AEROSPIKE_ERR_RECORD_KEY_MISMATCH:
-							case AEROSPIKE_ERR_BIN_NAME:
-							case AEROSPIKE_ERR_ALWAYS_FORBIDDEN:
-								if (verbose) {
-									ver("Error while storing record - code %d: %s at %s:%d",
-											ae.code, ae.message, ae.file, ae.line);
-								}
-
-								if (! flag_ignore_rec_error) {
-									stop = true;
-									err("Error while storing record - code %d: %s at %s:%d", ae.code, ae.message, ae.file, ae.line);
-									err("Encountered error while restoring. Skipping retries and aborting!!");
-								}
-								cf_atomic64_incr(&ptc.conf->ignored_records);
-								break;
-
-							// Conditional error based on input config. No
-							// retries.
-							case AEROSPIKE_ERR_RECORD_GENERATION:
-								cf_atomic64_incr(&ptc.conf->fresher_records);
-								break;
-
-							case AEROSPIKE_ERR_RECORD_EXISTS:
-								cf_atomic64_incr(&ptc.conf->existed_records);
-								break;
-
-							case AEROSPIKE_OK:
-								if (verbose) {
-									print_stat(&ptc, &prev_log, &prev_records,
-											&now, &store_time, &read_time);
-								}
-								cf_atomic64_incr(&ptc.conf->inserted_records);
-								break;
-
-							// All other cases attempt retry.
-							default: 
-
-								if (tries == MAX_TRIES - 1) {
-									err("Error while storing record - code %d: %s at %s:%d",
-											ae.code, ae.message, ae.file, ae.line);
-									err("Encountered too many errors while restoring. Aborting!!");
-									stop = true;
-									break;
-								}
-
-								do_retry = true;
-
-								if (verbose) {
-									ver("Error while storing record - code %d: %s at %s:%d",
-											ae.code, ae.message, ae.file,
-											ae.line);
-								}
-
-
-								// DEVICE_OVERLOAD error always retry with
-								// backoff and sleep.
-								if (put == AEROSPIKE_ERR_DEVICE_OVERLOAD) {
-									usleep(backoff);
-									backoff *= 2;
-									cf_atomic64_incr(&ptc.conf->backoff_count);
-								} else {
-									backoff = INITIAL_BACKOFF * 1000;
-									sleep(1);
-								} 
-								break;
-
+						if (put == AEROSPIKE_OK && verbose) {
+							print_stat(&ptc, &prev_log, &prev_records, &now, &store_time,
+									&read_time);
 						}
 
-						if (! do_retry) {
+						if (!check_put_status(ptc.conf, put, &ae, tries)) {
 							break;
 						}
+
+						retry_backoff(ptc.conf, put, &backoff);
 					}
 				}
 
 				cf_atomic64_incr(&ptc.conf->total_records);
-				as_record_destroy(&rec);
+
+				// the pooled record gets recycled by the next parse() call
+				if (aw != NULL) {
+					as_record_destroy(rec);
+					cf_free(aw);
+				}
 
 				if (ptc.conf->bandwidth > 0 && ptc.conf->tps > 0) {
 					safe_lock();
@@ -724,6 +932,8 @@ restore_thread_func(void *cont)
 
 				continue;
 			}
+
+			cf_free(aw);
 		}
 
 		// restoring from a single backup file: do nothing
@@ -748,6 +958,9 @@ restore_thread_func(void *cont)
 		stop = true;
 	}
 
+	as_record_destroy(&pool_rec);
+	value_arena_free(&pool_arena);
+
 	if (verbose) {
 		ver("Leaving correction thread");
 	}
@@ -755,6 +968,18 @@ restore_thread_func(void *cont)
 	return res;
 }
 
+///
+/// Logs an interruption by `SIGINT` or `SIGTERM` once. The signal handler cannot log
+/// itself, as the log functions are not reentrant.
+///
+static void
+report_interrupt(void)
+{
+	if (interrupted == 1 && __sync_bool_compare_and_swap(&interrupted, 1, 2)) {
+		err("### Correction interrupted ###");
+	}
+}
+
 ///
 /// Main counter thread function.
 ///
@@ -780,6 +1005,7 @@ counter_thread_func(void *cont)
 
 	while (true) {
 		sleep(1);
+		report_interrupt();
 		bool last_iter = stop;
 
 		cf_clock now_ms = cf_getms();
@@ -995,7 +1221,7 @@ static void
 sig_hand(int32_t sig)
 {
 	(void)sig;
-	err("### Correction interrupted ###");
+	interrupted = 1;
 	stop = true;
 }
 
@@ -1147,6 +1373,11 @@ usage(const char *name)
 	fprintf(stderr, "                      write operations in TPS.\n");
 	fprintf(stderr, " -T TIMEOUT, --timeout=TIMEOUT\n");
 	fprintf(stderr, "                      Set the timeout (ms) for commands. Default: 10000\n");
+	fprintf(stderr, "  --max-async <n>\n");
+	fprintf(stderr, "                      Pipeline writes asynchronously with up to n in-flight\n");
+	fprintf(stderr, "                      writes per cluster node. The correction threads then\n");
+	fprintf(stderr, "                      only decode records, so a few suffice.\n");
+	fprintf(stderr, "                      Default: 0, i.e., synchronous writes.\n");
 
 	fprintf(stderr, "\n\n");
 	fprintf(stderr, "Default configuration files are read from the following files in the given order:\n");
@@ -1232,6 +1463,7 @@ main(int32_t argc, char **argv)
 		{ "nice", required_argument, NULL, 'N' },
 		{ "services-alternate", no_argument, NULL, 'S' },
 		{ "timeout", required_argument, 0, 'T' },
+		{ "max-async", required_argument, 0, MAX_ASYNC_OPT },
 		{ NULL, 0, NULL, 0 }
 	};
 
@@ -1491,6 +1723,15 @@ main(int32_t argc, char **argv)
 			conf.timeout = (uint32_t)tmp;
 			break;
 
+		case MAX_ASYNC_OPT:
+			if (!better_atoi(optarg, &tmp) || tmp > MAX_ASYNC) {
+				err("Invalid max-async value %s", optarg);
+				goto cleanup1;
+			}
+
+			conf.max_async = (uint32_t)tmp;
+			break;
+
 		case CONFIG_FILE_OPT_FILE:
 		case CONFIG_FILE_OPT_INSTANCE:
 		case CONFIG_FILE_OPT_NO_CONFIG_FILE:
@@ -1584,6 +1825,21 @@ main(int32_t argc, char **argv)
 	memcpy(&as_conf.tls, &conf.tls, sizeof(as_config_tls));
 	memset(&conf.tls, 0, sizeof(conf.tls));
 
+	if (conf.max_async > 0) {
+		if (as_conf.async_max_conns_per_node < conf.max_async) {
+			as_conf.async_max_conns_per_node = conf.max_async;
+		}
+
+		if (verbose) {
+			ver("Creating %d event loop(s)", ASYNC_EVENT_LOOPS);
+		}
+
+		if (as_event_create_loops(ASYNC_EVENT_LOOPS) == NULL) {
+			err("Error while creating event loops");
+			goto cleanup2;
+		}
+	}
+
 	aerospike as;
 	aerospike_init(&as, &as_conf);
 	conf.as = &as;
@@ -1637,6 +1893,14 @@ main(int32_t argc, char **argv)
 	restore_args.path = NULL;
 	restore_args.shared_fd = NULL;
 	restore_args.line_no = NULL;
+	conf.async_limit = conf.max_async * (n_node_names > 0 ? n_node_names : 1);
+
+	if (conf.max_async > 0 &&
+			(conf.async_retries = cf_queue_create(sizeof (async_write *), true)) == NULL) {
+		err_code("Error while allocating retry queue");
+		goto cleanup5;
+	}
+
 	cf_queue *job_queue = cf_queue_create(sizeof (restore_thread_args), true);
 
 	if (job_queue == NULL) {
@@ -1808,6 +2072,15 @@ cleanup10:
 		}
 	}
 
+	// asynchronous writes: wait for the in-flight writes and re-issue their retries
+	if (conf.max_async > 0) {
+		if (verbose) {
+			ver("Waiting for %u in-flight write(s)", cf_atomic32_get(conf.async_pending));
+		}
+
+		async_write_wait(&conf, 1, false);
+	}
+
 cleanup8:
 	if (conf.directory != NULL) {
 		for (uint32_t i = 0; i < file_vec.size; ++i) {
@@ -1827,6 +2100,10 @@ cleanup6:
 	cf_queue_destroy(job_queue);
 
 cleanup5:
+	if (conf.async_retries != NULL) {
+		cf_queue_destroy(conf.async_retries);
+	}
+
 	stop = true;
 
 	if (verbose) {
@@ -1848,6 +2125,10 @@ cleanup4:
 cleanup3:
 	aerospike_destroy(&as);
 
+	if (conf.max_async > 0) {
+		as_event_close_loops();
+	}
+
 cleanup2:
 	if (mach_fd != NULL) {
 		fclose(mach_fd);
@@ -1906,6 +2187,8 @@ cleanup1:
 		cf_free(conf.tls.certfile);
 	}
 
+	report_interrupt();
+
 	if (verbose) {
 		ver("Exiting with status code %d", res);
 	}
@@ -1938,6 +2221,10 @@ config_default(restore_config *conf)
 	conf->bandwidth = 0;
 	conf->tps = 0;
 	conf->timeout = TIMEOUT;
+	conf->max_async = 0;
+	conf->async_limit = 0;
+	cf_atomic32_set(&conf->async_pending, 0);
+	conf->async_retries = NULL;
 	memset(&conf->tls, 0, sizeof(as_config_tls));
 };
 
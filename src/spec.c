@@ -0,0 +1,447 @@
+/*
+ * Aerospike Record Specification Parser
+ *
+ * Copyright (c) 2008-2017 Aerospike, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <spec.h>
+
+#define MAX_SPEC_DEPTH 32       ///< The maximal nesting depth of value specifications.
+#define MAX_SPEC_KEYWORD 20     ///< The maximal length of a keyword.
+
+///
+/// The parser state: the specification text and the current position in it.
+///
+typedef struct {
+	const char *text;           ///< The specification text.
+	size_t pos;                 ///< The current offset into the text.
+	uint32_t line_no;           ///< The current line.
+	uint32_t col_no;            ///< The current column.
+} spec_parser;
+
+///
+/// Skips white space and `;` comments.
+///
+/// @param sp  The parser state.
+///
+/// @result    The next character, `0` at the end of the text.
+///
+static char
+spec_skip(spec_parser *sp)
+{
+	while (true) {
+		char ch = sp->text[sp->pos];
+
+		if (ch == ';') {
+			while (sp->text[sp->pos] != 0 && sp->text[sp->pos] != '\n') {
+				++sp->pos;
+			}
+
+			continue;
+		}
+
+		if (ch == '\n') {
+			++sp->line_no;
+			sp->col_no = 1;
+			++sp->pos;
+			continue;
+		}
+
+		if (ch == ' ' || ch == '\t' || ch == '\r') {
+			++sp->col_no;
+			++sp->pos;
+			continue;
+		}
+
+		return ch;
+	}
+}
+
+///
+/// Consumes the given character.
+///
+/// @param sp  The parser state.
+/// @param ch  The expected character.
+///
+/// @result    `true`, if successful.
+///
+static bool
+spec_expect(spec_parser *sp, char ch)
+{
+	char x = spec_skip(sp);
+
+	if (x != ch) {
+		err("Unexpected %s in specification (line %u, col %u), expected %s",
+				x == 0 ? "end of file" : print_char(x), sp->line_no, sp->col_no, print_char(ch));
+		return false;
+	}
+
+	++sp->pos;
+	++sp->col_no;
+	return true;
+}
+
+///
+/// Parses a keyword, i.e., a sequence of lower-case letters.
+///
+/// @param sp       The parser state.
+/// @param keyword  The output buffer for the keyword. At least MAX_SPEC_KEYWORD + 1 bytes.
+///
+/// @result         `true`, if successful.
+///
+static bool
+spec_keyword(spec_parser *sp, char *keyword)
+{
+	spec_skip(sp);
+	size_t len = 0;
+
+	while (sp->text[sp->pos] >= 'a' && sp->text[sp->pos] <= 'z') {
+		if (len == MAX_SPEC_KEYWORD) {
+			err("Keyword too long in specification (line %u, col %u)", sp->line_no, sp->col_no);
+			return false;
+		}
+
+		keyword[len++] = sp->text[sp->pos++];
+		++sp->col_no;
+	}
+
+	keyword[len] = 0;
+
+	if (len == 0) {
+		err("Expected keyword in specification (line %u, col %u)", sp->line_no, sp->col_no);
+		return false;
+	}
+
+	return true;
+}
+
+///
+/// Parses an unsigned 32-bit number.
+///
+/// @param sp   The parser state.
+/// @param val  The parsed number.
+///
+/// @result     `true`, if successful.
+///
+static bool
+spec_number(spec_parser *sp, uint32_t *val)
+{
+	spec_skip(sp);
+	uint64_t res = 0;
+	size_t start = sp->pos;
+
+	while (sp->text[sp->pos] >= '0' && sp->text[sp->pos] <= '9') {
+		res = res * 10 + (uint64_t)(sp->text[sp->pos++] - '0');
+		++sp->col_no;
+
+		if (res > UINT32_MAX) {
+			err("Number too large in specification (line %u, col %u)", sp->line_no, sp->col_no);
+			return false;
+		}
+	}
+
+	if (sp->pos == start) {
+		err("Expected number in specification (line %u, col %u)", sp->line_no, sp->col_no);
+		return false;
+	}
+
+	*val = (uint32_t)res;
+	return true;
+}
+
+///
+/// Frees a value specification.
+///
+/// @param value  The value specification to be freed. May be `NULL`.
+///
+static void
+spec_free_value(spec_value *value)
+{
+	if (value == NULL) {
+		return;
+	}
+
+	spec_free_value(value->sub1);
+	spec_free_value(value->sub2);
+	cf_free(value);
+}
+
+///
+/// Parses a value specification, e.g., `(list 3 (string 50))`.
+///
+/// @param sp     The parser state.
+/// @param depth  The current nesting depth.
+///
+/// @result       The parsed value specification, `NULL` on error.
+///
+static spec_value *
+spec_parse_value(spec_parser *sp, uint32_t depth)
+{
+	if (depth > MAX_SPEC_DEPTH) {
+		err("Specification nested too deeply (line %u, col %u)", sp->line_no, sp->col_no);
+		return NULL;
+	}
+
+	char keyword[MAX_SPEC_KEYWORD + 1];
+
+	if (!spec_expect(sp, '(') || !spec_keyword(sp, keyword)) {
+		return NULL;
+	}
+
+	spec_value *value = safe_malloc(sizeof (spec_value));
+	memset(value, 0, sizeof (spec_value));
+
+	if (strcmp(keyword, "nil") == 0) {
+		value->type = SPEC_NIL;
+	} else if (strcmp(keyword, "integer") == 0) {
+		value->type = SPEC_INTEGER;
+	} else if (strcmp(keyword, "double") == 0) {
+		value->type = SPEC_DOUBLE;
+	} else if (strcmp(keyword, "string") == 0) {
+		value->type = SPEC_STRING;
+
+		if (!spec_number(sp, &value->size)) {
+			goto cleanup1;
+		}
+	} else if (strcmp(keyword, "bytes") == 0) {
+		value->type = SPEC_BYTES;
+
+		if (!spec_number(sp, &value->size)) {
+			goto cleanup1;
+		}
+	} else if (strcmp(keyword, "list") == 0) {
+		value->type = SPEC_LIST;
+
+		if (!spec_number(sp, &value->size) ||
+				(value->sub1 = spec_parse_value(sp, depth + 1)) == NULL) {
+			goto cleanup1;
+		}
+	} else if (strcmp(keyword, "map") == 0) {
+		value->type = SPEC_MAP;
+
+		if (!spec_number(sp, &value->size) ||
+				(value->sub1 = spec_parse_value(sp, depth + 1)) == NULL ||
+				(value->sub2 = spec_parse_value(sp, depth + 1)) == NULL) {
+			goto cleanup1;
+		}
+	} else {
+		err("Invalid value type %s in specification (line %u, col %u)", keyword, sp->line_no,
+				sp->col_no);
+		goto cleanup1;
+	}
+
+	if (!spec_expect(sp, ')')) {
+		goto cleanup1;
+	}
+
+	return value;
+
+cleanup1:
+	spec_free_value(value);
+	return NULL;
+}
+
+///
+/// Frees the bin specifications of a record specification.
+///
+/// @param rec  The record specification.
+///
+static void
+spec_free_record(spec_record *rec)
+{
+	for (uint32_t i = 0; i < rec->bins.size; ++i) {
+		spec_bins *bins = as_vector_get(&rec->bins, i);
+		spec_free_value(bins->value);
+	}
+
+	as_vector_destroy(&rec->bins);
+}
+
+///
+/// Parses a record specification, e.g., `(record "map" 1 (map 3 (integer) (string 50)))`.
+///
+/// @param sp   The parser state.
+/// @param rec  The parsed record specification.
+///
+/// @result     `true`, if successful.
+///
+static bool
+spec_parse_record(spec_parser *sp, spec_record *rec)
+{
+	char keyword[MAX_SPEC_KEYWORD + 1];
+
+	if (!spec_expect(sp, '(') || !spec_keyword(sp, keyword)) {
+		return false;
+	}
+
+	if (strcmp(keyword, "record") != 0) {
+		err("Expected record in specification (line %u, col %u)", sp->line_no, sp->col_no);
+		return false;
+	}
+
+	if (!spec_expect(sp, '"')) {
+		return false;
+	}
+
+	size_t len = 0;
+
+	while (sp->text[sp->pos] != '"') {
+		if (sp->text[sp->pos] == 0 || sp->text[sp->pos] == '\n' || len == MAX_SPEC_NAME) {
+			err("Invalid record name in specification (line %u, col %u)", sp->line_no,
+					sp->col_no);
+			return false;
+		}
+
+		rec->name[len++] = sp->text[sp->pos++];
+		++sp->col_no;
+	}
+
+	rec->name[len] = 0;
+	++sp->pos;
+	++sp->col_no;
+
+	as_vector_init(&rec->bins, sizeof (spec_bins), 4);
+	rec->n_bins = 0;
+
+	while (spec_skip(sp) != ')') {
+		spec_bins bins;
+
+		if (!spec_number(sp, &bins.count) ||
+				(bins.value = spec_parse_value(sp, 0)) == NULL) {
+			goto cleanup1;
+		}
+
+		as_vector_append(&rec->bins, &bins);
+		rec->n_bins += bins.count;
+	}
+
+	if (rec->bins.size == 0) {
+		err("Record %s without bins in specification (line %u, col %u)", rec->name,
+				sp->line_no, sp->col_no);
+		goto cleanup1;
+	}
+
+	++sp->pos;
+	++sp->col_no;
+	return true;
+
+cleanup1:
+	spec_free_record(rec);
+	return false;
+}
+
+///
+/// Parses a specification file.
+///
+/// @param path     The specification file.
+/// @param records  Initialized and populated with the parsed spec_record elements.
+///
+/// @result         `true`, if successful.
+///
+bool
+spec_parse_file(const char *path, as_vector *records)
+{
+	bool res = false;
+	FILE *fd = fopen(path, "r");
+
+	if (fd == NULL) {
+		err_code("Error while opening specification file %s", path);
+		goto cleanup0;
+	}
+
+	struct stat sb;
+
+	if (fstat(fileno(fd), &sb) < 0) {
+		err_code("Error while determining size of specification file %s", path);
+		goto cleanup1;
+	}
+
+	char *text = safe_malloc((size_t)sb.st_size + 1);
+
+	if (fread(text, 1, (size_t)sb.st_size, fd) != (size_t)sb.st_size) {
+		err_code("Error while reading specification file %s", path);
+		goto cleanup2;
+	}
+
+	text[sb.st_size] = 0;
+
+	spec_parser sp = { .text = text, .pos = 0, .line_no = 1, .col_no = 1 };
+	as_vector_init(records, sizeof (spec_record), 16);
+
+	while (spec_skip(&sp) != 0) {
+		spec_record rec;
+
+		if (!spec_parse_record(&sp, &rec)) {
+			spec_free(records);
+			goto cleanup2;
+		}
+
+		as_vector_append(records, &rec);
+	}
+
+	res = true;
+
+cleanup2:
+	cf_free(text);
+
+cleanup1:
+	fclose(fd);
+
+cleanup0:
+	return res;
+}
+
+///
+/// Frees the record specifications parsed by spec_parse_file().
+///
+/// @param records  The spec_record elements.
+///
+void
+spec_free(as_vector *records)
+{
+	for (uint32_t i = 0; i < records->size; ++i) {
+		spec_free_record(as_vector_get(records, i));
+	}
+
+	as_vector_destroy(records);
+}
+
+///
+/// Looks up a record specification by name.
+///
+/// @param records  The spec_record elements.
+/// @param name     The name of the record specification.
+///
+/// @result         The record specification, `NULL` if not found.
+///
+const spec_record *
+spec_find(const as_vector *records, const char *name)
+{
+	for (uint32_t i = 0; i < records->size; ++i) {
+		const spec_record *rec = as_vector_get((as_vector *)records, i);
+
+		if (strcmp(rec->name, name) == 0) {
+			return rec;
+		}
+	}
+
+	return NULL;
+}
@@ -0,0 +1,475 @@
+/*
+ * Aerospike io_uring Output Writer
+ *
+ * Copyright (c) 2008-2017 Aerospike, Inc. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <uring.h>
+
+#if defined USE_IO_URING
+
+#include <liburing.h>
+
+#define URING_SYNC URING_BUFFERS        ///< The completion tag of the final fdatasync().
+
+///
+/// An output file written through io_uring. Output is collected in a ring of buffers that are
+/// registered with the kernel. Each full buffer is submitted as an asynchronous write, while
+/// the next buffer is being filled. The writer only blocks when all buffers are in flight.
+///
+typedef struct uring_file_s {
+	int32_t fd;                         ///< The native file descriptor.
+	FILE *stream;                       ///< The file's stdio stream.
+	struct uring_file_s *next;          ///< The next open output file, see uring_is_file().
+	struct io_uring ring;               ///< The file's submission and completion queues.
+	char *bufs;                         ///< URING_BUFFERS buffers of URING_BUF_SIZE bytes each.
+	bool fixed;                         ///< The buffers could be registered with the kernel.
+	bool busy[URING_BUFFERS];           ///< The buffer is being written.
+	size_t len[URING_BUFFERS];          ///< The number of bytes to be written from the buffer.
+	size_t done[URING_BUFFERS];         ///< The number of bytes written from the buffer so far.
+	uint64_t off[URING_BUFFERS];        ///< The file offset of the buffer's data.
+	uint32_t in_flight;                 ///< The number of submitted, but uncompleted operations.
+	uint32_t cur;                       ///< The buffer that's being filled.
+	size_t fill;                        ///< The number of bytes in the buffer that's being filled.
+	uint64_t offset;                    ///< The file offset of the next buffer to be submitted.
+	bool closing;                       ///< The final fdatasync() has been submitted.
+	bool resync;                        ///< A write was resubmitted after the final fdatasync().
+	int32_t err;                        ///< The first error, as an errno value. `0`, if none.
+} uring_file;
+
+static pthread_mutex_t open_lock = PTHREAD_MUTEX_INITIALIZER;  ///< Protects open_files.
+static uring_file *open_files = NULL;   ///< The open output files.
+
+///
+/// Submits the remaining data of a buffer as an asynchronous write.
+///
+/// @param uf  The output file.
+/// @param i   The buffer.
+///
+/// @result    `true`, if successful.
+///
+static bool
+uring_submit_write(uring_file *uf, uint32_t i)
+{
+	// the queue has room for all buffers plus the final fdatasync()
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&uf->ring);
+	const char *data = uf->bufs + (size_t)i * URING_BUF_SIZE + uf->done[i];
+	unsigned len = (unsigned)(uf->len[i] - uf->done[i]);
+
+	if (uf->fixed) {
+		io_uring_prep_write_fixed(sqe, uf->fd, data, len, uf->off[i] + uf->done[i], (int)i);
+	} else {
+		io_uring_prep_write(sqe, uf->fd, data, len, uf->off[i] + uf->done[i]);
+	}
+
+	io_uring_sqe_set_data(sqe, (void *)(uintptr_t)i);
+	int32_t res = io_uring_submit(&uf->ring);
+
+	if (res < 0) {
+		uf->err = -res;
+		return false;
+	}
+
+	++uf->in_flight;
+	return true;
+}
+
+///
+/// Waits for an operation to complete and processes its result. Resubmits the rest of short
+/// writes.
+///
+/// @param uf  The output file.
+///
+/// @result    `false`, if waiting failed. Errors of the completed operation go to `err`.
+///
+static bool
+uring_reap(uring_file *uf)
+{
+	struct io_uring_cqe *cqe;
+	int32_t res = io_uring_wait_cqe(&uf->ring, &cqe);
+
+	if (res < 0) {
+		uf->err = uf->err != 0 ? uf->err : -res;
+		return false;
+	}
+
+	uint32_t i = (uint32_t)(uintptr_t)io_uring_cqe_get_data(cqe);
+	res = cqe->res;
+	io_uring_cqe_seen(&uf->ring, cqe);
+	--uf->in_flight;
+
+	if (res < 0 || (res == 0 && i != URING_SYNC)) {
+		uf->err = uf->err != 0 ? uf->err : (res < 0 ? -res : EIO);
+	}
+
+	if (i == URING_SYNC) {
+		return true;
+	}
+
+	if (res > 0) {
+		uf->done[i] += (size_t)res;
+
+		if (uf->done[i] < uf->len[i] && uf->err == 0) {
+			// the drained fdatasync() doesn't cover the rest of a short write
+			uf->resync = uf->resync || uf->closing;
+
+			if (uring_submit_write(uf, i)) {
+				return true;
+			}
+		}
+	}
+
+	uf->busy[i] = false;
+	return true;
+}
+
+///
+/// Submits the buffer that's being filled.
+///
+/// @param uf  The output file.
+///
+/// @result    `true`, if successful.
+///
+static bool
+uring_submit_buffer(uring_file *uf)
+{
+	uint32_t i = uf->cur;
+	uf->busy[i] = true;
+	uf->len[i] = uf->fill;
+	uf->done[i] = 0;
+	uf->off[i] = uf->offset;
+
+	uf->offset += uf->fill;
+	uf->fill = 0;
+
+	if (!uring_submit_write(uf, i)) {
+		uf->busy[i] = false;
+		return false;
+	}
+
+	return true;
+}
+
+///
+/// Moves on to the next buffer. Waits for it, if it's still being written.
+///
+/// @param uf  The output file.
+///
+/// @result    `true`, if successful.
+///
+static bool
+uring_next_buffer(uring_file *uf)
+{
+	uf->cur = (uf->cur + 1) % URING_BUFFERS;
+
+	while (uf->busy[uf->cur]) {
+		if (!uring_reap(uf)) {
+			return false;
+		}
+	}
+
+	return uf->err == 0;
+}
+
+///
+/// The write function of the output file's stdio stream. Passed to `fopencookie()`.
+///
+/// @param cookie  The output file.
+/// @param data    The data to be written.
+/// @param size    The size of the data.
+///
+/// @result        The number of bytes written, `-1` on error.
+///
+static ssize_t
+uring_write(void *cookie, const char *data, size_t size)
+{
+	uring_file *uf = cookie;
+	size_t left = size;
+
+	while (left > 0) {
+		if (uf->err != 0) {
+			errno = uf->err;
+			return -1;
+		}
+
+		size_t n = URING_BUF_SIZE - uf->fill;
+		n = n < left ? n : left;
+
+		memcpy(uf->bufs + (size_t)uf->cur * URING_BUF_SIZE + uf->fill, data, n);
+		uf->fill += n;
+		data += n;
+		left -= n;
+
+		if (uf->fill == URING_BUF_SIZE && uring_submit_buffer(uf)) {
+			uring_next_buffer(uf);
+		}
+	}
+
+	if (uf->err != 0) {
+		errno = uf->err;
+		return -1;
+	}
+
+	return (ssize_t)size;
+}
+
+///
+/// The close function of the output file's stdio stream. Passed to `fopencookie()`.
+///
+///   - Submits the partially filled buffer.
+///   - Submits an fdatasync() that the kernel only starts after all writes completed.
+///   - Waits for everything to complete and closes the file.
+///
+/// @param cookie  The output file.
+///
+/// @result        `0` on success, `-1` on error.
+///
+static int
+uring_close(void *cookie)
+{
+	uring_file *uf = cookie;
+
+	pthread_mutex_lock(&open_lock);
+
+	for (uring_file **walk = &open_files; *walk != NULL; walk = &(*walk)->next) {
+		if (*walk == uf) {
+			*walk = uf->next;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&open_lock);
+
+	if (uf->err == 0 && uf->fill > 0) {
+		uring_submit_buffer(uf);
+	}
+
+	if (uf->err == 0) {
+		struct io_uring_sqe *sqe = io_uring_get_sqe(&uf->ring);
+		io_uring_prep_fsync(sqe, uf->fd, IORING_FSYNC_DATASYNC);
+		io_uring_sqe_set_flags(sqe, IOSQE_IO_DRAIN);
+		io_uring_sqe_set_data(sqe, (void *)(uintptr_t)URING_SYNC);
+		int32_t res = io_uring_submit(&uf->ring);
+
+		if (res < 0) {
+			uf->err = -res;
+		} else {
+			++uf->in_flight;
+			uf->closing = true;
+		}
+	}
+
+	while (uf->in_flight > 0 && uring_reap(uf)) {
+	}
+
+	if (uf->err == 0 && uf->resync && fdatasync(uf->fd) < 0) {
+		uf->err = errno;
+	}
+
+	if (close(uf->fd) < 0 && uf->err == 0) {
+		uf->err = errno;
+	}
+
+	int32_t err = uf->err;
+	io_uring_queue_exit(&uf->ring);
+	cf_free(uf->bufs);
+	cf_free(uf);
+
+	if (err != 0) {
+		errno = err;
+		return -1;
+	}
+
+	return 0;
+}
+
+///
+/// Checks whether the kernel supports io_uring.
+///
+/// @result  `true`, if it does.
+///
+bool
+uring_probe(void)
+{
+	struct io_uring ring;
+	int32_t res = io_uring_queue_init(2, &ring, 0);
+
+	if (res < 0) {
+		errno = -res;
+		err_code("io_uring is unavailable");
+		return false;
+	}
+
+	io_uring_queue_exit(&ring);
+	return true;
+}
+
+///
+/// Creates an output file that is written through io_uring. The returned stdio stream does its
+/// own buffering and should be unbuffered. Closing it syncs the file.
+///
+/// @param file_path  The path of the output file.
+/// @param topo       The NUMA topology. May be `NULL`.
+/// @param node       The NUMA node of the thread that's going to write the file. May be `-1`.
+///
+/// @result           The stdio stream of the output file, `NULL` on error.
+///
+FILE *
+uring_open(const char *file_path, const numa_topology *topo, int32_t node)
+{
+	uring_file *uf = safe_malloc(sizeof (uring_file));
+	memset(uf, 0, sizeof (uring_file));
+
+	if ((uf->fd = open(file_path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+		err_code("Error while creating output file %s", file_path);
+		goto cleanup1;
+	}
+
+	int32_t res = io_uring_queue_init(URING_BUFFERS + 1, &uf->ring, 0);
+
+	if (res < 0) {
+		errno = -res;
+		err_code("Error while setting up io_uring for output file %s", file_path);
+		goto cleanup2;
+	}
+
+	uf->bufs = safe_malloc((size_t)URING_BUFFERS * URING_BUF_SIZE);
+
+	// before registering, which pins the pages wherever they get touched
+	numa_bind(topo, node, uf->bufs, (size_t)URING_BUFFERS * URING_BUF_SIZE);
+	struct iovec iov[URING_BUFFERS];
+
+	for (uint32_t i = 0; i < URING_BUFFERS; ++i) {
+		iov[i].iov_base = uf->bufs + (size_t)i * URING_BUF_SIZE;
+		iov[i].iov_len = URING_BUF_SIZE;
+	}
+
+	// registering can fail, e.g., because of RLIMIT_MEMLOCK; plain writes still work then
+	uf->fixed = io_uring_register_buffers(&uf->ring, iov, URING_BUFFERS) == 0;
+
+	if (!uf->fixed && verbose) {
+		ver("Using unregistered io_uring buffers for output file %s", file_path);
+	}
+
+	cookie_io_functions_t funcs = {
+		.read = NULL, .write = uring_write, .seek = NULL, .close = uring_close
+	};
+
+	FILE *fd = fopencookie(uf, "w", funcs);
+
+	if (fd == NULL) {
+		err_code("Error while creating stream for output file %s", file_path);
+		goto cleanup3;
+	}
+
+	uf->stream = fd;
+	pthread_mutex_lock(&open_lock);
+	uf->next = open_files;
+	open_files = uf;
+	pthread_mutex_unlock(&open_lock);
+	return fd;
+
+cleanup3:
+	cf_free(uf->bufs);
+	io_uring_queue_exit(&uf->ring);
+
+cleanup2:
+	close(uf->fd);
+
+cleanup1:
+	cf_free(uf);
+	return NULL;
+}
+
+///
+/// Checks whether a stdio stream is an output file created by uring_open().
+///
+/// @param fd  The stdio stream.
+///
+/// @result    `true`, if it is.
+///
+bool
+uring_is_file(FILE *fd)
+{
+	bool res = false;
+	pthread_mutex_lock(&open_lock);
+
+	for (uring_file *walk = open_files; walk != NULL; walk = walk->next) {
+		if (walk->stream == fd) {
+			res = true;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&open_lock);
+	return res;
+}
+
+#else
+
+///
+/// Checks whether the kernel supports io_uring. Without `USE_IO_URING`, it never does.
+///
+/// @result  Always `false`.
+///
+bool
+uring_probe(void)
+{
+	err("io_uring support wasn't compiled in; rebuild with USE_IO_URING=1");
+	return false;
+}
+
+///
+/// Creates an output file that is written through io_uring. Without `USE_IO_URING`, that always
+/// fails.
+///
+/// @param file_path  The path of the output file.
+/// @param topo       The NUMA topology. May be `NULL`.
+/// @param node       The NUMA node of the thread that's going to write the file. May be `-1`.
+///
+/// @result           Always `NULL`.
+///
+FILE *
+uring_open(const char *file_path, const numa_topology *topo, int32_t node)
+{
+	(void)file_path;
+	(void)topo;
+	(void)node;
+	errno = ENOSYS;
+	return NULL;
+}
+
+///
+/// Checks whether a stdio stream is an output file created by uring_open(). Without
+/// `USE_IO_URING`, it never is.
+///
+/// @param fd  The stdio stream.
+///
+/// @result    Always `false`.
+///
+bool
+uring_is_file(FILE *fd)
+{
+	(void)fd;
+	return false;
+}
+
+#endif
@@ -27,6 +27,46 @@ static pthread_mutex_t mutex = MUTEX_INIT;                  ///< Mutex used by s
                                                             ///  safe_unlock(), and safe_wait().
 bool verbose = false;                                       ///< Enables verbose logging.
 
+///
+/// The logging state of a thread. Owned by one thread at a time. When a thread exits, the next
+/// new thread takes over its state, so that the number of states stays bounded.
+///
+/// While the log thread is running, the owning thread appends its log lines to the state's ring
+/// and the log thread drains the ring. The owning thread is the only one that moves the ring's
+/// head, the log thread is the only one that moves its tail, so neither needs a lock.
+///
+typedef struct log_state_s {
+	struct log_state_s *next;           ///< The next state in the list of all states.
+	uint32_t owned;                     ///< Whether a thread currently owns the state.
+	pid_t tid;                          ///< The ID of the owning thread.
+	time_t ts_sec;                      ///< The second of the cached timestamp.
+	size_t ts_len;                      ///< The length of the cached timestamp.
+	char ts[64];                        ///< The cached timestamp, formatted for ts_sec.
+	uint64_t rep_hash[2];               ///< The hash of the thread's last error message.
+	time_t rep_start;                   ///< When the last error message's repeat window began.
+	uint32_t rep_count;                 ///< How often the last error message occurred in the
+	                                    ///  repeat window.
+	uint32_t rep_dropped;               ///< The number of suppressed repeats that haven't been
+	                                    ///  reported yet.
+	char *ring;                         ///< The log ring, LOG_RING_SIZE bytes of log lines.
+	                                    ///  Allocated when first used.
+	uint64_t head;                      ///< The total number of bytes appended to the ring.
+	uint64_t tail;                      ///< The total number of bytes drained from the ring.
+	char line[LOG_LINE_SIZE];           ///< The log line being formatted.
+} log_state;
+
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;         ///< Creates log_key.
+static pthread_key_t log_key;                               ///< The current thread's log_state.
+static log_state *log_states = NULL;                        ///< The list of all log_state
+                                                            ///  structs.
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;   ///< Serializes additions to
+                                                            ///  log_states.
+static pthread_t log_thread;                                ///< The thread that drains the log
+                                                            ///  rings.
+static volatile bool log_async = false;                     ///< Whether the log thread is
+                                                            ///  running.
+static volatile bool log_stopping = false;                  ///< Makes the log thread exit.
+
 ///
 /// Lookup table for base-64 decoding. Invalid characters yield 0xff. '=' (0x3d) yields 0x00 to
 /// make it a legal character.
@@ -68,7 +108,232 @@ thread_id(void)
 }
 
 ///
-/// Central log function. Writes a single log message.
+/// Exits after a failure in the logging code itself, which cannot be logged.
+///
+/// @param what  What failed.
+///
+static void
+log_fatal(const char *what)
+{
+	fprintf(stderr, "%s, error %d, %s\n", what, errno, strerror(errno));
+	exit(EXIT_FAILURE);
+}
+
+///
+/// Writes log output to `stderr`.
+///
+/// @param data  The log output.
+/// @param len   The size of the log output.
+///
+static void
+log_write(const char *data, size_t len)
+{
+	fwrite(data, 1, len, stderr);
+}
+
+///
+/// Updates a logging state's cached timestamp, if a new second has begun.
+///
+/// @param ls  The logging state.
+///
+static void
+log_timestamp(log_state *ls)
+{
+	time_t now = time(NULL);
+
+	if (now == (time_t)-1) {
+		log_fatal("Error while getting current time");
+	}
+
+	if (LIKELY(now == ls->ts_sec)) {
+		return;
+	}
+
+	struct tm now_tm;
+
+	if (gmtime_r(&now, &now_tm) == NULL) {
+		log_fatal("Error while calculating GMT");
+	}
+
+	ls->ts_len = strftime(ls->ts, sizeof ls->ts, "%Y-%m-%d %H:%M:%S %Z ", &now_tm);
+
+	if (ls->ts_len == 0) {
+		log_fatal("Error while converting time to string");
+	}
+
+	ls->ts_sec = now;
+}
+
+///
+/// Outputs a log line of a thread. Appends the line to the thread's log ring, while the log
+/// thread is running. Waits, while the ring is full.
+///
+/// @param ls    The thread's logging state.
+/// @param line  The log line, including the terminating `\n`.
+/// @param len   The length of the log line.
+///
+static void
+log_put(log_state *ls, const char *line, size_t len)
+{
+	if (!log_async) {
+		log_write(line, len);
+		return;
+	}
+
+	if (ls->ring == NULL && (ls->ring = cf_malloc(LOG_RING_SIZE)) == NULL) {
+		log_write(line, len);
+		return;
+	}
+
+	uint64_t head = ls->head;
+
+	while (head + len - __atomic_load_n(&ls->tail, __ATOMIC_ACQUIRE) > LOG_RING_SIZE) {
+		if (!log_async) {
+			log_write(line, len);
+			return;
+		}
+
+		usleep(LOG_WAIT_US);
+	}
+
+	size_t pos = head % LOG_RING_SIZE;
+	size_t first = len < LOG_RING_SIZE - pos ? len : LOG_RING_SIZE - pos;
+	memcpy(ls->ring + pos, line, first);
+	memcpy(ls->ring, line + first, len - first);
+
+	// publish the line only after it was copied
+	__atomic_store_n(&ls->head, head + len, __ATOMIC_RELEASE);
+}
+
+///
+/// Outputs the pending log lines of a thread's log ring.
+///
+/// @param ls  The thread's logging state.
+///
+/// @result    `true`, if there were pending log lines.
+///
+static bool
+log_drain(log_state *ls)
+{
+	uint64_t head = __atomic_load_n(&ls->head, __ATOMIC_ACQUIRE);
+	uint64_t tail = ls->tail;
+
+	if (head == tail) {
+		return false;
+	}
+
+	size_t pos = tail % LOG_RING_SIZE;
+	size_t len = (size_t)(head - tail);
+	size_t first = len < LOG_RING_SIZE - pos ? len : LOG_RING_SIZE - pos;
+	log_write(ls->ring + pos, first);
+
+	if (len > first) {
+		log_write(ls->ring, len - first);
+	}
+
+	__atomic_store_n(&ls->tail, head, __ATOMIC_RELEASE);
+	return true;
+}
+
+///
+/// Reports the suppressed repeats of a thread's last error, if there are any.
+///
+/// @param out  The logging state of the current thread, used for output.
+/// @param ls   The logging state of the thread whose repeats are to be reported.
+///
+static void
+log_repeats(log_state *out, log_state *ls)
+{
+	uint32_t dropped = __atomic_exchange_n(&ls->rep_dropped, 0, __ATOMIC_RELAXED);
+
+	if (dropped == 0) {
+		return;
+	}
+
+	log_timestamp(out);
+	char line[200];
+	int32_t len = snprintf(line, sizeof line, "%.*s[ERR] [%5d] Last error repeated %u more "
+			"time(s)\n", (int32_t)out->ts_len, out->ts, (int32_t)(ls->tid % 100000), dropped);
+	log_put(out, line, (size_t)len < sizeof line ? (size_t)len : sizeof line - 1);
+}
+
+///
+/// Destructor of a thread's logging state. Reports the suppressed repeats of the thread's last
+/// error and passes the state on to the next new thread.
+///
+/// @param cont  The logging state.
+///
+static void
+log_release(void *cont)
+{
+	log_state *ls = cont;
+	log_repeats(ls, ls);
+	__atomic_store_n(&ls->owned, 0, __ATOMIC_RELEASE);
+}
+
+///
+/// Creates the key of the per-thread logging states. Invoked via `pthread_once()`.
+///
+static void
+log_init_key(void)
+{
+	if (pthread_key_create(&log_key, log_release) != 0) {
+		log_fatal("Error while creating log key");
+	}
+}
+
+///
+/// Returns the current thread's logging state. Takes over the state of an exited thread, if
+/// there is one, or creates a new state.
+///
+/// @result  The logging state.
+///
+static log_state *
+log_get_state(void)
+{
+	pthread_once(&log_once, log_init_key);
+	log_state *ls = pthread_getspecific(log_key);
+
+	if (LIKELY(ls != NULL)) {
+		return ls;
+	}
+
+	for (ls = __atomic_load_n(&log_states, __ATOMIC_ACQUIRE); ls != NULL; ls = ls->next) {
+		uint32_t unowned = 0;
+
+		if (__atomic_compare_exchange_n(&ls->owned, &unowned, 1, false, __ATOMIC_ACQUIRE,
+				__ATOMIC_RELAXED)) {
+			break;
+		}
+	}
+
+	if (ls == NULL) {
+		// not safe_malloc(), which logs its errors
+		if ((ls = cf_malloc(sizeof (log_state))) == NULL) {
+			log_fatal("Error while allocating logging state");
+		}
+
+		memset(ls, 0, sizeof (log_state));
+		ls->owned = 1;
+
+		pthread_mutex_lock(&log_mutex);
+		ls->next = log_states;
+		__atomic_store_n(&log_states, ls, __ATOMIC_RELEASE);
+		pthread_mutex_unlock(&log_mutex);
+	}
+
+	// a taken-over state's repeats were reported when its thread exited
+	ls->tid = thread_id();
+	ls->rep_hash[0] = ls->rep_hash[1] = 0;
+	ls->rep_count = 0;
+	pthread_setspecific(log_key, ls);
+	return ls;
+}
+
+///
+/// Central log function. Writes a single log message. Reports an error message, which the
+/// same thread has already reported LOG_REPEAT_BURST times in the last LOG_REPEAT_WINDOW
+/// seconds, only as a count.
 ///
 /// @param tag     The severity tag.
 /// @param prefix  A prefix to be prepended to the log message.
@@ -79,60 +344,144 @@ thread_id(void)
 static void
 log_line(const char *tag, const char *prefix, const char *format, va_list args, bool error)
 {
-	char buffer[10000];
-	time_t now;
-	struct tm now_tm;
+	int32_t err_no = errno;
+	log_state *ls = log_get_state();
+	log_timestamp(ls);
 
-	if ((now = time(NULL)) == (time_t)-1) {
-		fprintf(stderr, "Error while getting current time, error %d, %s\n", errno, strerror(errno));
-		exit(EXIT_FAILURE);
+	char *buffer = ls->line;
+	size_t size = sizeof ls->line;
+	size_t index = ls->ts_len;
+	memcpy(buffer, ls->ts, index);
+
+	index += (size_t)snprintf(buffer + index, size - index, "[%s] [%5d] ", tag,
+			(int32_t)(ls->tid % 100000));
+	size_t msg_index = index;
+
+	index += (size_t)snprintf(buffer + index, size - index, "%s", prefix);
+
+	if (index < size) {
+		index += (size_t)vsnprintf(buffer + index, size - index, format, args);
 	}
 
-	if (gmtime_r(&now, &now_tm) == NULL) {
-		fprintf(stderr, "Error while calculating GMT, error %d, %s\n", errno, strerror(errno));
+	if (error && index < size) {
+		index += (size_t)snprintf(buffer + index, size - index, " (error %d: %s)", err_no,
+				strerror(err_no));
+	}
+
+	// leave room for the '\n'
+	if (index >= size - 1) {
+		fprintf(stderr, "Buffer overflow while creating log message\n");
 		exit(EXIT_FAILURE);
 	}
 
-	size_t index = 0;
-	size_t length = strftime(buffer + index, sizeof buffer, "%Y-%m-%d %H:%M:%S %Z ", &now_tm);
+	if (strcmp(tag, "ERR") == 0) {
+		uint64_t hash[2];
+		murmur_hash_128(buffer + msg_index, index - msg_index, hash);
 
-	if (length == 0) {
-		fprintf(stderr, "Error while converting time to string, error %d, %s\n", errno,
-				strerror(errno));
-		exit(EXIT_FAILURE);
+		if (hash[0] == ls->rep_hash[0] && hash[1] == ls->rep_hash[1] &&
+				ls->ts_sec - ls->rep_start < LOG_REPEAT_WINDOW) {
+			if (++ls->rep_count > LOG_REPEAT_BURST) {
+				__atomic_add_fetch(&ls->rep_dropped, 1, __ATOMIC_RELAXED);
+				return;
+			}
+		} else {
+			log_repeats(ls, ls);
+			ls->rep_hash[0] = hash[0];
+			ls->rep_hash[1] = hash[1];
+			ls->rep_start = ls->ts_sec;
+			ls->rep_count = 1;
+		}
 	}
 
-	index += length;
-	length = (size_t)snprintf(buffer + index, sizeof buffer - index, "[%s] [%5d] %s", tag,
-			(int32_t)(thread_id() % 100000), prefix);
-	index += length;
+	buffer[index++] = '\n';
+	log_put(ls, buffer, index);
+}
 
-	length = (size_t)vsnprintf(buffer + index, sizeof buffer - index, format, args);
-	index += length;
+///
+/// Main thread function of the log thread. Drains the threads' log rings until log_stop() is
+/// called.
+///
+/// @param cont  Unused.
+///
+/// @result      Always `EXIT_SUCCESS`.
+///
+static void *
+log_thread_func(void *cont)
+{
+	(void)cont;
 
-	if (index >= sizeof buffer) {
-		fprintf(stderr, "Buffer overflow while creating log message\n");
-		exit(EXIT_FAILURE);
-	}
+	while (!log_stopping) {
+		bool busy = false;
 
-	if (error) {
-		length = (size_t)snprintf(buffer + index, sizeof buffer - index, " (error %d: %s)", errno,
-				strerror(errno));
-		index += length;
+		for (log_state *ls = __atomic_load_n(&log_states, __ATOMIC_ACQUIRE); ls != NULL;
+				ls = ls->next) {
+			busy |= log_drain(ls);
+		}
 
-		if (index >= sizeof buffer) {
-			fprintf(stderr, "Buffer overflow while creating log message\n");
-			exit(EXIT_FAILURE);
+		if (!busy) {
+			usleep(LOG_DRAIN_MS * 1000);
 		}
 	}
 
-	if (index >= sizeof buffer) {
-		fprintf(stderr, "Buffer overflow while creating log message\n");
-		exit(EXIT_FAILURE);
+	return (void *)EXIT_SUCCESS;
+}
+
+///
+/// Makes logging asynchronous: from now on, threads append their log lines to per-thread log
+/// rings and a log thread writes them to `stderr`. Until log_stop() is called.
+///
+/// @result  `true`, if successful.
+///
+bool
+log_start(void)
+{
+	if (log_async) {
+		return true;
+	}
+
+	log_stopping = false;
+	log_async = true;
+
+	if (pthread_create(&log_thread, NULL, log_thread_func, NULL) != 0) {
+		log_async = false;
+		err_code("Error while creating log thread");
+		return false;
+	}
+
+	static bool exit_hook = false;
+
+	// don't lose the pending log lines when exiting on an error
+	if (!exit_hook) {
+		atexit(log_stop);
+		exit_hook = true;
 	}
 
-	buffer[index] = 0;
-	fprintf(stderr, "%s\n", buffer);
+	return true;
+}
+
+///
+/// Makes logging synchronous again: stops the log thread, writes the pending log lines, and
+/// reports the suppressed repeats of all threads. Lines that other threads log concurrently
+/// with this call may come out after these.
+///
+void
+log_stop(void)
+{
+	if (!log_async) {
+		return;
+	}
+
+	log_stopping = true;
+	pthread_join(log_thread, NULL);
+	log_async = false;
+
+	log_state *out = log_get_state();
+
+	for (log_state *ls = __atomic_load_n(&log_states, __ATOMIC_ACQUIRE); ls != NULL;
+			ls = ls->next) {
+		log_drain(ls);
+		log_repeats(out, ls);
+	}
 }
 
 ///
@@ -719,6 +1068,119 @@ format_eta(int32_t seconds, char *buffer, size_t size)
 	}
 }
 
+///
+/// Mixes the bits of a 64-bit hash lane. The MurmurHash3 finalizer.
+///
+/// @param k  The lane.
+///
+/// @result   The mixed lane.
+///
+static inline uint64_t
+murmur_fmix(uint64_t k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+	return k;
+}
+
+///
+/// Computes the 128-bit MurmurHash3 (x64 variant, seed 0) of the given data.
+///
+/// @param data  The data to be hashed.
+/// @param size  The size of the data.
+/// @param hash  Receives the two 64-bit halves of the hash.
+///
+void
+murmur_hash_128(const void *data, size_t size, uint64_t hash[2])
+{
+	static const uint64_t c1 = 0x87c37b91114253d5ULL;
+	static const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+	const uint8_t *bytes = data;
+	size_t n_blocks = size / 16;
+	uint64_t h1 = 0;
+	uint64_t h2 = 0;
+
+	for (size_t i = 0; i < n_blocks; ++i) {
+		uint64_t k1;
+		uint64_t k2;
+		memcpy(&k1, bytes + i * 16, 8);
+		memcpy(&k2, bytes + i * 16 + 8, 8);
+
+		k1 *= c1;
+		k1 = (k1 << 31) | (k1 >> 33);
+		k1 *= c2;
+		h1 ^= k1;
+
+		h1 = (h1 << 27) | (h1 >> 37);
+		h1 += h2;
+		h1 = h1 * 5 + 0x52dce729;
+
+		k2 *= c2;
+		k2 = (k2 << 33) | (k2 >> 31);
+		k2 *= c1;
+		h2 ^= k2;
+
+		h2 = (h2 << 31) | (h2 >> 33);
+		h2 += h1;
+		h2 = h2 * 5 + 0x38495ab5;
+	}
+
+	const uint8_t *tail = bytes + n_blocks * 16;
+	uint64_t k1 = 0;
+	uint64_t k2 = 0;
+
+	switch (size & 15) {
+	case 15: k2 ^= (uint64_t)tail[14] << 48; // fall through
+	case 14: k2 ^= (uint64_t)tail[13] << 40; // fall through
+	case 13: k2 ^= (uint64_t)tail[12] << 32; // fall through
+	case 12: k2 ^= (uint64_t)tail[11] << 24; // fall through
+	case 11: k2 ^= (uint64_t)tail[10] << 16; // fall through
+	case 10: k2 ^= (uint64_t)tail[9] << 8; // fall through
+	case 9:
+		k2 ^= (uint64_t)tail[8];
+		k2 *= c2;
+		k2 = (k2 << 33) | (k2 >> 31);
+		k2 *= c1;
+		h2 ^= k2;
+		// fall through
+	case 8: k1 ^= (uint64_t)tail[7] << 56; // fall through
+	case 7: k1 ^= (uint64_t)tail[6] << 48; // fall through
+	case 6: k1 ^= (uint64_t)tail[5] << 40; // fall through
+	case 5: k1 ^= (uint64_t)tail[4] << 32; // fall through
+	case 4: k1 ^= (uint64_t)tail[3] << 24; // fall through
+	case 3: k1 ^= (uint64_t)tail[2] << 16; // fall through
+	case 2: k1 ^= (uint64_t)tail[1] << 8; // fall through
+	case 1:
+		k1 ^= (uint64_t)tail[0];
+		k1 *= c1;
+		k1 = (k1 << 31) | (k1 >> 33);
+		k1 *= c2;
+		h1 ^= k1;
+		break;
+	default:
+		break;
+	}
+
+	h1 ^= (uint64_t)size;
+	h2 ^= (uint64_t)size;
+
+	h1 += h2;
+	h2 += h1;
+
+	h1 = murmur_fmix(h1);
+	h2 = murmur_fmix(h2);
+
+	h1 += h2;
+	h2 += h1;
+
+	hash[0] = h1;
+	hash[1] = h2;
+}
+
 ///
 /// Formats a character as a string. Unprintable characters use "\x..." notation.
 ///
@@ -754,6 +1216,130 @@ print_char(int32_t ch)
 	return buff[i];
 }
 
+///
+/// Enlarges an output buffer, so that it can hold the given number of additional bytes. Used by
+/// output_buffer_reserve().
+///
+/// @param buf   The output buffer.
+/// @param size  The number of bytes to be appended.
+///
+/// @result      `true`, if successful.
+///
+bool
+output_buffer_grow(output_buffer *buf, size_t size)
+{
+	size_t capacity = buf->capacity == 0 ? 4096 : buf->capacity;
+
+	while (capacity < buf->size + size) {
+		capacity *= 2;
+	}
+
+	char *data = cf_realloc(buf->data, capacity);
+
+	if (data == NULL) {
+		err_code("Error while allocating %zu byte(s) for output buffer", capacity);
+		return false;
+	}
+
+	buf->data = data;
+	buf->capacity = capacity;
+	return true;
+}
+
+///
+/// Frees the memory held by an output buffer.
+///
+/// @param buf  The output buffer.
+///
+void
+output_buffer_free(output_buffer *buf)
+{
+	cf_free(buf->data);
+	buf->data = NULL;
+	buf->size = 0;
+	buf->capacity = 0;
+}
+
+///
+/// Initializes an empty value arena.
+///
+/// @param arena  The value arena.
+///
+void
+value_arena_init(value_arena *arena)
+{
+	as_vector_init(&arena->blocks, sizeof (arena_block), 4);
+	arena->block = 0;
+	arena->used = 0;
+}
+
+///
+/// Allocates memory from a value arena. The memory is 8-byte aligned and stays valid until the
+/// arena is reset or freed.
+///
+/// @param arena  The value arena.
+/// @param size   The number of bytes to allocate.
+///
+/// @result       The allocated memory.
+///
+void *
+value_arena_alloc(value_arena *arena, size_t size)
+{
+	size = (size + 7) & ~(size_t)7;
+
+	// blocks that are too small for this allocation get their next chance after the next reset
+	while (arena->block < arena->blocks.size) {
+		arena_block *blk = as_vector_get(&arena->blocks, arena->block);
+
+		if (blk->size - arena->used >= size) {
+			void *res = (uint8_t *)blk->data + arena->used;
+			arena->used += size;
+			return res;
+		}
+
+		++arena->block;
+		arena->used = 0;
+	}
+
+	arena_block blk;
+	blk.size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+	blk.data = safe_malloc(blk.size);
+	as_vector_append(&arena->blocks, &blk);
+
+	arena->used = size;
+	return blk.data;
+}
+
+///
+/// Releases all allocations from a value arena at once. Keeps the arena's blocks.
+///
+/// @param arena  The value arena.
+///
+void
+value_arena_reset(value_arena *arena)
+{
+	arena->block = 0;
+	arena->used = 0;
+}
+
+///
+/// Frees the memory held by a value arena.
+///
+/// @param arena  The value arena.
+///
+void
+value_arena_free(value_arena *arena)
+{
+	for (uint32_t i = 0; i < arena->blocks.size; ++i) {
+		arena_block *blk = as_vector_get(&arena->blocks, i);
+		cf_free(blk->data);
+	}
+
+	as_vector_destroy(&arena->blocks);
+	arena->block = 0;
+	arena->used = 0;
+}
+
 ///
 /// Obtains the node IDs of the cluster from the Aerospike client library. Optionally only
 /// considers user-specified nodes.